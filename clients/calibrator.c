@@ -117,6 +117,7 @@ finish_calibration (struct calibrator *calibrator)
 		m.d[i + 8] = 1;
 	}
 	m.d[15] = 1;
+	m.type = WESTON_MATRIX_TRANSFORM_OTHER;
 
 	weston_matrix_invert(&inverse, &m);
 
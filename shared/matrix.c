@@ -36,6 +36,13 @@
 
 #include "matrix.h"
 
+#if defined(__SSE__)
+#include <xmmintrin.h>
+#define MATRIX_SSE 1
+#elif defined(__ARM_NEON__) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#define MATRIX_NEON 1
+#endif
 
 /*
  * Matrices are stored in column-major order, that is the array indices are:
@@ -56,23 +63,90 @@ weston_matrix_init(struct weston_matrix *matrix)
 	memcpy(matrix, &identity, sizeof identity);
 }
 
-/* m <- n * m, that is, m is multiplied on the LEFT. */
-WL_EXPORT void
-weston_matrix_multiply(struct weston_matrix *m, const struct weston_matrix *n)
+/*
+ * The type bits tell which helpers built a matrix.  Hand-built matrices
+ * carry WESTON_MATRIX_TRANSFORM_OTHER and always take the general path.
+ * Anything without it is affine with a last row of 0 0 0 1,
+ * and rotation only ever mixes x and y, so the fast paths below only
+ * need to look at the elements those helpers can change.
+ */
+#define AFFINE_TYPES (WESTON_MATRIX_TRANSFORM_TRANSLATE | \
+		      WESTON_MATRIX_TRANSFORM_SCALE | \
+		      WESTON_MATRIX_TRANSFORM_ROTATE)
+
+/* Column i of n * m is n times column i of m: the columns of n
+ * weighted by the elements of that column. */
+static inline void
+multiply_columns(float *out, const float *m, const float *n)
 {
-	struct weston_matrix tmp;
-	const float *row, *column;
-	div_t d;
+#if defined(MATRIX_SSE)
+	__m128 c0 = _mm_loadu_ps(n + 0), c1 = _mm_loadu_ps(n + 4);
+	__m128 c2 = _mm_loadu_ps(n + 8), c3 = _mm_loadu_ps(n + 12);
+	__m128 r;
+	int i;
+
+	for (i = 0; i < 16; i += 4) {
+		r = _mm_mul_ps(c0, _mm_set1_ps(m[i + 0]));
+		r = _mm_add_ps(r, _mm_mul_ps(c1, _mm_set1_ps(m[i + 1])));
+		r = _mm_add_ps(r, _mm_mul_ps(c2, _mm_set1_ps(m[i + 2])));
+		r = _mm_add_ps(r, _mm_mul_ps(c3, _mm_set1_ps(m[i + 3])));
+		_mm_storeu_ps(out + i, r);
+	}
+#elif defined(MATRIX_NEON)
+	float32x4_t c0 = vld1q_f32(n + 0), c1 = vld1q_f32(n + 4);
+	float32x4_t c2 = vld1q_f32(n + 8), c3 = vld1q_f32(n + 12);
+	float32x4_t r;
+	int i;
+
+	for (i = 0; i < 16; i += 4) {
+		r = vmulq_n_f32(c0, m[i + 0]);
+		r = vmlaq_n_f32(r, c1, m[i + 1]);
+		r = vmlaq_n_f32(r, c2, m[i + 2]);
+		r = vmlaq_n_f32(r, c3, m[i + 3]);
+		vst1q_f32(out + i, r);
+	}
+#else
 	int i, j;
 
 	for (i = 0; i < 16; i++) {
-		tmp.d[i] = 0;
-		d = div(i, 4);
-		row = m->d + d.quot * 4;
-		column = n->d + d.rem;
+		out[i] = 0;
 		for (j = 0; j < 4; j++)
-			tmp.d[i] += row[j] * column[j * 4];
+			out[i] += m[(i & ~3) + j] * n[(i & 3) + j * 4];
 	}
+#endif
+}
+
+/* m <- n * m, that is, m is multiplied on the LEFT. */
+WL_EXPORT void
+weston_matrix_multiply(struct weston_matrix *m, const struct weston_matrix *n)
+{
+	struct weston_matrix tmp;
+	int i;
+
+	switch (n->type) {
+	case 0:
+		/* identity */
+		return;
+	case WESTON_MATRIX_TRANSFORM_TRANSLATE:
+		/* adds w times the translation to x, y and z */
+		for (i = 0; i < 16; i += 4) {
+			m->d[i + 0] += n->d[12] * m->d[i + 3];
+			m->d[i + 1] += n->d[13] * m->d[i + 3];
+			m->d[i + 2] += n->d[14] * m->d[i + 3];
+		}
+		m->type |= n->type;
+		return;
+	case WESTON_MATRIX_TRANSFORM_SCALE:
+		for (i = 0; i < 16; i += 4) {
+			m->d[i + 0] *= n->d[0];
+			m->d[i + 1] *= n->d[5];
+			m->d[i + 2] *= n->d[10];
+		}
+		m->type |= n->type;
+		return;
+	}
+
+	multiply_columns(tmp.d, m->d, n->d);
 	tmp.type = m->type | n->type;
 	memcpy(m, &tmp, sizeof tmp);
 }
@@ -114,16 +188,50 @@ weston_matrix_rotate_xy(struct weston_matrix *matrix, float cos, float sin)
 WL_EXPORT void
 weston_matrix_transform(struct weston_matrix *matrix, struct weston_vector *v)
 {
-	int i, j;
+	const float *d = matrix->d;
+#if defined(MATRIX_SSE)
+	__m128 r;
+#elif defined(MATRIX_NEON)
+	float32x4_t r;
+#else
 	struct weston_vector t;
+	int i, j;
+#endif
+
+	switch (matrix->type) {
+	case 0:
+		return;
+	case WESTON_MATRIX_TRANSFORM_TRANSLATE:
+		v->f[0] += d[12] * v->f[3];
+		v->f[1] += d[13] * v->f[3];
+		v->f[2] += d[14] * v->f[3];
+		return;
+	}
 
+#if defined(MATRIX_SSE)
+	r = _mm_mul_ps(_mm_loadu_ps(d + 0), _mm_set1_ps(v->f[0]));
+	r = _mm_add_ps(r, _mm_mul_ps(_mm_loadu_ps(d + 4),
+				     _mm_set1_ps(v->f[1])));
+	r = _mm_add_ps(r, _mm_mul_ps(_mm_loadu_ps(d + 8),
+				     _mm_set1_ps(v->f[2])));
+	r = _mm_add_ps(r, _mm_mul_ps(_mm_loadu_ps(d + 12),
+				     _mm_set1_ps(v->f[3])));
+	_mm_storeu_ps(v->f, r);
+#elif defined(MATRIX_NEON)
+	r = vmulq_n_f32(vld1q_f32(d + 0), v->f[0]);
+	r = vmlaq_n_f32(r, vld1q_f32(d + 4), v->f[1]);
+	r = vmlaq_n_f32(r, vld1q_f32(d + 8), v->f[2]);
+	r = vmlaq_n_f32(r, vld1q_f32(d + 12), v->f[3]);
+	vst1q_f32(v->f, r);
+#else
 	for (i = 0; i < 4; i++) {
 		t.f[i] = 0;
 		for (j = 0; j < 4; j++)
-			t.f[i] += v->f[j] * matrix->d[i + j * 4];
+			t.f[i] += v->f[j] * d[i + j * 4];
 	}
 
 	*v = t;
+#endif
 }
 
 static inline void
@@ -253,6 +361,47 @@ inverse_transform(const double *LU, const unsigned *p, float *v)
 		v[j] = b[j];
 }
 
+/*
+ * Inverse of an affine matrix without WESTON_MATRIX_TRANSFORM_OTHER:
+ *
+ *	| A  t |^-1   | A^-1  -A^-1 t |
+ *	| 0  1 |    = | 0      1      |
+ *
+ * where A is a 2x2 block in x and y plus a z scale.
+ */
+static int
+matrix_invert_affine(struct weston_matrix *inverse,
+		     const struct weston_matrix *matrix)
+{
+	const float *d = matrix->d;
+	double a, b, c, e, det, z;
+	double tx = d[12], ty = d[13], tz = d[14];
+	unsigned int type = matrix->type;
+
+	a = d[0];
+	b = d[4];
+	c = d[1];
+	e = d[5];
+	det = a * e - b * c;
+	if (fabs(det) < 1e-9 || fabs(d[10]) < 1e-9)
+		return -1;
+	z = 1.0 / d[10];
+	det = 1.0 / det;
+
+	weston_matrix_init(inverse);
+	inverse->d[0] = e * det;
+	inverse->d[4] = -b * det;
+	inverse->d[1] = -c * det;
+	inverse->d[5] = a * det;
+	inverse->d[10] = z;
+	inverse->d[12] = -(e * tx - b * ty) * det;
+	inverse->d[13] = -(a * ty - c * tx) * det;
+	inverse->d[14] = -tz * z;
+	inverse->type = type;
+
+	return 0;
+}
+
 WL_EXPORT int
 weston_matrix_invert(struct weston_matrix *inverse,
 		     const struct weston_matrix *matrix)
@@ -261,6 +410,14 @@ weston_matrix_invert(struct weston_matrix *inverse,
 	unsigned perm[4];	/* permutation */
 	unsigned c;
 
+	if (matrix->type == 0) {
+		weston_matrix_init(inverse);
+		return 0;
+	}
+
+	if ((matrix->type & ~AFFINE_TYPES) == 0)
+		return matrix_invert_affine(inverse, matrix);
+
 	if (matrix_invert(LU, perm, matrix) < 0)
 		return -1;
 
@@ -35,6 +35,9 @@ enum weston_matrix_transform_type {
 	WESTON_MATRIX_TRANSFORM_OTHER		= (1 << 3),
 };
 
+/* type tells which of the weston_matrix_* helpers built the matrix and
+ * selects their fast paths; 0 means identity.  Code that fills in d[]
+ * by hand must set WESTON_MATRIX_TRANSFORM_OTHER. */
 struct weston_matrix {
 	float d[16];
 	unsigned int type;
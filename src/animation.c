@@ -44,24 +44,15 @@ weston_spring_init(struct weston_spring *spring,
 	spring->clip = WESTON_SPRING_OVERSHOOT;
 	spring->min = 0.0;
 	spring->max = 1.0;
+	spring->solver = WESTON_SPRING_SOLVER_STEP;
+	spring->segment.valid = 0;
 }
 
-WL_EXPORT void
-weston_spring_update(struct weston_spring *spring, uint32_t msec)
+static void
+weston_spring_update_step(struct weston_spring *spring, uint32_t msec)
 {
 	double force, v, current, step;
 
-	/* Limit the number of executions of the loop below by ensuring that
-	 * the timestamp for last update of the spring is no more than 1s ago.
-	 * This handles the case where time moves backwards or forwards in
-	 * large jumps.
-	 */
-	if (msec - spring->timestamp > 1000) {
-		weston_log("unexpectedly large timestamp jump (from %u to %u)\n",
-			   spring->timestamp, msec);
-		spring->timestamp = msec - 1000;
-	}
-
 	step = 0.01;
 	while (4 < msec - spring->timestamp) {
 		current = spring->current;
@@ -82,7 +73,7 @@ weston_spring_update(struct weston_spring *spring, uint32_t msec)
 			if (spring->current > spring->max) {
 				spring->current = spring->max;
 				spring->previous = spring->max;
-			} else if (spring->current < 0.0) {
+			} else if (spring->current < spring->min) {
 				spring->current = spring->min;
 				spring->previous = spring->min;
 			}
@@ -107,6 +98,369 @@ weston_spring_update(struct weston_spring *spring, uint32_t msec)
 	}
 }
 
+/* The step solver above is the linear recurrence
+ *
+ *	e[n+1] = p e[n] - q e[n-1],	e = current - target
+ *
+ * with p = 2 - k/1e5 - (1 + friction)/1e4 and q = 1 - (1 + friction)/1e4.
+ * Its solutions are sums of powers of the roots of r² - p r + q, which
+ * the analytic solver evaluates at fractional n, so the trajectory
+ * matches the step solver on every 4 ms boundary and is exact at the
+ * frame time in between.
+ */
+enum spring_roots_type {
+	SPRING_ROOTS_COMPLEX,	/* underdamped: l1 = log|r|, l2 = arg r */
+	SPRING_ROOTS_REAL,	/* overdamped: l1, l2 = log r1, log r2 */
+	SPRING_ROOTS_DOUBLE	/* critically damped: l1 = log r */
+};
+
+struct spring_roots {
+	enum spring_roots_type type;
+	double l1, l2;
+};
+
+static int
+spring_roots(const struct weston_spring *spring, struct spring_roots *roots)
+{
+	double p, q, disc, r1, r2;
+
+	q = 1.0 - (1.0 + spring->friction) * 1e-4;
+	p = 1.0 + q - spring->k * 1e-5;
+	if (q <= 0.0)
+		return -1;
+
+	disc = p * p - 4.0 * q;
+	if (disc < -1e-12) {
+		roots->type = SPRING_ROOTS_COMPLEX;
+		roots->l1 = 0.5 * log(q);
+		roots->l2 = acos(p / (2.0 * sqrt(q)));
+	} else if (disc > 1e-12) {
+		r1 = (p + sqrt(disc)) / 2.0;
+		r2 = (p - sqrt(disc)) / 2.0;
+		if (r2 <= 0.0)
+			return -1;
+		roots->type = SPRING_ROOTS_REAL;
+		roots->l1 = log(r1);
+		roots->l2 = log(r2);
+	} else {
+		if (p <= 0.0)
+			return -1;
+		roots->type = SPRING_ROOTS_DOUBLE;
+		roots->l1 = log(p / 2.0);
+	}
+
+	return 0;
+}
+
+/* Slope at n = 0 of the solution through e[-1] = em1 and e[0] = e0. */
+static double
+spring_roots_slope(const struct spring_roots *roots, double e0, double em1)
+{
+	double a, b, s, d;
+
+	switch (roots->type) {
+	case SPRING_ROOTS_COMPLEX:
+		a = roots->l1;
+		b = roots->l2;
+		s = (e0 * cos(b) - em1 * exp(a)) / sin(b);
+		return a * e0 + b * s;
+	case SPRING_ROOTS_REAL:
+		a = (em1 - e0 * exp(-roots->l2)) /
+			(exp(-roots->l1) - exp(-roots->l2));
+		return a * roots->l1 + (e0 - a) * roots->l2;
+	case SPRING_ROOTS_DOUBLE:
+	default:
+		d = e0 - em1 * exp(roots->l1);
+		return d + roots->l1 * e0;
+	}
+}
+
+/* Offset and slope at n of the solution with e(0) = e0, e'(0) = v0. */
+static void
+spring_roots_eval(const struct spring_roots *roots,
+		  double e0, double v0, double n, double *e, double *v)
+{
+	double a, b, c, s, x, x1, x2;
+
+	switch (roots->type) {
+	case SPRING_ROOTS_COMPLEX:
+		s = (v0 - roots->l1 * e0) / roots->l2;
+		x = exp(roots->l1 * n);
+		c = cos(roots->l2 * n);
+		b = sin(roots->l2 * n);
+		*e = x * (e0 * c + s * b);
+		*v = roots->l1 * *e + x * roots->l2 * (s * c - e0 * b);
+		break;
+	case SPRING_ROOTS_REAL:
+		a = (v0 - roots->l2 * e0) / (roots->l1 - roots->l2);
+		x1 = exp(roots->l1 * n);
+		x2 = exp(roots->l2 * n);
+		*e = a * x1 + (e0 - a) * x2;
+		*v = a * roots->l1 * x1 + (e0 - a) * roots->l2 * x2;
+		break;
+	case SPRING_ROOTS_DOUBLE:
+	default:
+		x = exp(roots->l1 * n);
+		*e = (e0 + (v0 - roots->l1 * e0) * n) * x;
+		*v = (v0 - roots->l1 * e0) * x + roots->l1 * *e;
+		break;
+	}
+}
+
+static int
+spring_segment_is_current(const struct weston_spring *spring)
+{
+	return spring->segment.valid &&
+		spring->segment.k == spring->k &&
+		spring->segment.friction == spring->friction &&
+		spring->segment.current == spring->current &&
+		spring->segment.previous == spring->previous &&
+		spring->segment.target == spring->target &&
+		spring->segment.timestamp == spring->timestamp;
+}
+
+static double
+spring_segment_steps(const struct weston_spring *spring, uint32_t msec)
+{
+	return (double) (msec - spring->segment.start) / 4.0 -
+		spring->segment.origin;
+}
+
+static int
+spring_is_clipped(const struct weston_spring *spring, double x)
+{
+	return spring->clip != WESTON_SPRING_OVERSHOOT &&
+		(x > spring->max || x < spring->min);
+}
+
+/* Extrema of the solution with e(0) = e0, e'(0) = v0 after n, in
+ * order.  The trajectory is monotonic between them.  An underdamped
+ * one has extrema every half period, of shrinking size and
+ * alternating sign, so once two in a row are inside the bounds all
+ * later ones are too and only the first two are returned. */
+static int
+spring_roots_extrema(const struct spring_roots *roots,
+		     double e0, double v0, double n, double *t)
+{
+	double a, b, c, phase, k, ratio;
+
+	switch (roots->type) {
+	case SPRING_ROOTS_COMPLEX:
+		/* e = |r|^n A cos(l2 n - phase) has e' = 0 where
+		 * tan(l2 n - phase) = l1 / l2. */
+		b = (v0 - roots->l1 * e0) / roots->l2;
+		if (e0 == 0.0 && b == 0.0)
+			return 0;
+		phase = atan2(b, e0) + atan(roots->l1 / roots->l2);
+		k = floor(((n + 1e-9) * roots->l2 - phase) / M_PI) + 1.0;
+		t[0] = (phase + k * M_PI) / roots->l2;
+		t[1] = t[0] + M_PI / roots->l2;
+		return 2;
+	case SPRING_ROOTS_REAL:
+		a = (v0 - roots->l2 * e0) / (roots->l1 - roots->l2);
+		b = e0 - a;
+		if (a == 0.0)
+			return 0;
+		ratio = -b * roots->l2 / (a * roots->l1);
+		if (ratio <= 0.0)
+			return 0;
+		t[0] = log(ratio) / (roots->l1 - roots->l2);
+		break;
+	case SPRING_ROOTS_DOUBLE:
+	default:
+		c = v0 - roots->l1 * e0;
+		if (c == 0.0)
+			return 0;
+		t[0] = -v0 / (roots->l1 * c);
+		break;
+	}
+
+	return t[0] > n + 1e-9;
+}
+
+/* Where the monotonic trajectory between lo, inside the bounds, and
+ * hi, outside, reaches the bound: Newton's method, falling back to
+ * bisection when it leaves the bracket. */
+static double
+spring_segment_crossing(const struct weston_spring *spring,
+			const struct spring_roots *roots,
+			double bound, double lo, double hi)
+{
+	double x, next, e, v, f;
+	int i;
+
+	x = hi;
+	for (i = 0; i < 30 && hi - lo > 1e-9; i++) {
+		spring_roots_eval(roots, spring->segment.e0,
+				  spring->segment.v0, x, &e, &v);
+		f = spring->target + e - bound;
+		if (fabs(f) < 1e-12)
+			return x;
+		if (spring_is_clipped(spring, spring->target + e))
+			hi = x;
+		else
+			lo = x;
+
+		next = v != 0.0 ? x - f / v : lo;
+		if (next <= lo || next >= hi)
+			next = (lo + hi) / 2.0;
+		x = next;
+	}
+
+	return lo;
+}
+
+/* Follow the trajectory from the last update up to n_end and restart
+ * it at the bound wherever it leaves [min, max]: with zero slope for
+ * CLAMP, reflected for BOUNCE.  Crossings can only happen in the
+ * monotonic stretches up to the next two extrema, so the work does not
+ * depend on how long ago the last update was.  Returns n_end in the
+ * coordinates of the segment that is current afterwards. */
+static double
+spring_segment_clip(struct weston_spring *spring,
+		    const struct spring_roots *roots, double n, double n_end)
+{
+	double t[3], lo, hi, e, v, bound;
+	int i, count, restarts = 0;
+
+	while (n < n_end && restarts < 32) {
+		count = spring_roots_extrema(roots, spring->segment.e0,
+					     spring->segment.v0, n, t);
+		t[count++] = n_end;
+
+		lo = n;
+		hi = n_end;
+		e = 0.0;
+		for (i = 0; i < count; i++) {
+			hi = t[i] < n_end ? t[i] : n_end;
+			spring_roots_eval(roots, spring->segment.e0,
+					  spring->segment.v0, hi, &e, &v);
+			if (spring_is_clipped(spring, spring->target + e))
+				break;
+			lo = hi;
+			if (hi >= n_end)
+				break;
+		}
+		if (i == count || !spring_is_clipped(spring,
+						     spring->target + e))
+			break;
+
+		bound = spring->target + e > spring->max ?
+			spring->max : spring->min;
+		lo = spring_segment_crossing(spring, roots, bound, lo, hi);
+
+		spring_roots_eval(roots, spring->segment.e0,
+				  spring->segment.v0, lo, &e, &v);
+		spring->segment.origin += lo;
+		spring->segment.e0 = bound - spring->target;
+		spring->segment.v0 =
+			spring->clip == WESTON_SPRING_CLAMP ? 0.0 : -v;
+		n_end -= lo;
+		n = 0.0;
+		restarts++;
+
+		/* Clamped against a bound the target lies beyond: the
+		 * spring stays there until the caller moves it. */
+		if (spring->clip == WESTON_SPRING_CLAMP &&
+		    (spring->target - bound) * (bound == spring->max ? 1 : -1)
+		    >= 0.0) {
+			spring->segment.pinned = 1;
+			break;
+		}
+	}
+
+	return n_end;
+}
+
+static void
+weston_spring_update_analytic(struct weston_spring *spring, uint32_t msec)
+{
+	struct spring_roots roots;
+	double n, n_end, e, v;
+
+	if (spring_roots(spring, &roots) < 0) {
+		spring->segment.valid = 0;
+		weston_spring_update_step(spring, msec);
+		return;
+	}
+
+	if (!spring_segment_is_current(spring)) {
+		spring->segment.valid = 1;
+		spring->segment.pinned = 0;
+		spring->segment.start = spring->timestamp;
+		spring->segment.origin = 0.0;
+		spring->segment.e0 = spring->current - spring->target;
+		spring->segment.v0 =
+			spring_roots_slope(&roots, spring->segment.e0,
+					   spring->previous - spring->target);
+	}
+
+	if (!spring->segment.pinned) {
+		n = spring_segment_steps(spring, spring->timestamp);
+		n_end = spring_segment_steps(spring, msec);
+		if (spring->clip != WESTON_SPRING_OVERSHOOT)
+			n_end = spring_segment_clip(spring, &roots, n, n_end);
+	}
+
+	if (spring->segment.pinned) {
+		spring->current = spring->target + spring->segment.e0;
+		spring->previous = spring->current;
+	} else {
+		spring_roots_eval(&roots, spring->segment.e0,
+				  spring->segment.v0, n_end, &e, &v);
+		spring->current = spring->target + e;
+		if (spring->clip != WESTON_SPRING_OVERSHOOT) {
+			if (spring->current > spring->max)
+				spring->current = spring->max;
+			else if (spring->current < spring->min)
+				spring->current = spring->min;
+		}
+		/* One step back on the same trajectory, so that seeding
+		 * from current and previous again reproduces it. */
+		if (spring->segment.origin == 0.0 || n_end >= 1.0) {
+			spring_roots_eval(&roots, spring->segment.e0,
+					  spring->segment.v0, n_end - 1.0,
+					  &e, &v);
+			spring->previous = spring->target + e;
+		} else {
+			spring->previous = spring->current - v;
+		}
+	}
+
+	spring->timestamp = msec;
+	spring->segment.k = spring->k;
+	spring->segment.friction = spring->friction;
+	spring->segment.current = spring->current;
+	spring->segment.previous = spring->previous;
+	spring->segment.target = spring->target;
+	spring->segment.timestamp = spring->timestamp;
+}
+
+WL_EXPORT void
+weston_spring_update(struct weston_spring *spring, uint32_t msec)
+{
+	/* Limit the amount of work done by the solvers by ensuring that
+	 * the timestamp for last update of the spring is no more than 1s ago.
+	 * This handles the case where time moves backwards or forwards in
+	 * large jumps.
+	 */
+	if (msec - spring->timestamp > 1000) {
+		weston_log("unexpectedly large timestamp jump (from %u to %u)\n",
+			   spring->timestamp, msec);
+		spring->timestamp = msec - 1000;
+	}
+
+	switch (spring->solver) {
+	case WESTON_SPRING_SOLVER_ANALYTIC:
+		weston_spring_update_analytic(spring, msec);
+		break;
+	case WESTON_SPRING_SOLVER_STEP:
+	default:
+		weston_spring_update_step(spring, msec);
+		break;
+	}
+}
+
 WL_EXPORT int
 weston_spring_done(struct weston_spring *spring)
 {
@@ -176,7 +530,7 @@ weston_surface_animation_frame(struct weston_animation *base,
 		animation->frame(animation);
 
 	weston_surface_geometry_dirty(animation->surface);
-	weston_compositor_schedule_repaint(animation->surface->compositor);
+	weston_surface_schedule_geometry_repaint(animation->surface);
 }
 
 static struct weston_surface_animation *
@@ -205,6 +559,7 @@ weston_surface_animation_run(struct weston_surface *surface,
 		       &animation->transform.link);
 	weston_spring_init(&animation->spring, 200.0, 0.0, 1.0);
 	animation->spring.friction = 700;
+	animation->spring.solver = surface->compositor->spring_solver;
 	animation->animation.frame_counter = 0;
 	animation->animation.frame = weston_surface_animation_frame;
 	weston_surface_animation_frame(&animation->animation, NULL, 0);
@@ -262,6 +617,7 @@ weston_zoom_run(struct weston_surface *surface, float start, float stop,
 	weston_spring_init(&zoom->spring, 300.0, start, stop);
 	zoom->spring.friction = 1400;
 	zoom->spring.previous = start - (stop - start) * 0.03;
+	zoom->spring.solver = surface->compositor->spring_solver;
 
 	return zoom;
 }
@@ -292,6 +648,7 @@ weston_fade_run(struct weston_surface *surface,
 
 	fade->spring.friction = 1400;
 	fade->spring.previous = -(end - start) * 0.03;
+	fade->spring.solver = surface->compositor->spring_solver;
 
 	surface->alpha = start;
 
@@ -26,7 +26,16 @@
 
 #include "compositor.h"
 
+enum binding_type {
+	BINDING_KEY,
+	BINDING_BUTTON,
+	BINDING_TOUCH,
+	BINDING_AXIS,
+	BINDING_DEBUG
+};
+
 struct weston_binding {
+	enum binding_type type;
 	uint32_t key;
 	uint32_t button;
 	uint32_t axis;
@@ -34,10 +43,124 @@ struct weston_binding {
 	void *handler;
 	void *data;
 	struct wl_list link;
+	struct weston_binding_table *table;
+	struct wl_list hash_link;
 };
 
+#define BINDING_TABLE_MIN_SIZE	32
+
+static uint32_t
+binding_hash(enum binding_type type, uint32_t code, uint32_t modifier)
+{
+	uint32_t h;
+
+	h = code * 0x9e3779b1;
+	h ^= (modifier << 8 | type) * 0x85ebca6b;
+	h ^= h >> 15;
+
+	return h;
+}
+
+static struct wl_list *
+binding_bucket(struct weston_binding_table *table,
+	       enum binding_type type, uint32_t code, uint32_t modifier)
+{
+	return &table->buckets[binding_hash(type, code, modifier) &
+			       table->mask];
+}
+
+static uint32_t
+binding_code(struct weston_binding *binding)
+{
+	switch (binding->type) {
+	case BINDING_BUTTON:
+		return binding->button;
+	case BINDING_AXIS:
+		return binding->axis;
+	default:
+		return binding->key;
+	}
+}
+
+WL_EXPORT void
+weston_binding_table_init(struct weston_binding_table *table)
+{
+	table->buckets = NULL;
+	table->mask = 0;
+	table->count = 0;
+	table->dispatching = 0;
+}
+
+WL_EXPORT void
+weston_binding_table_release(struct weston_binding_table *table)
+{
+	free(table->buckets);
+	weston_binding_table_init(table);
+}
+
+/* Moving the bindings bucket by bucket, appending to the new buckets,
+ * keeps bindings with the same hash key in registration order. */
+static int
+binding_table_resize(struct weston_binding_table *table, uint32_t size)
+{
+	struct wl_list *buckets;
+	struct weston_binding *binding, *next;
+	uint32_t i, old_size = table->buckets ? table->mask + 1 : 0;
+
+	buckets = malloc(size * sizeof *buckets);
+	if (buckets == NULL)
+		return -1;
+
+	for (i = 0; i < size; i++)
+		wl_list_init(&buckets[i]);
+
+	for (i = 0; i < old_size; i++) {
+		wl_list_for_each_safe(binding, next,
+				      &table->buckets[i], hash_link) {
+			wl_list_remove(&binding->hash_link);
+			wl_list_insert(buckets[binding_hash(binding->type,
+							    binding_code(binding),
+							    binding->modifier) &
+					       (size - 1)].prev,
+				       &binding->hash_link);
+		}
+	}
+
+	free(table->buckets);
+	table->buckets = buckets;
+	table->mask = size - 1;
+
+	return 0;
+}
+
+static int
+binding_table_insert(struct weston_binding_table *table,
+		     struct weston_binding *binding)
+{
+	uint32_t size = table->mask + 1;
+
+	/* Never rehash while a handler is running; the run functions
+	 * are still walking a bucket. */
+	if (table->buckets == NULL) {
+		if (binding_table_resize(table, BINDING_TABLE_MIN_SIZE) < 0)
+			return -1;
+	} else if (table->count >= 2 * size && !table->dispatching) {
+		binding_table_resize(table, 2 * size);
+	}
+
+	wl_list_insert(binding_bucket(table, binding->type,
+				      binding_code(binding),
+				      binding->modifier)->prev,
+		       &binding->hash_link);
+	binding->table = table;
+	table->count++;
+
+	return 0;
+}
+
 static struct weston_binding *
 weston_compositor_add_binding(struct weston_compositor *compositor,
+			      enum binding_type type, struct wl_list *list,
 			      uint32_t key, uint32_t button, uint32_t axis,
 			      uint32_t modifier, void *handler, void *data)
 {
@@ -47,6 +170,7 @@ weston_compositor_add_binding(struct weston_compositor *compositor,
 	if (binding == NULL)
 		return NULL;
 
+	binding->type = type;
 	binding->key = key;
 	binding->button = button;
 	binding->axis = axis;
@@ -54,6 +178,13 @@ weston_compositor_add_binding(struct weston_compositor *compositor,
 	binding->handler = handler;
 	binding->data = data;
 
+	if (binding_table_insert(&compositor->binding_table, binding) < 0) {
+		free(binding);
+		return NULL;
+	}
+
+	wl_list_insert(list->prev, &binding->link);
+
 	return binding;
 }
 
@@ -63,16 +194,10 @@ weston_compositor_add_key_binding(struct weston_compositor *compositor,
 				  weston_key_binding_handler_t handler,
 				  void *data)
 {
-	struct weston_binding *binding;
-
-	binding = weston_compositor_add_binding(compositor, key, 0, 0,
-						modifier, handler, data);
-	if (binding == NULL)
-		return NULL;
-
-	wl_list_insert(compositor->key_binding_list.prev, &binding->link);
-
-	return binding;
+	return weston_compositor_add_binding(compositor, BINDING_KEY,
+					     &compositor->key_binding_list,
+					     key, 0, 0, modifier,
+					     handler, data);
 }
 
 WL_EXPORT struct weston_binding *
@@ -81,16 +206,10 @@ weston_compositor_add_button_binding(struct weston_compositor *compositor,
 				     weston_button_binding_handler_t handler,
 				     void *data)
 {
-	struct weston_binding *binding;
-
-	binding = weston_compositor_add_binding(compositor, 0, button, 0,
-						modifier, handler, data);
-	if (binding == NULL)
-		return NULL;
-
-	wl_list_insert(compositor->button_binding_list.prev, &binding->link);
-
-	return binding;
+	return weston_compositor_add_binding(compositor, BINDING_BUTTON,
+					     &compositor->button_binding_list,
+					     0, button, 0, modifier,
+					     handler, data);
 }
 
 WL_EXPORT struct weston_binding *
@@ -99,16 +218,10 @@ weston_compositor_add_touch_binding(struct weston_compositor *compositor,
 				    weston_touch_binding_handler_t handler,
 				    void *data)
 {
-	struct weston_binding *binding;
-
-	binding = weston_compositor_add_binding(compositor, 0, 0, 0,
-						modifier, handler, data);
-	if (binding == NULL)
-		return NULL;
-
-	wl_list_insert(compositor->touch_binding_list.prev, &binding->link);
-
-	return binding;
+	return weston_compositor_add_binding(compositor, BINDING_TOUCH,
+					     &compositor->touch_binding_list,
+					     0, 0, 0, modifier,
+					     handler, data);
 }
 
 WL_EXPORT struct weston_binding *
@@ -117,16 +230,10 @@ weston_compositor_add_axis_binding(struct weston_compositor *compositor,
 				   weston_axis_binding_handler_t handler,
 				   void *data)
 {
-	struct weston_binding *binding;
-
-	binding = weston_compositor_add_binding(compositor, 0, 0, axis,
-						modifier, handler, data);
-	if (binding == NULL)
-		return NULL;
-
-	wl_list_insert(compositor->axis_binding_list.prev, &binding->link);
-
-	return binding;
+	return weston_compositor_add_binding(compositor, BINDING_AXIS,
+					     &compositor->axis_binding_list,
+					     0, 0, axis, modifier,
+					     handler, data);
 }
 
 WL_EXPORT struct weston_binding *
@@ -135,20 +242,17 @@ weston_compositor_add_debug_binding(struct weston_compositor *compositor,
 				    weston_key_binding_handler_t handler,
 				    void *data)
 {
-	struct weston_binding *binding;
-
-	binding = weston_compositor_add_binding(compositor, key, 0, 0, 0,
-						handler, data);
-
-	wl_list_insert(compositor->debug_binding_list.prev, &binding->link);
-
-	return binding;
+	return weston_compositor_add_binding(compositor, BINDING_DEBUG,
+					     &compositor->debug_binding_list,
+					     key, 0, 0, 0, handler, data);
 }
 
 WL_EXPORT void
 weston_binding_destroy(struct weston_binding *binding)
 {
 	wl_list_remove(&binding->link);
+	wl_list_remove(&binding->hash_link);
+	binding->table->count--;
 	free(binding);
 }
 
@@ -237,19 +341,38 @@ install_binding_grab(struct weston_seat *seat, uint32_t time, uint32_t key)
 	weston_keyboard_start_grab(seat->keyboard, &grab->grab);
 }
 
+static struct wl_list *
+binding_table_lookup(struct weston_binding_table *table,
+		     enum binding_type type, uint32_t code, uint32_t modifier)
+{
+	if (table->buckets == NULL)
+		return NULL;
+
+	return binding_bucket(table, type, code, modifier);
+}
+
 WL_EXPORT void
 weston_compositor_run_key_binding(struct weston_compositor *compositor,
 				  struct weston_seat *seat,
 				  uint32_t time, uint32_t key,
 				  enum wl_keyboard_key_state state)
 {
+	struct weston_binding_table *table = &compositor->binding_table;
 	struct weston_binding *b;
+	struct wl_list *bucket;
 
 	if (state == WL_KEYBOARD_KEY_STATE_RELEASED)
 		return;
 
-	wl_list_for_each(b, &compositor->key_binding_list, link) {
-		if (b->key == key && b->modifier == seat->modifier_state) {
+	bucket = binding_table_lookup(table, BINDING_KEY, key,
+				      seat->modifier_state);
+	if (bucket == NULL)
+		return;
+
+	table->dispatching++;
+	wl_list_for_each(b, bucket, hash_link) {
+		if (b->type == BINDING_KEY && b->key == key &&
+		    b->modifier == seat->modifier_state) {
 			weston_key_binding_handler_t handler = b->handler;
 			handler(seat, time, key, b->data);
 
@@ -261,6 +384,7 @@ weston_compositor_run_key_binding(struct weston_compositor *compositor,
 				install_binding_grab(seat, time, key);
 		}
 	}
+	table->dispatching--;
 }
 
 WL_EXPORT void
@@ -269,17 +393,27 @@ weston_compositor_run_button_binding(struct weston_compositor *compositor,
 				     uint32_t time, uint32_t button,
 				     enum wl_pointer_button_state state)
 {
+	struct weston_binding_table *table = &compositor->binding_table;
 	struct weston_binding *b;
+	struct wl_list *bucket;
 
 	if (state == WL_POINTER_BUTTON_STATE_RELEASED)
 		return;
 
-	wl_list_for_each(b, &compositor->button_binding_list, link) {
-		if (b->button == button && b->modifier == seat->modifier_state) {
+	bucket = binding_table_lookup(table, BINDING_BUTTON, button,
+				      seat->modifier_state);
+	if (bucket == NULL)
+		return;
+
+	table->dispatching++;
+	wl_list_for_each(b, bucket, hash_link) {
+		if (b->type == BINDING_BUTTON && b->button == button &&
+		    b->modifier == seat->modifier_state) {
 			weston_button_binding_handler_t handler = b->handler;
 			handler(seat, time, button, b->data);
 		}
 	}
+	table->dispatching--;
 }
 
 WL_EXPORT void
@@ -287,17 +421,27 @@ weston_compositor_run_touch_binding(struct weston_compositor *compositor,
 				    struct weston_seat *seat, uint32_t time,
 				    int touch_type)
 {
+	struct weston_binding_table *table = &compositor->binding_table;
 	struct weston_binding *b;
+	struct wl_list *bucket;
 
 	if (seat->num_tp != 1 || touch_type != WL_TOUCH_DOWN)
 		return;
 
-	wl_list_for_each(b, &compositor->touch_binding_list, link) {
-		if (b->modifier == seat->modifier_state) {
+	bucket = binding_table_lookup(table, BINDING_TOUCH, 0,
+				      seat->modifier_state);
+	if (bucket == NULL)
+		return;
+
+	table->dispatching++;
+	wl_list_for_each(b, bucket, hash_link) {
+		if (b->type == BINDING_TOUCH &&
+		    b->modifier == seat->modifier_state) {
 			weston_touch_binding_handler_t handler = b->handler;
 			handler(seat, time, b->data);
 		}
 	}
+	table->dispatching--;
 }
 
 WL_EXPORT int
@@ -306,10 +450,18 @@ weston_compositor_run_axis_binding(struct weston_compositor *compositor,
 				   uint32_t time, uint32_t axis,
 				   wl_fixed_t value)
 {
+	struct weston_binding_table *table = &compositor->binding_table;
 	struct weston_binding *b;
+	struct wl_list *bucket;
 
-	wl_list_for_each(b, &compositor->axis_binding_list, link) {
-		if (b->axis == axis && b->modifier == seat->modifier_state) {
+	bucket = binding_table_lookup(table, BINDING_AXIS, axis,
+				      seat->modifier_state);
+	if (bucket == NULL)
+		return 0;
+
+	wl_list_for_each(b, bucket, hash_link) {
+		if (b->type == BINDING_AXIS && b->axis == axis &&
+		    b->modifier == seat->modifier_state) {
 			weston_axis_binding_handler_t handler = b->handler;
 			handler(seat, time, axis, value, b->data);
 			return 1;
@@ -325,18 +477,26 @@ weston_compositor_run_debug_binding(struct weston_compositor *compositor,
 				    uint32_t time, uint32_t key,
 				    enum wl_keyboard_key_state state)
 {
+	struct weston_binding_table *table = &compositor->binding_table;
 	weston_key_binding_handler_t handler;
 	struct weston_binding *binding;
+	struct wl_list *bucket;
 	int count = 0;
 
-	wl_list_for_each(binding, &compositor->debug_binding_list, link) {
-		if (key != binding->key)
+	bucket = binding_table_lookup(table, BINDING_DEBUG, key, 0);
+	if (bucket == NULL)
+		return 0;
+
+	table->dispatching++;
+	wl_list_for_each(binding, bucket, hash_link) {
+		if (binding->type != BINDING_DEBUG || key != binding->key)
 			continue;
 
 		count++;
 		handler = binding->handler;
 		handler(seat, time, key, binding->data);
 	}
+	table->dispatching--;
 
 	return count;
 }
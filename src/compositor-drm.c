@@ -46,6 +46,7 @@
 #include "compositor.h"
 #include "gl-renderer.h"
 #include "pixman-renderer.h"
+#include "damage-copy.h"
 #include "udev-seat.h"
 #include "launcher-util.h"
 #include "vaapi-recorder.h"
@@ -101,6 +102,8 @@ struct drm_compositor {
 
 	int cursors_are_broken;
 
+	int planes_debug;
+
 	int use_pixman;
 
 	uint32_t prev_state;
@@ -160,10 +163,15 @@ struct drm_output {
 	struct drm_fb *current, *next;
 	struct backlight *backlight;
 
+	/* The pixman renderer draws into the shadow image in cached
+	 * memory.  Each dumb buffer remembers what changed since it was
+	 * last written, in buffer coordinates, and only that is copied
+	 * from the shadow image before it is shown again. */
+	pixman_image_t *shadow;
 	struct drm_fb *dumb[2];
 	pixman_image_t *image[2];
+	pixman_region32_t dumb_damage[2];
 	int current_image;
-	pixman_region32_t previous_damage;
 
 	struct vaapi_recorder *recorder;
 	struct wl_listener recorder_frame_listener;
@@ -408,13 +416,10 @@ drm_output_release_fb(struct drm_output *output, struct drm_fb *fb)
 
 static uint32_t
 drm_output_check_scanout_format(struct drm_output *output,
-				struct weston_surface *es, struct gbm_bo *bo)
+				struct weston_surface *es, uint32_t format)
 {
-	uint32_t format;
 	pixman_region32_t r;
 
-	format = gbm_bo_get_format(bo);
-
 	switch (format) {
 	case GBM_FORMAT_XRGB8888:
 		return format;
@@ -438,6 +443,21 @@ drm_output_check_scanout_format(struct drm_output *output,
 	}
 }
 
+static int
+drm_output_scanout_possible(struct drm_output *output,
+			    struct weston_surface *es)
+{
+	struct weston_buffer *buffer = es->buffer_ref.buffer;
+
+	return es->geometry.x == output->base.x &&
+		es->geometry.y == output->base.y &&
+		buffer != NULL &&
+		buffer->width == output->base.current_mode->width &&
+		buffer->height == output->base.current_mode->height &&
+		output->base.transform == es->buffer_transform &&
+		!es->transform.enabled;
+}
+
 static struct weston_plane *
 drm_output_prepare_scanout_surface(struct weston_output *_output,
 				   struct weston_surface *es)
@@ -449,13 +469,7 @@ drm_output_prepare_scanout_surface(struct weston_output *_output,
 	struct gbm_bo *bo;
 	uint32_t format;
 
-	if (es->geometry.x != output->base.x ||
-	    es->geometry.y != output->base.y ||
-	    buffer == NULL || c->gbm == NULL ||
-	    buffer->width != output->base.current_mode->width ||
-	    buffer->height != output->base.current_mode->height ||
-	    output->base.transform != es->buffer_transform ||
-	    es->transform.enabled)
+	if (c->gbm == NULL || !drm_output_scanout_possible(output, es))
 		return NULL;
 
 	bo = gbm_bo_import(c->gbm, GBM_BO_IMPORT_WL_BUFFER,
@@ -465,7 +479,8 @@ drm_output_prepare_scanout_surface(struct weston_output *_output,
 	if (!bo)
 		return NULL;
 
-	format = drm_output_check_scanout_format(output, es, bo);
+	format = drm_output_check_scanout_format(output, es,
+						 gbm_bo_get_format(bo));
 	if (format == 0) {
 		gbm_bo_destroy(bo);
 		return NULL;
@@ -482,6 +497,95 @@ drm_output_prepare_scanout_surface(struct weston_output *_output,
 	return &output->fb_plane;
 }
 
+/* Switches to the next dumb buffer and brings it up to date with src,
+ * damage is what changed in src since the last call. */
+static void
+drm_output_update_dumb(struct drm_output *output, pixman_image_t *src,
+		       pixman_region32_t *damage)
+{
+	unsigned int i;
+
+	for (i = 0; i < ARRAY_LENGTH(output->dumb); i++)
+		pixman_region32_union(&output->dumb_damage[i],
+				      &output->dumb_damage[i], damage);
+
+	output->current_image ^= 1;
+	i = output->current_image;
+	output->next = output->dumb[i];
+
+	damage_copy_region(output->image[i], src, &output->dumb_damage[i]);
+	pixman_region32_clear(&output->dumb_damage[i]);
+}
+
+/* Without gbm an shm buffer can't be scanned out directly, but a
+ * fullscreen one needn't be composited either: copy its damage
+ * straight into the next dumb buffer. */
+static struct weston_plane *
+drm_output_prepare_shm_scanout(struct weston_output *_output,
+			       struct weston_surface *es)
+{
+	struct drm_output *output = (struct drm_output *) _output;
+	struct drm_compositor *c =
+		(struct drm_compositor *) output->base.compositor;
+	struct weston_buffer *buffer = es->buffer_ref.buffer;
+	struct wl_shm_buffer *shm_buffer;
+	pixman_region32_t damage;
+	pixman_image_t *image;
+	uint32_t format;
+
+	if (!c->use_pixman || !drm_output_scanout_possible(output, es))
+		return NULL;
+
+	/* surface coordinates have to be dumb buffer coordinates */
+	if (output->base.transform != WL_OUTPUT_TRANSFORM_NORMAL ||
+	    es->geometry.width != buffer->width ||
+	    es->geometry.height != buffer->height)
+		return NULL;
+
+	shm_buffer = wl_shm_buffer_get(buffer->resource);
+	if (!shm_buffer)
+		return NULL;
+
+	switch (wl_shm_buffer_get_format(shm_buffer)) {
+	case WL_SHM_FORMAT_XRGB8888:
+		format = GBM_FORMAT_XRGB8888;
+		break;
+	case WL_SHM_FORMAT_ARGB8888:
+		format = GBM_FORMAT_ARGB8888;
+		break;
+	default:
+		return NULL;
+	}
+	if (drm_output_check_scanout_format(output, es, format) == 0)
+		return NULL;
+
+	/* Coming from the primary plane, the dumb buffers were copied
+	 * from the shadow image, which needn't match this buffer. */
+	if (es->plane != &output->fb_plane)
+		pixman_region32_init_rect(&damage, 0, 0,
+					  buffer->width, buffer->height);
+	else
+		pixman_region32_init(&damage);
+	pixman_region32_union(&damage, &damage, &es->damage);
+
+	image = pixman_image_create_bits(PIXMAN_x8r8g8b8,
+					 buffer->width, buffer->height,
+					 wl_shm_buffer_get_data(shm_buffer),
+					 wl_shm_buffer_get_stride(shm_buffer));
+
+	drm_output_update_dumb(output, image, &damage);
+	pixman_renderer_output_set_buffer(&output->base,
+					  output->image[output->current_image]);
+
+	pixman_image_unref(image);
+	pixman_region32_fini(&damage);
+
+	/* needed again if the next repaint isn't for a new buffer */
+	es->keep_buffer = 1;
+
+	return &output->fb_plane;
+}
+
 static void
 drm_output_render_gl(struct drm_output *output, pixman_region32_t *damage)
 {
@@ -509,26 +613,19 @@ static void
 drm_output_render_pixman(struct drm_output *output, pixman_region32_t *damage)
 {
 	struct weston_compositor *ec = output->base.compositor;
-	pixman_region32_t total_damage, previous_damage;
-
-	pixman_region32_init(&total_damage);
-	pixman_region32_init(&previous_damage);
-
-	pixman_region32_copy(&previous_damage, damage);
-
-	pixman_region32_union(&total_damage, damage, &output->previous_damage);
-	pixman_region32_copy(&output->previous_damage, &previous_damage);
+	pixman_region32_t buffer_damage;
 
-	output->current_image ^= 1;
-
-	output->next = output->dumb[output->current_image];
-	pixman_renderer_output_set_buffer(&output->base,
-					  output->image[output->current_image]);
-
-	ec->renderer->repaint_output(&output->base, &total_damage);
+	/* The shadow image is always complete, so only this frame's
+	 * damage is rendered. */
+	pixman_renderer_output_set_buffer(&output->base, output->shadow);
+	ec->renderer->repaint_output(&output->base, damage);
 
-	pixman_region32_fini(&total_damage);
-	pixman_region32_fini(&previous_damage);
+	pixman_region32_init(&buffer_damage);
+	pixman_region32_copy(&buffer_damage, damage);
+	pixman_renderer_output_region_to_buffer(&output->base,
+						&buffer_damage);
+	drm_output_update_dumb(output, output->shadow, &buffer_damage);
+	pixman_region32_fini(&buffer_damage);
 }
 
 static void
@@ -791,6 +888,27 @@ drm_surface_transform_supported(struct weston_surface *es)
 		(es->transform.matrix.type < WESTON_MATRIX_TRANSFORM_ROTATE);
 }
 
+/* The checks for putting a surface on a sprite that don't need the
+ * buffer imported. */
+static int
+drm_output_overlay_possible(struct weston_output *output_base,
+			    struct weston_surface *es)
+{
+	struct drm_compositor *c =
+		(struct drm_compositor *) output_base->compositor;
+
+	return c->gbm != NULL &&
+		es->buffer_transform == output_base->transform &&
+		es->buffer_scale == output_base->current_scale &&
+		!c->sprites_are_broken &&
+		weston_output_mask_is_single(&es->output_mask,
+					     output_base->id) &&
+		es->buffer_ref.buffer != NULL &&
+		es->alpha == 1.0f &&
+		!wl_shm_buffer_get(es->buffer_ref.buffer->resource) &&
+		drm_surface_transform_supported(es);
+}
+
 static struct weston_plane *
 drm_output_prepare_overlay_surface(struct weston_output *output_base,
 				   struct weston_surface *es)
@@ -805,31 +923,7 @@ drm_output_prepare_overlay_surface(struct weston_output *output_base,
 	uint32_t format;
 	wl_fixed_t sx1, sy1, sx2, sy2;
 
-	if (c->gbm == NULL)
-		return NULL;
-
-	if (es->buffer_transform != output_base->transform)
-		return NULL;
-
-	if (es->buffer_scale != output_base->current_scale)
-		return NULL;
-
-	if (c->sprites_are_broken)
-		return NULL;
-
-	if (es->output_mask != (1u << output_base->id))
-		return NULL;
-
-	if (es->buffer_ref.buffer == NULL)
-		return NULL;
-
-	if (es->alpha != 1.0f)
-		return NULL;
-
-	if (wl_shm_buffer_get(es->buffer_ref.buffer->resource))
-		return NULL;
-
-	if (!drm_surface_transform_supported(es))
+	if (!drm_output_overlay_possible(output_base, es))
 		return NULL;
 
 	wl_list_for_each(s, &c->sprite_list, link) {
@@ -940,13 +1034,14 @@ drm_output_prepare_cursor_surface(struct weston_output *output_base,
 		(struct drm_compositor *) output_base->compositor;
 	struct drm_output *output = (struct drm_output *) output_base;
 
-	if (c->gbm == NULL)
+	/* pixman outputs have no cursor bos */
+	if (c->gbm == NULL || c->use_pixman)
 		return NULL;
 	if (output->base.transform != WL_OUTPUT_TRANSFORM_NORMAL)
 		return NULL;
 	if (output->cursor_surface)
 		return NULL;
-	if (es->output_mask != (1u << output_base->id))
+	if (!weston_output_mask_is_single(&es->output_mask, output_base->id))
 		return NULL;
 	if (c->cursors_are_broken)
 		return NULL;
@@ -1015,28 +1110,219 @@ drm_output_set_cursor(struct drm_output *output)
 	}
 }
 
+#define DRM_MAX_PLANE_CANDIDATES 16
+
+struct drm_plane_candidate {
+	struct weston_surface *surface;
+	uint32_t requires; /* candidates above that overlap this one */
+	float cost;        /* pixels per second composited on primary */
+};
+
+struct drm_plane_selection {
+	struct drm_plane_candidate candidates[DRM_MAX_PLANE_CANDIDATES];
+	int count;
+	int max_sprites;
+	uint32_t chosen;
+	float saved;
+};
+
+static int
+region_overlaps(pixman_region32_t *region, pixman_region32_t *other)
+{
+	return pixman_region32_contains_rectangle(region,
+		pixman_region32_extents(other)) != PIXMAN_REGION_OUT;
+}
+
+static int
+drm_output_count_sprites(struct drm_output *output)
+{
+	struct drm_compositor *c =
+		(struct drm_compositor *) output->base.compositor;
+	struct drm_sprite *s;
+	int count = 0;
+
+	wl_list_for_each(s, &c->sprite_list, link)
+		if (drm_sprite_crtc_supported(&output->base, s->possible_crtcs))
+			count++;
+
+	return count;
+}
+
+static void
+drm_plane_selection_search(struct drm_plane_selection *sel, int first,
+			   uint32_t set, int nsprites, float saved)
+{
+	struct drm_plane_candidate *candidate;
+	int i;
+
+	if (saved > sel->saved) {
+		sel->saved = saved;
+		sel->chosen = set;
+	}
+
+	if (nsprites == sel->max_sprites)
+		return;
+
+	for (i = first; i < sel->count; i++) {
+		candidate = &sel->candidates[i];
+
+		/* everything above that overlaps it has to be off the
+		 * primary plane too, and candidates are in z-order */
+		if (candidate->requires & ~set)
+			continue;
+
+		drm_plane_selection_search(sel, i + 1, set | (1 << i),
+					   nsprites + 1,
+					   saved + candidate->cost);
+	}
+}
+
+/*
+ * Picks the surfaces to try on sprites.  Compositing a surface costs
+ * its visible area every time it updates, capped at the refresh rate.
+ * A surface can only go on a sprite if nothing above that overlaps it
+ * stays on the primary plane, so this picks the set of surfaces that
+ * satisfies that and saves the most composited pixels, using at most
+ * as many sprites as the output has.
+ */
+static void
+drm_output_select_overlays(struct drm_output *output,
+			   struct drm_plane_selection *sel)
+{
+	struct drm_compositor *c =
+		(struct drm_compositor *) output->base.compositor;
+	struct drm_plane_candidate *candidate;
+	struct weston_surface *es;
+	pixman_region32_t blocked, visible;
+	pixman_box32_t *box;
+	float rate, max_rate;
+	uint32_t now;
+	int i;
+
+	memset(sel, 0, sizeof *sel);
+	sel->max_sprites = drm_output_count_sprites(output);
+	if (sel->max_sprites == 0)
+		return;
+
+	now = weston_compositor_get_time();
+	max_rate = output->base.current_mode->refresh / 1000.0f;
+
+	pixman_region32_init(&blocked);
+	pixman_region32_init(&visible);
+	wl_list_for_each(es, &c->base.surface_list, link) {
+		pixman_region32_intersect(&visible, &es->transform.boundingbox,
+					  &output->base.region);
+		if (!pixman_region32_not_empty(&visible))
+			continue;
+
+		/* cursor sized shm surfaces will likely end up on the
+		 * cursor plane, so they don't block anything */
+		if (c->gbm && !c->use_pixman && !c->cursors_are_broken &&
+		    es->buffer_ref.buffer &&
+		    wl_shm_buffer_get(es->buffer_ref.buffer->resource) &&
+		    es->geometry.width <= 64 && es->geometry.height <= 64)
+			continue;
+
+		if (sel->count == DRM_MAX_PLANE_CANDIDATES ||
+		    drm_output_scanout_possible(output, es) ||
+		    !drm_output_overlay_possible(&output->base, es) ||
+		    region_overlaps(&blocked, &visible)) {
+			pixman_region32_union(&blocked, &blocked, &visible);
+			continue;
+		}
+
+		candidate = &sel->candidates[sel->count];
+		candidate->surface = es;
+		candidate->requires = 0;
+		for (i = 0; i < sel->count; i++)
+			if (region_overlaps(&visible, &sel->candidates[i].
+					    surface->transform.boundingbox))
+				candidate->requires |= 1 << i;
+
+		rate = weston_surface_get_commit_rate(es, now);
+		if (rate > max_rate)
+			rate = max_rate;
+		box = pixman_region32_extents(&visible);
+		candidate->cost = (float) (box->x2 - box->x1) *
+			(box->y2 - box->y1) * rate;
+
+		sel->count++;
+	}
+	pixman_region32_fini(&visible);
+	pixman_region32_fini(&blocked);
+
+	drm_plane_selection_search(sel, 0, 0, 0, 0);
+}
+
+static int
+drm_plane_selection_has(struct drm_plane_selection *sel,
+			struct weston_surface *es)
+{
+	int i;
+
+	for (i = 0; i < sel->count; i++)
+		if (sel->candidates[i].surface == es)
+			return (sel->chosen & (1 << i)) != 0;
+
+	return 0;
+}
+
+static const char *
+drm_output_plane_name(struct drm_output *output, struct weston_plane *plane)
+{
+	if (plane == &output->base.compositor->primary_plane)
+		return "primary";
+	if (plane == &output->cursor_plane)
+		return "cursor";
+	if (plane == &output->fb_plane)
+		return "scanout";
+
+	return "overlay";
+}
+
+static void
+drm_output_log_planes(struct drm_output *output,
+		      struct drm_plane_selection *sel)
+{
+	struct weston_surface *es;
+	int i;
+
+	weston_log("planes on %s: %d candidates for %d sprites, "
+		   "saving %.0f composited pixels/s\n",
+		   output->base.name, sel->count, sel->max_sprites, sel->saved);
+
+	for (i = 0; i < sel->count; i++) {
+		es = sel->candidates[i].surface;
+		weston_log_continue("  surface %p %dx%d, %.0f pixels/s, "
+				    "%s, on %s\n", es,
+				    es->geometry.width, es->geometry.height,
+				    sel->candidates[i].cost,
+				    (sel->chosen & (1 << i)) ?
+				    "picked" : "not picked",
+				    drm_output_plane_name(output, es->plane));
+	}
+}
+
 static void
 drm_assign_planes(struct weston_output *output)
 {
 	struct drm_compositor *c =
 		(struct drm_compositor *) output->compositor;
+	struct drm_output *drm_output = (struct drm_output *) output;
+	struct drm_plane_selection sel;
 	struct weston_surface *es, *next;
 	pixman_region32_t overlap, surface_overlap;
 	struct weston_plane *primary, *next_plane;
 
 	/*
-	 * Find a surface for each sprite in the output using some heuristics:
-	 * 1) size
-	 * 2) frequency of update
-	 * 3) opacity (though some hw might support alpha blending)
-	 * 4) clipping (this can be fixed with color keys)
-	 *
-	 * The idea is to save on blitting since this should save power.
-	 * If we can get a large video surface on the sprite for example,
-	 * the main display surface may not need to update at all, and
-	 * the client buffer can be used directly for the sprite surface
-	 * as we do for flipping full screen surfaces.
+	 * Put the cursor on the cursor plane and a full screen surface
+	 * on the scanout plane if possible, and the surfaces chosen by
+	 * drm_output_select_overlays() on sprites.  Anything overlapped
+	 * by a surface that stays on the primary plane has to be
+	 * composited as well.
 	 */
+	drm_output_select_overlays(drm_output, &sel);
+
 	pixman_region32_init(&overlap);
 	primary = &c->base.primary_plane;
 	wl_list_for_each_safe(es, next, &c->base.surface_list, link) {
@@ -1062,6 +1348,8 @@ drm_assign_planes(struct weston_output *output)
 		if (next_plane == NULL)
 			next_plane = drm_output_prepare_scanout_surface(output, es);
 		if (next_plane == NULL)
+			next_plane = drm_output_prepare_shm_scanout(output, es);
+		if (next_plane == NULL && drm_plane_selection_has(&sel, es))
 			next_plane = drm_output_prepare_overlay_surface(output, es);
 		if (next_plane == NULL)
 			next_plane = primary;
@@ -1073,6 +1361,9 @@ drm_assign_planes(struct weston_output *output)
 		pixman_region32_fini(&surface_overlap);
 	}
 	pixman_region32_fini(&overlap);
+
+	if (c->planes_debug)
+		drm_output_log_planes(drm_output, &sel);
 }
 
 static void
@@ -1291,7 +1582,19 @@ init_egl(struct drm_compositor *ec)
 static int
 init_pixman(struct drm_compositor *ec)
 {
-	return pixman_renderer_init(&ec->base);
+	/* The renderer doesn't need gbm, but client buffers gbm can
+	 * import may still be scanned out from sprites. */
+	if (!ec->sprites_are_broken)
+		ec->gbm = gbm_create_device(ec->drm.fd);
+
+	if (pixman_renderer_init(&ec->base) < 0) {
+		if (ec->gbm)
+			gbm_device_destroy(ec->gbm);
+		ec->gbm = NULL;
+		return -1;
+	}
+
+	return 0;
 }
 
 static struct drm_mode *
@@ -1529,15 +1832,25 @@ drm_output_init_pixman(struct drm_output *output, struct drm_compositor *c)
 			goto err;
 	}
 
+	output->shadow = pixman_image_create_bits(PIXMAN_x8r8g8b8, w, h,
+						  NULL, 0);
+	if (!output->shadow)
+		goto err;
+
 	if (pixman_renderer_output_create(&output->base) < 0)
 		goto err;
 
-	pixman_region32_init_rect(&output->previous_damage,
-				  output->base.x, output->base.y, output->base.width, output->base.height);
+	for (i = 0; i < ARRAY_LENGTH(output->dumb); i++)
+		pixman_region32_init_rect(&output->dumb_damage[i],
+					  0, 0, w, h);
 
 	return 0;
 
 err:
+	if (output->shadow)
+		pixman_image_unref(output->shadow);
+	output->shadow = NULL;
+
 	for (i = 0; i < ARRAY_LENGTH(output->dumb); i++) {
 		if (output->dumb[i])
 			drm_fb_destroy_dumb(output->dumb[i]);
@@ -1557,9 +1870,11 @@ drm_output_fini_pixman(struct drm_output *output)
 	unsigned int i;
 
 	pixman_renderer_output_destroy(&output->base);
-	pixman_region32_fini(&output->previous_damage);
+	pixman_image_unref(output->shadow);
+	output->shadow = NULL;
 
 	for (i = 0; i < ARRAY_LENGTH(output->dumb); i++) {
+		pixman_region32_fini(&output->dumb_damage[i]);
 		drm_fb_destroy_dumb(output->dumb[i]);
 		pixman_image_unref(output->image[i]);
 		output->dumb[i] = NULL;
@@ -2459,6 +2774,9 @@ planes_binding(struct weston_seat *seat, uint32_t time, uint32_t key, void *data
 	case KEY_O:
 		c->sprites_hidden ^= 1;
 		break;
+	case KEY_L:
+		c->planes_debug ^= 1;
+		break;
 	default:
 		break;
 	}
@@ -2560,7 +2878,7 @@ recorder_binding(struct weston_seat *seat, uint32_t time, uint32_t key,
 static struct weston_compositor *
 drm_compositor_create(struct wl_display *display,
 		      int connector, const char *seat_id, int tty, int pixman,
-		      int *argc, char *argv[],
+		      int sprites, int *argc, char *argv[],
 		      struct weston_config *config)
 {
 	struct drm_compositor *ec;
@@ -2576,8 +2894,8 @@ drm_compositor_create(struct wl_display *display,
 		return NULL;
 
 	/* KMS support for sprites is not complete yet, so disable the
-	 * functionality for now. */
-	ec->sprites_are_broken = 1;
+	 * functionality unless asked for. */
+	ec->sprites_are_broken = !sprites;
 	ec->format = GBM_FORMAT_XRGB8888;
 	ec->use_pixman = pixman;
 
@@ -2686,6 +3004,8 @@ drm_compositor_create(struct wl_display *display,
 					    planes_binding, ec);
 	weston_compositor_add_debug_binding(&ec->base, KEY_V,
 					    planes_binding, ec);
+	weston_compositor_add_debug_binding(&ec->base, KEY_L,
+					    planes_binding, ec);
 	weston_compositor_add_debug_binding(&ec->base, KEY_Q,
 					    recorder_binding, ec);
 
@@ -2699,7 +3019,8 @@ err_drm_source:
 	udev_input_destroy(&ec->input);
 err_sprite:
 	ec->base.renderer->destroy(&ec->base);
-	gbm_device_destroy(ec->gbm);
+	if (ec->gbm)
+		gbm_device_destroy(ec->gbm);
 	destroy_sprites(ec);
 err_udev_dev:
 	udev_device_unref(drm_device);
@@ -2718,7 +3039,7 @@ WL_EXPORT struct weston_compositor *
 backend_init(struct wl_display *display, int *argc, char *argv[],
 	     struct weston_config *config)
 {
-	int connector = 0, tty = 0, use_pixman = 0;
+	int connector = 0, tty = 0, use_pixman = 0, use_sprites = 0;
 	const char *seat_id = default_seat;
 
 	const struct weston_option drm_options[] = {
@@ -2727,10 +3048,11 @@ backend_init(struct wl_display *display, int *argc, char *argv[],
 		{ WESTON_OPTION_INTEGER, "tty", 0, &tty },
 		{ WESTON_OPTION_BOOLEAN, "current-mode", 0, &option_current_mode },
 		{ WESTON_OPTION_BOOLEAN, "use-pixman", 0, &use_pixman },
+		{ WESTON_OPTION_BOOLEAN, "use-sprites", 0, &use_sprites },
 	};
 
 	parse_options(drm_options, ARRAY_LENGTH(drm_options), argc, argv);
 
 	return drm_compositor_create(display, connector, seat_id, tty, use_pixman,
-				     argc, argv, config);
+				     use_sprites, argc, argv, config);
 }
@@ -34,6 +34,8 @@
 #include <sys/types.h>
 #include <fcntl.h>
 #include <unistd.h>
+#include <pthread.h>
+#include <sys/time.h>
 #include <linux/fb.h>
 #include <linux/input.h>
 
@@ -52,6 +54,7 @@ struct fbdev_compositor {
 	struct udev *udev;
 	struct udev_input input;
 	int use_pixman;
+	int double_buffer;
 	struct wl_listener session_listener;
 };
 
@@ -83,16 +86,44 @@ struct fbdev_output {
 	void *fb; /* length is fb_info.buffer_length */
 
 	/* pixman details. */
-	pixman_image_t *hw_surface;
+	pixman_image_t *hw_surfaces[2];
 	pixman_image_t *shadow_surface;
 	void *shadow_buf;
 	uint8_t depth;
+
+	/* With --double-buffer the virtual frame buffer holds two
+	 * screens and the one not shown is drawn into, then panned to.
+	 * buffer_damage is what a buffer missed since it was drawn. */
+	int fd; /* kept open for panning and vsync, or -1 */
+	struct fb_var_screeninfo varinfo;
+	int num_buffers;
+	int current_buffer; /* the one being scanned out */
+	pixman_region32_t buffer_damage[2];
+
+	/* FBIO_WAITFORVSYNC blocks, so panning and waiting for the
+	 * vblank happen on a helper thread, which wakes up the main
+	 * loop through the pipe when the frame is on screen. */
+	struct {
+		pthread_t thread;
+		pthread_mutex_t mutex;
+		pthread_cond_t cond;
+		int pipe[2];
+		struct wl_event_source *source;
+		int pending;
+		int stop;
+		int pan;
+		uint32_t yoffset;
+		int pan_error;
+		int vsync_error;
+		uint32_t msec;
+	} vsync;
 };
 
 struct fbdev_parameters {
 	int tty;
 	char *device;
 	int use_gl;
+	int double_buffer;
 };
 
 static const char default_seat[] = "seat0";
@@ -121,17 +152,13 @@ fbdev_output_start_repaint_loop(struct weston_output *output)
 }
 
 static void
-fbdev_output_repaint_pixman(struct weston_output *base, pixman_region32_t *damage)
+fbdev_output_copy_damage(struct fbdev_output *output,
+			 pixman_image_t *hw_surface, pixman_region32_t *damage)
 {
-	struct fbdev_output *output = to_fbdev_output(base);
-	struct weston_compositor *ec = output->base.compositor;
+	struct weston_output *base = &output->base;
 	pixman_box32_t *rects;
 	int nrects, i, src_x, src_y, x1, y1, x2, y2, width, height;
 
-	/* Repaint the damaged region onto the back buffer. */
-	pixman_renderer_output_set_buffer(base, output->shadow_surface);
-	ec->renderer->repaint_output(base, damage);
-
 	/* Transform and composite onto the frame buffer. */
 	width = pixman_image_get_width(output->shadow_surface);
 	height = pixman_image_get_height(output->shadow_surface);
@@ -171,22 +198,21 @@ fbdev_output_repaint_pixman(struct weston_output *base, pixman_region32_t *damag
 		pixman_image_composite32(PIXMAN_OP_SRC,
 			output->shadow_surface, /* src */
 			NULL /* mask */,
-			output->hw_surface, /* dest */
+			hw_surface, /* dest */
 			src_x, src_y, /* src_x, src_y */
 			0, 0, /* mask_x, mask_y */
 			x1, y1, /* dest_x, dest_y */
 			x2 - x1, /* width */
 			y2 - y1 /* height */);
 	}
+}
 
-	/* Update the damage region. */
-	pixman_region32_subtract(&ec->primary_plane.damage,
-	                         &ec->primary_plane.damage, damage);
-
-	/* Schedule the end of the frame. We do not sync this to the frame
-	 * buffer clock because users who want that should be using the DRM
-	 * compositor. FBIO_WAITFORVSYNC blocks and FB_ACTIVATE_VBL requires
-	 * panning, which is broken in most kernel drivers.
+static void
+fbdev_output_schedule_finish_frame(struct fbdev_output *output)
+{
+	/* Without --double-buffer, or if the driver can't wait for vsync,
+	 * the frame is not synced to the frame buffer clock and may tear.
+	 * Users who want that should be using the DRM compositor.
 	 *
 	 * Finish the frame synchronised to the specified refresh rate. The
 	 * refresh rate is given in mHz and the interval in ms. */
@@ -194,6 +220,77 @@ fbdev_output_repaint_pixman(struct weston_output *base, pixman_region32_t *damag
 	                             1000000 / output->mode.refresh);
 }
 
+/* Panning failed, so keep drawing into the buffer that is shown. */
+static void
+fbdev_output_pan_failed(struct fbdev_output *output, int error)
+{
+	weston_log("fbdev: panning failed: %s, "
+		   "falling back to a single buffer\n", strerror(error));
+
+	output->num_buffers = 1;
+	output->current_buffer ^= 1;
+	if (output->hw_surfaces[output->current_buffer])
+		fbdev_output_copy_damage(output,
+					 output->hw_surfaces[output->current_buffer],
+					 &output->base.region);
+}
+
+/* Shows buffer and finishes the frame once it is on screen, or after
+ * a refresh period without vsync. Panning without vsync would tear just
+ * like a single buffer does, so there are two buffers only while the
+ * vsync thread runs. */
+static void
+fbdev_output_present(struct fbdev_output *output, int buffer)
+{
+	if (!output->vsync.source) {
+		fbdev_output_schedule_finish_frame(output);
+		return;
+	}
+
+	pthread_mutex_lock(&output->vsync.mutex);
+	output->vsync.pan = buffer != output->current_buffer;
+	output->vsync.yoffset = buffer * output->fb_info.y_resolution;
+	output->vsync.pending = 1;
+	pthread_cond_broadcast(&output->vsync.cond);
+	pthread_mutex_unlock(&output->vsync.mutex);
+
+	output->current_buffer = buffer;
+}
+
+static void
+fbdev_output_repaint_pixman(struct weston_output *base, pixman_region32_t *damage)
+{
+	struct fbdev_output *output = to_fbdev_output(base);
+	struct weston_compositor *ec = output->base.compositor;
+	int buffer, i;
+
+	/* Repaint the damaged region onto the back buffer. */
+	pixman_renderer_output_set_buffer(base, output->shadow_surface);
+	ec->renderer->repaint_output(base, damage);
+
+	if (output->num_buffers == 1) {
+		buffer = output->current_buffer;
+		fbdev_output_copy_damage(output, output->hw_surfaces[buffer],
+					 damage);
+	} else {
+		for (i = 0; i < output->num_buffers; i++)
+			pixman_region32_union(&output->buffer_damage[i],
+					      &output->buffer_damage[i],
+					      damage);
+
+		buffer = output->current_buffer ^ 1;
+		fbdev_output_copy_damage(output, output->hw_surfaces[buffer],
+					 &output->buffer_damage[buffer]);
+		pixman_region32_clear(&output->buffer_damage[buffer]);
+	}
+
+	/* Update the damage region. */
+	pixman_region32_subtract(&ec->primary_plane.damage,
+	                         &ec->primary_plane.damage, damage);
+
+	fbdev_output_present(output, buffer);
+}
+
 static int
 fbdev_output_repaint(struct weston_output *base, pixman_region32_t *damage)
 {
@@ -209,8 +306,7 @@ fbdev_output_repaint(struct weston_output *base, pixman_region32_t *damage)
 		pixman_region32_subtract(&ec->primary_plane.damage,
 	                         &ec->primary_plane.damage, damage);
 
-		wl_event_source_timer_update(output->finish_frame_timer,
-	                             1000000 / output->mode.refresh);
+		fbdev_output_schedule_finish_frame(output);
 	}
 
 	return 0;
@@ -226,6 +322,160 @@ finish_frame_handler(void *data)
 	return 1;
 }
 
+static void *
+fbdev_vsync_thread(void *data)
+{
+	struct fbdev_output *output = data;
+	struct fb_var_screeninfo varinfo;
+	struct timeval tv;
+	uint32_t crtc = 0;
+	int pan_error, vsync_error;
+	char byte = 0;
+
+	pthread_mutex_lock(&output->vsync.mutex);
+	while (!output->vsync.stop) {
+		if (!output->vsync.pending) {
+			pthread_cond_wait(&output->vsync.cond,
+					  &output->vsync.mutex);
+			continue;
+		}
+
+		varinfo = output->varinfo;
+		varinfo.yoffset = output->vsync.yoffset;
+		pan_error = 0;
+		vsync_error = 0;
+		pthread_mutex_unlock(&output->vsync.mutex);
+
+		if (output->vsync.pan &&
+		    ioctl(output->fd, FBIOPAN_DISPLAY, &varinfo) < 0)
+			pan_error = errno;
+		if (ioctl(output->fd, FBIO_WAITFORVSYNC, &crtc) < 0)
+			vsync_error = errno;
+		gettimeofday(&tv, NULL);
+
+		pthread_mutex_lock(&output->vsync.mutex);
+		output->vsync.pan_error = pan_error;
+		output->vsync.vsync_error = vsync_error;
+		output->vsync.msec = tv.tv_sec * 1000 + tv.tv_usec / 1000;
+		output->vsync.pending = 0;
+		pthread_cond_broadcast(&output->vsync.cond);
+		if (write(output->vsync.pipe[1], &byte, 1) < 0 &&
+		    errno != EAGAIN)
+			weston_log("fbdev vsync: failed to signal: %m\n");
+	}
+	pthread_mutex_unlock(&output->vsync.mutex);
+
+	return NULL;
+}
+
+static void
+fbdev_output_stop_vsync(struct fbdev_output *output);
+
+static int
+vsync_handler(int fd, uint32_t mask, void *data)
+{
+	struct fbdev_output *output = data;
+	int pan_error, vsync_error;
+	uint32_t msec;
+	char buf[16];
+
+	while (read(fd, buf, sizeof buf) > 0)
+		;
+
+	pthread_mutex_lock(&output->vsync.mutex);
+	pan_error = output->vsync.pan_error;
+	vsync_error = output->vsync.vsync_error;
+	msec = output->vsync.msec;
+	pthread_mutex_unlock(&output->vsync.mutex);
+
+	if (pan_error)
+		fbdev_output_pan_failed(output, pan_error);
+
+	/* The buffer just shown is complete, so keep drawing into it. */
+	if (vsync_error) {
+		weston_log("fbdev: waiting for vsync failed: %s, "
+			   "falling back to a timer and a single buffer\n",
+			   strerror(vsync_error));
+		fbdev_output_stop_vsync(output);
+		output->num_buffers = 1;
+	}
+
+	weston_output_finish_frame(&output->base, msec);
+
+	return 1;
+}
+
+static int
+fbdev_output_start_vsync(struct fbdev_output *output)
+{
+	struct wl_event_loop *loop;
+
+	if (pipe2(output->vsync.pipe, O_CLOEXEC | O_NONBLOCK) == -1)
+		return -1;
+
+	loop = wl_display_get_event_loop(output->compositor->base.wl_display);
+	output->vsync.source =
+		wl_event_loop_add_fd(loop, output->vsync.pipe[0],
+				     WL_EVENT_READABLE, vsync_handler, output);
+	if (!output->vsync.source)
+		goto err_pipe;
+
+	pthread_mutex_init(&output->vsync.mutex, NULL);
+	pthread_cond_init(&output->vsync.cond, NULL);
+	output->vsync.stop = 0;
+	output->vsync.pending = 0;
+
+	if (pthread_create(&output->vsync.thread, NULL,
+			   fbdev_vsync_thread, output) != 0) {
+		pthread_mutex_destroy(&output->vsync.mutex);
+		pthread_cond_destroy(&output->vsync.cond);
+		wl_event_source_remove(output->vsync.source);
+		output->vsync.source = NULL;
+		goto err_pipe;
+	}
+
+	return 0;
+
+err_pipe:
+	close(output->vsync.pipe[0]);
+	close(output->vsync.pipe[1]);
+	return -1;
+}
+
+static void
+fbdev_output_stop_vsync(struct fbdev_output *output)
+{
+	if (!output->vsync.source)
+		return;
+
+	pthread_mutex_lock(&output->vsync.mutex);
+	output->vsync.stop = 1;
+	pthread_cond_broadcast(&output->vsync.cond);
+	pthread_mutex_unlock(&output->vsync.mutex);
+	pthread_join(output->vsync.thread, NULL);
+
+	pthread_mutex_destroy(&output->vsync.mutex);
+	pthread_cond_destroy(&output->vsync.cond);
+	wl_event_source_remove(output->vsync.source);
+	output->vsync.source = NULL;
+	close(output->vsync.pipe[0]);
+	close(output->vsync.pipe[1]);
+}
+
+/* The helper thread uses the frame buffer fd, so wait for it to finish
+ * the frame in flight before closing it. */
+static void
+fbdev_output_wait_vsync_idle(struct fbdev_output *output)
+{
+	if (!output->vsync.source)
+		return;
+
+	pthread_mutex_lock(&output->vsync.mutex);
+	while (output->vsync.pending)
+		pthread_cond_wait(&output->vsync.cond, &output->vsync.mutex);
+	pthread_mutex_unlock(&output->vsync.mutex);
+}
+
 static pixman_format_code_t
 calculate_pixman_format(struct fb_var_screeninfo *vinfo,
                         struct fb_fix_screeninfo *finfo)
@@ -435,14 +685,69 @@ fbdev_frame_buffer_open(struct fbdev_output *output, const char *fb_dev,
 	return fd;
 }
 
-/* Closes the FD on success or failure. */
+/* Makes the virtual frame buffer two screens high, if the driver can
+ * pan between them. */
+static int
+fbdev_frame_buffer_setup_panning(struct fbdev_output *output, int fd)
+{
+	struct fb_var_screeninfo varinfo;
+	struct fb_fix_screeninfo fixinfo;
+	unsigned int yres = output->fb_info.y_resolution;
+
+	if (ioctl(fd, FBIOGET_VSCREENINFO, &varinfo) < 0)
+		return -1;
+
+	if (varinfo.yres_virtual < 2 * yres) {
+		varinfo.yres_virtual = 2 * yres;
+		if (ioctl(fd, FBIOPUT_VSCREENINFO, &varinfo) < 0 ||
+		    ioctl(fd, FBIOGET_VSCREENINFO, &varinfo) < 0)
+			return -1;
+	}
+
+	if (ioctl(fd, FBIOGET_FSCREENINFO, &fixinfo) < 0)
+		return -1;
+
+	if (varinfo.yres_virtual < 2 * yres ||
+	    fixinfo.ypanstep == 0 || yres % fixinfo.ypanstep != 0 ||
+	    fixinfo.smem_len < 2 * yres * fixinfo.line_length) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	varinfo.xoffset = 0;
+	varinfo.yoffset = 0;
+	if (ioctl(fd, FBIOPAN_DISPLAY, &varinfo) < 0)
+		return -1;
+
+	output->varinfo = varinfo;
+	output->fb_info.buffer_length = fixinfo.smem_len;
+	output->fb_info.line_length = fixinfo.line_length;
+
+	return 0;
+}
+
+/* Closes the FD on failure, and on success unless it is needed for
+ * double buffering. */
 static int
 fbdev_frame_buffer_map(struct fbdev_output *output, int fd)
 {
 	int retval = -1;
+	uint8_t *screen;
+	int i;
 
 	weston_log("Mapping fbdev frame buffer.\n");
 
+	output->num_buffers = 1;
+	output->current_buffer = 0;
+	if (output->compositor->double_buffer) {
+		if (fbdev_frame_buffer_setup_panning(output, fd) == 0)
+			output->num_buffers = 2;
+		else
+			weston_log("Frame buffer can't pan, "
+				   "using a single buffer: %s\n",
+				   strerror(errno));
+	}
+
 	/* Map the frame buffer. Write-only mode, since we don't want to read
 	 * anything back (because it's slow). */
 	output->fb = mmap(NULL, output->fb_info.buffer_length,
@@ -453,16 +758,22 @@ fbdev_frame_buffer_map(struct fbdev_output *output, int fd)
 		goto out_close;
 	}
 
-	/* Create a pixman image to wrap the memory mapped frame buffer. */
-	output->hw_surface =
-		pixman_image_create_bits(output->fb_info.pixel_format,
-		                         output->fb_info.x_resolution,
-		                         output->fb_info.y_resolution,
-		                         output->fb,
-		                         output->fb_info.line_length);
-	if (output->hw_surface == NULL) {
-		weston_log("Failed to create surface for frame buffer.\n");
-		goto out_unmap;
+	/* Create a pixman image to wrap each screen of the memory mapped
+	 * frame buffer. */
+	for (i = 0; i < output->num_buffers; i++) {
+		screen = (uint8_t *) output->fb + i *
+			output->fb_info.y_resolution *
+			output->fb_info.line_length;
+		output->hw_surfaces[i] =
+			pixman_image_create_bits(output->fb_info.pixel_format,
+			                         output->fb_info.x_resolution,
+			                         output->fb_info.y_resolution,
+			                         (uint32_t *) screen,
+			                         output->fb_info.line_length);
+		if (output->hw_surfaces[i] == NULL) {
+			weston_log("Failed to create surface for frame buffer.\n");
+			goto out_unmap;
+		}
 	}
 
 	/* Success! */
@@ -473,8 +784,11 @@ out_unmap:
 		fbdev_frame_buffer_destroy(output);
 
 out_close:
-	if (fd >= 0)
+	if (retval == 0 && output->compositor->double_buffer) {
+		output->fd = fd;
+	} else if (fd >= 0) {
 		close(fd);
+	}
 
 	return retval;
 }
@@ -482,8 +796,17 @@ out_close:
 static void
 fbdev_frame_buffer_destroy(struct fbdev_output *output)
 {
+	int i;
+
 	weston_log("Destroying fbdev frame buffer.\n");
 
+	for (i = 0; i < 2; i++) {
+		if (output->hw_surfaces[i] != NULL) {
+			pixman_image_unref(output->hw_surfaces[i]);
+			output->hw_surfaces[i] = NULL;
+		}
+	}
+
 	if (munmap(output->fb, output->fb_info.buffer_length) < 0)
 		weston_log("Failed to munmap frame buffer: %s\n",
 		           strerror(errno));
@@ -491,6 +814,17 @@ fbdev_frame_buffer_destroy(struct fbdev_output *output)
 	output->fb = NULL;
 }
 
+/* Every buffer has to be drawn completely before it is shown. */
+static void
+fbdev_output_reset_buffer_damage(struct fbdev_output *output)
+{
+	int i;
+
+	for (i = 0; i < 2; i++)
+		pixman_region32_copy(&output->buffer_damage[i],
+				     &output->base.region);
+}
+
 static void fbdev_output_destroy(struct weston_output *base);
 static void fbdev_output_disable(struct weston_output *base);
 
@@ -514,6 +848,7 @@ fbdev_output_create(struct fbdev_compositor *compositor,
 
 	output->compositor = compositor;
 	output->device = device;
+	output->fd = -1;
 
 	/* Create the frame buffer. */
 	fb_fd = fbdev_frame_buffer_open(output, device, &output->fb_info);
@@ -623,6 +958,10 @@ fbdev_output_create(struct fbdev_compositor *compositor,
 	if (compositor->use_pixman) {
 		if (pixman_renderer_output_create(&output->base) < 0)
 			goto out_shadow_surface;
+
+		pixman_region32_init(&output->buffer_damage[0]);
+		pixman_region32_init(&output->buffer_damage[1]);
+		fbdev_output_reset_buffer_damage(output);
 	} else {
 		setenv("HYBRIS_EGLPLATFORM", "wayland", 1);
 		if (gl_renderer_output_create(&output->base,
@@ -637,12 +976,26 @@ fbdev_output_create(struct fbdev_compositor *compositor,
 	output->finish_frame_timer =
 		wl_event_loop_add_timer(loop, finish_frame_handler, output);
 
+	/* Whether the driver can wait for vsync is only found out by the
+	 * thread, since the ioctl blocks; vsync_handler falls back. */
+	if (output->fd >= 0 && fbdev_output_start_vsync(output) < 0) {
+		weston_log("Failed to start vsync thread, "
+			   "using a timer and a single buffer.\n");
+		output->num_buffers = 1;
+	}
+
 	wl_list_insert(compositor->base.output_list.prev, &output->base.link);
 
 	weston_log("fbdev output %d×%d px\n",
 	           output->mode.width, output->mode.height);
 	weston_log_continue(STAMP_SPACE "guessing %d Hz and 96 dpi\n",
 	                    output->mode.refresh / 1000);
+	if (output->fd >= 0)
+		weston_log_continue(STAMP_SPACE "%s buffered, %s\n",
+				    output->num_buffers > 1 ?
+				    "double" : "single",
+				    output->vsync.source ?
+				    "paced by vsync" : "paced by a timer");
 
 	return 0;
 
@@ -651,10 +1004,10 @@ out_shadow_surface:
 	output->shadow_surface = NULL;
 out_hw_surface:
 	free(output->shadow_buf);
-	pixman_image_unref(output->hw_surface);
-	output->hw_surface = NULL;
 	weston_output_destroy(&output->base);
 	fbdev_frame_buffer_destroy(output);
+	if (output->fd >= 0)
+		close(output->fd);
 out_free:
 	free(output);
 
@@ -671,11 +1024,15 @@ fbdev_output_destroy(struct weston_output *base)
 
 	/* Close the frame buffer. */
 	fbdev_output_disable(base);
+	fbdev_output_stop_vsync(output);
 
 	if (compositor->use_pixman) {
 		if (base->renderer_state != NULL)
 			pixman_renderer_output_destroy(base);
 
+		pixman_region32_fini(&output->buffer_damage[0]);
+		pixman_region32_fini(&output->buffer_damage[1]);
+
 		if (output->shadow_surface != NULL) {
 			pixman_image_unref(output->shadow_surface);
 			output->shadow_surface = NULL;
@@ -760,6 +1117,9 @@ fbdev_output_reenable(struct fbdev_compositor *compositor,
 			weston_log("Mapping frame buffer failed.\n");
 			goto err;
 		}
+		if (!output->vsync.source)
+			output->num_buffers = 1;
+		fbdev_output_reset_buffer_damage(output);
 	}
 
 	return 0;
@@ -781,9 +1141,18 @@ fbdev_output_disable(struct weston_output *base)
 
 	if ( ! compositor->use_pixman) return;
 
-	if (output->hw_surface != NULL) {
-		pixman_image_unref(output->hw_surface);
-		output->hw_surface = NULL;
+	fbdev_output_wait_vsync_idle(output);
+
+	if (output->fd >= 0) {
+		/* Leave the first screen shown for the next user. */
+		if (output->current_buffer != 0) {
+			output->varinfo.yoffset = 0;
+			ioctl(output->fd, FBIOPAN_DISPLAY, &output->varinfo);
+			output->current_buffer = 0;
+		}
+
+		close(output->fd);
+		output->fd = -1;
 	}
 
 	fbdev_frame_buffer_destroy(output);
@@ -907,6 +1276,8 @@ fbdev_compositor_create(struct wl_display *display, int *argc, char *argv[],
 	compositor->base.focus = 1;
 	compositor->prev_state = WESTON_COMPOSITOR_ACTIVE;
 	compositor->use_pixman = !param->use_gl;
+	compositor->double_buffer = param->double_buffer &&
+		compositor->use_pixman;
 
 	for (key = KEY_F1; key < KEY_F9; key++)
 		weston_compositor_add_key_binding(&compositor->base, key,
@@ -959,12 +1330,15 @@ backend_init(struct wl_display *display, int *argc, char *argv[],
 		.tty = 0, /* default to current tty */
 		.device = "/dev/fb0", /* default frame buffer */
 		.use_gl = 0,
+		.double_buffer = 0,
 	};
 
 	const struct weston_option fbdev_options[] = {
 		{ WESTON_OPTION_INTEGER, "tty", 0, &param.tty },
 		{ WESTON_OPTION_STRING, "device", 0, &param.device },
 		{ WESTON_OPTION_BOOLEAN, "use-gl", 0, &param.use_gl },
+		{ WESTON_OPTION_BOOLEAN, "double-buffer", 0,
+		  &param.double_buffer },
 	};
 
 	parse_options(fbdev_options, ARRAY_LENGTH(fbdev_options), argc, argv);
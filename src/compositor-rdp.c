@@ -25,7 +25,13 @@
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/ioctl.h>
 #include <linux/input.h>
+#include <linux/sockios.h>
 
 #include <freerdp/freerdp.h>
 #include <freerdp/listener.h>
@@ -38,9 +44,15 @@
 
 #include "compositor.h"
 #include "pixman-renderer.h"
+#include "rdp-tiles.h"
 
 #define MAX_FREERDP_FDS 32
 #define DEFAULT_AXIS_STEP_DISTANCE wl_fixed_from_int(10)
+#define RDP_ENCODER_MAX_THREADS 8
+#define RDP_MAX_JOBS_IN_FLIGHT 2
+#define RDP_MAX_UNSENT_BYTES (256 * 1024)
+#define RDP_MIN_UPDATE_INTERVAL 16
+#define RDP_MAX_UPDATE_INTERVAL 500
 
 struct rdp_compositor_config {
 	int width;
@@ -52,6 +64,7 @@ struct rdp_compositor_config {
 	char *server_key;
 	char *extra_modes;
 	int env_socket;
+	int encoder_threads;
 };
 
 struct rdp_output;
@@ -82,12 +95,95 @@ struct rdp_peers_item {
 	struct wl_list link;
 };
 
+enum rdp_codec {
+	RDP_CODEC_RAW,
+	RDP_CODEC_NSC,
+	RDP_CODEC_RFX,
+};
+
+struct rdp_encoded_rect {
+	pixman_box32_t dest;
+	size_t offset;
+	size_t length;
+};
+
+/* Surface bits for a part of an update, in one codec */
+struct rdp_encoded_frame {
+	enum rdp_codec codec;
+	UINT32 max_request_size; /* raw updates are split by it */
+	wStream *stream;
+	struct wl_array rects; /* struct rdp_encoded_rect */
+};
+
+struct rdp_encoder {
+	RFX_CONTEXT *rfx_context;
+	NSC_CONTEXT *nsc_context;
+	RFX_RECT *rfx_rects;
+};
+
+struct rdp_encode_job;
+
+struct rdp_encode_task {
+	struct rdp_encode_job *job;
+	pixman_region32_t region;
+	struct rdp_encoded_frame frame;
+	uint64_t encode_usec;
+	struct wl_list link;
+};
+
+/* One update for one or more peers with the same codec configuration.
+ * The damage is copied out of the shadow surface and split into bands
+ * of tiles that the encoder threads work on in parallel. */
+struct rdp_encode_job {
+	int refcount;
+	enum rdp_codec codec;
+	UINT32 max_request_size;
+	int output_width, output_height;
+
+	/* covers the damage extents, task regions are relative to it */
+	pixman_image_t *snapshot;
+	int x, y;
+	struct rdp_encode_task *tasks;
+	int ntasks;
+	int nfinished;
+	int accounted;
+	struct wl_list link; /* rdp_output::shared_jobs */
+};
+
+struct rdp_encoder_pool;
+
+struct rdp_encoder_thread {
+	struct rdp_encoder_pool *pool;
+	pthread_t thread;
+	struct rdp_encoder encoder;
+};
+
+struct rdp_encoder_pool {
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+	struct wl_list queue; /* rdp_encode_task::link */
+	struct wl_list finished;
+	int destroying;
+
+	int pipe[2];
+	struct wl_event_source *source;
+
+	int nthreads;
+	struct rdp_encoder_thread threads[RDP_ENCODER_MAX_THREADS];
+};
+
 struct rdp_output {
 	struct weston_output base;
 	struct wl_event_source *finish_frame_timer;
+	struct wl_event_source *pacing_timer;
 	pixman_image_t *shadow_surface;
 
 	struct wl_list peers;
+
+	struct rdp_encoder_pool *pool;
+	struct wl_list shared_jobs; /* jobs of the current repaint */
+
+	struct rdp_tiles tiles; /* of the shadow surface */
 };
 
 struct rdp_peer_context {
@@ -95,10 +191,35 @@ struct rdp_peer_context {
 
 	struct rdp_compositor *rdpCompositor;
 	struct wl_event_source *events[MAX_FREERDP_FDS];
-	RFX_CONTEXT *rfx_context;
+	struct rdp_encoder encoder;
 	wStream *encode_stream;
-	RFX_RECT *rfx_rects;
-	NSC_CONTEXT *nsc_context;
+	struct rdp_encoded_frame frame;
+	int shared_encoding;
+
+	/* jobs not sent yet, oldest first, and damage not queued yet */
+	struct wl_array jobs;
+	pixman_region32_t pending_damage;
+
+	/* adaptive pacing, see rdp_peer_queue_update() */
+	struct {
+		uint32_t interval; /* ms */
+		uint32_t last_update;
+	} pacing;
+
+	struct {
+		uint32_t updates;
+		uint32_t encoded;
+		uint32_t deferred;
+		uint64_t bytes;
+		uint64_t encode_usec;
+
+		/* rates over the last full second */
+		uint32_t window_start;
+		uint32_t window_updates;
+		uint64_t window_bytes;
+		float fps;
+		float kbps;
+	} stats;
 
 	struct rdp_peers_item item;
 };
@@ -115,43 +236,121 @@ rdp_compositor_config_init(struct rdp_compositor_config *config) {
 	config->server_key = NULL;
 	config->extra_modes = NULL;
 	config->env_socket = 0;
+	config->encoder_threads = 0;
+}
+
+static uint64_t
+rdp_get_usec(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static enum rdp_codec
+rdp_peer_codec(freerdp_peer *peer)
+{
+	if (peer->settings->RemoteFxCodec)
+		return RDP_CODEC_RFX;
+	else if (peer->settings->NSCodec)
+		return RDP_CODEC_NSC;
+	else
+		return RDP_CODEC_RAW;
+}
+
+static int
+rdp_encoder_init(struct rdp_encoder *encoder, int width, int height)
+{
+	encoder->rfx_context = rfx_context_new();
+	encoder->nsc_context = nsc_context_new();
+	encoder->rfx_rects = NULL;
+	if (!encoder->rfx_context || !encoder->nsc_context)
+		return -1;
+
+	encoder->rfx_context->mode = RLGR3;
+	encoder->rfx_context->width = width;
+	encoder->rfx_context->height = height;
+	rfx_context_set_pixel_format(encoder->rfx_context, RDP_PIXEL_FORMAT_B8G8R8A8);
+	nsc_context_set_pixel_format(encoder->nsc_context, RDP_PIXEL_FORMAT_B8G8R8A8);
+
+	return 0;
+}
+
+static void
+rdp_encoder_release(struct rdp_encoder *encoder)
+{
+	if (encoder->nsc_context)
+		nsc_context_free(encoder->nsc_context);
+	if (encoder->rfx_context)
+		rfx_context_free(encoder->rfx_context);
+	free(encoder->rfx_rects);
+}
+
+static int
+rdp_encoded_frame_init(struct rdp_encoded_frame *frame, wStream *stream)
+{
+	frame->stream = stream ? stream : Stream_New(NULL, 65536);
+	if (!frame->stream)
+		return -1;
+
+	wl_array_init(&frame->rects);
+
+	return 0;
 }
 
 static void
-rdp_peer_refresh_rfx(pixman_region32_t *damage, pixman_image_t *image, freerdp_peer *peer)
+rdp_encoded_frame_translate(struct rdp_encoded_frame *frame, int dx, int dy)
+{
+	struct rdp_encoded_rect *rect;
+
+	wl_array_for_each(rect, &frame->rects) {
+		rect->dest.x1 += dx;
+		rect->dest.y1 += dy;
+		rect->dest.x2 += dx;
+		rect->dest.y2 += dy;
+	}
+}
+
+static void
+rdp_encoded_frame_add_rect(struct rdp_encoded_frame *frame,
+			   int x1, int y1, int x2, int y2, size_t offset)
+{
+	struct rdp_encoded_rect *rect;
+
+	rect = wl_array_add(&frame->rects, sizeof *rect);
+	if (!rect)
+		return;
+
+	rect->dest.x1 = x1;
+	rect->dest.y1 = y1;
+	rect->dest.x2 = x2;
+	rect->dest.y2 = y2;
+	rect->offset = offset;
+	rect->length = Stream_GetPosition(frame->stream) - offset;
+}
+
+static void
+rdp_encode_rfx(struct rdp_encoded_frame *frame, pixman_region32_t *damage,
+	       pixman_image_t *image, struct rdp_encoder *encoder)
 {
 	int width, height, nrects, i;
 	pixman_box32_t *region, *rects;
 	uint32_t *ptr;
 	RFX_RECT *rfxRect;
-	rdpUpdate *update = peer->update;
-	SURFACE_BITS_COMMAND *cmd = &update->surface_bits_command;
-	RdpPeerContext *context = (RdpPeerContext *)peer->context;
-
-	Stream_Clear(context->encode_stream);
-	Stream_SetPosition(context->encode_stream, 0);
 
 	width = (damage->extents.x2 - damage->extents.x1);
 	height = (damage->extents.y2 - damage->extents.y1);
 
-	cmd->destLeft = damage->extents.x1;
-	cmd->destTop = damage->extents.y1;
-	cmd->destRight = damage->extents.x2;
-	cmd->destBottom = damage->extents.y2;
-	cmd->bpp = 32;
-	cmd->codecID = peer->settings->RemoteFxCodecId;
-	cmd->width = width;
-	cmd->height = height;
-
 	ptr = pixman_image_get_data(image) + damage->extents.x1 +
 				damage->extents.y1 * (pixman_image_get_stride(image) / sizeof(uint32_t));
 
 	rects = pixman_region32_rectangles(damage, &nrects);
-	context->rfx_rects = realloc(context->rfx_rects, nrects * sizeof *rfxRect);
+	encoder->rfx_rects = realloc(encoder->rfx_rects, nrects * sizeof *rfxRect);
 
 	for (i = 0; i < nrects; i++) {
 		region = &rects[i];
-		rfxRect = &context->rfx_rects[i];
+		rfxRect = &encoder->rfx_rects[i];
 
 		rfxRect->x = (region->x1 - damage->extents.x1);
 		rfxRect->y = (region->y1 - damage->extents.y1);
@@ -159,51 +358,35 @@ rdp_peer_refresh_rfx(pixman_region32_t *damage, pixman_image_t *image, freerdp_p
 		rfxRect->height = (region->y2 - region->y1);
 	}
 
-	rfx_compose_message(context->rfx_context, context->encode_stream, context->rfx_rects, nrects,
+	rfx_compose_message(encoder->rfx_context, frame->stream, encoder->rfx_rects, nrects,
 			(BYTE *)ptr, width, height,
 			pixman_image_get_stride(image)
 	);
 
-	cmd->bitmapDataLength = Stream_GetPosition(context->encode_stream);
-	cmd->bitmapData = Stream_Buffer(context->encode_stream);
-
-	update->SurfaceBits(update->context, cmd);
+	rdp_encoded_frame_add_rect(frame, damage->extents.x1, damage->extents.y1,
+				   damage->extents.x2, damage->extents.y2, 0);
 }
 
 
 static void
-rdp_peer_refresh_nsc(pixman_region32_t *damage, pixman_image_t *image, freerdp_peer *peer)
+rdp_encode_nsc(struct rdp_encoded_frame *frame, pixman_region32_t *damage,
+	       pixman_image_t *image, struct rdp_encoder *encoder)
 {
 	int width, height;
 	uint32_t *ptr;
-	rdpUpdate *update = peer->update;
-	SURFACE_BITS_COMMAND *cmd = &update->surface_bits_command;
-	RdpPeerContext *context = (RdpPeerContext *)peer->context;
-
-	Stream_Clear(context->encode_stream);
-	Stream_SetPosition(context->encode_stream, 0);
 
 	width = (damage->extents.x2 - damage->extents.x1);
 	height = (damage->extents.y2 - damage->extents.y1);
 
-	cmd->destLeft = damage->extents.x1;
-	cmd->destTop = damage->extents.y1;
-	cmd->destRight = damage->extents.x2;
-	cmd->destBottom = damage->extents.y2;
-	cmd->bpp = 32;
-	cmd->codecID = peer->settings->NSCodecId;
-	cmd->width = width;
-	cmd->height = height;
-
 	ptr = pixman_image_get_data(image) + damage->extents.x1 +
 				damage->extents.y1 * (pixman_image_get_stride(image) / sizeof(uint32_t));
 
-	nsc_compose_message(context->nsc_context, context->encode_stream, (BYTE *)ptr,
-			cmd->width,	cmd->height,
+	nsc_compose_message(encoder->nsc_context, frame->stream, (BYTE *)ptr,
+			width, height,
 			pixman_image_get_stride(image));
-	cmd->bitmapDataLength = Stream_GetPosition(context->encode_stream);
-	cmd->bitmapData = Stream_Buffer(context->encode_stream);
-	update->SurfaceBits(update->context, cmd);
+
+	rdp_encoded_frame_add_rect(frame, damage->extents.x1, damage->extents.y1,
+				   damage->extents.x2, damage->extents.y2, 0);
 }
 
 static void
@@ -220,33 +403,21 @@ pixman_image_flipped_subrect(const pixman_box32_t *rect, pixman_image_t *img, BY
 }
 
 static void
-rdp_peer_refresh_raw(pixman_region32_t *region, pixman_image_t *image, freerdp_peer *peer)
+rdp_encode_raw(struct rdp_encoded_frame *frame, pixman_region32_t *region,
+	       pixman_image_t *image)
 {
-	rdpUpdate *update = peer->update;
-	SURFACE_BITS_COMMAND *cmd = &update->surface_bits_command;
-	SURFACE_FRAME_MARKER *marker = &update->surface_frame_marker;
 	pixman_box32_t *rect, subrect;
-	int nrects, i;
+	int nrects, i, width, height;
 	int heightIncrement, remainingHeight, top;
+	size_t offset, length;
 
 	rect = pixman_region32_rectangles(region, &nrects);
-	if (!nrects)
-		return;
-
-	marker->frameId++;
-	marker->frameAction = SURFACECMD_FRAMEACTION_BEGIN;
-	update->SurfaceFrameMarker(peer->context, marker);
-
-	cmd->bpp = 32;
-	cmd->codecID = 0;
 
 	for (i = 0; i < nrects; i++, rect++) {
 		/*weston_log("rect(%d,%d, %d,%d)\n", rect->x1, rect->y1, rect->x2, rect->y2);*/
-		cmd->destLeft = rect->x1;
-		cmd->destRight = rect->x2;
-		cmd->width = rect->x2 - rect->x1;
+		width = rect->x2 - rect->x1;
 
-		heightIncrement = peer->settings->MultifragMaxRequestSize / (16 + cmd->width * 4);
+		heightIncrement = frame->max_request_size / (16 + width * 4);
 		remainingHeight = rect->y2 - rect->y1;
 		top = rect->y1;
 
@@ -254,41 +425,637 @@ rdp_peer_refresh_raw(pixman_region32_t *region, pixman_image_t *image, freerdp_p
 		subrect.x2 = rect->x2;
 
 		while (remainingHeight) {
-			   cmd->height = (remainingHeight > heightIncrement) ? heightIncrement : remainingHeight;
-			   cmd->destTop = top;
-			   cmd->destBottom = top + cmd->height;
-			   cmd->bitmapDataLength = cmd->width * cmd->height * 4;
-			   cmd->bitmapData = (BYTE *)realloc(cmd->bitmapData, cmd->bitmapDataLength);
+			   height = (remainingHeight > heightIncrement) ? heightIncrement : remainingHeight;
+			   length = width * height * 4;
+			   offset = Stream_GetPosition(frame->stream);
+			   Stream_EnsureRemainingCapacity(frame->stream, length);
 
 			   subrect.y1 = top;
-			   subrect.y2 = top + cmd->height;
-			   pixman_image_flipped_subrect(&subrect, image, cmd->bitmapData);
+			   subrect.y2 = top + height;
+			   pixman_image_flipped_subrect(&subrect, image, Stream_Pointer(frame->stream));
+			   Stream_Seek(frame->stream, length);
 
-			   /*weston_log("*  sending (%d,%d, %d,%d)\n", subrect.x1, subrect.y1, subrect.x2, subrect.y2); */
-			   update->SurfaceBits(peer->context, cmd);
+			   rdp_encoded_frame_add_rect(frame, subrect.x1, subrect.y1,
+						      subrect.x2, subrect.y2, offset);
 
-			   remainingHeight -= cmd->height;
-			   top += cmd->height;
+			   remainingHeight -= height;
+			   top += height;
 		}
 	}
+}
+
+static void
+rdp_encode_region(struct rdp_encoded_frame *frame, pixman_region32_t *region,
+		  pixman_image_t *image, struct rdp_encoder *encoder)
+{
+	Stream_SetPosition(frame->stream, 0);
+	frame->rects.size = 0;
+
+	switch (frame->codec) {
+	case RDP_CODEC_RFX:
+		rdp_encode_rfx(frame, region, image, encoder);
+		break;
+	case RDP_CODEC_NSC:
+		rdp_encode_nsc(frame, region, image, encoder);
+		break;
+	case RDP_CODEC_RAW:
+		rdp_encode_raw(frame, region, image);
+		break;
+	}
+}
+
+static void
+rdp_peer_send_frame(freerdp_peer *peer, struct rdp_encoded_frame *frame)
+{
+	RdpPeerContext *context = (RdpPeerContext *)peer->context;
+	rdpUpdate *update = peer->update;
+	SURFACE_BITS_COMMAND *cmd = &update->surface_bits_command;
+	struct rdp_encoded_rect *rect;
+
+	switch (frame->codec) {
+	case RDP_CODEC_RFX:
+		cmd->codecID = peer->settings->RemoteFxCodecId;
+		break;
+	case RDP_CODEC_NSC:
+		cmd->codecID = peer->settings->NSCodecId;
+		break;
+	case RDP_CODEC_RAW:
+		cmd->codecID = 0;
+		break;
+	}
+	cmd->bpp = 32;
+
+	wl_array_for_each(rect, &frame->rects) {
+		cmd->destLeft = rect->dest.x1;
+		cmd->destTop = rect->dest.y1;
+		cmd->destRight = rect->dest.x2;
+		cmd->destBottom = rect->dest.y2;
+		cmd->width = rect->dest.x2 - rect->dest.x1;
+		cmd->height = rect->dest.y2 - rect->dest.y1;
+		cmd->bitmapDataLength = rect->length;
+		cmd->bitmapData = Stream_Buffer(frame->stream) + rect->offset;
+		update->SurfaceBits(peer->context, cmd);
+
+		context->stats.bytes += rect->length;
+	}
+	cmd->bitmapData = NULL;
+}
+
+static void
+rdp_peer_begin_update(freerdp_peer *peer)
+{
+	rdpUpdate *update = peer->update;
+	SURFACE_FRAME_MARKER *marker = &update->surface_frame_marker;
+
+	marker->frameId++;
+	marker->frameAction = SURFACECMD_FRAMEACTION_BEGIN;
+	update->SurfaceFrameMarker(peer->context, marker);
+}
+
+static void
+rdp_peer_end_update(freerdp_peer *peer)
+{
+	RdpPeerContext *context = (RdpPeerContext *)peer->context;
+	rdpUpdate *update = peer->update;
+	SURFACE_FRAME_MARKER *marker = &update->surface_frame_marker;
+
+	uint32_t now, elapsed;
 
 	marker->frameAction = SURFACECMD_FRAMEACTION_END;
 	update->SurfaceFrameMarker(peer->context, marker);
+
+	context->stats.updates++;
+
+	now = weston_compositor_get_time();
+	elapsed = now - context->stats.window_start;
+	if (elapsed >= 1000) {
+		context->stats.fps = (context->stats.updates -
+				      context->stats.window_updates) *
+			1000.0 / elapsed;
+		context->stats.kbps = (context->stats.bytes -
+				       context->stats.window_bytes) *
+			1000.0 / 1024 / elapsed;
+		context->stats.window_start = now;
+		context->stats.window_updates = context->stats.updates;
+		context->stats.window_bytes = context->stats.bytes;
+	}
 }
 
+/* Encodes with the peer's own contexts and sends right away. Used when
+ * nothing is queued for the peer: the full refresh on connect, the
+ * first update after activation (a reset RemoteFX context sends its
+ * headers with it) and when there are no encoder threads. */
 static void
 rdp_peer_refresh_region(pixman_region32_t *region, freerdp_peer *peer)
 {
 	RdpPeerContext *context = (RdpPeerContext *)peer->context;
 	struct rdp_output *output = context->rdpCompositor->output;
-	rdpSettings *settings = peer->settings;
+	uint64_t start;
 
-	if (settings->RemoteFxCodec)
-		rdp_peer_refresh_rfx(region, output->shadow_surface, peer);
-	else if (settings->NSCodec)
-		rdp_peer_refresh_nsc(region, output->shadow_surface, peer);
-	else
-		rdp_peer_refresh_raw(region, output->shadow_surface, peer);
+	if (!pixman_region32_not_empty(region))
+		return;
+
+	context->frame.codec = rdp_peer_codec(peer);
+	context->frame.max_request_size =
+		peer->settings->MultifragMaxRequestSize;
+
+	start = rdp_get_usec();
+	rdp_encode_region(&context->frame, region, output->shadow_surface,
+			  &context->encoder);
+	context->stats.encode_usec += rdp_get_usec() - start;
+	context->stats.encoded++;
+
+	rdp_peer_begin_update(peer);
+	rdp_peer_send_frame(peer, &context->frame);
+	rdp_peer_end_update(peer);
+
+	context->shared_encoding = 1;
+}
+
+static void
+rdp_encode_job_unref(struct rdp_encode_job *job)
+{
+	int i;
+
+	if (--job->refcount > 0)
+		return;
+
+	for (i = 0; i < job->ntasks; i++) {
+		pixman_region32_fini(&job->tasks[i].region);
+		Stream_Free(job->tasks[i].frame.stream, TRUE);
+		wl_array_release(&job->tasks[i].frame.rects);
+	}
+	free(job->tasks);
+	pixman_image_unref(job->snapshot);
+	wl_list_remove(&job->link);
+	free(job);
+}
+
+static void *
+rdp_encoder_thread_func(void *data)
+{
+	struct rdp_encoder_thread *thread = data;
+	struct rdp_encoder_pool *pool = thread->pool;
+	struct rdp_encoder *encoder = &thread->encoder;
+	struct rdp_encode_task *task;
+	struct rdp_encode_job *job;
+	uint64_t start;
+	char byte = 0;
+
+	pthread_mutex_lock(&pool->mutex);
+	while (!pool->destroying) {
+		if (wl_list_empty(&pool->queue)) {
+			pthread_cond_wait(&pool->cond, &pool->mutex);
+			continue;
+		}
+
+		task = container_of(pool->queue.next,
+				    struct rdp_encode_task, link);
+		wl_list_remove(&task->link);
+		pthread_mutex_unlock(&pool->mutex);
+
+		/* Follows mode switches, the context is ours alone */
+		job = task->job;
+		encoder->rfx_context->width = job->output_width;
+		encoder->rfx_context->height = job->output_height;
+
+		start = rdp_get_usec();
+		rdp_encode_region(&task->frame, &task->region, job->snapshot,
+				  encoder);
+		rdp_encoded_frame_translate(&task->frame, job->x, job->y);
+		task->encode_usec = rdp_get_usec() - start;
+
+		pthread_mutex_lock(&pool->mutex);
+		wl_list_insert(pool->finished.prev, &task->link);
+		if (write(pool->pipe[1], &byte, 1) < 0 && errno != EAGAIN)
+			weston_log("rdp encoder: failed to signal: %m\n");
+	}
+	pthread_mutex_unlock(&pool->mutex);
+
+	return NULL;
+}
+
+static void
+rdp_peer_send_job(freerdp_peer *peer, struct rdp_encode_job *job)
+{
+	RdpPeerContext *context = (RdpPeerContext *)peer->context;
+	int i;
+
+	rdp_peer_begin_update(peer);
+	for (i = 0; i < job->ntasks; i++)
+		rdp_peer_send_frame(peer, &job->tasks[i].frame);
+	rdp_peer_end_update(peer);
+
+	/* the first peer the job is sent to accounts for its encoding */
+	if (!job->accounted) {
+		for (i = 0; i < job->ntasks; i++)
+			context->stats.encode_usec += job->tasks[i].encode_usec;
+		context->stats.encoded++;
+		job->accounted = 1;
+	}
+}
+
+/* Sends finished jobs in the order they were queued, an update never
+ * overtakes an older one. */
+static void
+rdp_peer_flush_jobs(freerdp_peer *peer)
+{
+	RdpPeerContext *context = (RdpPeerContext *)peer->context;
+	struct rdp_output *output = context->rdpCompositor->output;
+	struct rdp_encode_job **jobs = context->jobs.data;
+	size_t sent = 0, count = context->jobs.size / sizeof *jobs;
+
+	while (sent < count && jobs[sent]->nfinished == jobs[sent]->ntasks) {
+		rdp_peer_send_job(peer, jobs[sent]);
+		rdp_encode_job_unref(jobs[sent]);
+		sent++;
+	}
+
+	if (!sent)
+		return;
+
+	memmove(jobs, jobs + sent, (count - sent) * sizeof *jobs);
+	context->jobs.size -= sent * sizeof *jobs;
+
+	if (!context->jobs.size &&
+	    pixman_region32_not_empty(&context->pending_damage))
+		weston_output_schedule_repaint(&output->base);
+}
+
+static int
+rdp_encoder_pool_handle_finished(int fd, uint32_t mask, void *data)
+{
+	struct rdp_output *output = data;
+	struct rdp_encoder_pool *pool = output->pool;
+	struct rdp_encode_task *task, *next;
+	struct rdp_peers_item *item;
+	struct wl_list finished;
+	char buf[64];
+
+	while (read(fd, buf, sizeof buf) > 0)
+		;
+
+	wl_list_init(&finished);
+	pthread_mutex_lock(&pool->mutex);
+	wl_list_insert_list(&finished, &pool->finished);
+	wl_list_init(&pool->finished);
+	pthread_mutex_unlock(&pool->mutex);
+
+	wl_list_for_each_safe(task, next, &finished, link) {
+		wl_list_init(&task->link);
+		if (++task->job->nfinished == task->job->ntasks)
+			rdp_encode_job_unref(task->job);
+	}
+
+	wl_list_for_each(item, &output->peers, link)
+		rdp_peer_flush_jobs(item->peer);
+
+	return 1;
+}
+
+static struct rdp_encoder_pool *
+rdp_encoder_pool_create(struct rdp_output *output, int nthreads)
+{
+	struct weston_compositor *ec = output->base.compositor;
+	struct rdp_encoder_pool *pool;
+	struct wl_event_loop *loop;
+	int i;
+
+	if (nthreads <= 0) {
+		nthreads = sysconf(_SC_NPROCESSORS_ONLN);
+		if (nthreads > 4)
+			nthreads = 4;
+	}
+	if (nthreads < 1)
+		nthreads = 1;
+	if (nthreads > RDP_ENCODER_MAX_THREADS)
+		nthreads = RDP_ENCODER_MAX_THREADS;
+
+	pool = zalloc(sizeof *pool);
+	if (!pool)
+		return NULL;
+
+	wl_list_init(&pool->queue);
+	wl_list_init(&pool->finished);
+	if (pipe2(pool->pipe, O_CLOEXEC | O_NONBLOCK) == -1)
+		goto err_free;
+
+	loop = wl_display_get_event_loop(ec->wl_display);
+	pool->source = wl_event_loop_add_fd(loop, pool->pipe[0],
+					    WL_EVENT_READABLE,
+					    rdp_encoder_pool_handle_finished,
+					    output);
+	if (!pool->source)
+		goto err_pipe;
+
+	pthread_mutex_init(&pool->mutex, NULL);
+	pthread_cond_init(&pool->cond, NULL);
+
+	for (i = 0; i < nthreads; i++) {
+		pool->threads[i].pool = pool;
+		if (rdp_encoder_init(&pool->threads[i].encoder,
+				     output->base.width,
+				     output->base.height) < 0 ||
+		    pthread_create(&pool->threads[i].thread, NULL,
+				   rdp_encoder_thread_func,
+				   &pool->threads[i]) != 0) {
+			rdp_encoder_release(&pool->threads[i].encoder);
+			break;
+		}
+	}
+	pool->nthreads = i;
+
+	if (pool->nthreads == 0) {
+		pthread_mutex_destroy(&pool->mutex);
+		pthread_cond_destroy(&pool->cond);
+		wl_event_source_remove(pool->source);
+		goto err_pipe;
+	}
+
+	weston_log("RDP: %d encoder threads\n", pool->nthreads);
+
+	return pool;
+
+err_pipe:
+	close(pool->pipe[0]);
+	close(pool->pipe[1]);
+err_free:
+	free(pool);
+	return NULL;
+}
+
+static void
+rdp_encoder_pool_destroy(struct rdp_encoder_pool *pool)
+{
+	struct rdp_encode_task *task, *next;
+	int i;
+
+	pthread_mutex_lock(&pool->mutex);
+	pool->destroying = 1;
+	pthread_cond_broadcast(&pool->cond);
+	pthread_mutex_unlock(&pool->mutex);
+
+	for (i = 0; i < pool->nthreads; i++) {
+		pthread_join(pool->threads[i].thread, NULL);
+		rdp_encoder_release(&pool->threads[i].encoder);
+	}
+
+	/* Jobs stay alive for the peers still holding them */
+	wl_list_insert_list(&pool->finished, &pool->queue);
+	wl_list_for_each_safe(task, next, &pool->finished, link) {
+		wl_list_init(&task->link);
+		if (++task->job->nfinished == task->job->ntasks)
+			rdp_encode_job_unref(task->job);
+	}
+
+	wl_event_source_remove(pool->source);
+	close(pool->pipe[0]);
+	close(pool->pipe[1]);
+	pthread_mutex_destroy(&pool->mutex);
+	pthread_cond_destroy(&pool->cond);
+	free(pool);
+}
+
+static struct rdp_encode_job *
+rdp_encode_job_create(struct rdp_output *output, freerdp_peer *peer,
+		      pixman_region32_t *region)
+{
+	struct rdp_encoder_pool *pool = output->pool;
+	struct rdp_encode_job *job;
+	struct rdp_encode_task *task;
+	pixman_box32_t *extents = pixman_region32_extents(region);
+	pixman_region32_t clip;
+	int width, height, band, y, i;
+
+	width = extents->x2 - extents->x1;
+	height = extents->y2 - extents->y1;
+
+	job = zalloc(sizeof *job);
+	if (!job)
+		return NULL;
+
+	/* one band of 64 pixel high tiles per thread */
+	band = (height + pool->nthreads - 1) / pool->nthreads;
+	band = (band + 63) & ~63;
+	if (band == 0)
+		band = 64;
+
+	job->tasks = calloc(height / band + 1, sizeof *job->tasks);
+	job->snapshot = pixman_image_create_bits(PIXMAN_x8r8g8b8,
+						 width, height, NULL,
+						 width * 4);
+	if (!job->tasks || !job->snapshot) {
+		if (job->snapshot)
+			pixman_image_unref(job->snapshot);
+		free(job->tasks);
+		free(job);
+		return NULL;
+	}
+	job->x = extents->x1;
+	job->y = extents->y1;
+	job->output_width = output->base.width;
+	job->output_height = output->base.height;
+
+	/* Only the damage is copied, the compositor may render the next
+	 * frame into the shadow surface while this one is encoded. */
+	pixman_region32_init(&clip);
+	pixman_region32_copy(&clip, region);
+	pixman_region32_translate(&clip, -job->x, -job->y);
+	pixman_image_set_clip_region32(job->snapshot, &clip);
+	pixman_image_composite32(PIXMAN_OP_SRC, output->shadow_surface,
+				 NULL, job->snapshot, job->x, job->y, 0, 0,
+				 0, 0, width, height);
+	pixman_image_set_clip_region32(job->snapshot, NULL);
+
+	job->refcount = 2; /* the requesting peer and the pool */
+	job->codec = rdp_peer_codec(peer);
+	job->max_request_size = job->codec == RDP_CODEC_RAW ?
+		peer->settings->MultifragMaxRequestSize : 0;
+	wl_list_init(&job->link);
+
+	for (y = 0; y < height; y += band) {
+		task = &job->tasks[job->ntasks];
+		pixman_region32_init_rect(&task->region, 0, y, width, band);
+		pixman_region32_intersect(&task->region, &task->region,
+					  &clip);
+		if (!pixman_region32_not_empty(&task->region) ||
+		    rdp_encoded_frame_init(&task->frame, NULL) < 0) {
+			pixman_region32_fini(&task->region);
+			continue;
+		}
+
+		task->job = job;
+		task->frame.codec = job->codec;
+		task->frame.max_request_size = job->max_request_size;
+		job->ntasks++;
+	}
+	pixman_region32_fini(&clip);
+
+	pthread_mutex_lock(&pool->mutex);
+	for (i = 0; i < job->ntasks; i++)
+		wl_list_insert(pool->queue.prev, &job->tasks[i].link);
+	pthread_cond_broadcast(&pool->cond);
+	pthread_mutex_unlock(&pool->mutex);
+
+	if (job->ntasks == 0)
+		rdp_encode_job_unref(job);
+
+	return job;
+}
+
+static int
+rdp_peer_unsent_bytes(freerdp_peer *peer)
+{
+	int unsent;
+
+	if (ioctl(peer->sockfd, SIOCOUTQ, &unsent) < 0)
+		return 0;
+
+	return unsent;
+}
+
+static int
+rdp_peer_update_due(RdpPeerContext *context, uint32_t now)
+{
+	return now - context->pacing.last_update >= context->pacing.interval;
+}
+
+/* Queues the repaint damage for the peer. Peers with identical codec
+ * settings and nothing held back share one job.
+ *
+ * Every peer gets updates at its own pace: while its link keeps up
+ * that is every repaint, when updates back up (encoding or the
+ * network can't keep up) the interval doubles, up to
+ * RDP_MAX_UPDATE_INTERVAL, and shrinks again once the socket drains.
+ * Damage in between accumulates, so a slow peer skips intermediate
+ * frames and receives their union. */
+static void
+rdp_peer_queue_update(pixman_region32_t *damage, freerdp_peer *peer)
+{
+	RdpPeerContext *context = (RdpPeerContext *)peer->context;
+	struct rdp_output *output = context->rdpCompositor->output;
+	struct rdp_encode_job *job = NULL, **slot;
+	uint32_t now;
+	int shared, unsent;
+
+	shared = !pixman_region32_not_empty(&context->pending_damage);
+	pixman_region32_union(&context->pending_damage,
+			      &context->pending_damage, damage);
+	pixman_region32_intersect_rect(&context->pending_damage,
+				       &context->pending_damage, 0, 0,
+				       output->base.width,
+				       output->base.height);
+	if (!pixman_region32_not_empty(&context->pending_damage))
+		return;
+
+	now = weston_compositor_get_time();
+	if (!rdp_peer_update_due(context, now)) {
+		context->stats.deferred++;
+		return;
+	}
+
+	unsent = rdp_peer_unsent_bytes(peer);
+	if (context->jobs.size / sizeof job >= RDP_MAX_JOBS_IN_FLIGHT ||
+	    unsent > RDP_MAX_UNSENT_BYTES) {
+		context->pacing.interval *= 2;
+		if (context->pacing.interval > RDP_MAX_UPDATE_INTERVAL)
+			context->pacing.interval = RDP_MAX_UPDATE_INTERVAL;
+		context->pacing.last_update = now;
+		context->stats.deferred++;
+		return;
+	}
+
+	if (unsent < RDP_MAX_UNSENT_BYTES / 4) {
+		context->pacing.interval -= context->pacing.interval / 4;
+		if (context->pacing.interval < RDP_MIN_UPDATE_INTERVAL)
+			context->pacing.interval = RDP_MIN_UPDATE_INTERVAL;
+	}
+	context->pacing.last_update = now;
+
+	if (context->jobs.size)
+		shared = 0;
+
+	if (!output->pool || !context->shared_encoding) {
+		if (context->jobs.size)
+			return;
+		rdp_peer_refresh_region(&context->pending_damage, peer);
+		pixman_region32_clear(&context->pending_damage);
+		return;
+	}
+
+	if (shared) {
+		wl_list_for_each(job, &output->shared_jobs, link) {
+			if (job->codec == rdp_peer_codec(peer) &&
+			    (job->codec != RDP_CODEC_RAW ||
+			     job->max_request_size ==
+			     peer->settings->MultifragMaxRequestSize))
+				break;
+		}
+		if (&job->link == &output->shared_jobs)
+			job = NULL;
+	}
+
+	if (job) {
+		job->refcount++;
+	} else {
+		job = rdp_encode_job_create(output, peer,
+					    &context->pending_damage);
+		if (!job)
+			return;
+		if (shared)
+			wl_list_insert(&output->shared_jobs, &job->link);
+	}
+
+	slot = wl_array_add(&context->jobs, sizeof *slot);
+	if (!slot) {
+		rdp_encode_job_unref(job);
+		return;
+	}
+	*slot = job;
+	pixman_region32_clear(&context->pending_damage);
+
+	/* A job without tasks is finished already */
+	rdp_peer_flush_jobs(peer);
+}
+
+/* Damage held back from a paced peer must go out once the peer is due,
+ * even if nothing repaints in the meantime: keep a timer armed for the
+ * earliest due time while any peer has pending damage. */
+static void
+rdp_output_update_pacing_timer(struct rdp_output *output)
+{
+	struct rdp_peers_item *item;
+	RdpPeerContext *context;
+	uint32_t now = weston_compositor_get_time();
+	uint32_t elapsed;
+	int delay = 0, wait;
+
+	wl_list_for_each(item, &output->peers, link) {
+		context = (RdpPeerContext *)item->peer->context;
+		if (!pixman_region32_not_empty(&context->pending_damage))
+			continue;
+
+		elapsed = now - context->pacing.last_update;
+		if (elapsed >= context->pacing.interval)
+			wait = 1;
+		else
+			wait = context->pacing.interval - elapsed;
+		if (delay == 0 || wait < delay)
+			delay = wait;
+	}
+
+	/* a delay of 0 disarms the timer */
+	wl_event_source_timer_update(output->pacing_timer, delay);
+}
+
+static int
+rdp_output_pacing_handler(void *data)
+{
+	struct rdp_output *output = data;
+
+	weston_output_schedule_repaint(&output->base);
+
+	return 1;
 }
 
 static void
@@ -308,17 +1075,30 @@ rdp_output_repaint(struct weston_output *output_base, pixman_region32_t *damage)
 	struct rdp_output *output = container_of(output_base, struct rdp_output, base);
 	struct weston_compositor *ec = output->base.compositor;
 	struct rdp_peers_item *outputPeer;
+	struct rdp_encode_job *job, *next;
+	pixman_region32_t changed;
 
 	pixman_renderer_output_set_buffer(output_base, output->shadow_surface);
 	ec->renderer->repaint_output(&output->base, damage);
 
+	pixman_region32_init(&changed);
+	rdp_tiles_filter_damage(&output->tiles, output->shadow_surface,
+				damage, &changed);
+
+	wl_list_for_each_safe(job, next, &output->shared_jobs, link) {
+		wl_list_remove(&job->link);
+		wl_list_init(&job->link);
+	}
+
 	wl_list_for_each(outputPeer, &output->peers, link) {
 		if ((outputPeer->flags & RDP_PEER_ACTIVATED) &&
 				(outputPeer->flags & RDP_PEER_OUTPUT_ENABLED))
 		{
-			rdp_peer_refresh_region(damage, outputPeer->peer);
+			rdp_peer_queue_update(&changed, outputPeer->peer);
 		}
 	}
+	pixman_region32_fini(&changed);
+	rdp_output_update_pacing_timer(output);
 
 	pixman_region32_subtract(&ec->primary_plane.damage,
 				 &ec->primary_plane.damage, damage);
@@ -331,7 +1111,23 @@ static void
 rdp_output_destroy(struct weston_output *output_base)
 {
 	struct rdp_output *output = (struct rdp_output *)output_base;
+	struct rdp_encode_job *job, *next;
+
+	wl_list_for_each_safe(job, next, &output->shared_jobs, link) {
+		wl_list_remove(&job->link);
+		wl_list_init(&job->link);
+	}
+	if (output->pool)
+		rdp_encoder_pool_destroy(output->pool);
+
+	if (output->tiles.stats.damaged)
+		weston_log("RDP: %llu kB damaged, %llu kB unchanged and "
+			   "not encoded\n",
+			   (unsigned long long) output->tiles.stats.damaged / 1024,
+			   (unsigned long long) output->tiles.stats.unchanged / 1024);
+	rdp_tiles_release(&output->tiles);
 
+	wl_event_source_remove(output->pacing_timer);
 	wl_event_source_remove(output->finish_frame_timer);
 	free(output);
 }
@@ -387,6 +1183,9 @@ rdp_switch_mode(struct weston_output *output, struct weston_mode *target_mode) {
 			0, 0, 0, 0, 0, 0, target_mode->width, target_mode->height);
 	pixman_image_unref(rdpOutput->shadow_surface);
 	rdpOutput->shadow_surface = new_shadow_buffer;
+	if (rdp_tiles_reset(&rdpOutput->tiles, rdpOutput->shadow_surface) < 0)
+		weston_log("RDP: no memory for tile hashes, "
+			   "sending all damage\n");
 
 	wl_list_for_each(rdpPeer, &rdpOutput->peers, link) {
 		settings = rdpPeer->peer->settings;
@@ -441,7 +1240,7 @@ parse_extra_modes(const char *modes_str, struct rdp_output *output) {
 }
 static int
 rdp_compositor_create_output(struct rdp_compositor *c, int width, int height,
-		const char *extraModes)
+		const char *extraModes, int encoderThreads)
 {
 	struct rdp_output *output;
 	struct wl_event_loop *loop;
@@ -452,6 +1251,7 @@ rdp_compositor_create_output(struct rdp_compositor *c, int width, int height,
 		return -1;
 
 	wl_list_init(&output->peers);
+	wl_list_init(&output->shared_jobs);
 	wl_list_init(&output->base.mode_list);
 
 	currentMode = malloc(sizeof *currentMode);
@@ -486,10 +1286,17 @@ rdp_compositor_create_output(struct rdp_compositor *c, int width, int height,
 	if (pixman_renderer_output_create(&output->base) < 0)
 		goto out_shadow_surface;
 
+	if (rdp_tiles_reset(&output->tiles, output->shadow_surface) < 0)
+		weston_log("RDP: no memory for tile hashes, "
+			   "sending all damage\n");
+
 	weston_output_move(&output->base, 0, 0);
 
 	loop = wl_display_get_event_loop(c->base.wl_display);
 	output->finish_frame_timer = wl_event_loop_add_timer(loop, finish_frame_handler, output);
+	output->pacing_timer =
+		wl_event_loop_add_timer(loop, rdp_output_pacing_handler,
+					output);
 
 	output->base.start_repaint_loop = rdp_output_start_repaint_loop;
 	output->base.repaint = rdp_output_repaint;
@@ -500,6 +1307,10 @@ rdp_compositor_create_output(struct rdp_compositor *c, int width, int height,
 	output->base.switch_mode = rdp_switch_mode;
 	c->output = output;
 
+	output->pool = rdp_encoder_pool_create(output, encoderThreads);
+	if (!output->pool)
+		weston_log("RDP: no encoder threads, encoding synchronously\n");
+
 	wl_list_insert(c->base.output_list.prev, &output->base.link);
 	return 0;
 
@@ -574,21 +1385,23 @@ rdp_peer_context_new(freerdp_peer* client, RdpPeerContext* context)
 	context->item.peer = client;
 	context->item.flags = RDP_PEER_OUTPUT_ENABLED;
 
-	context->rfx_context = rfx_context_new();
-	context->rfx_context->mode = RLGR3;
-	context->rfx_context->width = client->settings->DesktopWidth;
-	context->rfx_context->height = client->settings->DesktopHeight;
-	rfx_context_set_pixel_format(context->rfx_context, RDP_PIXEL_FORMAT_B8G8R8A8);
-
-	context->nsc_context = nsc_context_new();
-	nsc_context_set_pixel_format(context->nsc_context, RDP_PIXEL_FORMAT_B8G8R8A8);
+	rdp_encoder_init(&context->encoder, client->settings->DesktopWidth,
+			 client->settings->DesktopHeight);
 
 	context->encode_stream = Stream_New(NULL, 65536);
+	rdp_encoded_frame_init(&context->frame, context->encode_stream);
+
+	wl_array_init(&context->jobs);
+	pixman_region32_init(&context->pending_damage);
+
+	context->pacing.interval = RDP_MIN_UPDATE_INTERVAL;
+	context->stats.window_start = weston_compositor_get_time();
 }
 
 static void
 rdp_peer_context_free(freerdp_peer* client, RdpPeerContext* context)
 {
+	struct rdp_encode_job **job;
 	int i;
 	if(!context)
 		return;
@@ -601,10 +1414,26 @@ rdp_peer_context_free(freerdp_peer* client, RdpPeerContext* context)
 
 	if(context->item.flags & RDP_PEER_ACTIVATED)
 		weston_seat_release(&context->item.seat);
+
+	if (context->stats.encoded)
+		weston_log("RDP peer %p: %u updates, %u encoded for it, "
+			   "%u deferred, %llu kB sent, %.2f ms per encode, "
+			   "last %.1f fps at %.1f kB/s\n",
+			   client, context->stats.updates,
+			   context->stats.encoded, context->stats.deferred,
+			   (unsigned long long) context->stats.bytes / 1024,
+			   context->stats.encode_usec / 1000.0 /
+			   context->stats.encoded,
+			   context->stats.fps, context->stats.kbps);
+
+	wl_array_for_each(job, &context->jobs)
+		rdp_encode_job_unref(*job);
+	wl_array_release(&context->jobs);
+	pixman_region32_fini(&context->pending_damage);
+
+	wl_array_release(&context->frame.rects);
 	Stream_Free(context->encode_stream, TRUE);
-	nsc_context_free(context->nsc_context);
-	rfx_context_free(context->rfx_context);
-	free(context->rfx_rects);
+	rdp_encoder_release(&context->encoder);
 }
 
 
@@ -754,7 +1583,8 @@ static BOOL
 xf_peer_activate(freerdp_peer *client)
 {
 	RdpPeerContext *context = (RdpPeerContext *)client->context;
-	rfx_context_reset(context->rfx_context);
+	rfx_context_reset(context->encoder.rfx_context);
+	context->shared_encoding = 0;
 	return TRUE;
 }
 
@@ -824,22 +1654,14 @@ xf_extendedMouseEvent(rdpInput *input, UINT16 flags, UINT16 x, UINT16 y) {
 static void
 xf_input_synchronize_event(rdpInput *input, UINT32 flags)
 {
-	freerdp_peer *client = input->context->peer;
 	RdpPeerContext *peerCtx = (RdpPeerContext *)input->context;
 	struct rdp_output *output = peerCtx->rdpCompositor->output;
-	pixman_box32_t box;
-	pixman_region32_t damage;
-
-	/* sends a full refresh */
-	box.x1 = 0;
-	box.y1 = 0;
-	box.x2 = output->base.width;
-	box.y2 = output->base.height;
-	pixman_region32_init_with_extents(&damage, &box);
 
-	rdp_peer_refresh_region(&damage, client);
-
-	pixman_region32_fini(&damage);
+	/* sends a full refresh, behind any update still queued */
+	pixman_region32_union_rect(&peerCtx->pending_damage,
+				   &peerCtx->pending_damage, 0, 0,
+				   output->base.width, output->base.height);
+	weston_output_schedule_repaint(&output->base);
 }
 
 extern DWORD KEYCODE_TO_VKCODE_EVDEV[];
@@ -985,6 +1807,29 @@ rdp_incoming_peer(freerdp_listener *instance, freerdp_peer *client)
 		return;
 }
 
+static void
+peer_stats_binding(struct weston_seat *seat, uint32_t time, uint32_t key,
+		   void *data)
+{
+	struct rdp_compositor *c = data;
+	struct rdp_peers_item *item;
+
+	weston_log("RDP: %llu kB damaged, %llu kB unchanged and not encoded\n",
+		   (unsigned long long) c->output->tiles.stats.damaged / 1024,
+		   (unsigned long long) c->output->tiles.stats.unchanged / 1024);
+	wl_list_for_each(item, &c->output->peers, link) {
+		RdpPeerContext *context = (RdpPeerContext *)item->peer->context;
+
+		weston_log("RDP peer %s: %.1f fps, %.1f kB/s, "
+			   "update interval %u ms, %u deferred, "
+			   "%d bytes unsent\n",
+			   item->peer->hostname, context->stats.fps,
+			   context->stats.kbps, context->pacing.interval,
+			   context->stats.deferred,
+			   rdp_peer_unsent_bytes(item->peer));
+	}
+}
+
 static struct weston_compositor *
 rdp_compositor_create(struct wl_display *display,
 		struct rdp_compositor_config *config,
@@ -1018,7 +1863,8 @@ rdp_compositor_create(struct wl_display *display,
 	if (pixman_renderer_init(&c->base) < 0)
 		goto err_compositor;
 
-	if (rdp_compositor_create_output(c, config->width, config->height, config->extra_modes) < 0)
+	if (rdp_compositor_create_output(c, config->width, config->height, config->extra_modes,
+			config->encoder_threads) < 0)
 		goto err_compositor;
 
 	if(!config->env_socket) {
@@ -1045,6 +1891,9 @@ rdp_compositor_create(struct wl_display *display,
 			goto err_output;
 	}
 
+	weston_compositor_add_debug_binding(&c->base, KEY_P,
+					    peer_stats_binding, c);
+
 	return &c->base;
 
 err_listener:
@@ -1086,7 +1935,8 @@ backend_init(struct wl_display *display, int *argc, char *argv[],
 		{ WESTON_OPTION_INTEGER, "port", 0, &config.port },
 		{ WESTON_OPTION_STRING,  "rdp4-key", 0, &config.rdp_key },
 		{ WESTON_OPTION_STRING,  "rdp-tls-cert", 0, &config.server_cert },
-		{ WESTON_OPTION_STRING,  "rdp-tls-key", 0, &config.server_key }
+		{ WESTON_OPTION_STRING,  "rdp-tls-key", 0, &config.server_key },
+		{ WESTON_OPTION_INTEGER, "encoder-threads", 0, &config.encoder_threads }
 	};
 
 	parse_options(rdp_options, ARRAY_LENGTH(rdp_options), argc, argv);
@@ -53,6 +53,7 @@
 #endif
 
 #include "compositor.h"
+#include "timer-wheel.h"
 #include "subsurface-server-protocol.h"
 #include "../shared/os-compatibility.h"
 #include "git-version.h"
@@ -176,6 +177,7 @@ weston_output_switch_mode(struct weston_output *output, struct weston_mode *mode
 	pixman_region32_init(&output->previous_damage);
 	pixman_region32_init_rect(&output->region, output->x, output->y,
 				  output->width, output->height);
+	output->compositor->output_index_dirty = 1;
 
 	weston_output_update_matrix(output);
 
@@ -357,6 +359,7 @@ weston_surface_create(struct weston_compositor *compositor)
 		return NULL;
 
 	wl_signal_init(&surface->destroy_signal);
+	wl_signal_init(&surface->geometry_signal);
 
 	surface->resource = NULL;
 
@@ -415,6 +418,20 @@ weston_surface_set_color(struct weston_surface *surface,
 	surface->compositor->renderer->surface_set_color(surface, red, green, blue, alpha);
 }
 
+WL_EXPORT int
+weston_surface_set_image(struct weston_surface *surface,
+			 pixman_image_t *image)
+{
+	struct weston_renderer *renderer = surface->compositor->renderer;
+
+	if (!renderer->surface_set_image)
+		return -1;
+
+	renderer->surface_set_image(surface, image);
+
+	return 0;
+}
+
 WL_EXPORT void
 weston_surface_to_global_float(struct weston_surface *surface,
 			       float sx, float sy, float *x, float *y)
@@ -585,69 +602,157 @@ weston_surface_damage_below(struct weston_surface *surface)
 }
 
 static void
-weston_surface_update_output_mask(struct weston_surface *es, uint32_t mask)
+weston_surface_update_output_mask(struct weston_surface *es,
+				  const struct weston_output_mask *mask)
 {
-	uint32_t different = es->output_mask ^ mask;
-	uint32_t entered = mask & different;
-	uint32_t left = es->output_mask & different;
 	struct weston_output *output;
-	struct wl_resource *resource = NULL;
+	struct wl_resource *resource;
 	struct wl_client *client;
+	int was, is;
 
-	es->output_mask = mask;
-	if (es->resource == NULL)
+	if (weston_output_mask_equal(&es->output_mask, mask))
 		return;
-	if (different == 0)
+
+	if (es->resource == NULL) {
+		weston_output_mask_copy(&es->output_mask, mask);
 		return;
+	}
 
 	client = wl_resource_get_client(es->resource);
 
 	wl_list_for_each(output, &es->compositor->output_list, link) {
-		if (1 << output->id & different)
-			resource =
-				wl_resource_find_for_client(&output->resource_list,
-							 client);
+		was = weston_output_mask_test(&es->output_mask, output->id);
+		is = weston_output_mask_test(mask, output->id);
+		if (was == is)
+			continue;
+		resource = wl_resource_find_for_client(&output->resource_list,
+						       client);
 		if (resource == NULL)
 			continue;
-		if (1 << output->id & entered)
+		if (is)
 			wl_surface_send_enter(es->resource, resource);
-		if (1 << output->id & left)
+		else
 			wl_surface_send_leave(es->resource, resource);
 	}
+
+	weston_output_mask_copy(&es->output_mask, mask);
+}
+
+static int
+compare_output_left_edge(const void *a, const void *b)
+{
+	const struct weston_output *oa = *(struct weston_output * const *) a;
+	const struct weston_output *ob = *(struct weston_output * const *) b;
+
+	return oa->region.extents.x1 - ob->region.extents.x1;
+}
+
+/* Outputs sorted by their left edge, rebuilt after outputs come, go
+ * or move. */
+static struct weston_output **
+weston_compositor_output_index(struct weston_compositor *ec, int *count)
+{
+	struct weston_output **by_id, **p;
+	int32_t width;
+	unsigned int i;
+
+	if (ec->output_index_dirty) {
+		ec->output_index.size = 0;
+		ec->output_index_max_width = 0;
+		by_id = ec->output_by_id.data;
+		for (i = 0; i < ec->output_by_id.size / sizeof *by_id; i++) {
+			if (!by_id[i])
+				continue;
+			p = wl_array_add(&ec->output_index, sizeof *p);
+			if (!p)
+				break;
+			*p = by_id[i];
+			width = by_id[i]->region.extents.x2 -
+				by_id[i]->region.extents.x1;
+			if (width > ec->output_index_max_width)
+				ec->output_index_max_width = width;
+		}
+		qsort(ec->output_index.data,
+		      ec->output_index.size / sizeof *p, sizeof *p,
+		      compare_output_left_edge);
+		ec->output_index_dirty = 0;
+	}
+
+	*count = ec->output_index.size / sizeof (struct weston_output *);
+
+	return ec->output_index.data;
+}
+
+static struct weston_output *
+weston_compositor_output_by_id(struct weston_compositor *ec, uint32_t id)
+{
+	struct weston_output **by_id = ec->output_by_id.data;
+
+	if (id >= ec->output_by_id.size / sizeof *by_id)
+		return NULL;
+
+	return by_id[id];
 }
 
 static void
 weston_surface_assign_output(struct weston_surface *es)
 {
 	struct weston_compositor *ec = es->compositor;
-	struct weston_output *output, *new_output;
-	pixman_region32_t region;
-	uint32_t max, area, mask;
-	pixman_box32_t *e;
+	struct weston_output *output, *new_output, **index;
+	struct weston_output_mask mask;
+	pixman_box32_t *bbox, *e;
+	int32_t x1, y1, x2, y2;
+	uint32_t max, area;
+	int count, lo, hi, mid;
 
 	new_output = NULL;
 	max = 0;
-	mask = 0;
-	pixman_region32_init(&region);
-	wl_list_for_each(output, &ec->output_list, link) {
-		pixman_region32_intersect(&region, &es->transform.boundingbox,
-					  &output->region);
+	weston_output_mask_init(&mask);
+
+	/* Only outputs starting less than the widest output left of the
+	 * bounding box can reach into it. */
+	bbox = pixman_region32_extents(&es->transform.boundingbox);
+	index = weston_compositor_output_index(ec, &count);
+	lo = 0;
+	hi = count;
+	while (lo < hi) {
+		mid = (lo + hi) / 2;
+		if (index[mid]->region.extents.x1 <=
+		    bbox->x1 - ec->output_index_max_width)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
 
-		e = pixman_region32_extents(&region);
-		area = (e->x2 - e->x1) * (e->y2 - e->y1);
+	for (; lo < count; lo++) {
+		output = index[lo];
+		e = &output->region.extents;
+		if (e->x1 >= bbox->x2)
+			break;
 
-		if (area > 0)
-			mask |= 1 << output->id;
+		x1 = MAX(e->x1, bbox->x1);
+		y1 = MAX(e->y1, bbox->y1);
+		x2 = MIN(e->x2, bbox->x2);
+		y2 = MIN(e->y2, bbox->y2);
+		if (x2 <= x1 || y2 <= y1)
+			continue;
 
+		area = (x2 - x1) * (y2 - y1);
+		weston_output_mask_set(&mask, output->id);
 		if (area >= max) {
 			new_output = output;
 			max = area;
 		}
 	}
-	pixman_region32_fini(&region);
+
+	/* Off screen surfaces still need an output to be repainted on */
+	if (!new_output && !wl_list_empty(&ec->output_list))
+		new_output = container_of(ec->output_list.prev,
+					  struct weston_output, link);
 
 	es->output = new_output;
-	weston_surface_update_output_mask(es, mask);
+	weston_surface_update_output_mask(es, &mask);
+	weston_output_mask_release(&mask);
 }
 
 static void
@@ -817,6 +922,7 @@ weston_surface_geometry_dirty(struct weston_surface *surface)
 		return;
 
 	surface->transform.dirty = 1;
+	wl_signal_emit(&surface->geometry_signal, surface);
 
 	wl_list_for_each(child, &surface->geometry.child_list,
 			 geometry.parent_link)
@@ -892,12 +998,103 @@ weston_surface_from_global(struct weston_surface *surface,
 
 WL_EXPORT void
 weston_surface_schedule_repaint(struct weston_surface *surface)
+{
+	weston_compositor_schedule_repaint_outputs(surface->compositor,
+						   &surface->output_mask);
+}
+
+static void
+weston_surface_geometry_output_mask(struct weston_surface *surface,
+				    struct weston_output_mask *mask)
+{
+	struct weston_surface *child;
+
+	weston_output_mask_or(mask, &surface->output_mask);
+	weston_surface_update_transform(surface);
+	weston_output_mask_or(mask, &surface->output_mask);
+
+	wl_list_for_each(child, &surface->geometry.child_list,
+			 geometry.parent_link)
+		if (weston_surface_is_mapped(child))
+			weston_surface_geometry_output_mask(child, mask);
+}
+
+/*
+ * Repaints the outputs a surface was on and the ones it is on after
+ * a pending geometry change, instead of all outputs.  The transform
+ * is updated right away to know where the surface ends up.
+ */
+WL_EXPORT void
+weston_surface_schedule_geometry_repaint(struct weston_surface *surface)
+{
+	struct weston_output_mask mask;
+
+	if (!weston_surface_is_mapped(surface)) {
+		weston_surface_schedule_repaint(surface);
+		return;
+	}
+
+	weston_output_mask_init(&mask);
+	weston_surface_geometry_output_mask(surface, &mask);
+	weston_compositor_schedule_repaint_outputs(surface->compositor, &mask);
+	weston_output_mask_release(&mask);
+}
+
+/* Outputs that the damage of a surface with an up to date transform
+ * intersects. */
+static void
+weston_surface_damage_output_mask(struct weston_surface *surface,
+				  struct weston_output_mask *mask)
 {
 	struct weston_output *output;
+	pixman_region32_t damage;
+	pixman_box32_t *e;
+	int id;
 
-	wl_list_for_each(output, &surface->compositor->output_list, link)
-		if (surface->output_mask & (1 << output->id))
-			weston_output_schedule_repaint(output);
+	if (!pixman_region32_not_empty(&surface->damage))
+		return;
+
+	e = pixman_region32_extents(&surface->damage);
+	surface_compute_bbox(surface, e->x1, e->y1,
+			     e->x2 - e->x1, e->y2 - e->y1, &damage);
+	e = pixman_region32_extents(&damage);
+
+	weston_output_mask_for_each(id, &surface->output_mask) {
+		output = weston_compositor_output_by_id(surface->compositor,
+							id);
+		if (!output)
+			continue;
+		if (pixman_region32_contains_rectangle(&output->region, e) !=
+		    PIXMAN_REGION_OUT)
+			weston_output_mask_set(mask, id);
+	}
+
+	pixman_region32_fini(&damage);
+}
+
+static void
+weston_surface_schedule_commit_repaint(struct weston_surface *surface)
+{
+	struct weston_output_mask mask;
+
+	if (surface->freeze.active) {
+		surface->freeze.commits++;
+		return;
+	}
+
+	if (surface->transform.dirty) {
+		weston_surface_schedule_geometry_repaint(surface);
+		return;
+	}
+
+	/* Frame callbacks are sent when the primary output repaints */
+	weston_output_mask_init(&mask);
+	weston_surface_damage_output_mask(surface, &mask);
+	if (surface->output && !wl_list_empty(&surface->frame_callback_list))
+		weston_output_mask_set(&mask, surface->output->id);
+
+	weston_compositor_schedule_repaint_outputs(surface->compositor, &mask);
+	weston_output_mask_release(&mask);
 }
 
 WL_EXPORT void
@@ -1121,6 +1318,7 @@ weston_surface_destroy(struct weston_surface *surface)
 	pixman_region32_fini(&surface->opaque);
 	pixman_region32_fini(&surface->clip);
 	pixman_region32_fini(&surface->input);
+	weston_output_mask_release(&surface->output_mask);
 
 	wl_list_for_each_safe(cb, next, &surface->frame_callback_list, link)
 		wl_resource_destroy(cb->resource);
@@ -1148,7 +1346,7 @@ weston_buffer_destroy_handler(struct wl_listener *listener, void *data)
 	free(buffer);
 }
 
-struct weston_buffer *
+WL_EXPORT struct weston_buffer *
 weston_buffer_from_resource(struct wl_resource *resource)
 {
 	struct weston_buffer *buffer;
@@ -1210,18 +1408,96 @@ weston_buffer_reference(struct weston_buffer_reference *ref,
 	ref->destroy_listener.notify = weston_buffer_reference_handle_destroy;
 }
 
+static void
+surface_release_renderer_state(struct weston_surface *surface)
+{
+	struct weston_renderer *renderer = surface->compositor->renderer;
+	void *state = surface->renderer_state;
+	void *fresh;
+
+	if (surface->freeze.released)
+		return;
+
+	surface->renderer_state = NULL;
+	if (renderer->create_surface(surface) < 0) {
+		surface->renderer_state = state;
+		return;
+	}
+
+	fresh = surface->renderer_state;
+	surface->renderer_state = state;
+	renderer->destroy_surface(surface);
+	surface->renderer_state = fresh;
+	surface->freeze.released = 1;
+}
+
 static void
 weston_surface_attach(struct weston_surface *surface,
 		      struct weston_buffer *buffer)
 {
+	struct wl_shm_buffer *shm_buffer = NULL;
+
 	weston_buffer_reference(&surface->buffer_ref, buffer);
 
 	if (!buffer) {
 		if (weston_surface_is_mapped(surface))
 			weston_surface_unmap(surface);
+	} else {
+		shm_buffer = wl_shm_buffer_get(buffer->resource);
+	}
+
+	/* A frozen surface keeps its shm buffer in the core reference
+	 * only, whatever the renderer held is stale now. The upload
+	 * happens after weston_surface_thaw(). */
+	if (surface->freeze.active && shm_buffer) {
+		buffer->width = wl_shm_buffer_get_width(shm_buffer);
+		buffer->height = wl_shm_buffer_get_height(shm_buffer);
+		surface_release_renderer_state(surface);
+		return;
 	}
 
 	surface->compositor->renderer->attach(surface, buffer);
+	surface->freeze.released = 0;
+}
+
+/* Freezing is for surfaces the shell keeps out of sight for a while,
+ * such as those on hidden workspaces. Commits still update the
+ * surface state but no longer schedule repaints, so frame callbacks
+ * stay queued until the surface is thawed. If the core holds the
+ * buffer, the renderer state is dropped right away, otherwise as
+ * soon as the client commits a new shm buffer; either way its
+ * texture is rebuilt from the buffer on thaw.
+ */
+WL_EXPORT void
+weston_surface_freeze(struct weston_surface *surface)
+{
+	if (surface->freeze.active)
+		return;
+
+	surface->freeze.active = 1;
+	surface->freeze.commits = 0;
+
+	if (surface->buffer_ref.buffer &&
+	    wl_shm_buffer_get(surface->buffer_ref.buffer->resource))
+		surface_release_renderer_state(surface);
+}
+
+WL_EXPORT void
+weston_surface_thaw(struct weston_surface *surface)
+{
+	if (!surface->freeze.active)
+		return;
+
+	surface->freeze.active = 0;
+
+	if (surface->freeze.released) {
+		surface->compositor->renderer->attach(surface,
+						      surface->buffer_ref.buffer);
+		surface->freeze.released = 0;
+		weston_surface_damage(surface);
+	} else if (surface->freeze.commits > 0) {
+		weston_surface_schedule_repaint(surface);
+	}
 }
 
 WL_EXPORT void
@@ -1371,6 +1647,7 @@ static int
 weston_output_repaint(struct weston_output *output, uint32_t msecs)
 {
 	struct weston_compositor *ec = output->compositor;
+	struct weston_output *other;
 	struct weston_surface *es;
 	struct weston_animation *animation, *next;
 	struct weston_frame_callback *cb, *cnext;
@@ -1412,6 +1689,9 @@ weston_output_repaint(struct weston_output *output, uint32_t msecs)
 	pixman_region32_fini(&output_damage);
 
 	output->repaint_needed = 0;
+	output->repaint_count++;
+	wl_list_for_each(other, &ec->output_list, link)
+		other->repaint_skipped = 0;
 
 	weston_compositor_repick(ec);
 	wl_event_loop_dispatch(ec->input_loop, 0);
@@ -1483,6 +1763,86 @@ weston_layer_init(struct weston_layer *layer, struct wl_list *below)
 		wl_list_insert(below, &layer->link);
 }
 
+static void
+snapshot_add(struct wl_array *array, struct weston_surface *surface)
+{
+	struct weston_compositor *ec = surface->compositor;
+	struct weston_surface **s;
+
+	/* Surfaces outside the layer list have not been through a
+	 * repaint since they were last hidden, so bring their
+	 * transform and texture up to date here. */
+	weston_surface_update_transform(surface);
+	weston_surface_move_to_plane(surface, &ec->primary_plane);
+	ec->renderer->flush_damage(surface);
+
+	s = wl_array_add(array, sizeof *s);
+	if (s)
+		*s = surface;
+}
+
+static void
+snapshot_list_add(struct wl_array *array, struct weston_surface *surface)
+{
+	struct weston_subsurface *sub;
+
+	if (wl_list_empty(&surface->subsurface_list)) {
+		snapshot_add(array, surface);
+		return;
+	}
+
+	wl_list_for_each(sub, &surface->subsurface_list, parent_link) {
+		if (!weston_surface_is_mapped(sub->surface))
+			continue;
+
+		if (sub->surface == surface)
+			snapshot_add(array, sub->surface);
+		else
+			snapshot_list_add(array, sub->surface);
+	}
+}
+
+/* Render the surfaces of 'layer' that fall on 'output' once into a new,
+ * buffer-less surface covering the output. Moving the snapshot around is
+ * then one surface worth of work instead of one per window. Returns NULL
+ * if the renderer can't snapshot.
+ */
+WL_EXPORT struct weston_surface *
+weston_layer_snapshot(struct weston_layer *layer,
+		      struct weston_output *output)
+{
+	struct weston_compositor *ec = output->compositor;
+	struct weston_surface *snapshot, *surface;
+	struct wl_array surfaces;
+	int ret;
+
+	if (ec->renderer->snapshot == NULL)
+		return NULL;
+
+	snapshot = weston_surface_create(ec);
+	if (snapshot == NULL)
+		return NULL;
+
+	weston_surface_configure(snapshot, output->x, output->y,
+				 output->width, output->height);
+	snapshot->buffer_scale = output->current_scale;
+
+	wl_array_init(&surfaces);
+	wl_list_for_each(surface, &layer->surface_list, layer_link)
+		snapshot_list_add(&surfaces, surface);
+
+	ret = ec->renderer->snapshot(snapshot, output, surfaces.data,
+				     surfaces.size / sizeof surface);
+	wl_array_release(&surfaces);
+
+	if (ret < 0) {
+		weston_surface_destroy(snapshot);
+		return NULL;
+	}
+
+	return snapshot;
+}
+
 WL_EXPORT void
 weston_output_schedule_repaint(struct weston_output *output)
 {
@@ -1516,6 +1876,27 @@ weston_compositor_schedule_repaint(struct weston_compositor *compositor)
 		weston_output_schedule_repaint(output);
 }
 
+/*
+ * Schedules a repaint of only the outputs in output_mask.  Outputs
+ * that are left idle but would have been repainted by
+ * weston_compositor_schedule_repaint() count as avoided repaints.
+ */
+WL_EXPORT void
+weston_compositor_schedule_repaint_outputs(struct weston_compositor *compositor,
+					   const struct weston_output_mask *mask)
+{
+	struct weston_output *output;
+
+	wl_list_for_each(output, &compositor->output_list, link) {
+		if (weston_output_mask_test(mask, output->id)) {
+			weston_output_schedule_repaint(output);
+		} else if (!output->repaint_needed && !output->repaint_skipped) {
+			output->repaint_skipped = 1;
+			output->repaint_avoided++;
+		}
+	}
+}
+
 static void
 surface_destroy(struct wl_client *client, struct wl_resource *resource)
 {
@@ -1648,12 +2029,80 @@ weston_surface_commit_subsurface_order(struct weston_surface *surface)
 	}
 }
 
+static uint32_t
+region_area(pixman_region32_t *region)
+{
+	pixman_box32_t *rects;
+	uint32_t area = 0;
+	int i, n;
+
+	rects = pixman_region32_rectangles(region, &n);
+	for (i = 0; i < n; i++)
+		area += (rects[i].x2 - rects[i].x1) *
+			(rects[i].y2 - rects[i].y1);
+
+	return area;
+}
+
+static void
+weston_surface_update_stats(struct weston_surface *surface,
+			    pixman_region32_t *pending_damage)
+{
+	uint32_t now = weston_compositor_get_time();
+	uint32_t interval = now - surface->stats.last_commit;
+	pixman_region32_t damage;
+	uint32_t area;
+
+	pixman_region32_init(&damage);
+	pixman_region32_intersect_rect(&damage, pending_damage,
+				       0, 0,
+				       surface->geometry.width,
+				       surface->geometry.height);
+	area = region_area(&damage);
+	pixman_region32_fini(&damage);
+
+	if (surface->stats.last_commit) {
+		if (interval == 0)
+			interval = 1;
+		surface->stats.commit_rate +=
+			(1000.0f / interval - surface->stats.commit_rate) / 4;
+		surface->stats.damage_area +=
+			(area - surface->stats.damage_area) / 4;
+	} else {
+		surface->stats.damage_area = area;
+	}
+
+	surface->stats.commits++;
+	surface->stats.damage_total += area;
+	surface->stats.last_commit = now ? now : 1;
+}
+
+/* Buffers committed per second. The smoothed rate only changes on a
+ * commit, so it is capped by the time since the last one: a surface
+ * that stopped updating decays towards zero. */
+WL_EXPORT float
+weston_surface_get_commit_rate(struct weston_surface *surface, uint32_t now)
+{
+	uint32_t idle = now - surface->stats.last_commit;
+
+	if (!surface->stats.last_commit)
+		return 0;
+	if (idle > 0 && 1000.0f / idle < surface->stats.commit_rate)
+		return 1000.0f / idle;
+
+	return surface->stats.commit_rate;
+}
+
 static void
 weston_surface_commit(struct weston_surface *surface)
 {
 	pixman_region32_t opaque;
 	int surface_width = 0;
 	int surface_height = 0;
+	int new_buffer;
+
+	new_buffer = surface->pending.newly_attached &&
+		surface->pending.buffer;
 
 	/* wl_surface.set_buffer_transform */
 	surface->buffer_transform = surface->pending.buffer_transform;
@@ -1682,6 +2131,9 @@ weston_surface_commit(struct weston_surface *surface)
 	surface->pending.sy = 0;
 	surface->pending.newly_attached = 0;
 
+	if (new_buffer)
+		weston_surface_update_stats(surface, &surface->pending.damage);
+
 	/* wl_surface.damage */
 	pixman_region32_union(&surface->damage, &surface->damage,
 			      &surface->pending.damage);
@@ -1720,7 +2172,7 @@ weston_surface_commit(struct weston_surface *surface)
 
 	weston_surface_commit_subsurface_order(surface);
 
-	weston_surface_schedule_repaint(surface);
+	weston_surface_schedule_commit_repaint(surface);
 }
 
 static void
@@ -1885,6 +2337,10 @@ weston_subsurface_commit_from_cache(struct weston_subsurface *sub)
 	pixman_region32_t opaque;
 	int surface_width = 0;
 	int surface_height = 0;
+	int new_buffer;
+
+	new_buffer = sub->cached.newly_attached &&
+		sub->cached.buffer_ref.buffer;
 
 	/* wl_surface.set_buffer_transform */
 	surface->buffer_transform = sub->cached.buffer_transform;
@@ -1909,6 +2365,9 @@ weston_subsurface_commit_from_cache(struct weston_subsurface *sub)
 	sub->cached.sy = 0;
 	sub->cached.newly_attached = 0;
 
+	if (new_buffer)
+		weston_surface_update_stats(surface, &sub->cached.damage);
+
 	/* wl_surface.damage */
 	pixman_region32_union(&surface->damage, &surface->damage,
 			      &sub->cached.damage);
@@ -1947,7 +2406,7 @@ weston_subsurface_commit_from_cache(struct weston_subsurface *sub)
 
 	weston_surface_commit_subsurface_order(surface);
 
-	weston_surface_schedule_repaint(surface);
+	weston_surface_schedule_commit_repaint(surface);
 
 	sub->cached.has_data = 0;
 }
@@ -2707,10 +3166,21 @@ weston_output_destroy(struct weston_output *output)
 {
 	wl_signal_emit(&output->destroy_signal, output);
 
+	weston_log("output %s: %u repaints, %u avoided\n",
+		   output->name ? output->name : "(unnamed)",
+		   output->repaint_count, output->repaint_avoided);
+
 	free(output->name);
 	pixman_region32_fini(&output->region);
 	pixman_region32_fini(&output->previous_damage);
-	output->compositor->output_id_pool &= ~(1 << output->id);
+	if (weston_compositor_output_by_id(output->compositor,
+					   output->id) == output) {
+		weston_output_mask_unset(&output->compositor->output_id_pool,
+					 output->id);
+		((struct weston_output **)
+		 output->compositor->output_by_id.data)[output->id] = NULL;
+		output->compositor->output_index_dirty = 1;
+	}
 
 	wl_global_destroy(output->global);
 }
@@ -2846,6 +3316,7 @@ weston_output_move(struct weston_output *output, int x, int y)
 	pixman_region32_init_rect(&output->region, x, y,
 				  output->width,
 				  output->height);
+	output->compositor->output_index_dirty = 1;
 }
 
 WL_EXPORT void
@@ -2853,6 +3324,8 @@ weston_output_init(struct weston_output *output, struct weston_compositor *c,
 		   int x, int y, int mm_width, int mm_height, uint32_t transform,
 		   int32_t scale)
 {
+	struct weston_output **p;
+
 	output->compositor = c;
 	output->x = x;
 	output->y = y;
@@ -2864,6 +3337,9 @@ weston_output_init(struct weston_output *output, struct weston_compositor *c,
 	output->mm_height = mm_height;
 	output->dirty = 1;
 	output->original_scale = scale;
+	output->repaint_count = 0;
+	output->repaint_avoided = 0;
+	output->repaint_skipped = 0;
 
 	weston_output_transform_scale_init(output, transform, scale);
 	weston_output_init_zoom(output);
@@ -2876,8 +3352,24 @@ weston_output_init(struct weston_output *output, struct weston_compositor *c,
 	wl_list_init(&output->animation_list);
 	wl_list_init(&output->resource_list);
 
-	output->id = ffs(~output->compositor->output_id_pool) - 1;
-	output->compositor->output_id_pool |= 1 << output->id;
+	/* An output that can't be registered still repaints, but no
+	 * surface is assigned to it. */
+	output->id = weston_output_mask_first_clear(&c->output_id_pool);
+	while (c->output_by_id.size / sizeof output <= output->id) {
+		p = wl_array_add(&c->output_by_id, sizeof *p);
+		if (!p)
+			break;
+		*p = NULL;
+	}
+	if (c->output_by_id.size / sizeof output > output->id &&
+	    weston_output_mask_set(&c->output_id_pool, output->id) == 0) {
+		((struct weston_output **)
+		 c->output_by_id.data)[output->id] = output;
+		c->output_index_dirty = 1;
+	} else {
+		weston_log("failed to register output %u: out of memory\n",
+			   output->id);
+	}
 
 	output->global =
 		wl_global_create(c->wl_display, &wl_output_interface, 2,
@@ -2988,6 +3480,78 @@ weston_environment_get_fd(const char *env)
 	return fd;
 }
 
+static char *
+keymap_cache_dir(struct weston_config_section *s)
+{
+	const char *cache_home, *home;
+	char *dir;
+
+	weston_config_section_get_string(s, "keymap_cache_dir", &dir, NULL);
+	if (dir)
+		return dir;
+
+	cache_home = getenv("XDG_CACHE_HOME");
+	if (cache_home && asprintf(&dir, "%s/weston", cache_home) >= 0)
+		return dir;
+
+	home = getenv("HOME");
+	if (home && asprintf(&dir, "%s/.cache/weston", home) >= 0)
+		return dir;
+
+	return NULL;
+}
+
+/* Logs the update statistics of every surface on screen, topmost
+ * first, to see which clients keep the compositor busy. */
+WL_EXPORT void
+weston_compositor_log_surface_stats(struct weston_compositor *ec)
+{
+	struct weston_surface *es;
+	uint32_t now = weston_compositor_get_time();
+	uint32_t area, avg;
+	pid_t pid;
+
+	weston_log("surface update statistics:\n");
+	wl_list_for_each(es, &ec->surface_list, link) {
+		pid = 0;
+		if (es->resource)
+			wl_client_get_credentials(
+				wl_resource_get_client(es->resource),
+				&pid, NULL, NULL);
+
+		area = es->geometry.width * es->geometry.height;
+		avg = es->stats.commits ?
+			es->stats.damage_total / es->stats.commits : 0;
+
+		weston_log_continue(STAMP_SPACE
+				    "%p pid %d %dx%d %s: %u commits, "
+				    "%.1f/s, damage %.0f px (%u%%) "
+				    "avg %u px",
+				    es, pid,
+				    es->geometry.width, es->geometry.height,
+				    es->plane == &ec->primary_plane ?
+				    "primary" : "plane",
+				    es->stats.commits,
+				    weston_surface_get_commit_rate(es, now),
+				    es->stats.damage_area,
+				    area ? (uint32_t)
+				    (es->stats.damage_area * 100 / area) : 0,
+				    avg);
+		if (es->stats.last_commit)
+			weston_log_continue(", idle %u ms\n",
+					    now - es->stats.last_commit);
+		else
+			weston_log_continue("\n");
+	}
+}
+
+static void
+surface_stats_binding(struct weston_seat *seat, uint32_t time, uint32_t key,
+		      void *data)
+{
+	weston_compositor_log_surface_stats(data);
+}
+
 WL_EXPORT int
 weston_compositor_init(struct weston_compositor *ec,
 		       struct wl_display *display,
@@ -2997,6 +3561,8 @@ weston_compositor_init(struct weston_compositor *ec,
 	struct wl_event_loop *loop;
 	struct xkb_rule_names xkb_names;
 	struct weston_config_section *s;
+	int keymap_cache;
+	char *solver;
 
 	ec->config = config;
 	ec->wl_display = display;
@@ -3010,11 +3576,14 @@ weston_compositor_init(struct weston_compositor *ec,
 	wl_signal_init(&ec->hide_input_panel_signal);
 	wl_signal_init(&ec->update_input_panel_signal);
 	wl_signal_init(&ec->seat_created_signal);
+	wl_signal_init(&ec->gesture_signal);
 	wl_signal_init(&ec->output_created_signal);
 	wl_signal_init(&ec->session_signal);
 	ec->session_active = 1;
 
-	ec->output_id_pool = 0;
+	weston_output_mask_init(&ec->output_id_pool);
+	wl_array_init(&ec->output_by_id);
+	wl_array_init(&ec->output_index);
 
 	if (!wl_global_create(display, &wl_compositor_interface, 3,
 			      ec, compositor_bind))
@@ -3034,10 +3603,20 @@ weston_compositor_init(struct weston_compositor *ec,
 	wl_list_init(&ec->touch_binding_list);
 	wl_list_init(&ec->axis_binding_list);
 	wl_list_init(&ec->debug_binding_list);
+	weston_binding_table_init(&ec->binding_table);
+	wl_list_init(&ec->xkb_info_list);
 
 	weston_plane_init(&ec->primary_plane, ec, 0, 0);
 	weston_compositor_stack_plane(ec, &ec->primary_plane, NULL);
 
+	s = weston_config_get_section(ec->config, "core", NULL, NULL);
+	weston_config_section_get_string(s, "spring-solver", &solver, "step");
+	if (strcmp(solver, "analytic") == 0)
+		ec->spring_solver = WESTON_SPRING_SOLVER_ANALYTIC;
+	else
+		ec->spring_solver = WESTON_SPRING_SOLVER_STEP;
+	free(solver);
+
 	s = weston_config_get_section(ec->config, "keyboard", NULL, NULL);
 	weston_config_section_get_string(s, "keymap_rules",
 					 (char **) &xkb_names.rules, NULL);
@@ -3050,6 +3629,10 @@ weston_compositor_init(struct weston_compositor *ec,
 	weston_config_section_get_string(s, "keymap_options",
 					 (char **) &xkb_names.options, NULL);
 
+	weston_config_section_get_bool(s, "keymap_cache", &keymap_cache, 1);
+	if (keymap_cache)
+		ec->xkb_cache_dir = keymap_cache_dir(s);
+
 	if (weston_compositor_xkb_init(ec, &xkb_names) < 0)
 		return -1;
 
@@ -3067,11 +3650,19 @@ weston_compositor_init(struct weston_compositor *ec,
 	ec->idle_source = wl_event_loop_add_timer(loop, idle_handler, ec);
 	wl_event_source_timer_update(ec->idle_source, ec->idle_time * 1000);
 
+	/* Shared by the input devices for tap and gesture timeouts */
+	ec->timer_wheel = weston_timer_wheel_create(loop, 4);
+	if (ec->timer_wheel == NULL)
+		return -1;
+
 	ec->input_loop = wl_event_loop_create();
 
 	weston_layer_init(&ec->fade_layer, &ec->layer_list);
 	weston_layer_init(&ec->cursor_layer, &ec->fade_layer.link);
 
+	weston_compositor_add_debug_binding(ec, KEY_U,
+					    surface_stats_binding, ec);
+
 	weston_compositor_schedule_repaint(ec);
 
 	return 0;
@@ -3083,6 +3674,7 @@ weston_compositor_shutdown(struct weston_compositor *ec)
 	struct weston_output *output, *next;
 
 	wl_event_source_remove(ec->idle_source);
+	weston_timer_wheel_destroy(ec->timer_wheel);
 	if (ec->input_loop_source)
 		wl_event_source_remove(ec->input_loop_source);
 
@@ -3095,9 +3687,14 @@ weston_compositor_shutdown(struct weston_compositor *ec)
 	weston_binding_list_destroy_all(&ec->touch_binding_list);
 	weston_binding_list_destroy_all(&ec->axis_binding_list);
 	weston_binding_list_destroy_all(&ec->debug_binding_list);
+	weston_binding_table_release(&ec->binding_table);
 
 	weston_plane_release(&ec->primary_plane);
 
+	weston_output_mask_release(&ec->output_id_pool);
+	wl_array_release(&ec->output_by_id);
+	wl_array_release(&ec->output_index);
+
 	wl_event_loop_destroy(ec->input_loop);
 
 	weston_config_destroy(ec->config);
@@ -3377,12 +3974,14 @@ usage(int error_code)
 		"  --seat=SEAT\t\tThe seat that weston should run on\n"
 		"  --tty=TTY\t\tThe tty to use\n"
 		"  --use-pixman\t\tUse the pixman (CPU) renderer\n"
+		"  --use-sprites\t\tPut surfaces on overlay planes\n"
 		"  --current-mode\tPrefer current KMS mode over EDID preferred mode\n\n");
 
 	fprintf(stderr,
 		"Options for fbdev-backend.so:\n\n"
 		"  --tty=TTY\t\tThe tty to use\n"
-		"  --device=DEVICE\tThe framebuffer device to use\n\n");
+		"  --device=DEVICE\tThe framebuffer device to use\n"
+		"  --double-buffer\tPan between two buffers on vsync, if supported\n\n");
 
 	fprintf(stderr,
 		"Options for x11-backend.so:\n\n"
@@ -3421,6 +4020,7 @@ usage(int error_code)
        "  --rdp4-key=FILE\tThe file containing the key for RDP4 encryption\n"
        "  --rdp-tls-cert=FILE\tThe file containing the certificate for TLS encryption\n"
        "  --rdp-tls-key=FILE\tThe file containing the private key for TLS encryption\n"
+       "  --encoder-threads=N\tNumber of encoder threads, 0 picks one per core (up to 4)\n"
        "\n");
 #endif
 
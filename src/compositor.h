@@ -43,6 +43,10 @@ extern "C" {
 #define MIN(x,y) (((x) < (y)) ? (x) : (y))
 #endif
 
+#ifndef MAX
+#define MAX(x,y) (((x) > (y)) ? (x) : (y))
+#endif
+
 #define ARRAY_LENGTH(a) (sizeof (a) / sizeof (a)[0])
 
 #define container_of(ptr, type, member) ({				\
@@ -116,6 +120,53 @@ struct weston_border {
 	int32_t left, right, top, bottom;
 };
 
+/*
+ * A set of outputs by weston_output::id.  The first 64 ids live in
+ * inline words, so zeroed memory is an empty mask and small masks
+ * never allocate; higher ids grow the set on the heap.
+ */
+struct weston_output_mask {
+	uint32_t *bits;			/* NULL while inline */
+	uint32_t size;			/* heap words */
+	uint32_t inline_bits[2];
+};
+
+#define weston_output_mask_for_each(id, mask)				\
+	for (id = weston_output_mask_next(mask, 0);			\
+	     id >= 0;							\
+	     id = weston_output_mask_next(mask, id + 1))
+
+void
+weston_output_mask_init(struct weston_output_mask *mask);
+void
+weston_output_mask_release(struct weston_output_mask *mask);
+void
+weston_output_mask_clear(struct weston_output_mask *mask);
+int
+weston_output_mask_set(struct weston_output_mask *mask, uint32_t id);
+void
+weston_output_mask_unset(struct weston_output_mask *mask, uint32_t id);
+int
+weston_output_mask_test(const struct weston_output_mask *mask, uint32_t id);
+int
+weston_output_mask_or(struct weston_output_mask *mask,
+		      const struct weston_output_mask *other);
+int
+weston_output_mask_copy(struct weston_output_mask *mask,
+			const struct weston_output_mask *other);
+int
+weston_output_mask_equal(const struct weston_output_mask *a,
+			 const struct weston_output_mask *b);
+int
+weston_output_mask_is_empty(const struct weston_output_mask *mask);
+int
+weston_output_mask_is_single(const struct weston_output_mask *mask,
+			     uint32_t id);
+int
+weston_output_mask_next(const struct weston_output_mask *mask, int id);
+uint32_t
+weston_output_mask_first_clear(const struct weston_output_mask *mask);
+
 struct weston_animation {
 	void (*frame)(struct weston_animation *animation,
 		      struct weston_output *output, uint32_t msecs);
@@ -129,6 +180,11 @@ enum {
 	WESTON_SPRING_BOUNCE
 };
 
+enum weston_spring_solver {
+	WESTON_SPRING_SOLVER_STEP,	/* fixed 4 ms Euler steps */
+	WESTON_SPRING_SOLVER_ANALYTIC	/* closed form, exact frame time */
+};
+
 struct weston_spring {
 	double k;
 	double friction;
@@ -138,6 +194,20 @@ struct weston_spring {
 	double min, max;
 	uint32_t timestamp;
 	uint32_t clip;
+	uint32_t solver;
+
+	/* Analytic solver state: the trajectory since the last seed or
+	 * clip event, and the values it last wrote back so that changes
+	 * made by the caller can be detected. */
+	struct {
+		int valid;
+		int pinned;
+		uint32_t start;
+		double origin;		/* in 4 ms steps after start */
+		double e0, v0;		/* offset from target and its slope */
+		double k, friction, current, previous, target;
+		uint32_t timestamp;
+	} segment;
 };
 
 enum {
@@ -199,6 +269,11 @@ struct weston_output {
 	pixman_region32_t previous_damage;
 	int repaint_needed;
 	int repaint_scheduled;
+	/* Repaints done, and repaints skipped because only other outputs
+	 * had damage.  Skips are counted once per repaint of any output. */
+	uint32_t repaint_count;
+	uint32_t repaint_avoided;
+	int repaint_skipped;
 	struct weston_output_zoom zoom;
 	int dirty;
 	struct wl_signal frame_signal;
@@ -283,6 +358,7 @@ struct weston_touch_grab_interface {
 			int touch_id,
 			wl_fixed_t sx,
 			wl_fixed_t sy);
+	void (*frame)(struct weston_touch_grab *grab);
 	void (*cancel)(struct weston_touch_grab *grab);
 };
 
@@ -416,6 +492,7 @@ struct weston_xkb_info {
 	size_t keymap_size;
 	char *keymap_area;
 	int32_t ref_count;
+	struct wl_list link; /* weston_compositor::xkb_info_list */
 	xkb_mod_index_t shift_mod;
 	xkb_mod_index_t caps_mod;
 	xkb_mod_index_t ctrl_mod;
@@ -519,6 +596,44 @@ struct weston_plane {
 	struct wl_list link;
 };
 
+/* Hash index over all bindings, keyed by (type, key/button/axis,
+ * modifier).  Each bucket keeps its bindings in registration order. */
+struct weston_binding_table {
+	struct wl_list *buckets;
+	uint32_t mask;
+	uint32_t count;
+	int dispatching;
+};
+
+enum weston_gesture_type {
+	WESTON_GESTURE_SCROLL,
+	WESTON_GESTURE_PINCH,
+	WESTON_GESTURE_SWIPE
+};
+
+enum weston_gesture_phase {
+	WESTON_GESTURE_BEGIN,
+	WESTON_GESTURE_UPDATE,
+	WESTON_GESTURE_END,
+	WESTON_GESTURE_CANCEL
+};
+
+/* Multi-finger touchpad gesture.  Distances are in device units of
+ * the touchpad, velocity in device units per ms. */
+struct weston_gesture_event {
+	struct weston_seat *seat;
+	enum weston_gesture_type type;
+	enum weston_gesture_phase phase;
+	uint32_t time;
+	int fingers;
+	double dx, dy;			/* since the previous event */
+	double total_dx, total_dy;	/* since the gesture started */
+	double scale;			/* finger spread relative to start */
+	double vx, vy;
+};
+
+struct weston_timer_wheel;
+
 struct weston_renderer {
 	int (*read_pixels)(struct weston_output *output,
 			       pixman_format_code_t format, void *pixels,
@@ -535,8 +650,24 @@ struct weston_renderer {
 	void (*surface_set_color)(struct weston_surface *surface,
 			       float red, float green,
 			       float blue, float alpha);
+	/* Replace 'region' (global coordinates) of the output being
+	 * repainted with an opaque color. Used for solid color surfaces
+	 * instead of compositing them. */
+	void (*fill_region)(struct weston_output *output,
+			    pixman_region32_t *region,
+			    float red, float green, float blue);
 	void (*destroy_surface)(struct weston_surface *surface);
 	void (*destroy)(struct weston_compositor *ec);
+	/* Render 'surfaces' (top to bottom, like the compositor surface
+	 * list) into the renderer state of 'snapshot', which covers the
+	 * output at its scale. May be NULL. */
+	int (*snapshot)(struct weston_surface *snapshot,
+			struct weston_output *output,
+			struct weston_surface **surfaces, int count);
+	/* Show the a8r8g8b8 'image' as the content of a surface that has
+	 * no buffer attached. May be NULL. */
+	void (*surface_set_image)(struct weston_surface *surface,
+				  pixman_image_t *image);
 };
 
 enum weston_capability {
@@ -567,6 +698,7 @@ struct weston_compositor {
 	struct wl_signal update_input_panel_signal;
 
 	struct wl_signal seat_created_signal;
+	struct wl_signal gesture_signal;
 	struct wl_signal output_created_signal;
 
 	struct wl_event_loop *input_loop;
@@ -588,12 +720,18 @@ struct weston_compositor {
 	struct wl_list touch_binding_list;
 	struct wl_list axis_binding_list;
 	struct wl_list debug_binding_list;
+	struct weston_binding_table binding_table;
 
 	uint32_t state;
 	struct wl_event_source *idle_source;
 	uint32_t idle_inhibit;
 	int idle_time;			/* timeout, s */
 
+	struct weston_timer_wheel *timer_wheel;
+
+	/* Solver for the springs driving surface animations */
+	enum weston_spring_solver spring_solver;
+
 	/* Repaint state. */
 	struct weston_plane primary_plane;
 	uint32_t capabilities; /* combination of enum weston_capability */
@@ -612,11 +750,19 @@ struct weston_compositor {
 
 	struct weston_launcher *launcher;
 
-	uint32_t output_id_pool;
+	struct weston_output_mask output_id_pool;
+
+	/* Outputs by id, and sorted by left edge for output assignment */
+	struct wl_array output_by_id;	/* struct weston_output * */
+	struct wl_array output_index;	/* struct weston_output * */
+	int32_t output_index_max_width;
+	int output_index_dirty;
 
 	struct xkb_rule_names xkb_names;
 	struct xkb_context *xkb_context;
 	struct weston_xkb_info *xkb_info;
+	struct wl_list xkb_info_list;
+	char *xkb_cache_dir;	/* NULL if keymap caching is disabled */
 
 	/* Raw keyboard processing (no libxkbcommon initialization or handling) */
 	int use_xkbcommon;
@@ -729,6 +875,7 @@ struct weston_subsurface {
 struct weston_surface {
 	struct wl_resource *resource;
 	struct wl_signal destroy_signal;
+	struct wl_signal geometry_signal; /* geometry became dirty */
 	struct weston_compositor *compositor;
 	pixman_region32_t clip;
 	pixman_region32_t damage;
@@ -790,7 +937,7 @@ struct weston_surface {
 	 * A more complete representation of all outputs this surface is
 	 * displayed on.
 	 */
-	uint32_t output_mask;
+	struct weston_output_mask output_mask;
 
 	struct wl_list frame_callback_list;
 
@@ -799,6 +946,23 @@ struct weston_surface {
 	int32_t buffer_scale;
 	int keep_buffer; /* bool for backends to prevent early release */
 
+	/* Updated on each commit that attaches a buffer, see
+	 * weston_surface_get_commit_rate() */
+	struct {
+		uint32_t commits;
+		uint32_t last_commit; /* ms, 0 before the first commit */
+		float commit_rate; /* commits per second, smoothed */
+		float damage_area; /* pixels per commit, smoothed */
+		uint64_t damage_total;
+	} stats;
+
+	/* See weston_surface_freeze() */
+	struct {
+		int active;
+		int released; /* renderer state dropped, attach on thaw */
+		uint32_t commits; /* commits held back while frozen */
+	} freeze;
+
 	/* All the pending state, that wl_surface.commit will apply. */
 	struct {
 		/* wl_surface.attach */
@@ -934,9 +1098,16 @@ notify_keyboard_focus_out(struct weston_seat *seat);
 void
 notify_touch(struct weston_seat *seat, uint32_t time, int touch_id,
 	     wl_fixed_t x, wl_fixed_t y, int touch_type);
+void
+notify_touch_frame(struct weston_seat *seat);
+void
+notify_gesture(struct weston_seat *seat, struct weston_gesture_event *event);
 
 void
 weston_layer_init(struct weston_layer *layer, struct wl_list *below);
+struct weston_surface *
+weston_layer_snapshot(struct weston_layer *layer,
+		      struct weston_output *output);
 
 void
 weston_plane_init(struct weston_plane *plane,
@@ -959,6 +1130,9 @@ weston_output_damage(struct weston_output *output);
 void
 weston_compositor_schedule_repaint(struct weston_compositor *compositor);
 void
+weston_compositor_schedule_repaint_outputs(struct weston_compositor *compositor,
+					   const struct weston_output_mask *mask);
+void
 weston_compositor_fade(struct weston_compositor *compositor, float tint);
 void
 weston_compositor_damage_all(struct weston_compositor *compositor);
@@ -1026,6 +1200,11 @@ weston_binding_destroy(struct weston_binding *binding);
 void
 weston_binding_list_destroy_all(struct wl_list *list);
 
+void
+weston_binding_table_init(struct weston_binding_table *table);
+void
+weston_binding_table_release(struct weston_binding_table *table);
+
 void
 weston_compositor_run_key_binding(struct weston_compositor *compositor,
 				  struct weston_seat *seat, uint32_t time,
@@ -1080,6 +1259,9 @@ weston_surface_is_mapped(struct weston_surface *surface);
 void
 weston_surface_schedule_repaint(struct weston_surface *surface);
 
+void
+weston_surface_schedule_geometry_repaint(struct weston_surface *surface);
+
 void
 weston_surface_damage(struct weston_surface *surface);
 
@@ -1241,13 +1423,68 @@ struct weston_surface_animation *
 weston_slide_run(struct weston_surface *surface, float start, float stop,
 		 weston_surface_animation_done_func_t done, void *data);
 
+enum weston_timeline_property {
+	WESTON_TIMELINE_ALPHA,
+	WESTON_TIMELINE_TRANSLATE_X,
+	WESTON_TIMELINE_TRANSLATE_Y,
+	WESTON_TIMELINE_SCALE,
+	WESTON_TIMELINE_ROTATION,	/* radians, around the center */
+	WESTON_TIMELINE_NUM_PROPERTIES
+};
+
+/* Easing of the segment that ends at a keyframe */
+enum weston_timeline_easing {
+	WESTON_TIMELINE_LINEAR,
+	WESTON_TIMELINE_EASE_IN,
+	WESTON_TIMELINE_EASE_OUT,
+	WESTON_TIMELINE_EASE_IN_OUT
+};
+
+struct weston_timeline;
+typedef void (*weston_timeline_done_func_t)(struct weston_timeline *timeline,
+					    void *data);
+
+struct weston_timeline *
+weston_timeline_create(struct weston_compositor *compositor);
+void
+weston_timeline_destroy(struct weston_timeline *timeline);
+int
+weston_timeline_add_keyframe(struct weston_timeline *timeline,
+			     struct weston_surface *surface,
+			     enum weston_timeline_property property,
+			     uint32_t time, float value,
+			     enum weston_timeline_easing easing);
+int
+weston_timeline_start(struct weston_timeline *timeline,
+		      struct weston_output *output,
+		      weston_timeline_done_func_t done, void *data);
+void
+weston_timeline_seek(struct weston_timeline *timeline, uint32_t time);
+uint32_t
+weston_timeline_get_duration(struct weston_timeline *timeline);
+
 void
 weston_surface_set_color(struct weston_surface *surface,
 			 float red, float green, float blue, float alpha);
+int
+weston_surface_set_image(struct weston_surface *surface,
+			 pixman_image_t *image);
 
 void
 weston_surface_destroy(struct weston_surface *surface);
 
+void
+weston_surface_freeze(struct weston_surface *surface);
+
+void
+weston_surface_thaw(struct weston_surface *surface);
+
+float
+weston_surface_get_commit_rate(struct weston_surface *surface, uint32_t now);
+
+void
+weston_compositor_log_surface_stats(struct weston_compositor *compositor);
+
 int
 weston_output_switch_mode(struct weston_output *output, struct weston_mode *mode,
 			int32_t scale, enum weston_mode_switch_op op);
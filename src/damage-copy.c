@@ -0,0 +1,97 @@
+/*
+ * Copyright © 2013 Intel Corporation
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and
+ * its documentation for any purpose is hereby granted without fee, provided
+ * that the above copyright notice appear in all copies and that both that
+ * copyright notice and this permission notice appear in supporting
+ * documentation, and that the name of the copyright holders not be used in
+ * advertising or publicity pertaining to distribution of the software
+ * without specific, written prior permission.  The copyright holders make
+ * no representations about the suitability of this software for any
+ * purpose.  It is provided "as is" without express or implied warranty.
+ *
+ * THE COPYRIGHT HOLDERS DISCLAIM ALL WARRANTIES WITH REGARD TO THIS
+ * SOFTWARE, INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS, IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * SPECIAL, INDIRECT OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER
+ * RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF
+ * CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "damage-copy.h"
+
+/* Widen the rectangles to whole lines and let pixman merge the ones
+ * that now overlap or line up. */
+static void
+align_region(pixman_region32_t *dst, pixman_region32_t *src, int width)
+{
+	pixman_box32_t *rects, *aligned;
+	int i, n;
+
+	rects = pixman_region32_rectangles(src, &n);
+	aligned = malloc(n * sizeof *aligned);
+	if (aligned == NULL) {
+		pixman_region32_copy(dst, src);
+		return;
+	}
+
+	for (i = 0; i < n; i++) {
+		aligned[i].x1 = rects[i].x1 & ~(DAMAGE_COPY_ALIGN - 1);
+		aligned[i].x2 = (rects[i].x2 + DAMAGE_COPY_ALIGN - 1) &
+			~(DAMAGE_COPY_ALIGN - 1);
+		if (aligned[i].x2 > width)
+			aligned[i].x2 = width;
+		aligned[i].y1 = rects[i].y1;
+		aligned[i].y2 = rects[i].y2;
+	}
+
+	pixman_region32_fini(dst);
+	pixman_region32_init_rects(dst, aligned, n);
+	free(aligned);
+}
+
+void
+damage_copy_region(pixman_image_t *dst, pixman_image_t *src,
+		   pixman_region32_t *region)
+{
+	uint8_t *d = (uint8_t *) pixman_image_get_data(dst);
+	uint8_t *s = (uint8_t *) pixman_image_get_data(src);
+	int dst_stride = pixman_image_get_stride(dst);
+	int src_stride = pixman_image_get_stride(src);
+	int width = pixman_image_get_width(dst);
+	int height = pixman_image_get_height(dst);
+	pixman_region32_t lines;
+	pixman_box32_t *rects;
+	int i, n, y, x, len;
+
+	pixman_region32_init(&lines);
+	align_region(&lines, region, width);
+	pixman_region32_intersect_rect(&lines, &lines, 0, 0, width, height);
+
+	rects = pixman_region32_rectangles(&lines, &n);
+	for (i = 0; i < n; i++) {
+		x = rects[i].x1 * 4;
+		len = (rects[i].x2 - rects[i].x1) * 4;
+
+		if (len == width * 4 && dst_stride == src_stride) {
+			memcpy(d + rects[i].y1 * dst_stride,
+			       s + rects[i].y1 * src_stride,
+			       (rects[i].y2 - rects[i].y1) * dst_stride);
+			continue;
+		}
+
+		for (y = rects[i].y1; y < rects[i].y2; y++)
+			memcpy(d + y * dst_stride + x,
+			       s + y * src_stride + x, len);
+	}
+
+	pixman_region32_fini(&lines);
+}
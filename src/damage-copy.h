@@ -0,0 +1,42 @@
+/*
+ * Copyright © 2013 Intel Corporation
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and
+ * its documentation for any purpose is hereby granted without fee, provided
+ * that the above copyright notice appear in all copies and that both that
+ * copyright notice and this permission notice appear in supporting
+ * documentation, and that the name of the copyright holders not be used in
+ * advertising or publicity pertaining to distribution of the software
+ * without specific, written prior permission.  The copyright holders make
+ * no representations about the suitability of this software for any
+ * purpose.  It is provided "as is" without express or implied warranty.
+ *
+ * THE COPYRIGHT HOLDERS DISCLAIM ALL WARRANTIES WITH REGARD TO THIS
+ * SOFTWARE, INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS, IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * SPECIAL, INDIRECT OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER
+ * RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF
+ * CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef _DAMAGE_COPY_H_
+#define _DAMAGE_COPY_H_
+
+#include <pixman.h>
+
+/* Pixels per 64 byte write-combining line at 32 bpp */
+#define DAMAGE_COPY_ALIGN 16
+
+/*
+ * Copies the damaged region of a 32 bpp shadow image into a
+ * framebuffer of the same size, typically mapped write-combined.
+ * Rectangles are widened to whole write-combining lines, so some
+ * undamaged pixels around them are copied as well, and whole rows
+ * with matching strides go in a single memcpy().
+ */
+void
+damage_copy_region(pixman_image_t *dst, pixman_image_t *src,
+		   pixman_region32_t *region);
+
+#endif
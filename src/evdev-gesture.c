@@ -0,0 +1,353 @@
+/*
+ * Copyright © 2013 Intel Corporation
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and
+ * its documentation for any purpose is hereby granted without fee, provided
+ * that the above copyright notice appear in all copies and that both that
+ * copyright notice and this permission notice appear in supporting
+ * documentation, and that the name of the copyright holders not be used in
+ * advertising or publicity pertaining to distribution of the software
+ * without specific, written prior permission.  The copyright holders make
+ * no representations about the suitability of this software for any
+ * purpose.  It is provided "as is" without express or implied warranty.
+ *
+ * THE COPYRIGHT HOLDERS DISCLAIM ALL WARRANTIES WITH REGARD TO THIS
+ * SOFTWARE, INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS, IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * SPECIAL, INDIRECT OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER
+ * RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF
+ * CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <string.h>
+#include <math.h>
+#include <linux/input.h>
+
+#include "evdev-gesture.h"
+
+/* Velocity is estimated over the centroid motion in this window */
+#define GESTURE_VELOCITY_WINDOW 50 /* ms */
+
+/* Fingers moving within 60 degrees of the centroid count as moving
+ * together, and each of them must have moved half the threshold. */
+#define GESTURE_SAME_DIRECTION_COS 0.5
+
+static int
+gesture_centroid(struct evdev_gesture *gesture,
+		 double *x, double *y, double *spread)
+{
+	struct evdev_gesture_contact *c;
+	double sx = 0.0, sy = 0.0, sd = 0.0;
+	int i, n = 0;
+
+	for (i = 0; i < EVDEV_GESTURE_MAX_CONTACTS; i++) {
+		c = &gesture->contacts[i];
+		if (!c->active)
+			continue;
+		sx += c->x;
+		sy += c->y;
+		n++;
+	}
+
+	if (n == 0)
+		return 0;
+
+	*x = sx / n;
+	*y = sy / n;
+
+	for (i = 0; i < EVDEV_GESTURE_MAX_CONTACTS; i++) {
+		c = &gesture->contacts[i];
+		if (c->active)
+			sd += hypot(c->x - *x, c->y - *y);
+	}
+	*spread = sd / n;
+
+	return n;
+}
+
+static void
+gesture_push_motion(struct evdev_gesture *gesture,
+		    double x, double y, uint32_t time)
+{
+	struct evdev_gesture_motion *m;
+
+	gesture->motion_index = (gesture->motion_index + 1) %
+		EVDEV_GESTURE_HISTORY_LENGTH;
+	m = &gesture->motion_history[gesture->motion_index];
+	m->x = x;
+	m->y = y;
+	m->time = time;
+
+	if (gesture->motion_count < EVDEV_GESTURE_HISTORY_LENGTH)
+		gesture->motion_count++;
+}
+
+static void
+gesture_get_velocity(struct evdev_gesture *gesture, double *vx, double *vy)
+{
+	struct evdev_gesture_motion *last, *first, *m;
+	int i, index;
+
+	*vx = 0.0;
+	*vy = 0.0;
+
+	if (gesture->motion_count < 2)
+		return;
+
+	last = &gesture->motion_history[gesture->motion_index];
+	first = last;
+	for (i = 1; i < gesture->motion_count; i++) {
+		index = (gesture->motion_index - i +
+			 EVDEV_GESTURE_HISTORY_LENGTH) %
+			EVDEV_GESTURE_HISTORY_LENGTH;
+		m = &gesture->motion_history[index];
+		if (last->time - m->time > GESTURE_VELOCITY_WINDOW)
+			break;
+		first = m;
+	}
+
+	if (last->time == first->time)
+		return;
+
+	*vx = (last->x - first->x) / (last->time - first->time);
+	*vy = (last->y - first->y) / (last->time - first->time);
+}
+
+static void
+gesture_notify(struct evdev_gesture *gesture, enum weston_gesture_phase phase,
+	       uint32_t time, double x, double y, double spread)
+{
+	struct weston_gesture_event event;
+
+	memset(&event, 0, sizeof event);
+	event.type = gesture->type;
+	event.phase = phase;
+	event.time = time;
+	event.fingers = gesture->fingers;
+	event.dx = x - gesture->last_x;
+	event.dy = y - gesture->last_y;
+	event.total_dx = x - gesture->start_x;
+	event.total_dy = y - gesture->start_y;
+	event.scale = spread / gesture->start_spread;
+	gesture_get_velocity(gesture, &event.vx, &event.vy);
+
+	gesture->notify(gesture, &event, gesture->data);
+}
+
+static void
+gesture_start(struct evdev_gesture *gesture, int fingers, uint32_t time)
+{
+	struct evdev_gesture_contact *c;
+	double x, y, spread;
+	int i;
+
+	for (i = 0; i < EVDEV_GESTURE_MAX_CONTACTS; i++) {
+		c = &gesture->contacts[i];
+		c->start_x = c->x;
+		c->start_y = c->y;
+	}
+
+	gesture_centroid(gesture, &x, &y, &spread);
+	if (spread < 1.0)
+		spread = 1.0;
+
+	gesture->state = EVDEV_GESTURE_PENDING;
+	gesture->fingers = fingers;
+	gesture->start_x = gesture->last_x = x;
+	gesture->start_y = gesture->last_y = y;
+	gesture->start_spread = gesture->last_spread = spread;
+	gesture->motion_count = 0;
+	gesture_push_motion(gesture, x, y, time);
+}
+
+static void
+gesture_end(struct evdev_gesture *gesture,
+	    enum weston_gesture_phase phase, uint32_t time)
+{
+	if (gesture->state != EVDEV_GESTURE_ACTIVE)
+		return;
+
+	/* The fingers that are left may have a different centroid, so
+	 * end with where the gesture was last seen. */
+	gesture_notify(gesture, phase, time, gesture->last_x,
+		       gesture->last_y, gesture->last_spread);
+}
+
+static void
+gesture_update_fingers(struct evdev_gesture *gesture, int fingers,
+		       uint32_t time)
+{
+	int was_active = gesture->state == EVDEV_GESTURE_ACTIVE;
+
+	gesture_end(gesture, WESTON_GESTURE_END, time);
+
+	if (fingers < 2) {
+		gesture->state = EVDEV_GESTURE_IDLE;
+		gesture->fingers = fingers;
+	} else if (fingers > gesture->fingers ||
+		   gesture->state == EVDEV_GESTURE_PENDING) {
+		gesture_start(gesture, fingers, time);
+	} else if (was_active || gesture->state == EVDEV_GESTURE_DONE) {
+		/* Lifting fingers one by one ends a gesture, it doesn't
+		 * start a new one with the fingers that are left. */
+		gesture->state = EVDEV_GESTURE_DONE;
+		gesture->fingers = fingers;
+	} else {
+		gesture_start(gesture, fingers, time);
+	}
+}
+
+static int
+gesture_fingers_move_together(struct evdev_gesture *gesture,
+			      double dx, double dy, double d)
+{
+	struct evdev_gesture_contact *c;
+	double cx, cy, cd;
+	int i;
+
+	for (i = 0; i < EVDEV_GESTURE_MAX_CONTACTS; i++) {
+		c = &gesture->contacts[i];
+		if (!c->active)
+			continue;
+
+		cx = c->x - c->start_x;
+		cy = c->y - c->start_y;
+		cd = hypot(cx, cy);
+		if (cd < gesture->move_threshold / 2)
+			return 0;
+		if (cx * dx + cy * dy < GESTURE_SAME_DIRECTION_COS * cd * d)
+			return 0;
+	}
+
+	return 1;
+}
+
+static void
+gesture_recognize(struct evdev_gesture *gesture, uint32_t time,
+		  double x, double y, double spread)
+{
+	double dx = x - gesture->start_x;
+	double dy = y - gesture->start_y;
+	double d = hypot(dx, dy);
+
+	if (d >= gesture->move_threshold &&
+	    gesture_fingers_move_together(gesture, dx, dy, d)) {
+		if (gesture->fingers == 2)
+			gesture->type = WESTON_GESTURE_SCROLL;
+		else
+			gesture->type = WESTON_GESTURE_SWIPE;
+	} else if (fabs(spread - gesture->start_spread) >=
+		   gesture->pinch_threshold) {
+		gesture->type = WESTON_GESTURE_PINCH;
+	} else {
+		return;
+	}
+
+	/* The motion that led to the decision is reported with the
+	 * begin event, none of it is lost. */
+	gesture->state = EVDEV_GESTURE_ACTIVE;
+	gesture->last_x = gesture->start_x;
+	gesture->last_y = gesture->start_y;
+	gesture_notify(gesture, WESTON_GESTURE_BEGIN, time, x, y, spread);
+}
+
+void
+evdev_gesture_init(struct evdev_gesture *gesture,
+		   double move_threshold, double pinch_threshold,
+		   evdev_gesture_notify_t notify, void *data)
+{
+	memset(gesture, 0, sizeof *gesture);
+	gesture->notify = notify;
+	gesture->data = data;
+	gesture->move_threshold = move_threshold;
+	gesture->pinch_threshold = pinch_threshold;
+	gesture->state = EVDEV_GESTURE_IDLE;
+}
+
+void
+evdev_gesture_process_abs(struct evdev_gesture *gesture,
+			  uint16_t code, int32_t value)
+{
+	struct evdev_gesture_contact *c = NULL;
+
+	if (gesture->slot >= 0 && gesture->slot < EVDEV_GESTURE_MAX_CONTACTS)
+		c = &gesture->contacts[gesture->slot];
+
+	switch (code) {
+	case ABS_MT_SLOT:
+		gesture->slot = value;
+		break;
+	case ABS_MT_TRACKING_ID:
+		if (c == NULL)
+			break;
+		if (value >= 0 && !c->active)
+			c->down = 1;
+		c->active = value >= 0;
+		break;
+	case ABS_MT_POSITION_X:
+		if (c)
+			c->x = value;
+		break;
+	case ABS_MT_POSITION_Y:
+		if (c)
+			c->y = value;
+		break;
+	}
+}
+
+void
+evdev_gesture_frame(struct evdev_gesture *gesture, uint32_t time)
+{
+	struct evdev_gesture_contact *c;
+	double x, y, spread;
+	int i, fingers;
+
+	for (i = 0; i < EVDEV_GESTURE_MAX_CONTACTS; i++) {
+		c = &gesture->contacts[i];
+		if (c->down) {
+			c->down = 0;
+			c->start_x = c->x;
+			c->start_y = c->y;
+		}
+	}
+
+	fingers = gesture_centroid(gesture, &x, &y, &spread);
+	if (fingers != gesture->fingers)
+		gesture_update_fingers(gesture, fingers, time);
+
+	switch (gesture->state) {
+	case EVDEV_GESTURE_IDLE:
+	case EVDEV_GESTURE_DONE:
+		return;
+	case EVDEV_GESTURE_PENDING:
+		gesture_push_motion(gesture, x, y, time);
+		gesture_recognize(gesture, time, x, y, spread);
+		break;
+	case EVDEV_GESTURE_ACTIVE:
+		if (x == gesture->last_x && y == gesture->last_y &&
+		    spread == gesture->last_spread)
+			return;
+		gesture_push_motion(gesture, x, y, time);
+		gesture_notify(gesture, WESTON_GESTURE_UPDATE,
+			       time, x, y, spread);
+		break;
+	}
+
+	gesture->last_x = x;
+	gesture->last_y = y;
+	gesture->last_spread = spread;
+}
+
+void
+evdev_gesture_cancel(struct evdev_gesture *gesture, uint32_t time)
+{
+	gesture_end(gesture, WESTON_GESTURE_CANCEL, time);
+
+	if (gesture->fingers >= 2)
+		gesture->state = EVDEV_GESTURE_DONE;
+	else
+		gesture->state = EVDEV_GESTURE_IDLE;
+}
@@ -0,0 +1,104 @@
+/*
+ * Copyright © 2013 Intel Corporation
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and
+ * its documentation for any purpose is hereby granted without fee, provided
+ * that the above copyright notice appear in all copies and that both that
+ * copyright notice and this permission notice appear in supporting
+ * documentation, and that the name of the copyright holders not be used in
+ * advertising or publicity pertaining to distribution of the software
+ * without specific, written prior permission.  The copyright holders make
+ * no representations about the suitability of this software for any
+ * purpose.  It is provided "as is" without express or implied warranty.
+ *
+ * THE COPYRIGHT HOLDERS DISCLAIM ALL WARRANTIES WITH REGARD TO THIS
+ * SOFTWARE, INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS, IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * SPECIAL, INDIRECT OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER
+ * RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF
+ * CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef EVDEV_GESTURE_H
+#define EVDEV_GESTURE_H
+
+#include "config.h"
+
+#include "compositor.h"
+
+#define EVDEV_GESTURE_MAX_CONTACTS 5
+#define EVDEV_GESTURE_HISTORY_LENGTH 8
+
+enum evdev_gesture_state {
+	EVDEV_GESTURE_IDLE,	/* less than two fingers */
+	EVDEV_GESTURE_PENDING,	/* fingers down, nothing recognized yet */
+	EVDEV_GESTURE_ACTIVE,
+	EVDEV_GESTURE_DONE	/* fingers lifted, wait for the rest */
+};
+
+struct evdev_gesture_contact {
+	int active;
+	int down;		/* touched since the last frame */
+	int32_t x, y;
+	int32_t start_x, start_y;
+};
+
+struct evdev_gesture_motion {
+	double x, y;
+	uint32_t time;
+};
+
+struct evdev_gesture;
+
+typedef void (*evdev_gesture_notify_t)(struct evdev_gesture *gesture,
+				       struct weston_gesture_event *event,
+				       void *data);
+
+/*
+ * Recognizes two finger scroll, pinch and three or more finger swipe
+ * from multi-touch slot events.  A gesture is decided as soon as the
+ * fingers pass the movement threshold, without waiting for a timeout,
+ * and ends when the number of fingers changes.
+ */
+struct evdev_gesture {
+	evdev_gesture_notify_t notify;
+	void *data;
+
+	double move_threshold;
+	double pinch_threshold;
+
+	struct evdev_gesture_contact contacts[EVDEV_GESTURE_MAX_CONTACTS];
+	int slot;
+	int fingers;
+
+	enum evdev_gesture_state state;
+	enum weston_gesture_type type;
+
+	double start_x, start_y;
+	double start_spread;
+	double last_x, last_y;
+	double last_spread;
+
+	/* Finger centroid, for velocity estimation */
+	struct evdev_gesture_motion motion_history[EVDEV_GESTURE_HISTORY_LENGTH];
+	int motion_index;
+	int motion_count;
+};
+
+void
+evdev_gesture_init(struct evdev_gesture *gesture,
+		   double move_threshold, double pinch_threshold,
+		   evdev_gesture_notify_t notify, void *data);
+
+void
+evdev_gesture_process_abs(struct evdev_gesture *gesture,
+			  uint16_t code, int32_t value);
+
+void
+evdev_gesture_frame(struct evdev_gesture *gesture, uint32_t time);
+
+void
+evdev_gesture_cancel(struct evdev_gesture *gesture, uint32_t time);
+
+#endif /* EVDEV_GESTURE_H */
@@ -31,6 +31,8 @@
 
 #include "filter.h"
 #include "evdev.h"
+#include "evdev-gesture.h"
+#include "timer-wheel.h"
 #include "../shared/config-parser.h"
 
 /* Default values */
@@ -38,6 +40,10 @@
 #define DEFAULT_MIN_ACCEL_FACTOR 0.16
 #define DEFAULT_MAX_ACCEL_FACTOR 1.0
 #define DEFAULT_HYSTERESIS_MARGIN_DENOMINATOR 700.0
+#define DEFAULT_GESTURE_MOVE_DENOMINATOR 100.0
+#define DEFAULT_GESTURE_PINCH_DENOMINATOR 50.0
+
+#define MAX_ACCEL_CURVE_POINTS 16
 
 #define DEFAULT_TOUCHPAD_SINGLE_TAP_BUTTON BTN_LEFT
 #define DEFAULT_TOUCHPAD_SINGLE_TAP_TIMEOUT 100
@@ -119,6 +125,14 @@ struct touchpad_dispatch {
 	double min_accel_factor;
 	double max_accel_factor;
 
+	/* Optional piecewise linear profile, velocity in units/ms */
+	struct {
+		int count;
+		double velocity[MAX_ACCEL_CURVE_POINTS];
+		double factor[MAX_ACCEL_CURVE_POINTS];
+	} accel_curve;
+	int accel_table;
+
 	unsigned int event_mask;
 	unsigned int event_mask_filter;
 
@@ -129,9 +143,15 @@ struct touchpad_dispatch {
 
 		struct wl_array events;
 		enum fsm_state state;
-		struct wl_event_source *timer_source;
+		struct weston_timer timer;
 	} fsm;
 
+	struct weston_timer_wheel *timer_wheel;
+
+	/* Multi-finger gestures, on multi-touch touchpads only */
+	int gestures;
+	struct evdev_gesture gesture;
+
 	struct {
 		int32_t x;
 		int32_t y;
@@ -207,6 +227,21 @@ touchpad_profile(struct weston_motion_filter *filter,
 		(struct touchpad_dispatch *) data;
 
 	double accel_factor;
+	double *v = touchpad->accel_curve.velocity;
+	double *f = touchpad->accel_curve.factor;
+	int i, n = touchpad->accel_curve.count;
+
+	if (n > 0) {
+		if (velocity <= v[0])
+			return f[0];
+
+		for (i = 1; i < n; i++)
+			if (velocity < v[i])
+				return f[i - 1] + (f[i] - f[i - 1]) *
+					(velocity - v[i - 1]) / (v[i] - v[i - 1]);
+
+		return f[n - 1];
+	}
 
 	accel_factor = velocity * touchpad->constant_accel_factor;
 
@@ -386,9 +421,12 @@ process_fsm_events(struct touchpad_dispatch *touchpad, uint32_t time)
 		}
 	}
 
-	if (timeout != UINT32_MAX)
-		wl_event_source_timer_update(touchpad->fsm.timer_source,
-					     timeout);
+	if (timeout == 0)
+		weston_timer_cancel(touchpad->timer_wheel,
+				    &touchpad->fsm.timer);
+	else if (timeout != UINT32_MAX)
+		weston_timer_schedule(touchpad->timer_wheel,
+				      &touchpad->fsm.timer, time, timeout);
 
 	wl_array_release(&touchpad->fsm.events);
 	wl_array_init(&touchpad->fsm.events);
@@ -410,17 +448,44 @@ push_fsm_event(struct touchpad_dispatch *touchpad,
 		touchpad->fsm.state = FSM_IDLE;
 }
 
-static int
-fsm_timout_handler(void *data)
+static void
+fsm_timout_handler(struct weston_timer *timer, uint32_t time)
 {
-	struct touchpad_dispatch *touchpad = data;
+	struct touchpad_dispatch *touchpad =
+		container_of(timer, struct touchpad_dispatch, fsm.timer);
 
 	if (touchpad->fsm.events.size == 0) {
 		push_fsm_event(touchpad, FSM_EVENT_TIMEOUT);
-		process_fsm_events(touchpad, weston_compositor_get_time());
+		process_fsm_events(touchpad, time);
 	}
+}
+
+static void
+touchpad_gesture_notify(struct evdev_gesture *gesture,
+			struct weston_gesture_event *event, void *data)
+{
+	struct touchpad_dispatch *touchpad = data;
+	double dx = event->dx, dy = event->dy;
+
+	if (event->type != WESTON_GESTURE_SCROLL) {
+		notify_gesture(touchpad->device->seat, event);
+		return;
+	}
+
+	if (event->phase != WESTON_GESTURE_BEGIN &&
+	    event->phase != WESTON_GESTURE_UPDATE)
+		return;
+
+	filter_motion(touchpad, &dx, &dy, event->time);
 
-	return 1;
+	if (dx != 0.0)
+		notify_axis(touchpad->device->seat, event->time,
+			    WL_POINTER_AXIS_HORIZONTAL_SCROLL,
+			    wl_fixed_from_double(dx));
+	if (dy != 0.0)
+		notify_axis(touchpad->device->seat, event->time,
+			    WL_POINTER_AXIS_VERTICAL_SCROLL,
+			    wl_fixed_from_double(dy));
 }
 
 static void
@@ -493,7 +558,8 @@ touchpad_update_state(struct touchpad_dispatch *touchpad, uint32_t time)
 			notify_motion(touchpad->device->seat, time,
 				      wl_fixed_from_double(dx),
 				      wl_fixed_from_double(dy));
-		} else if (touchpad->finger_state == TOUCHPAD_FINGERS_TWO) {
+		} else if (touchpad->finger_state == TOUCHPAD_FINGERS_TWO &&
+			   !touchpad->gestures) {
 			if (dx != 0.0)
 				notify_axis(touchpad->device->seat,
 					    time,
@@ -563,6 +629,14 @@ process_absolute(struct touchpad_dispatch *touchpad,
 			touchpad->event_mask |= TOUCHPAD_EVENT_ABSOLUTE_Y;
 		}
 		break;
+	case ABS_MT_SLOT:
+	case ABS_MT_TRACKING_ID:
+	case ABS_MT_POSITION_X:
+	case ABS_MT_POSITION_Y:
+		if (touchpad->gestures)
+			evdev_gesture_process_abs(&touchpad->gesture,
+						  e->code, e->value);
+		break;
 	}
 }
 
@@ -608,6 +682,8 @@ process_key(struct touchpad_dispatch *touchpad,
 	case BTN_TOOL_MOUSE:
 	case BTN_TOOL_LENS:
 		touchpad->reset = 1;
+		if (touchpad->gestures)
+			evdev_gesture_cancel(&touchpad->gesture, time);
 		break;
 	case BTN_TOOL_FINGER:
 		if (e->value)
@@ -641,8 +717,11 @@ touchpad_process(struct evdev_dispatch *dispatch,
 
 	switch (e->type) {
 	case EV_SYN:
-		if (e->code == SYN_REPORT)
+		if (e->code == SYN_REPORT) {
 			touchpad->event_mask |= TOUCHPAD_EVENT_REPORT;
+			if (touchpad->gestures)
+				evdev_gesture_frame(&touchpad->gesture, time);
+		}
 		break;
 	case EV_ABS:
 		process_absolute(touchpad, device, e);
@@ -662,7 +741,7 @@ touchpad_destroy(struct evdev_dispatch *dispatch)
 		(struct touchpad_dispatch *) dispatch;
 
 	touchpad->filter->interface->destroy(touchpad->filter);
-	wl_event_source_remove(touchpad->fsm.timer_source);
+	weston_timer_cancel(touchpad->timer_wheel, &touchpad->fsm.timer);
 	free(dispatch);
 }
 
@@ -671,6 +750,50 @@ struct evdev_dispatch_interface touchpad_interface = {
 	touchpad_destroy
 };
 
+/*
+ * Parses "velocity:factor" pairs separated by commas, with velocity in
+ * touchpad diagonals per second. Points must have increasing velocity.
+ */
+static void
+touchpad_parse_accel_curve(struct touchpad_dispatch *touchpad,
+			   const char *curve, double diagonal)
+{
+	const char *p = curve;
+	char *end;
+	double velocity, factor;
+	int n = 0;
+
+	while (*p != '\0' && n < MAX_ACCEL_CURVE_POINTS) {
+		velocity = strtod(p, &end);
+		if (end == p || *end != ':')
+			break;
+		p = end + 1;
+		factor = strtod(p, &end);
+		if (end == p)
+			break;
+		p = end;
+
+		velocity = velocity * diagonal / 1000.0;
+		if (n > 0 && velocity <= touchpad->accel_curve.velocity[n - 1])
+			break;
+
+		touchpad->accel_curve.velocity[n] = velocity;
+		touchpad->accel_curve.factor[n] = factor;
+		n++;
+
+		while (*p == ',' || *p == ' ')
+			p++;
+	}
+
+	if (*p != '\0') {
+		weston_log("touchpad: invalid accel_curve \"%s\", "
+			   "using linear acceleration\n", curve);
+		n = 0;
+	}
+
+	touchpad->accel_curve.count = n;
+}
+
 static void
 touchpad_parse_config(struct touchpad_dispatch *touchpad, double diagonal)
 {
@@ -680,6 +803,7 @@ touchpad_parse_config(struct touchpad_dispatch *touchpad, double diagonal)
 	double constant_accel_factor;
 	double min_accel_factor;
 	double max_accel_factor;
+	char *curve;
 
 	s = weston_config_get_section(compositor->config,
 				      "touchpad", NULL, NULL);
@@ -697,6 +821,39 @@ touchpad_parse_config(struct touchpad_dispatch *touchpad, double diagonal)
 		constant_accel_factor / diagonal;
 	touchpad->min_accel_factor = min_accel_factor;
 	touchpad->max_accel_factor = max_accel_factor;
+
+	touchpad->accel_curve.count = 0;
+	weston_config_section_get_string(s, "accel_curve", &curve, NULL);
+	if (curve) {
+		touchpad_parse_accel_curve(touchpad, curve, diagonal);
+		free(curve);
+	}
+
+	weston_config_section_get_bool(s, "accel_table",
+				       &touchpad->accel_table, 0);
+	weston_config_section_get_bool(s, "gestures",
+				       &touchpad->gestures, 1);
+}
+
+static struct weston_motion_filter *
+touchpad_create_filter(struct touchpad_dispatch *touchpad)
+{
+	double max_velocity;
+
+	/* Sample up to the point where the profile stops changing */
+	if (touchpad->accel_curve.count > 0)
+		max_velocity = touchpad->accel_curve.velocity[
+				touchpad->accel_curve.count - 1];
+	else
+		max_velocity = touchpad->max_accel_factor /
+			touchpad->constant_accel_factor;
+
+	if (!touchpad->accel_table || max_velocity <= 0.0)
+		return create_pointer_accelator_filter(touchpad_profile);
+
+	return create_pointer_table_accelerator_filter(touchpad_profile,
+						       touchpad,
+						       max_velocity);
 }
 
 static int
@@ -704,7 +861,6 @@ touchpad_init(struct touchpad_dispatch *touchpad,
 	      struct evdev_device *device)
 {
 	struct weston_motion_filter *accel;
-	struct wl_event_loop *loop;
 
 	unsigned long prop_bits[INPUT_PROP_MAX];
 	struct input_absinfo absinfo;
@@ -749,7 +905,7 @@ touchpad_init(struct touchpad_dispatch *touchpad,
 	touchpad->hysteresis.center_y = 0;
 
 	/* Configure acceleration profile */
-	accel = create_pointer_accelator_filter(touchpad_profile);
+	accel = touchpad_create_filter(touchpad);
 	if (accel == NULL)
 		return -1;
 	touchpad->filter = accel;
@@ -768,13 +924,17 @@ touchpad_init(struct touchpad_dispatch *touchpad,
 	wl_array_init(&touchpad->fsm.events);
 	touchpad->fsm.state = FSM_IDLE;
 
-	loop = wl_display_get_event_loop(device->seat->compositor->wl_display);
-	touchpad->fsm.timer_source =
-		wl_event_loop_add_timer(loop, fsm_timout_handler, touchpad);
-	if (touchpad->fsm.timer_source == NULL) {
-		accel->interface->destroy(accel);
-		return -1;
-	}
+	touchpad->timer_wheel = device->seat->compositor->timer_wheel;
+	weston_timer_init(&touchpad->fsm.timer, fsm_timout_handler);
+
+	/* Gestures need the position of every finger */
+	if (!device->is_mt)
+		touchpad->gestures = 0;
+	if (touchpad->gestures)
+		evdev_gesture_init(&touchpad->gesture,
+				   diagonal / DEFAULT_GESTURE_MOVE_DENOMINATOR,
+				   diagonal / DEFAULT_GESTURE_PINCH_DENOMINATOR,
+				   touchpad_gesture_notify, touchpad);
 
 	/* Configure */
 	touchpad->fsm.enable = !has_buttonpad;
@@ -84,6 +84,108 @@ transform_absolute(struct evdev_device *device, int32_t *x, int32_t *y)
        }
 }
 
+static void
+evdev_flush_touch_events(struct evdev_device *device)
+{
+	struct weston_seat *master = device->seat;
+	uint32_t mask = device->touch_frame.slot_mask;
+	int slot;
+
+	for (slot = 0; slot < MAX_SLOTS; slot++) {
+		uint32_t pending = device->touch_frame.slots[slot].pending;
+		uint32_t time = device->touch_frame.slots[slot].time;
+		wl_fixed_t x = device->touch_frame.slots[slot].x;
+		wl_fixed_t y = device->touch_frame.slots[slot].y;
+
+		if (!(mask & (1 << slot)))
+			continue;
+
+		if (pending & EVDEV_TOUCH_PENDING_DOWN) {
+			notify_touch(master, time, slot, x, y, WL_TOUCH_DOWN);
+			device->touch_frame.event_count++;
+		}
+		if (pending & EVDEV_TOUCH_PENDING_MOTION) {
+			notify_touch(master, time, slot, x, y, WL_TOUCH_MOTION);
+			device->touch_frame.event_count++;
+		}
+		if (pending & EVDEV_TOUCH_PENDING_UP) {
+			notify_touch(master, time, slot, 0, 0, WL_TOUCH_UP);
+			device->touch_frame.event_count++;
+		}
+
+		device->touch_frame.slots[slot].pending = 0;
+	}
+
+	if (mask)
+		device->touch_frame.need_frame = 1;
+	device->touch_frame.slot_mask = 0;
+}
+
+static void
+evdev_flush_touch_frame(struct evdev_device *device)
+{
+	evdev_flush_touch_events(device);
+
+	if (!device->touch_frame.need_frame)
+		return;
+
+	notify_touch_frame(device->seat);
+	device->touch_frame.need_frame = 0;
+	device->touch_frame.frame_count++;
+}
+
+static void
+evdev_queue_touch(struct evdev_device *device, uint32_t time, int slot,
+		  wl_fixed_t x, wl_fixed_t y, int touch_type)
+{
+	uint32_t *pending;
+
+	if (slot < 0 || slot >= MAX_SLOTS) {
+		notify_touch(device->seat, time, slot, x, y, touch_type);
+		device->touch_frame.event_count++;
+		device->touch_frame.need_frame = 1;
+		return;
+	}
+
+	pending = &device->touch_frame.slots[slot].pending;
+
+	/* A second down or up of the same slot cannot be merged into the
+	 * current report, so send what we have and start over. */
+	switch (touch_type) {
+	case WL_TOUCH_DOWN:
+		if (*pending & (EVDEV_TOUCH_PENDING_DOWN |
+				EVDEV_TOUCH_PENDING_UP))
+			evdev_flush_touch_events(device);
+		*pending |= EVDEV_TOUCH_PENDING_DOWN;
+		break;
+	case WL_TOUCH_MOTION:
+		if (*pending & EVDEV_TOUCH_PENDING_UP)
+			evdev_flush_touch_events(device);
+		if (*pending & (EVDEV_TOUCH_PENDING_DOWN |
+				EVDEV_TOUCH_PENDING_MOTION))
+			device->touch_frame.suppressed_count++;
+		else
+			*pending |= EVDEV_TOUCH_PENDING_MOTION;
+		break;
+	case WL_TOUCH_UP:
+		if (*pending & EVDEV_TOUCH_PENDING_UP)
+			evdev_flush_touch_events(device);
+		if (*pending & EVDEV_TOUCH_PENDING_MOTION) {
+			*pending &= ~EVDEV_TOUCH_PENDING_MOTION;
+			device->touch_frame.suppressed_count++;
+		}
+		*pending |= EVDEV_TOUCH_PENDING_UP;
+		break;
+	}
+
+	if (touch_type != WL_TOUCH_UP) {
+		device->touch_frame.slots[slot].x = x;
+		device->touch_frame.slots[slot].y = y;
+	}
+	device->touch_frame.slots[slot].time = time;
+	device->touch_frame.slot_mask |= 1 << slot;
+}
+
 static void
 evdev_flush_pending_event(struct evdev_device *device, uint32_t time)
 {
@@ -107,26 +209,23 @@ evdev_flush_pending_event(struct evdev_device *device, uint32_t time)
 						   device->mt.slots[slot].x,
 						   device->mt.slots[slot].y,
 						   &x, &y);
-		notify_touch(master, time,
-			     slot, x, y, WL_TOUCH_DOWN);
+		evdev_queue_touch(device, time, slot, x, y, WL_TOUCH_DOWN);
 		goto handled;
 	case EVDEV_ABSOLUTE_MT_MOTION:
 		weston_output_transform_coordinate(device->output,
 						   device->mt.slots[slot].x,
 						   device->mt.slots[slot].y,
 						   &x, &y);
-		notify_touch(master, time,
-			     slot, x, y, WL_TOUCH_MOTION);
+		evdev_queue_touch(device, time, slot, x, y, WL_TOUCH_MOTION);
 		goto handled;
 	case EVDEV_ABSOLUTE_MT_UP:
-		notify_touch(master, time, slot, 0, 0,
-			     WL_TOUCH_UP);
+		evdev_queue_touch(device, time, slot, 0, 0, WL_TOUCH_UP);
 		goto handled;
 	case EVDEV_ABSOLUTE_TOUCH_DOWN:
 		transform_absolute(device, &cx, &cy);
 		weston_output_transform_coordinate(device->output,
 						   cx, cy, &x, &y);
-		notify_touch(master, time, 0, x, y, WL_TOUCH_DOWN);
+		evdev_queue_touch(device, time, 0, x, y, WL_TOUCH_DOWN);
 		goto handled;
 	case EVDEV_ABSOLUTE_MOTION:
 		transform_absolute(device, &cx, &cy);
@@ -134,12 +233,13 @@ evdev_flush_pending_event(struct evdev_device *device, uint32_t time)
 						   cx, cy, &x, &y);
 
 		if (device->caps & EVDEV_TOUCH)
-			notify_touch(master, time, 0, x, y, WL_TOUCH_MOTION);
+			evdev_queue_touch(device, time, 0, x, y,
+					  WL_TOUCH_MOTION);
 		else
 			notify_motion_absolute(master, time, x, y);
 		goto handled;
 	case EVDEV_ABSOLUTE_TOUCH_UP:
-		notify_touch(master, time, 0, 0, 0, WL_TOUCH_UP);
+		evdev_queue_touch(device, time, 0, 0, 0, WL_TOUCH_UP);
 		goto handled;
 	}
 
@@ -174,7 +274,10 @@ evdev_process_key(struct evdev_device *device, struct input_event *e, int time)
 		return;
 	}
 
+	/* Keep the order of the report: touch points queued before this
+	 * key go out first, the frame still waits for the SYN. */
 	evdev_flush_pending_event(device, time);
+	evdev_flush_touch_events(device);
 
 	switch (e->code) {
 	case BTN_LEFT:
@@ -347,6 +450,7 @@ fallback_process(struct evdev_dispatch *dispatch,
 		break;
 	case EV_SYN:
 		evdev_flush_pending_event(device, time);
+		evdev_flush_touch_frame(device);
 		break;
 	}
 }
@@ -657,8 +761,14 @@ evdev_device_destroy(struct evdev_device *device)
 		weston_seat_release_pointer(device->seat);
 	if (device->seat_caps & EVDEV_SEAT_KEYBOARD)
 		weston_seat_release_keyboard(device->seat);
-	if (device->seat_caps & EVDEV_SEAT_TOUCH)
+	if (device->seat_caps & EVDEV_SEAT_TOUCH) {
+		weston_log("input device %s: %u touch frames, %u touch events, "
+			   "%u redundant touch events suppressed\n",
+			   device->devnode, device->touch_frame.frame_count,
+			   device->touch_frame.event_count,
+			   device->touch_frame.suppressed_count);
 		weston_seat_release_touch(device->seat);
+	}
 
 	dispatch = device->dispatch;
 	if (dispatch)
@@ -49,6 +49,12 @@ enum evdev_device_capability {
 	EVDEV_TOUCH = (1 << 4),
 };
 
+enum evdev_touch_pending {
+	EVDEV_TOUCH_PENDING_DOWN = (1 << 0),
+	EVDEV_TOUCH_PENDING_MOTION = (1 << 1),
+	EVDEV_TOUCH_PENDING_UP = (1 << 2)
+};
+
 enum evdev_device_seat_capability {
 	EVDEV_SEAT_POINTER = (1 << 0),
 	EVDEV_SEAT_KEYBOARD = (1 << 1),
@@ -80,6 +86,23 @@ struct evdev_device {
 	} mt;
 	struct mtdev *mtdev;
 
+	/* Touch points collected until the next SYN_REPORT. Repeated motion
+	 * of a slot within one report only keeps the last position. */
+	struct {
+		uint32_t slot_mask;
+		struct {
+			uint32_t pending; /* enum evdev_touch_pending */
+			uint32_t time;
+			wl_fixed_t x, y;
+		} slots[MAX_SLOTS];
+
+		int need_frame;
+
+		uint32_t frame_count;
+		uint32_t event_count;
+		uint32_t suppressed_count;
+	} touch_frame;
+
 	struct {
 		wl_fixed_t dx, dy;
 	} rel;
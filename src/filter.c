@@ -336,3 +336,298 @@ create_pointer_accelator_filter(accel_profile_func_t profile)
 
 	return &filter->base;
 }
+
+/*
+ * Table driven pointer acceleration filter
+ *
+ * The acceleration profile is sampled once into a lookup table when the
+ * filter is created, and the velocity is estimated from 24.8 fixed point
+ * deltas. Candidate trackers are compared against the initial velocity
+ * using squared distances, so only the first and the selected tracker need
+ * a square root and a division, and directions are classified without
+ * atan2().
+ */
+
+#define ACCEL_TABLE_SIZE	256
+#define VELOCITY_FRAC_BITS	8
+#define MAX_VELOCITY_DIFF_FIXED	\
+	((uint64_t) (MAX_VELOCITY_DIFF * (1 << VELOCITY_FRAC_BITS)))
+
+struct table_tracker {
+	int32_t dx;
+	int32_t dy;
+	uint32_t time;
+	int dir;
+};
+
+struct table_accelerator {
+	struct weston_motion_filter base;
+
+	double table[ACCEL_TABLE_SIZE];
+	uint32_t index_scale;
+
+	uint32_t last_velocity;
+	double last_dx;
+	double last_dy;
+
+	struct table_tracker trackers[NUM_POINTER_TRACKERS];
+	int cur_tracker;
+};
+
+/* Integer variant of get_direction(). The octant and the position within
+ * it are found by comparing the deltas against tan(4.5°) and tan(40.5°),
+ * the 0.1 and 0.9 octant boundaries, instead of calling atan2(). */
+static int
+get_direction_fixed(int dx, int dy)
+{
+	int u, v, quadrant, octant, near;
+
+	if (abs(dx) < 2 && abs(dy) < 2)
+		return get_direction(dx, dy);
+
+	/* Rotate into the first quadrant, u >= 0 and v >= 0 */
+	if (dx > 0 && dy >= 0) {
+		quadrant = 0; u = dx; v = dy;
+	} else if (dx <= 0 && dy > 0) {
+		quadrant = 1; u = dy; v = -dx;
+	} else if (dx < 0 && dy <= 0) {
+		quadrant = 2; u = -dx; v = -dy;
+	} else {
+		quadrant = 3; u = -dy; v = dx;
+	}
+
+	/* near: -1 if in the first tenth of the octant, 1 if in the last
+	 * tenth, 0 otherwise. */
+	if (v <= u) {
+		octant = quadrant * 2;
+		if (10000 * v < 787 * u)
+			near = -1;
+		else if (10000 * v >= 8541 * u)
+			near = 1;
+		else
+			near = 0;
+	} else {
+		octant = quadrant * 2 + 1;
+		if (10000 * u <= 787 * v)
+			near = 1;
+		else if (10000 * u > 8541 * v)
+			near = -1;
+		else
+			near = 0;
+	}
+
+	/* Octant 0 in get_direction() is North */
+	octant = (octant + 2) % 8;
+
+	if (near < 0)
+		return 1 << octant;
+	else if (near > 0)
+		return 1 << ((octant + 1) % 8);
+	else
+		return (1 << octant) | (1 << ((octant + 1) % 8));
+}
+
+static void
+table_feed_trackers(struct table_accelerator *accel,
+		    double dx, double dy, uint32_t time)
+{
+	struct table_tracker *trackers = accel->trackers;
+	int32_t fdx = dx * (1 << VELOCITY_FRAC_BITS);
+	int32_t fdy = dy * (1 << VELOCITY_FRAC_BITS);
+	int i, current;
+
+	for (i = 0; i < NUM_POINTER_TRACKERS; i++) {
+		trackers[i].dx += fdx;
+		trackers[i].dy += fdy;
+	}
+
+	current = (accel->cur_tracker + 1) % NUM_POINTER_TRACKERS;
+	accel->cur_tracker = current;
+
+	trackers[current].dx = 0;
+	trackers[current].dy = 0;
+	trackers[current].time = time;
+	trackers[current].dir = get_direction_fixed(dx, dy);
+}
+
+static struct table_tracker *
+table_tracker_by_offset(struct table_accelerator *accel, unsigned int offset)
+{
+	unsigned int index =
+		(accel->cur_tracker + NUM_POINTER_TRACKERS - offset)
+		% NUM_POINTER_TRACKERS;
+	return &accel->trackers[index];
+}
+
+static uint64_t
+table_tracker_distance2(struct table_tracker *tracker)
+{
+	int64_t dx = tracker->dx;
+	int64_t dy = tracker->dy;
+
+	return dx * dx + dy * dy;
+}
+
+/* Velocity in 24.8 fixed point device units per millisecond. */
+static uint32_t
+table_tracker_velocity(struct table_tracker *tracker, uint32_t time)
+{
+	uint32_t dt = time - tracker->time;
+
+	if (dt == 0)
+		return 0;
+
+	return sqrt(table_tracker_distance2(tracker)) / dt;
+}
+
+static uint32_t
+table_calculate_velocity(struct table_accelerator *accel, uint32_t time)
+{
+	struct table_tracker *tracker, *result = NULL;
+	uint32_t initial_velocity = 0;
+	uint64_t low, high, dt2, distance2;
+	uint32_t dt;
+	unsigned int offset;
+
+	unsigned int dir = table_tracker_by_offset(accel, 0)->dir;
+
+	/* Find first velocity */
+	for (offset = 1; offset < NUM_POINTER_TRACKERS; offset++) {
+		tracker = table_tracker_by_offset(accel, offset);
+
+		if (time <= tracker->time)
+			continue;
+
+		result = tracker;
+		initial_velocity = table_tracker_velocity(tracker, time);
+		if (initial_velocity > 0)
+			break;
+	}
+
+	/* |velocity - initial_velocity| <= MAX_VELOCITY_DIFF, expressed as
+	 * bounds on distance^2 / dt^2 so the loop needs no sqrt(). */
+	low = initial_velocity > MAX_VELOCITY_DIFF_FIXED ?
+		initial_velocity - MAX_VELOCITY_DIFF_FIXED : 0;
+	high = initial_velocity + MAX_VELOCITY_DIFF_FIXED;
+	low *= low;
+	high *= high;
+
+	/* Find least recent vector within a timelimit, maximum velocity diff
+	 * and direction threshold. */
+	for (; offset < NUM_POINTER_TRACKERS; offset++) {
+		tracker = table_tracker_by_offset(accel, offset);
+
+		/* Stop if too far away in time */
+		dt = time - tracker->time;
+		if (dt > MOTION_TIMEOUT || tracker->time >= time)
+			break;
+
+		/* Stop if direction changed */
+		dir &= tracker->dir;
+		if (dir == 0)
+			break;
+
+		/* Stop if velocity differs too much from initial */
+		dt2 = (uint64_t) dt * dt;
+		distance2 = table_tracker_distance2(tracker);
+		if (distance2 < low * dt2 || distance2 > high * dt2)
+			break;
+
+		result = tracker;
+	}
+
+	if (result == NULL)
+		return 0;
+
+	return table_tracker_velocity(result, time);
+}
+
+static double
+table_lookup(struct table_accelerator *accel, uint32_t velocity)
+{
+	uint64_t index = ((uint64_t) velocity * accel->index_scale) >>
+		VELOCITY_FRAC_BITS;
+	uint32_t i = index >> 8;
+	double frac;
+
+	if (i >= ACCEL_TABLE_SIZE - 1)
+		return accel->table[ACCEL_TABLE_SIZE - 1];
+
+	frac = (index & 0xff) * (1.0 / 256.0);
+
+	return accel->table[i] + frac * (accel->table[i + 1] - accel->table[i]);
+}
+
+static void
+table_accelerator_filter(struct weston_motion_filter *filter,
+			 struct weston_motion_params *motion,
+			 void *data, uint32_t time)
+{
+	struct table_accelerator *accel =
+		(struct table_accelerator *) filter;
+	uint32_t velocity;
+	double accel_value;
+
+	table_feed_trackers(accel, motion->dx, motion->dy, time);
+	velocity = table_calculate_velocity(accel, time);
+
+	/* Same Simpson's rule average as the profile based accelerator, but
+	 * each sample is a table lookup. */
+	accel_value = table_lookup(accel, velocity);
+	accel_value += table_lookup(accel, accel->last_velocity);
+	accel_value += 4.0 *
+		table_lookup(accel, (accel->last_velocity + velocity) / 2);
+	accel_value = accel_value / 6.0;
+
+	motion->dx = accel_value * motion->dx;
+	motion->dy = accel_value * motion->dy;
+
+	motion->dx = soften_delta(accel->last_dx, motion->dx);
+	motion->dy = soften_delta(accel->last_dy, motion->dy);
+
+	accel->last_dx = motion->dx;
+	accel->last_dy = motion->dy;
+
+	accel->last_velocity = velocity;
+}
+
+static void
+table_accelerator_destroy(struct weston_motion_filter *filter)
+{
+	free(filter);
+}
+
+struct weston_motion_filter_interface table_accelerator_interface = {
+	table_accelerator_filter,
+	table_accelerator_destroy
+};
+
+struct weston_motion_filter *
+create_pointer_table_accelerator_filter(accel_profile_func_t profile,
+					void *data, double max_velocity)
+{
+	struct table_accelerator *filter;
+	int i;
+
+	if (max_velocity <= 0.0)
+		return NULL;
+
+	filter = calloc(1, sizeof *filter);
+	if (filter == NULL)
+		return NULL;
+
+	filter->base.interface = &table_accelerator_interface;
+	wl_list_init(&filter->base.link);
+
+	for (i = 0; i < ACCEL_TABLE_SIZE; i++)
+		filter->table[i] =
+			profile(&filter->base, data,
+				max_velocity * i / (ACCEL_TABLE_SIZE - 1), 0);
+
+	/* Maps a 24.8 velocity to a 24.8 table index. */
+	filter->index_scale = (ACCEL_TABLE_SIZE - 1) / max_velocity * 256.0;
+	if (filter->index_scale == 0)
+		filter->index_scale = 1;
+
+	return &filter->base;
+}
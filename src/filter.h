@@ -64,4 +64,11 @@ typedef double (*accel_profile_func_t)(struct weston_motion_filter *filter,
 WL_EXPORT struct weston_motion_filter *
 create_pointer_accelator_filter(accel_profile_func_t filter);
 
+/* Samples profile over [0, max_velocity] (device units per ms) into a lookup
+ * table at creation time. Velocities above max_velocity use the last
+ * sample. */
+WL_EXPORT struct weston_motion_filter *
+create_pointer_table_accelerator_filter(accel_profile_func_t profile,
+					void *data, double max_velocity);
+
 #endif // _FILTER_H_
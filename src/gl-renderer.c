@@ -97,6 +97,7 @@ struct gl_renderer {
 	} border;
 
 	GLuint fbo;
+	int snapshot_active;
 
 	struct wl_array vertices;
 	struct wl_array indices; /* only used in compositor-wayland */
@@ -481,6 +482,50 @@ shader_uniforms(struct gl_shader *shader,
 		glUniform1i(shader->tex_uniforms[i], i);
 }
 
+static void
+gl_renderer_fill_region(struct weston_output *output,
+			pixman_region32_t *region,
+			float red, float green, float blue)
+{
+	struct gl_renderer *gr = get_renderer(output->compositor);
+	pixman_box32_t *rects, r;
+	int i, n;
+
+	glEnable(GL_SCISSOR_TEST);
+	glClearColor(red, green, blue, 1.0);
+
+	rects = pixman_region32_rectangles(region, &n);
+	for (i = 0; i < n; i++) {
+		r = rects[i];
+		r.x1 -= output->x;
+		r.y1 -= output->y;
+		r.x2 -= output->x;
+		r.y2 -= output->y;
+
+		/* Snapshots have no border or output transform and
+		 * store rows top first. */
+		if (gr->snapshot_active) {
+			r = weston_transformed_rect(output->width,
+						    output->height,
+						    WL_OUTPUT_TRANSFORM_NORMAL,
+						    output->current_scale, r);
+			glScissor(r.x1, r.y1, r.x2 - r.x1, r.y2 - r.y1);
+		} else {
+			r = weston_transformed_rect(output->width,
+						    output->height,
+						    output->transform,
+						    output->current_scale, r);
+			glScissor(output->border.left + r.x1,
+				  output->border.bottom +
+				  output->current_mode->height - r.y2,
+				  r.x2 - r.x1, r.y2 - r.y1);
+		}
+		glClear(GL_COLOR_BUFFER_BIT);
+	}
+
+	glDisable(GL_SCISSOR_TEST);
+}
+
 static void
 draw_surface(struct weston_surface *es, struct weston_output *output,
 	     pixman_region32_t *damage) /* in global coordinates */
@@ -503,6 +548,19 @@ draw_surface(struct weston_surface *es, struct weston_output *output,
 	if (!pixman_region32_not_empty(&repaint))
 		goto out;
 
+	/* Opaque solid color surfaces (fades, fullscreen backgrounds)
+	 * covering axis aligned rectangles are cleared, not shaded. */
+	if (gs->shader == &gr->solid_shader &&
+	    gs->color[3] * es->alpha >= 1.0 &&
+	    !gr->fan_debug && !output->zoom.active &&
+	    !(es->transform.enabled &&
+	      es->transform.matrix.type & ~(WESTON_MATRIX_TRANSFORM_TRANSLATE |
+					    WESTON_MATRIX_TRANSFORM_SCALE))) {
+		gl_renderer_fill_region(output, &repaint, gs->color[0],
+					gs->color[1], gs->color[2]);
+		goto out;
+	}
+
 	glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
 
 	if (gr->fan_debug) {
@@ -572,6 +630,58 @@ repaint_surfaces(struct weston_output *output, pixman_region32_t *damage)
 			draw_surface(surface, output, damage);
 }
 
+static int
+read_shm_buffer_pixels(struct wl_shm_buffer *shm_buffer,
+		       pixman_format_code_t format, void *pixels,
+		       int x, int y, int width, int height)
+{
+	pixman_format_code_t shm_format;
+	pixman_image_t *src, *dst;
+
+	/* An x format source reads back with opaque alpha. */
+	switch (wl_shm_buffer_get_format(shm_buffer)) {
+	case WL_SHM_FORMAT_XRGB8888:
+		shm_format = PIXMAN_x8r8g8b8;
+		break;
+	case WL_SHM_FORMAT_ARGB8888:
+		shm_format = PIXMAN_a8r8g8b8;
+		break;
+	case WL_SHM_FORMAT_RGB565:
+		shm_format = PIXMAN_r5g6b5;
+		break;
+	default:
+		return -1;
+	}
+
+	src = pixman_image_create_bits(shm_format,
+				       wl_shm_buffer_get_width(shm_buffer),
+				       wl_shm_buffer_get_height(shm_buffer),
+				       wl_shm_buffer_get_data(shm_buffer),
+				       wl_shm_buffer_get_stride(shm_buffer));
+	dst = pixman_image_create_bits(format, width, height, pixels,
+				       (PIXMAN_FORMAT_BPP(format) / 8) * width);
+	if (!src || !dst) {
+		if (src)
+			pixman_image_unref(src);
+		if (dst)
+			pixman_image_unref(dst);
+		return -1;
+	}
+
+	pixman_image_composite32(PIXMAN_OP_SRC,
+				 src, /* src */
+				 NULL /* mask */,
+				 dst, /* dest */
+				 x, y, /* src_x, src_y */
+				 0, 0, /* mask_x, mask_y */
+				 0, 0, /* dest_x, dest_y */
+				 width, height);
+	pixman_image_unref(src);
+	pixman_image_unref(dst);
+
+	return 0;
+}
+
 static int
 gl_renderer_read_surface_pixels(struct weston_surface *es,
 				pixman_format_code_t format, void *pixels,
@@ -582,7 +692,7 @@ gl_renderer_read_surface_pixels(struct weston_surface *es,
 	struct gl_renderer *gr = get_renderer(ec);
 	struct gl_surface_state *gs = get_surface_state(es);
 	GLenum gl_format;
-	int size;
+	GLenum status;
 	struct wl_shm_buffer *shm_buffer = NULL;
 
 	switch (format) {
@@ -599,25 +709,31 @@ gl_renderer_read_surface_pixels(struct weston_surface *es,
         if (buffer) {
 		shm_buffer = wl_shm_buffer_get(buffer->resource);
 	}
-	if (shm_buffer) {
-		size = buffer->width * 4 * buffer->height;
-		memcpy(pixels, wl_shm_buffer_get_data(shm_buffer), size);
-	} else {
-		if (gr->fbo == 0)
-			glGenFramebuffers(1, &gr->fbo);
-		glBindFramebuffer(GL_FRAMEBUFFER, gr->fbo);
-		glFramebufferTexture2D(GL_FRAMEBUFFER,
-				       GL_COLOR_ATTACHMENT0,
-				       GL_TEXTURE_2D,
-				       gs->textures[0], 0);
+	if (shm_buffer)
+		return read_shm_buffer_pixels(shm_buffer, format, pixels,
+					      x, y, width, height);
+
+	/* Only a single RGB texture can be attached to the fbo, external
+	 * and multi-planar YUV textures can't be read back. */
+	if (gs->target != GL_TEXTURE_2D || gs->num_textures != 1)
+		return -1;
+
+	if (gr->fbo == 0)
+		glGenFramebuffers(1, &gr->fbo);
+	glBindFramebuffer(GL_FRAMEBUFFER, gr->fbo);
+	glFramebufferTexture2D(GL_FRAMEBUFFER,
+			       GL_COLOR_ATTACHMENT0,
+			       GL_TEXTURE_2D,
+			       gs->textures[0], 0);
 
+	status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+	if (status == GL_FRAMEBUFFER_COMPLETE)
 		glReadPixels(x, y, width, height,
 			     gl_format, GL_UNSIGNED_BYTE, pixels);
 
-		glBindFramebuffer(GL_FRAMEBUFFER, 0);
-	}
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
-	return 0;
+	return status == GL_FRAMEBUFFER_COMPLETE ? 0 : -1;
 }
 
 static int
@@ -987,6 +1103,108 @@ ensure_textures(struct gl_surface_state *gs, int num_textures)
 	glBindTexture(gs->target, 0);
 }
 
+static int
+gl_renderer_snapshot(struct weston_surface *snapshot,
+		     struct weston_output *output,
+		     struct weston_surface **surfaces, int count)
+{
+	struct gl_renderer *gr = get_renderer(output->compositor);
+	struct gl_surface_state *gs = get_surface_state(snapshot);
+	struct weston_matrix matrix;
+	pixman_region32_t clip;
+	int32_t width, height;
+	GLenum status;
+	int i;
+
+	width = output->width * output->current_scale;
+	height = output->height * output->current_scale;
+
+	if (use_output(output) < 0)
+		return -1;
+
+	gs->target = GL_TEXTURE_2D;
+	ensure_textures(gs, 1);
+	glBindTexture(GL_TEXTURE_2D, gs->textures[0]);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_BGRA_EXT, width, height, 0,
+		     GL_BGRA_EXT, GL_UNSIGNED_BYTE, NULL);
+
+	if (gr->fbo == 0)
+		glGenFramebuffers(1, &gr->fbo);
+	glBindFramebuffer(GL_FRAMEBUFFER, gr->fbo);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+			       GL_TEXTURE_2D, gs->textures[0], 0);
+
+	status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+	if (status != GL_FRAMEBUFFER_COMPLETE) {
+		weston_log("snapshot framebuffer incomplete: 0x%x\n", status);
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		return -1;
+	}
+
+	glViewport(0, 0, width, height);
+	glClearColor(0.0, 0.0, 0.0, 0.0);
+	glClear(GL_COLOR_BUFFER_BIT);
+
+	/* Draw with a plain projection of the output rectangle: no
+	 * border, zoom or output transform, those get applied when the
+	 * snapshot itself is drawn. Rows come out top first, hence
+	 * y_inverted below. */
+	matrix = output->matrix;
+	weston_matrix_init(&output->matrix);
+	weston_matrix_translate(&output->matrix,
+				-(output->x + output->width / 2.0),
+				-(output->y + output->height / 2.0), 0);
+	weston_matrix_scale(&output->matrix,
+			    2.0 / output->width, 2.0 / output->height, 1);
+
+	/* The clip regions of hidden surfaces are stale, just paint
+	 * everything back to front. */
+	gr->snapshot_active = 1;
+	for (i = count - 1; i >= 0; i--) {
+		clip = surfaces[i]->clip;
+		pixman_region32_init(&surfaces[i]->clip);
+		draw_surface(surfaces[i], output, &output->region);
+		pixman_region32_fini(&surfaces[i]->clip);
+		surfaces[i]->clip = clip;
+	}
+	gr->snapshot_active = 0;
+
+	output->matrix = matrix;
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	gs->shader = &gr->texture_shader_rgba;
+	gs->buffer_type = BUFFER_TYPE_NULL;
+	gs->pitch = width;
+	gs->height = height;
+	gs->y_inverted = 1;
+
+	return 0;
+}
+
+static void
+gl_renderer_surface_set_image(struct weston_surface *surface,
+			      pixman_image_t *image)
+{
+	struct gl_renderer *gr = get_renderer(surface->compositor);
+	struct gl_surface_state *gs = get_surface_state(surface);
+
+	gs->target = GL_TEXTURE_2D;
+	ensure_textures(gs, 1);
+
+	/* Upload whole rows like the shm path does without
+	 * GL_EXT_unpack_subimage, texcoords are scaled by the pitch. */
+	gs->pitch = pixman_image_get_stride(image) / 4;
+	gs->height = pixman_image_get_height(image);
+	glBindTexture(GL_TEXTURE_2D, gs->textures[0]);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_BGRA_EXT, gs->pitch, gs->height, 0,
+		     GL_BGRA_EXT, GL_UNSIGNED_BYTE,
+		     pixman_image_get_data(image));
+
+	gs->shader = &gr->texture_shader_rgba;
+	gs->buffer_type = BUFFER_TYPE_NULL;
+	gs->y_inverted = 1;
+}
+
 static void
 gl_renderer_attach_shm(struct weston_surface *es, struct weston_buffer *buffer,
 		       struct wl_shm_buffer *shm_buffer)
@@ -1693,8 +1911,11 @@ gl_renderer_create(struct weston_compositor *ec, EGLNativeDisplayType display,
 	gr->base.attach = gl_renderer_attach;
 	gr->base.create_surface = gl_renderer_create_surface;
 	gr->base.surface_set_color = gl_renderer_surface_set_color;
+	gr->base.fill_region = gl_renderer_fill_region;
+	gr->base.surface_set_image = gl_renderer_surface_set_image;
 	gr->base.destroy_surface = gl_renderer_destroy_surface;
 	gr->base.destroy = gl_renderer_destroy;
+	gr->base.snapshot = gl_renderer_snapshot;
 
 	gr->egl_display = eglGetDisplay(display);
 	if (gr->egl_display == EGL_NO_DISPLAY) {
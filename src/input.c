@@ -24,11 +24,15 @@
 
 #include <stdlib.h>
 #include <stdint.h>
+#include <stdio.h>
 #include <string.h>
 #include <sys/mman.h>
 #include <assert.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/stat.h>
 
 #include "../shared/os-compatibility.h"
 #include "compositor.h"
@@ -232,6 +236,15 @@ default_grab_touch_motion(struct weston_touch_grab *grab, uint32_t time,
 	}
 }
 
+static void
+default_grab_touch_frame(struct weston_touch_grab *grab)
+{
+	struct wl_resource *resource;
+
+	wl_resource_for_each(resource, &grab->touch->focus_resource_list)
+		wl_touch_send_frame(resource);
+}
+
 static void
 default_grab_touch_cancel(struct weston_touch_grab *grab)
 {
@@ -241,6 +254,7 @@ static const struct weston_touch_grab_interface default_touch_grab_interface = {
 	default_grab_touch_down,
 	default_grab_touch_up,
 	default_grab_touch_motion,
+	default_grab_touch_frame,
 	default_grab_touch_cancel,
 };
 
@@ -1132,6 +1146,11 @@ notify_touch(struct weston_seat *seat, uint32_t time, int touch_id,
 	case WL_TOUCH_DOWN:
 		weston_compositor_idle_inhibit(ec);
 
+		/* the previous touch session ended earlier in this frame,
+		 * finish it before picking a new surface */
+		if (seat->num_tp == 0 && touch->focus)
+			notify_touch_frame(seat);
+
 		seat->num_tp++;
 
 		/* the first finger down picks the surface, and all further go
@@ -1175,15 +1194,47 @@ notify_touch(struct weston_seat *seat, uint32_t time, int touch_id,
 		weston_compositor_idle_release(ec);
 		seat->num_tp--;
 
+		/* the focus is dropped by notify_touch_frame(), so the
+		 * surface still gets the frame ending this touch session */
 		grab->interface->up(grab, time, touch_id);
-		if (seat->num_tp == 0)
-			weston_touch_set_focus(seat, NULL);
 		break;
 	}
 
 	weston_compositor_run_touch_binding(ec, seat, time, touch_type);
 }
 
+/**
+ * notify_touch_frame - marks the end of a set of touch events.
+ *
+ * Backends that batch touch points call this after the notify_touch()
+ * calls belonging to one hardware report, so that clients can handle all
+ * touch points of the report together. Once the last touch point is up,
+ * the frame ends the touch session and the focus is dropped.
+ */
+WL_EXPORT void
+notify_touch_frame(struct weston_seat *seat)
+{
+	struct weston_touch_grab *grab = seat->touch->grab;
+
+	grab->interface->frame(grab);
+
+	if (seat->num_tp == 0)
+		weston_touch_set_focus(seat, NULL);
+}
+
+/* Wayland has no gesture events, so pinch and swipe gestures are only
+ * handed to the shell and other listeners inside the compositor. */
+WL_EXPORT void
+notify_gesture(struct weston_seat *seat, struct weston_gesture_event *event)
+{
+	struct weston_compositor *compositor = seat->compositor;
+
+	weston_compositor_wake(compositor);
+
+	event->seat = seat;
+	wl_signal_emit(&compositor->gesture_signal, event);
+}
+
 static void
 pointer_cursor_surface_configure(struct weston_surface *es,
 				 int32_t dx, int32_t dy, int32_t width, int32_t height)
@@ -1523,6 +1574,7 @@ weston_xkb_info_destroy(struct weston_xkb_info *xkb_info)
 		munmap(xkb_info->keymap_area, xkb_info->keymap_size);
 	if (xkb_info->keymap_fd >= 0)
 		close(xkb_info->keymap_fd);
+	wl_list_remove(&xkb_info->link);
 	free(xkb_info);
 }
 
@@ -1541,24 +1593,53 @@ weston_compositor_xkb_destroy(struct weston_compositor *ec)
 	free((char *) ec->xkb_names.layout);
 	free((char *) ec->xkb_names.variant);
 	free((char *) ec->xkb_names.options);
+	free(ec->xkb_cache_dir);
 
 	if (ec->xkb_info)
 		weston_xkb_info_destroy(ec->xkb_info);
 	xkb_context_unref(ec->xkb_context);
 }
 
+/*
+ * Creates the xkb_info for keymap, or returns a new reference to an
+ * existing one whose keymap serializes to the same string, so that seats
+ * with identical keymaps share one keymap file. keymap_str is the
+ * serialized keymap if the caller already has it, or NULL; it is always
+ * consumed.
+ */
 static struct weston_xkb_info *
-weston_xkb_info_create(struct xkb_keymap *keymap)
+weston_xkb_info_create(struct weston_compositor *ec,
+		       struct xkb_keymap *keymap, char *keymap_str)
 {
-	struct weston_xkb_info *xkb_info = zalloc(sizeof *xkb_info);
-	if (xkb_info == NULL)
+	struct weston_xkb_info *xkb_info;
+	size_t size;
+
+	if (keymap_str == NULL)
+		keymap_str = xkb_map_get_as_string(keymap);
+	if (keymap_str == NULL) {
+		weston_log("failed to get string version of keymap\n");
 		return NULL;
+	}
+	size = strlen(keymap_str) + 1;
+
+	wl_list_for_each(xkb_info, &ec->xkb_info_list, link) {
+		if (xkb_info->keymap_size == size &&
+		    memcmp(xkb_info->keymap_area, keymap_str, size) == 0) {
+			xkb_info->ref_count++;
+			free(keymap_str);
+			return xkb_info;
+		}
+	}
+
+	xkb_info = zalloc(sizeof *xkb_info);
+	if (xkb_info == NULL) {
+		free(keymap_str);
+		return NULL;
+	}
 
 	xkb_info->keymap = xkb_map_ref(keymap);
 	xkb_info->ref_count = 1;
 
-	char *keymap_str;
-
 	xkb_info->shift_mod = xkb_map_mod_get_index(xkb_info->keymap,
 						    XKB_MOD_NAME_SHIFT);
 	xkb_info->caps_mod = xkb_map_mod_get_index(xkb_info->keymap,
@@ -1580,12 +1661,7 @@ weston_xkb_info_create(struct xkb_keymap *keymap)
 	xkb_info->scroll_led = xkb_map_led_get_index(xkb_info->keymap,
 						     XKB_LED_NAME_SCROLL);
 
-	keymap_str = xkb_map_get_as_string(xkb_info->keymap);
-	if (keymap_str == NULL) {
-		weston_log("failed to get string version of keymap\n");
-		goto err_keymap;
-	}
-	xkb_info->keymap_size = strlen(keymap_str) + 1;
+	xkb_info->keymap_size = size;
 
 	xkb_info->keymap_fd = os_create_anonymous_file(xkb_info->keymap_size);
 	if (xkb_info->keymap_fd < 0) {
@@ -1605,29 +1681,227 @@ weston_xkb_info_create(struct xkb_keymap *keymap)
 	strcpy(xkb_info->keymap_area, keymap_str);
 	free(keymap_str);
 
+	wl_list_insert(&ec->xkb_info_list, &xkb_info->link);
+
 	return xkb_info;
 
 err_dev_zero:
 	close(xkb_info->keymap_fd);
 err_keymap_str:
 	free(keymap_str);
-err_keymap:
 	xkb_map_unref(xkb_info->keymap);
 	free(xkb_info);
 	return NULL;
 }
 
+/*
+ * Compiled keymap cache
+ *
+ * Compiling a keymap from RMLVO names is much slower than parsing an
+ * already compiled keymap, so the serialized global keymap is kept in
+ * xkb_cache_dir. A cache file holds the cache key, a NUL, the keymap
+ * string and a terminating NUL. The key covers the RMLVO names and the
+ * libxkbcommon version, since the keymap text format may change between
+ * versions.
+ */
+
+#ifndef XKBCOMMON_VERSION
+#define XKBCOMMON_VERSION "unknown"
+#endif
+
+static char *
+keymap_cache_key(struct weston_compositor *ec)
+{
+	char *key;
+
+	if (asprintf(&key, "rules=%s model=%s layout=%s variant=%s "
+		     "options=%s xkbcommon=%s",
+		     ec->xkb_names.rules ? ec->xkb_names.rules : "",
+		     ec->xkb_names.model ? ec->xkb_names.model : "",
+		     ec->xkb_names.layout ? ec->xkb_names.layout : "",
+		     ec->xkb_names.variant ? ec->xkb_names.variant : "",
+		     ec->xkb_names.options ? ec->xkb_names.options : "",
+		     XKBCOMMON_VERSION) < 0)
+		return NULL;
+
+	return key;
+}
+
+static char *
+keymap_cache_path(struct weston_compositor *ec, const char *key)
+{
+	uint64_t hash = 0xcbf29ce484222325ULL; /* FNV-1a */
+	const char *p;
+	char *path;
+
+	for (p = key; *p; p++) {
+		hash ^= (unsigned char) *p;
+		hash *= 0x100000001b3ULL;
+	}
+
+	if (asprintf(&path, "%s/keymap-%016llx",
+		     ec->xkb_cache_dir, (unsigned long long) hash) < 0)
+		return NULL;
+
+	return path;
+}
+
+static struct xkb_keymap *
+keymap_cache_load(struct weston_compositor *ec, const char *path,
+		  const char *key, char **keymap_str)
+{
+	struct xkb_keymap *keymap = NULL;
+	size_t key_size = strlen(key) + 1;
+	struct stat st;
+	char *data;
+	int fd;
+
+	fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return NULL;
+
+	if (fstat(fd, &st) < 0 || (size_t) st.st_size <= key_size + 1) {
+		close(fd);
+		return NULL;
+	}
+
+	data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED)
+		return NULL;
+
+	if (memcmp(data, key, key_size) == 0 &&
+	    data[st.st_size - 1] == '\0') {
+		keymap = xkb_map_new_from_string(ec->xkb_context,
+						 data + key_size,
+						 XKB_KEYMAP_FORMAT_TEXT_V1, 0);
+		if (keymap)
+			*keymap_str = strdup(data + key_size);
+	}
+
+	munmap(data, st.st_size);
+
+	if (keymap && *keymap_str == NULL) {
+		xkb_map_unref(keymap);
+		keymap = NULL;
+	}
+
+	return keymap;
+}
+
+static int
+ensure_dir(const char *dir)
+{
+	char *path, *p;
+	int ret = 0;
+
+	path = strdup(dir);
+	if (path == NULL)
+		return -1;
+
+	for (p = path + 1; ret == 0; p++) {
+		if (*p != '/' && *p != '\0')
+			continue;
+
+		if (*p == '/') {
+			*p = '\0';
+			if (mkdir(path, 0700) < 0 && errno != EEXIST)
+				ret = -1;
+			*p = '/';
+		} else {
+			if (mkdir(path, 0700) < 0 && errno != EEXIST)
+				ret = -1;
+			break;
+		}
+	}
+
+	free(path);
+
+	return ret;
+}
+
+static void
+keymap_cache_store(struct weston_compositor *ec, const char *path,
+		   const char *key, const char *keymap_str)
+{
+	char *tmp;
+	int fd, ok;
+
+	if (ensure_dir(ec->xkb_cache_dir) < 0 ||
+	    asprintf(&tmp, "%s.XXXXXX", path) < 0)
+		return;
+
+	fd = mkstemp(tmp);
+	if (fd < 0) {
+		free(tmp);
+		return;
+	}
+
+	ok = write(fd, key, strlen(key) + 1) == (ssize_t) strlen(key) + 1 &&
+	     write(fd, keymap_str, strlen(keymap_str) + 1) ==
+		(ssize_t) strlen(keymap_str) + 1;
+	close(fd);
+
+	if (!ok || rename(tmp, path) < 0) {
+		weston_log("failed to write keymap cache %s\n", path);
+		unlink(tmp);
+	}
+
+	free(tmp);
+}
+
+static double
+elapsed_ms(const struct timespec *start)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (now.tv_sec - start->tv_sec) * 1000.0 +
+	       (now.tv_nsec - start->tv_nsec) / 1000000.0;
+}
+
 static int
 weston_compositor_build_global_keymap(struct weston_compositor *ec)
 {
-	struct xkb_keymap *keymap;
+	struct xkb_keymap *keymap = NULL;
+	char *key = NULL, *path = NULL, *keymap_str = NULL;
+	struct timespec start;
 
 	if (ec->xkb_info != NULL)
 		return 0;
 
-	keymap = xkb_map_new_from_names(ec->xkb_context,
-					&ec->xkb_names,
-					0);
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	if (ec->xkb_cache_dir) {
+		key = keymap_cache_key(ec);
+		if (key)
+			path = keymap_cache_path(ec, key);
+		if (path)
+			keymap = keymap_cache_load(ec, path, key, &keymap_str);
+		if (keymap)
+			weston_log("loaded XKB keymap from %s in %.1f ms\n",
+				   path, elapsed_ms(&start));
+	}
+
+	if (keymap == NULL) {
+		keymap = xkb_map_new_from_names(ec->xkb_context,
+						&ec->xkb_names,
+						0);
+		if (keymap)
+			weston_log("compiled XKB keymap in %.1f ms\n",
+				   elapsed_ms(&start));
+
+		if (keymap && path) {
+			keymap_str = xkb_map_get_as_string(keymap);
+			if (keymap_str)
+				keymap_cache_store(ec, path, key, keymap_str);
+		}
+	}
+
+	free(key);
+	free(path);
+
 	if (keymap == NULL) {
 		weston_log("failed to compile global XKB keymap\n");
 		weston_log("  tried rules %s, model %s, layout %s, variant %s, "
@@ -1638,10 +1912,13 @@ weston_compositor_build_global_keymap(struct weston_compositor *ec)
 		return -1;
 	}
 
-	ec->xkb_info = weston_xkb_info_create(keymap);
+	ec->xkb_info = weston_xkb_info_create(ec, keymap, keymap_str);
+	xkb_map_unref(keymap);
 	if (ec->xkb_info == NULL)
 		return -1;
 
+	weston_log("XKB keymap set up in %.1f ms\n", elapsed_ms(&start));
+
 	return 0;
 }
 #else
@@ -1673,7 +1950,9 @@ weston_seat_init_keyboard(struct weston_seat *seat, struct xkb_keymap *keymap)
 #ifdef ENABLE_XKBCOMMON
 	if (seat->compositor->use_xkbcommon) {
 		if (keymap != NULL) {
-			seat->xkb_info = weston_xkb_info_create(keymap);
+			seat->xkb_info =
+				weston_xkb_info_create(seat->compositor,
+						       keymap, NULL);
 			if (seat->xkb_info == NULL)
 				return -1;
 		} else {
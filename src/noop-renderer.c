@@ -85,13 +85,17 @@ noop_renderer_init(struct weston_compositor *ec)
 		return -1;
 
 	renderer->read_pixels = noop_renderer_read_pixels;
+	renderer->read_surface_pixels = NULL;
 	renderer->repaint_output = noop_renderer_repaint_output;
 	renderer->flush_damage = noop_renderer_flush_damage;
 	renderer->attach = noop_renderer_attach;
 	renderer->create_surface = noop_renderer_create_surface;
 	renderer->surface_set_color = noop_renderer_surface_set_color;
+	renderer->fill_region = NULL;
 	renderer->destroy_surface = noop_renderer_destroy_surface;
 	renderer->destroy = noop_renderer_destroy;
+	renderer->snapshot = NULL;
+	renderer->surface_set_image = NULL;
 	ec->renderer = renderer;
 
 	return 0;
@@ -0,0 +1,233 @@
+/*
+ * Copyright © 2013 Intel Corporation
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and
+ * its documentation for any purpose is hereby granted without fee, provided
+ * that the above copyright notice appear in all copies and that both that
+ * copyright notice and this permission notice appear in supporting
+ * documentation, and that the name of the copyright holders not be used in
+ * advertising or publicity pertaining to distribution of the software
+ * without specific, written prior permission.  The copyright holders make
+ * no representations about the suitability of this software for any
+ * purpose.  It is provided "as is" without express or implied warranty.
+ *
+ * THE COPYRIGHT HOLDERS DISCLAIM ALL WARRANTIES WITH REGARD TO THIS
+ * SOFTWARE, INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS, IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * SPECIAL, INDIRECT OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER
+ * RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF
+ * CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "compositor.h"
+
+#define INLINE_WORDS ARRAY_LENGTH(((struct weston_output_mask *) 0)->inline_bits)
+
+static inline uint32_t *
+mask_words(struct weston_output_mask *mask)
+{
+	return mask->bits ? mask->bits : mask->inline_bits;
+}
+
+static inline const uint32_t *
+mask_words_const(const struct weston_output_mask *mask)
+{
+	return mask->bits ? mask->bits : mask->inline_bits;
+}
+
+static inline uint32_t
+mask_size(const struct weston_output_mask *mask)
+{
+	return mask->bits ? mask->size : INLINE_WORDS;
+}
+
+static int
+mask_reserve(struct weston_output_mask *mask, uint32_t words)
+{
+	uint32_t *bits, size;
+
+	if (words <= mask_size(mask))
+		return 0;
+
+	size = mask_size(mask);
+	while (size < words)
+		size *= 2;
+
+	bits = realloc(mask->bits, size * sizeof *bits);
+	if (!bits)
+		return -1;
+
+	if (!mask->bits)
+		memcpy(bits, mask->inline_bits, sizeof mask->inline_bits);
+	memset(bits + mask_size(mask), 0,
+	       (size - mask_size(mask)) * sizeof *bits);
+	mask->bits = bits;
+	mask->size = size;
+
+	return 0;
+}
+
+WL_EXPORT void
+weston_output_mask_init(struct weston_output_mask *mask)
+{
+	memset(mask, 0, sizeof *mask);
+}
+
+WL_EXPORT void
+weston_output_mask_release(struct weston_output_mask *mask)
+{
+	free(mask->bits);
+	weston_output_mask_init(mask);
+}
+
+WL_EXPORT void
+weston_output_mask_clear(struct weston_output_mask *mask)
+{
+	memset(mask_words(mask), 0, mask_size(mask) * sizeof (uint32_t));
+}
+
+WL_EXPORT int
+weston_output_mask_set(struct weston_output_mask *mask, uint32_t id)
+{
+	if (mask_reserve(mask, id / 32 + 1) < 0)
+		return -1;
+
+	mask_words(mask)[id / 32] |= 1u << (id % 32);
+
+	return 0;
+}
+
+WL_EXPORT void
+weston_output_mask_unset(struct weston_output_mask *mask, uint32_t id)
+{
+	if (id / 32 < mask_size(mask))
+		mask_words(mask)[id / 32] &= ~(1u << (id % 32));
+}
+
+WL_EXPORT int
+weston_output_mask_test(const struct weston_output_mask *mask, uint32_t id)
+{
+	if (id / 32 >= mask_size(mask))
+		return 0;
+
+	return (mask_words_const(mask)[id / 32] >> (id % 32)) & 1;
+}
+
+WL_EXPORT int
+weston_output_mask_or(struct weston_output_mask *mask,
+		      const struct weston_output_mask *other)
+{
+	const uint32_t *src = mask_words_const(other);
+	uint32_t i, *dst, size = mask_size(other);
+
+	/* Only grow for words that have bits set */
+	while (size > mask_size(mask) && src[size - 1] == 0)
+		size--;
+	if (mask_reserve(mask, size) < 0)
+		return -1;
+
+	dst = mask_words(mask);
+	for (i = 0; i < size; i++)
+		dst[i] |= src[i];
+
+	return 0;
+}
+
+WL_EXPORT int
+weston_output_mask_copy(struct weston_output_mask *mask,
+			const struct weston_output_mask *other)
+{
+	if (mask == other)
+		return 0;
+
+	weston_output_mask_clear(mask);
+
+	return weston_output_mask_or(mask, other);
+}
+
+WL_EXPORT int
+weston_output_mask_equal(const struct weston_output_mask *a,
+			 const struct weston_output_mask *b)
+{
+	const uint32_t *wa = mask_words_const(a), *wb = mask_words_const(b);
+	uint32_t i, sa = mask_size(a), sb = mask_size(b);
+
+	for (i = 0; i < sa || i < sb; i++)
+		if ((i < sa ? wa[i] : 0) != (i < sb ? wb[i] : 0))
+			return 0;
+
+	return 1;
+}
+
+WL_EXPORT int
+weston_output_mask_is_empty(const struct weston_output_mask *mask)
+{
+	const uint32_t *words = mask_words_const(mask);
+	uint32_t i;
+
+	for (i = 0; i < mask_size(mask); i++)
+		if (words[i])
+			return 0;
+
+	return 1;
+}
+
+/* Whether id is the only output in the mask */
+WL_EXPORT int
+weston_output_mask_is_single(const struct weston_output_mask *mask,
+			     uint32_t id)
+{
+	const uint32_t *words = mask_words_const(mask);
+	uint32_t i;
+
+	if (!weston_output_mask_test(mask, id))
+		return 0;
+
+	for (i = 0; i < mask_size(mask); i++)
+		if (words[i] != (i == id / 32 ? 1u << (id % 32) : 0))
+			return 0;
+
+	return 1;
+}
+
+/* The lowest id >= id in the mask, or -1 */
+WL_EXPORT int
+weston_output_mask_next(const struct weston_output_mask *mask, int id)
+{
+	const uint32_t *words = mask_words_const(mask);
+	uint32_t i, word;
+
+	if (id < 0)
+		return -1;
+
+	for (i = id / 32; i < mask_size(mask); i++) {
+		word = words[i];
+		if (i == (uint32_t) id / 32)
+			word &= ~0u << (id % 32);
+		if (word)
+			return i * 32 + ffs(word) - 1;
+	}
+
+	return -1;
+}
+
+/* The lowest id that is not in the mask */
+WL_EXPORT uint32_t
+weston_output_mask_first_clear(const struct weston_output_mask *mask)
+{
+	const uint32_t *words = mask_words_const(mask);
+	uint32_t i;
+
+	for (i = 0; i < mask_size(mask); i++)
+		if (~words[i])
+			return i * 32 + ffs(~words[i]) - 1;
+
+	return mask_size(mask) * 32;
+}
@@ -39,6 +39,10 @@ struct pixman_output_state {
 struct pixman_surface_state {
 	pixman_image_t *image;
 	struct weston_buffer_reference buffer_ref;
+
+	/* set by surface_set_color(), premultiplied */
+	int solid;
+	pixman_color_t color;
 };
 
 struct pixman_renderer {
@@ -416,6 +420,59 @@ repaint_region(struct weston_surface *es, struct weston_output *output,
 	pixman_region32_fini(&final_region);
 }
 
+static void
+fill_region(struct weston_output *output, pixman_region32_t *region,
+	    pixman_color_t *color)
+{
+	struct pixman_renderer *pr =
+		(struct pixman_renderer *) output->compositor->renderer;
+	struct pixman_output_state *po = get_output_state(output);
+	pixman_region32_t final_region;
+	pixman_box32_t *rects;
+	pixman_op_t op;
+	int n;
+
+	pixman_region32_init(&final_region);
+	pixman_region32_copy(&final_region, region);
+	region_global_to_output(output, &final_region);
+
+	/* An opaque color is a plain pixman_fill() */
+	op = color->alpha == 0xffff ? PIXMAN_OP_SRC : PIXMAN_OP_OVER;
+	rects = pixman_region32_rectangles(&final_region, &n);
+	pixman_image_fill_boxes(op, po->shadow_image, color, n, rects);
+
+	if (pr->repaint_debug) {
+		pixman_image_set_clip_region32(po->shadow_image, &final_region);
+		pixman_image_composite32(PIXMAN_OP_OVER,
+					 pr->debug_color, /* src */
+					 NULL /* mask */,
+					 po->shadow_image, /* dest */
+					 0, 0, /* src_x, src_y */
+					 0, 0, /* mask_x, mask_y */
+					 0, 0, /* dest_x, dest_y */
+					 pixman_image_get_width (po->shadow_image), /* width */
+					 pixman_image_get_height (po->shadow_image) /* height */);
+		pixman_image_set_clip_region32(po->shadow_image, NULL);
+	}
+
+	pixman_region32_fini(&final_region);
+}
+
+static void
+pixman_renderer_fill_region(struct weston_output *output,
+			    pixman_region32_t *region,
+			    float red, float green, float blue)
+{
+	pixman_color_t color;
+
+	color.red = red * 0xffff;
+	color.green = green * 0xffff;
+	color.blue = blue * 0xffff;
+	color.alpha = 0xffff;
+
+	fill_region(output, region, &color);
+}
+
 static void
 draw_surface(struct weston_surface *es, struct weston_output *output,
 	     pixman_region32_t *damage) /* in global coordinates */
@@ -443,6 +500,24 @@ draw_surface(struct weston_surface *es, struct weston_output *output,
 		goto out;
 	}
 
+	/* Solid color surfaces covering axis aligned rectangles are
+	 * filled, this also gives fades their surface alpha. */
+	if (ps->solid &&
+	    !(es->transform.enabled &&
+	      es->transform.matrix.type & ~(WESTON_MATRIX_TRANSFORM_TRANSLATE |
+					    WESTON_MATRIX_TRANSFORM_SCALE))) {
+		pixman_color_t color = ps->color;
+
+		if (es->alpha < 1.0) {
+			color.red *= es->alpha;
+			color.green *= es->alpha;
+			color.blue *= es->alpha;
+			color.alpha *= es->alpha;
+		}
+		fill_region(output, &repaint, &color);
+		goto out;
+	}
+
 	/* TODO: Implement repaint_region_complex() using pixman_composite_trapezoids() */
 	if (es->transform.enabled &&
 	    es->transform.matrix.type != WESTON_MATRIX_TRANSFORM_TRANSLATE) {
@@ -478,6 +553,53 @@ repaint_surfaces(struct weston_output *output, pixman_region32_t *damage)
 			draw_surface(surface, output, damage);
 }
 
+static int
+pixman_renderer_snapshot(struct weston_surface *snapshot,
+			 struct weston_output *output,
+			 struct weston_surface **surfaces, int count)
+{
+	struct pixman_output_state *po = get_output_state(output);
+	struct pixman_surface_state *ps = get_surface_state(snapshot);
+	pixman_image_t *image, *shadow_image;
+	pixman_region32_t clip;
+	uint32_t transform;
+	int i;
+
+	image = pixman_image_create_bits(PIXMAN_a8r8g8b8,
+					 output->width * output->current_scale,
+					 output->height * output->current_scale,
+					 NULL, 0);
+	if (!image)
+		return -1;
+
+	/* Paint into the snapshot as if it was an untransformed shadow
+	 * buffer; the output transform is applied when the snapshot
+	 * itself is drawn. Clip regions of hidden surfaces are stale,
+	 * so paint everything back to front. */
+	shadow_image = po->shadow_image;
+	transform = output->transform;
+	po->shadow_image = image;
+	output->transform = WL_OUTPUT_TRANSFORM_NORMAL;
+
+	for (i = count - 1; i >= 0; i--) {
+		clip = surfaces[i]->clip;
+		pixman_region32_init(&surfaces[i]->clip);
+		draw_surface(surfaces[i], output, &output->region);
+		pixman_region32_fini(&surfaces[i]->clip);
+		surfaces[i]->clip = clip;
+	}
+
+	po->shadow_image = shadow_image;
+	output->transform = transform;
+
+	if (ps->image)
+		pixman_image_unref(ps->image);
+	ps->image = image;
+	ps->solid = 0;
+
+	return 0;
+}
+
 static void
 copy_to_hw_buffer(struct weston_output *output, pixman_region32_t *region)
 {
@@ -541,6 +663,7 @@ pixman_renderer_attach(struct weston_surface *es, struct weston_buffer *buffer)
 		pixman_image_unref(ps->image);
 		ps->image = NULL;
 	}
+	ps->solid = 0;
 
 	if (!buffer)
 		return;
@@ -612,6 +735,53 @@ pixman_renderer_surface_set_color(struct weston_surface *es,
 	}
 
 	ps->image = pixman_image_create_solid_fill(&color);
+	ps->solid = 1;
+	ps->color = color;
+}
+
+static int
+pixman_renderer_read_surface_pixels(struct weston_surface *es,
+				    pixman_format_code_t format, void *pixels,
+				    int x, int y, int width, int height)
+{
+	struct pixman_surface_state *ps = get_surface_state(es);
+	pixman_image_t *out_buf;
+
+	if (!ps->image)
+		return -1;
+
+	out_buf = pixman_image_create_bits(format, width, height, pixels,
+					   (PIXMAN_FORMAT_BPP(format) / 8) * width);
+	if (!out_buf)
+		return -1;
+
+	/* repaint leaves the output transform and filter on the image */
+	pixman_image_set_transform(ps->image, NULL);
+	pixman_image_set_filter(ps->image, PIXMAN_FILTER_NEAREST, NULL, 0);
+	pixman_image_composite32(PIXMAN_OP_SRC,
+				 ps->image, /* src */
+				 NULL /* mask */,
+				 out_buf, /* dest */
+				 x, y, /* src_x, src_y */
+				 0, 0, /* mask_x, mask_y */
+				 0, 0, /* dest_x, dest_y */
+				 width, height);
+	pixman_image_unref(out_buf);
+
+	return 0;
+}
+
+static void
+pixman_renderer_surface_set_image(struct weston_surface *es,
+				  pixman_image_t *image)
+{
+	struct pixman_surface_state *ps = get_surface_state(es);
+
+	if (ps->image)
+		pixman_image_unref(ps->image);
+
+	ps->image = pixman_image_ref(image);
+	ps->solid = 0;
 }
 
 static void
@@ -667,13 +837,18 @@ pixman_renderer_init(struct weston_compositor *ec)
 	renderer->repaint_debug = 0;
 	renderer->debug_color = NULL;
 	renderer->base.read_pixels = pixman_renderer_read_pixels;
+	renderer->base.read_surface_pixels =
+		pixman_renderer_read_surface_pixels;
 	renderer->base.repaint_output = pixman_renderer_repaint_output;
 	renderer->base.flush_damage = pixman_renderer_flush_damage;
 	renderer->base.attach = pixman_renderer_attach;
 	renderer->base.create_surface = pixman_renderer_create_surface;
 	renderer->base.surface_set_color = pixman_renderer_surface_set_color;
+	renderer->base.fill_region = pixman_renderer_fill_region;
 	renderer->base.destroy_surface = pixman_renderer_destroy_surface;
 	renderer->base.destroy = pixman_renderer_destroy;
+	renderer->base.snapshot = pixman_renderer_snapshot;
+	renderer->base.surface_set_image = pixman_renderer_surface_set_image;
 	ec->renderer = &renderer->base;
 	ec->capabilities |= WESTON_CAP_ROTATION_ANY;
 	ec->capabilities |= WESTON_CAP_CAPTURE_YFLIP;
@@ -701,6 +876,14 @@ pixman_renderer_output_set_buffer(struct weston_output *output, pixman_image_t *
 	}
 }
 
+/* For backends that copy damage out of the output buffer themselves */
+WL_EXPORT void
+pixman_renderer_output_region_to_buffer(struct weston_output *output,
+					pixman_region32_t *region)
+{
+	region_global_to_output(output, region);
+}
+
 WL_EXPORT int
 pixman_renderer_output_create(struct weston_output *output)
 {
@@ -0,0 +1,165 @@
+/*
+ * Copyright © 2013 Hardening <rdp.effort@gmail.com>
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and
+ * its documentation for any purpose is hereby granted without fee, provided
+ * that the above copyright notice appear in all copies and that both that
+ * copyright notice and this permission notice appear in supporting
+ * documentation, and that the name of the copyright holders not be used in
+ * advertising or publicity pertaining to distribution of the software
+ * without specific, written prior permission.  The copyright holders make
+ * no representations about the suitability of this software for any
+ * purpose.  It is provided "as is" without express or implied warranty.
+ *
+ * THE COPYRIGHT HOLDERS DISCLAIM ALL WARRANTIES WITH REGARD TO THIS
+ * SOFTWARE, INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS, IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * SPECIAL, INDIRECT OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER
+ * RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF
+ * CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "rdp-tiles.h"
+
+#ifndef MIN
+#define MIN(x,y) (((x) < (y)) ? (x) : (y))
+#endif
+
+static uint64_t
+tile_hash(pixman_image_t *image, int x, int y, int width, int height)
+{
+	uint32_t *data = pixman_image_get_data(image);
+	int stride = pixman_image_get_stride(image) / 4;
+	uint64_t hash = 14695981039346656037ULL;
+	uint32_t *row;
+	int i, j;
+
+	/* FNV-1a over whole pixels */
+	for (i = 0; i < height; i++) {
+		row = data + (y + i) * stride + x;
+		for (j = 0; j < width; j++)
+			hash = (hash ^ row[j]) * 1099511628211ULL;
+	}
+
+	return hash;
+}
+
+int
+rdp_tiles_reset(struct rdp_tiles *tiles, pixman_image_t *image)
+{
+	int width = pixman_image_get_width(image);
+	int height = pixman_image_get_height(image);
+	int tx, ty, x, y;
+	uint64_t *hash;
+
+	free(tiles->hashes);
+	tiles->tiles_x = (width + RDP_TILE_SIZE - 1) / RDP_TILE_SIZE;
+	tiles->tiles_y = (height + RDP_TILE_SIZE - 1) / RDP_TILE_SIZE;
+	tiles->hashes = malloc(tiles->tiles_x * tiles->tiles_y *
+			       sizeof *tiles->hashes);
+	if (!tiles->hashes)
+		return -1;
+
+	hash = tiles->hashes;
+	for (ty = 0; ty < tiles->tiles_y; ty++) {
+		y = ty * RDP_TILE_SIZE;
+		for (tx = 0; tx < tiles->tiles_x; tx++) {
+			x = tx * RDP_TILE_SIZE;
+			*hash++ = tile_hash(image, x, y,
+					    MIN(RDP_TILE_SIZE, width - x),
+					    MIN(RDP_TILE_SIZE, height - y));
+		}
+	}
+
+	return 0;
+}
+
+static uint64_t
+region_area(pixman_region32_t *region)
+{
+	pixman_box32_t *rects;
+	uint64_t area = 0;
+	int i, nrects;
+
+	rects = pixman_region32_rectangles(region, &nrects);
+	for (i = 0; i < nrects; i++)
+		area += (uint64_t) (rects[i].x2 - rects[i].x1) *
+			(rects[i].y2 - rects[i].y1);
+
+	return area;
+}
+
+/* Clients often redraw identical content (blinking cursors, clocks
+ * that didn't tick), so only tiles whose hash moved are kept. */
+void
+rdp_tiles_filter_damage(struct rdp_tiles *tiles, pixman_image_t *image,
+			pixman_region32_t *damage, pixman_region32_t *changed)
+{
+	int width = pixman_image_get_width(image);
+	int height = pixman_image_get_height(image);
+	pixman_box32_t *extents;
+	pixman_box32_t tile;
+	pixman_region32_t clip;
+	int tx, ty, tx1, ty1, tx2, ty2;
+	uint64_t hash, *slot;
+
+	if (!tiles->hashes) {
+		pixman_region32_copy(changed, damage);
+		return;
+	}
+
+	pixman_region32_init_rect(&clip, 0, 0, width, height);
+	pixman_region32_intersect(&clip, &clip, damage);
+	extents = pixman_region32_extents(&clip);
+
+	tx1 = extents->x1 / RDP_TILE_SIZE;
+	ty1 = extents->y1 / RDP_TILE_SIZE;
+	tx2 = (extents->x2 + RDP_TILE_SIZE - 1) / RDP_TILE_SIZE;
+	ty2 = (extents->y2 + RDP_TILE_SIZE - 1) / RDP_TILE_SIZE;
+
+	pixman_region32_clear(changed);
+	for (ty = ty1; ty < ty2; ty++) {
+		for (tx = tx1; tx < tx2; tx++) {
+			tile.x1 = tx * RDP_TILE_SIZE;
+			tile.y1 = ty * RDP_TILE_SIZE;
+			tile.x2 = MIN(tile.x1 + RDP_TILE_SIZE, width);
+			tile.y2 = MIN(tile.y1 + RDP_TILE_SIZE, height);
+			if (pixman_region32_contains_rectangle(&clip, &tile) ==
+			    PIXMAN_REGION_OUT)
+				continue;
+
+			hash = tile_hash(image, tile.x1, tile.y1,
+					 tile.x2 - tile.x1,
+					 tile.y2 - tile.y1);
+			slot = &tiles->hashes[ty * tiles->tiles_x + tx];
+			if (*slot == hash)
+				continue;
+
+			*slot = hash;
+			pixman_region32_union_rect(changed, changed,
+						   tile.x1, tile.y1,
+						   tile.x2 - tile.x1,
+						   tile.y2 - tile.y1);
+		}
+	}
+	pixman_region32_intersect(changed, changed, &clip);
+
+	tiles->stats.damaged += region_area(&clip) * 4;
+	tiles->stats.unchanged +=
+		(region_area(&clip) - region_area(changed)) * 4;
+
+	pixman_region32_fini(&clip);
+}
+
+void
+rdp_tiles_release(struct rdp_tiles *tiles)
+{
+	free(tiles->hashes);
+	tiles->hashes = NULL;
+}
@@ -0,0 +1,58 @@
+/*
+ * Copyright © 2013 Hardening <rdp.effort@gmail.com>
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and
+ * its documentation for any purpose is hereby granted without fee, provided
+ * that the above copyright notice appear in all copies and that both that
+ * copyright notice and this permission notice appear in supporting
+ * documentation, and that the name of the copyright holders not be used in
+ * advertising or publicity pertaining to distribution of the software
+ * without specific, written prior permission.  The copyright holders make
+ * no representations about the suitability of this software for any
+ * purpose.  It is provided "as is" without express or implied warranty.
+ *
+ * THE COPYRIGHT HOLDERS DISCLAIM ALL WARRANTIES WITH REGARD TO THIS
+ * SOFTWARE, INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS, IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * SPECIAL, INDIRECT OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER
+ * RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF
+ * CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef _RDP_TILES_H_
+#define _RDP_TILES_H_
+
+#include <stdint.h>
+#include <pixman.h>
+
+#define RDP_TILE_SIZE 64
+
+/*
+ * Content hash of every RDP_TILE_SIZE square of a 32 bpp image, used
+ * to drop damage that didn't change any pixels.
+ */
+struct rdp_tiles {
+	uint64_t *hashes;
+	int tiles_x, tiles_y;
+	struct {
+		uint64_t damaged;   /* bytes */
+		uint64_t unchanged; /* bytes */
+	} stats;
+};
+
+/* Hashes all of the image, after it was created or resized.  On
+ * failure all damage passes the filter unchanged. */
+int
+rdp_tiles_reset(struct rdp_tiles *tiles, pixman_image_t *image);
+
+/* Rehashes the tiles touched by damage and sets changed to the part
+ * of damage within tiles whose pixels are different now. */
+void
+rdp_tiles_filter_damage(struct rdp_tiles *tiles, pixman_image_t *image,
+			pixman_region32_t *damage, pixman_region32_t *changed);
+
+void
+rdp_tiles_release(struct rdp_tiles *tiles);
+
+#endif
@@ -39,8 +39,10 @@
 #include "input-method-server-protocol.h"
 #include "workspaces-server-protocol.h"
 #include "../shared/config-parser.h"
+#include "window-placement.h"
 
 #define DEFAULT_NUM_WORKSPACES 1
+#define PLACEMENT_CELL_SIZE 32
 #define DEFAULT_WORKSPACE_CHANGE_ANIMATION_LENGTH 200
 
 enum animation_type {
@@ -50,6 +52,11 @@ enum animation_type {
 	ANIMATION_FADE
 };
 
+enum workspace_animation_type {
+	WORKSPACE_ANIMATION_SINE,
+	WORKSPACE_ANIMATION_SPRING
+};
+
 enum fade_type {
 	FADE_IN,
 	FADE_OUT
@@ -71,6 +78,14 @@ struct workspace {
 	struct wl_listener seat_destroyed_listener;
 };
 
+struct workspace_snapshot {
+	struct workspace *ws;
+	struct weston_surface *surface;
+	struct weston_transform transform;
+	unsigned int height;
+	struct wl_list link;
+};
+
 struct input_panel_surface {
 	struct wl_resource *resource;
 	struct wl_signal destroy_signal;
@@ -94,6 +109,7 @@ struct desktop_shell {
 	struct wl_listener show_input_panel_listener;
 	struct wl_listener hide_input_panel_listener;
 	struct wl_listener update_input_panel_listener;
+	struct wl_listener gesture_listener;
 
 	struct weston_layer fullscreen_layer;
 	struct weston_layer panel_layer;
@@ -125,6 +141,13 @@ struct desktop_shell {
 	struct weston_surface *lock_surface;
 	struct wl_listener lock_surface_listener;
 
+	struct {
+		struct wl_list maps;
+		struct wl_list dirty_list;
+		uint32_t generation;
+		bool valid;
+	} placement;
+
 	struct {
 		struct wl_array array;
 		unsigned int current;
@@ -137,8 +160,20 @@ struct desktop_shell {
 		int anim_dir;
 		uint32_t anim_timestamp;
 		double anim_current;
+		enum workspace_animation_type anim_type;
+		struct weston_spring anim_spring;
 		struct workspace *anim_from;
 		struct workspace *anim_to;
+
+		int freeze_hidden;
+
+		int anim_snapshot;
+		struct weston_layer anim_snapshot_layer;
+		struct wl_list anim_snapshot_list;
+
+		uint32_t anim_frames;
+		uint32_t anim_first_msecs;
+		uint32_t anim_last_msecs;
 	} workspaces;
 
 	struct {
@@ -225,6 +260,20 @@ struct shell_surface {
 
 	struct weston_transform workspace_transform;
 
+	/* Footprint in the placement maps, see placement_get_map() */
+	struct {
+		struct wl_listener geometry_listener;
+		struct wl_list dirty_link;
+		struct weston_placement_footprint footprint;
+		uint32_t generation;
+	} placement;
+
+	/* Downscaled contents for the switcher overlay */
+	struct {
+		pixman_image_t *image;
+		bool stale;
+	} thumbnail;
+
 	struct weston_output *fullscreen_output;
 	struct weston_output *output;
 	struct wl_list link;
@@ -456,6 +505,17 @@ shell_configuration(struct desktop_shell *shell)
 	weston_config_section_get_uint(section, "num-workspaces",
 				       &shell->workspaces.num,
 				       DEFAULT_NUM_WORKSPACES);
+	weston_config_section_get_string(section,
+					 "workspace-animation", &s, "sine");
+	if (strcmp(s, "spring") == 0)
+		shell->workspaces.anim_type = WORKSPACE_ANIMATION_SPRING;
+	else
+		shell->workspaces.anim_type = WORKSPACE_ANIMATION_SINE;
+	free(s);
+	weston_config_section_get_bool(section, "workspace-snapshot",
+				       &shell->workspaces.anim_snapshot, 0);
+	weston_config_section_get_bool(section, "freeze-hidden-workspaces",
+				       &shell->workspaces.freeze_hidden, 1);
 }
 
 static void
@@ -651,6 +711,12 @@ get_current_workspace(struct desktop_shell *shell)
 	return get_workspace(shell, shell->workspaces.current);
 }
 
+static void
+placement_invalidate(struct desktop_shell *shell)
+{
+	shell->placement.valid = false;
+}
+
 static void
 activate_workspace(struct desktop_shell *shell, unsigned int index)
 {
@@ -662,6 +728,55 @@ activate_workspace(struct desktop_shell *shell, unsigned int index)
 	shell->workspaces.current = index;
 }
 
+struct freeze_stats {
+	int surfaces;
+	int released;
+	uint32_t commits;
+};
+
+static void
+surface_tree_set_frozen(struct weston_surface *surface, bool frozen,
+			struct freeze_stats *stats)
+{
+	struct weston_subsurface *sub;
+
+	stats->surfaces++;
+	if (frozen) {
+		weston_surface_freeze(surface);
+	} else {
+		if (surface->freeze.released)
+			stats->released++;
+		stats->commits += surface->freeze.commits;
+		weston_surface_thaw(surface);
+	}
+
+	wl_list_for_each(sub, &surface->subsurface_list, parent_link)
+		if (sub->surface != surface)
+			surface_tree_set_frozen(sub->surface, frozen, stats);
+}
+
+/* Surfaces on hidden workspaces don't need repaints or textures. Freeze
+ * them while hidden and thaw them before they show up again; the
+ * textures that were dropped get uploaded on the following repaint. */
+static void
+workspace_set_frozen(struct desktop_shell *shell, struct workspace *ws,
+		     bool frozen)
+{
+	struct weston_surface *surface;
+	struct freeze_stats stats = { 0 };
+
+	if (frozen && !shell->workspaces.freeze_hidden)
+		return;
+
+	wl_list_for_each(surface, &ws->layer.surface_list, layer_link)
+		surface_tree_set_frozen(surface, frozen, &stats);
+
+	if (!frozen && (stats.released > 0 || stats.commits > 0))
+		weston_log("workspace thawed: %d surfaces, %d textures "
+			   "rebuilt, %u commits held back while hidden\n",
+			   stats.surfaces, stats.released, stats.commits);
+}
+
 static unsigned int
 get_output_height(struct weston_output *output)
 {
@@ -719,6 +834,121 @@ workspace_translate_in(struct workspace *ws, double fraction)
 	}
 }
 
+static void
+workspace_snapshot_destroy_all(struct desktop_shell *shell)
+{
+	struct workspace_snapshot *snap, *next;
+
+	wl_list_for_each_safe(snap, next,
+			      &shell->workspaces.anim_snapshot_list, link) {
+		wl_list_remove(&snap->link);
+		wl_list_remove(&snap->surface->layer_link);
+		wl_list_init(&snap->surface->layer_link);
+		weston_surface_destroy(snap->surface);
+		free(snap);
+	}
+}
+
+/* Stand in for both workspaces with one snapshot per output each, so
+ * that every animation frame moves a handful of surfaces rather than
+ * every window on the two workspaces. The snapshot layer takes the
+ * place of the 'from' layer until the animation is over. */
+static int
+workspace_snapshot_begin(struct desktop_shell *shell,
+			 struct workspace *from, struct workspace *to)
+{
+	struct workspace *ws[2] = { from, to };
+	struct workspace_snapshot *snap;
+	struct weston_output *output;
+	int i;
+
+	if (!shell->workspaces.anim_snapshot ||
+	    !wl_list_empty(&shell->workspaces.anim_sticky_list) ||
+	    wl_list_empty(&shell->compositor->output_list))
+		return -1;
+
+	wl_list_for_each(output, &shell->compositor->output_list, link) {
+		for (i = 0; i < 2; i++) {
+			snap = zalloc(sizeof *snap);
+			if (snap == NULL)
+				goto err;
+
+			snap->surface = weston_layer_snapshot(&ws[i]->layer,
+							      output);
+			if (snap->surface == NULL) {
+				free(snap);
+				goto err;
+			}
+
+			snap->ws = ws[i];
+			snap->height = get_output_height(output);
+			weston_matrix_init(&snap->transform.matrix);
+			wl_list_insert(&snap->surface->geometry.transformation_list,
+				       &snap->transform.link);
+			wl_list_insert(&shell->workspaces.anim_snapshot_layer.surface_list,
+				       &snap->surface->layer_link);
+			wl_list_insert(&shell->workspaces.anim_snapshot_list,
+				       &snap->link);
+			weston_surface_damage(snap->surface);
+		}
+	}
+
+	wl_list_insert(from->layer.link.prev,
+		       &shell->workspaces.anim_snapshot_layer.link);
+	wl_list_remove(&from->layer.link);
+
+	return 0;
+
+err:
+	workspace_snapshot_destroy_all(shell);
+	return -1;
+}
+
+static void
+workspace_snapshot_end(struct desktop_shell *shell, struct workspace *to)
+{
+	wl_list_insert(&shell->workspaces.anim_snapshot_layer.link,
+		       &to->layer.link);
+	wl_list_remove(&shell->workspaces.anim_snapshot_layer.link);
+
+	workspace_snapshot_destroy_all(shell);
+}
+
+static void
+workspace_snapshot_translate(struct desktop_shell *shell,
+			     struct workspace *from, double fraction)
+{
+	struct workspace_snapshot *snap;
+	double d;
+
+	wl_list_for_each(snap, &shell->workspaces.anim_snapshot_list, link) {
+		if (snap->ws == from)
+			d = snap->height * fraction;
+		else if (fraction > 0)
+			d = -(snap->height - snap->height * fraction);
+		else
+			d = snap->height + snap->height * fraction;
+
+		weston_matrix_init(&snap->transform.matrix);
+		weston_matrix_translate(&snap->transform.matrix, 0.0, d, 0.0);
+		weston_surface_geometry_dirty(snap->surface);
+	}
+}
+
+static void
+workspace_change_translate(struct desktop_shell *shell,
+			   struct workspace *from, struct workspace *to,
+			   double fraction)
+{
+	if (!wl_list_empty(&shell->workspaces.anim_snapshot_list)) {
+		workspace_snapshot_translate(shell, from, fraction);
+		return;
+	}
+
+	workspace_translate_out(from, fraction);
+	workspace_translate_in(to, fraction);
+}
+
 static void
 broadcast_current_workspace_state(struct desktop_shell *shell)
 {
@@ -737,6 +967,7 @@ reverse_workspace_change_animation(struct desktop_shell *shell,
 				   struct workspace *to)
 {
 	shell->workspaces.current = index;
+	placement_invalidate(shell);
 
 	shell->workspaces.anim_to = to;
 	shell->workspaces.anim_from = from;
@@ -767,14 +998,70 @@ finish_workspace_change_animation(struct desktop_shell *shell,
 				  struct workspace *from,
 				  struct workspace *to)
 {
+	uint32_t frames = shell->workspaces.anim_frames;
+	uint32_t span;
+
 	weston_compositor_schedule_repaint(shell->compositor);
 
+	if (frames > 1) {
+		span = shell->workspaces.anim_last_msecs -
+			shell->workspaces.anim_first_msecs;
+		weston_log("workspace switch (%s): %u frames, "
+			   "%.1f ms per frame\n",
+			   wl_list_empty(&shell->workspaces.anim_snapshot_list) ?
+			   "translate" : "snapshot",
+			   frames, (double) span / (frames - 1));
+	}
+
 	wl_list_remove(&shell->workspaces.animation.link);
-	workspace_deactivate_transforms(from);
-	workspace_deactivate_transforms(to);
 	shell->workspaces.anim_to = NULL;
 
-	wl_list_remove(&shell->workspaces.anim_from->layer.link);
+	if (!wl_list_empty(&shell->workspaces.anim_snapshot_list)) {
+		workspace_snapshot_end(shell, to);
+	} else {
+		workspace_deactivate_transforms(from);
+		workspace_deactivate_transforms(to);
+
+		wl_list_remove(&shell->workspaces.anim_from->layer.link);
+	}
+
+	workspace_set_frozen(shell, from, true);
+}
+
+/* Spring driven progress of the workspace change in [0, 1], or -1.0
+ * once it has settled. */
+static double
+workspace_change_spring(struct desktop_shell *shell, uint32_t msecs)
+{
+	struct weston_spring *spring = &shell->workspaces.anim_spring;
+	double current, previous;
+
+	if (shell->workspaces.anim_timestamp == 0) {
+		if (shell->workspaces.anim_current == 0.0) {
+			current = 0.0;
+			previous = 0.0;
+		} else {
+			/* Reversed: from and to swapped, so carry the
+			 * position and velocity over mirrored. */
+			current = 1.0 - spring->current;
+			previous = 1.0 - spring->previous;
+		}
+
+		/* Settles in about DEFAULT_WORKSPACE_CHANGE_ANIMATION_LENGTH */
+		weston_spring_init(spring, 300.0, current, 1.0);
+		spring->friction = 600;
+		spring->previous = previous;
+		spring->clip = WESTON_SPRING_CLAMP;
+		spring->solver = shell->compositor->spring_solver;
+		spring->timestamp = msecs;
+		shell->workspaces.anim_timestamp = msecs;
+	}
+
+	weston_spring_update(spring, msecs);
+	if (weston_spring_done(spring))
+		return -1.0;
+
+	return spring->current;
 }
 
 static void
@@ -789,11 +1076,30 @@ animate_workspace_change_frame(struct weston_animation *animation,
 	uint32_t t;
 	double x, y;
 
+	if (shell->workspaces.anim_frames++ == 0)
+		shell->workspaces.anim_first_msecs = msecs;
+	shell->workspaces.anim_last_msecs = msecs;
+
 	if (workspace_is_empty(from) && workspace_is_empty(to)) {
 		finish_workspace_change_animation(shell, from, to);
 		return;
 	}
 
+	if (shell->workspaces.anim_type == WORKSPACE_ANIMATION_SPRING) {
+		y = workspace_change_spring(shell, msecs);
+		if (y < 0.0) {
+			finish_workspace_change_animation(shell, from, to);
+			return;
+		}
+
+		workspace_change_translate(shell, from, to,
+					   shell->workspaces.anim_dir * y);
+		shell->workspaces.anim_current = y;
+
+		weston_compositor_schedule_repaint(shell->compositor);
+		return;
+	}
+
 	if (shell->workspaces.anim_timestamp == 0) {
 		if (shell->workspaces.anim_current == 0.0)
 			shell->workspaces.anim_timestamp = msecs;
@@ -818,8 +1124,8 @@ animate_workspace_change_frame(struct weston_animation *animation,
 	if (t < DEFAULT_WORKSPACE_CHANGE_ANIMATION_LENGTH) {
 		weston_compositor_schedule_repaint(shell->compositor);
 
-		workspace_translate_out(from, shell->workspaces.anim_dir * y);
-		workspace_translate_in(to, shell->workspaces.anim_dir * y);
+		workspace_change_translate(shell, from, to,
+					   shell->workspaces.anim_dir * y);
 		shell->workspaces.anim_current = y;
 
 		weston_compositor_schedule_repaint(shell->compositor);
@@ -844,21 +1150,28 @@ animate_workspace_change(struct desktop_shell *shell,
 		dir = 1;
 
 	shell->workspaces.current = index;
+	placement_invalidate(shell);
+
+	workspace_set_frozen(shell, to, false);
 
 	shell->workspaces.anim_dir = dir;
 	shell->workspaces.anim_from = from;
 	shell->workspaces.anim_to = to;
 	shell->workspaces.anim_current = 0.0;
 	shell->workspaces.anim_timestamp = 0;
+	shell->workspaces.anim_frames = 0;
 
 	output = container_of(shell->compositor->output_list.next,
 			      struct weston_output, link);
 	wl_list_insert(&output->animation_list,
 		       &shell->workspaces.animation.link);
 
-	wl_list_insert(from->layer.link.prev, &to->layer.link);
-
-	workspace_translate_in(to, 0);
+	if (workspace_snapshot_begin(shell, from, to) == 0) {
+		workspace_snapshot_translate(shell, from, 0);
+	} else {
+		wl_list_insert(from->layer.link.prev, &to->layer.link);
+		workspace_translate_in(to, 0);
+	}
 
 	restore_focus_state(shell, to);
 
@@ -870,8 +1183,11 @@ update_workspace(struct desktop_shell *shell, unsigned int index,
 		 struct workspace *from, struct workspace *to)
 {
 	shell->workspaces.current = index;
+	placement_invalidate(shell);
+	workspace_set_frozen(shell, to, false);
 	wl_list_insert(&from->layer.link, &to->layer.link);
 	wl_list_remove(&from->layer.link);
+	workspace_set_frozen(shell, from, true);
 }
 
 static void
@@ -939,6 +1255,7 @@ move_surface_to_workspace(struct desktop_shell *shell,
 	struct workspace *to;
 	struct weston_seat *seat;
 	struct weston_surface *focus;
+	struct freeze_stats stats = { 0 };
 
 	assert(weston_surface_get_main_surface(surface) == surface);
 
@@ -953,6 +1270,12 @@ move_surface_to_workspace(struct desktop_shell *shell,
 
 	wl_list_remove(&surface->layer_link);
 	wl_list_insert(&to->layer.surface_list, &surface->layer_link);
+	placement_invalidate(shell);
+
+	if (shell->workspaces.freeze_hidden && to != from &&
+	    (shell->workspaces.anim_to == NULL ||
+	     shell->workspaces.anim_from != to))
+		surface_tree_set_frozen(surface, true, &stats);
 
 	drop_focus_state(shell, from, surface);
 	wl_list_for_each(seat, &shell->compositor->seat_list, link) {
@@ -988,12 +1311,15 @@ take_surface_to_workspace_by_seat(struct desktop_shell *shell,
 
 	wl_list_remove(&surface->layer_link);
 	wl_list_insert(&to->layer.surface_list, &surface->layer_link);
+	placement_invalidate(shell);
 
 	replace_focus_state(shell, to, seat);
 	drop_focus_state(shell, from, surface);
 
+	/* The snapshots no longer match, so don't reverse those. */
 	if (shell->workspaces.anim_from == to &&
-	    shell->workspaces.anim_to == from) {
+	    shell->workspaces.anim_to == from &&
+	    wl_list_empty(&shell->workspaces.anim_snapshot_list)) {
 		wl_list_remove(&to->layer.link);
 		wl_list_insert(from->layer.link.prev, &to->layer.link);
 
@@ -1115,7 +1441,12 @@ touch_move_grab_motion(struct weston_touch_grab *grab, uint32_t time,
 	weston_surface_configure(es, dx, dy,
 				 es->geometry.width, es->geometry.height);
 
-	weston_compositor_schedule_repaint(es->compositor);
+	weston_surface_schedule_geometry_repaint(es);
+}
+
+static void
+touch_move_grab_frame(struct weston_touch_grab *grab)
+{
 }
 
 static void
@@ -1133,6 +1464,7 @@ static const struct weston_touch_grab_interface touch_move_grab_interface = {
 	touch_move_grab_down,
 	touch_move_grab_up,
 	touch_move_grab_motion,
+	touch_move_grab_frame,
 	touch_move_grab_cancel,
 };
 
@@ -1185,7 +1517,7 @@ move_grab_motion(struct weston_pointer_grab *grab, uint32_t time)
 	weston_surface_configure(es, dx, dy,
 				 es->geometry.width, es->geometry.height);
 
-	weston_compositor_schedule_repaint(es->compositor);
+	weston_surface_schedule_geometry_repaint(es);
 }
 
 static void
@@ -2379,6 +2711,166 @@ static const struct wl_shell_surface_interface shell_surface_implementation = {
 	shell_surface_set_class
 };
 
+static bool
+placement_is_eligible(struct shell_surface *shsurf)
+{
+	return weston_surface_is_mapped(shsurf->surface) &&
+		(shsurf->type == SHELL_SURFACE_TOPLEVEL ||
+		 shsurf->type == SHELL_SURFACE_MAXIMIZED);
+}
+
+/* Take the footprint of a surface out of the maps. One from an older
+ * generation is not in the current maps. */
+static void
+placement_forget(struct shell_surface *shsurf)
+{
+	struct desktop_shell *shell = shsurf->shell;
+
+	if (shsurf->placement.generation == shell->placement.generation)
+		weston_placement_footprint_update(&shell->placement.maps,
+						  &shsurf->placement.footprint,
+						  NULL);
+	else
+		weston_placement_footprint_init(&shsurf->placement.footprint);
+}
+
+/* Bring the footprint of a surface on the current workspace up to
+ * date. Surfaces from an older generation are on other workspaces, or
+ * were when the maps were last rebuilt. */
+static void
+placement_update(struct shell_surface *shsurf)
+{
+	struct desktop_shell *shell = shsurf->shell;
+	struct weston_surface *surface = shsurf->surface;
+	pixman_box32_t box;
+
+	if (shsurf->placement.generation != shell->placement.generation)
+		return;
+
+	if (!placement_is_eligible(shsurf)) {
+		placement_forget(shsurf);
+		return;
+	}
+
+	box.x1 = surface->geometry.x;
+	box.y1 = surface->geometry.y;
+	box.x2 = surface->geometry.x + surface->geometry.width;
+	box.y2 = surface->geometry.y + surface->geometry.height;
+	weston_placement_footprint_update(&shell->placement.maps,
+					  &shsurf->placement.footprint, &box);
+}
+
+static void
+placement_handle_geometry(struct wl_listener *listener, void *data)
+{
+	struct shell_surface *shsurf =
+		container_of(listener, struct shell_surface,
+			     placement.geometry_listener);
+
+	if (wl_list_empty(&shsurf->placement.dirty_link))
+		wl_list_insert(&shsurf->shell->placement.dirty_list,
+			       &shsurf->placement.dirty_link);
+}
+
+/* Start tracking a surface just mapped on the current workspace */
+static void
+placement_track(struct shell_surface *shsurf)
+{
+	placement_forget(shsurf);
+	shsurf->placement.generation = shsurf->shell->placement.generation;
+	placement_handle_geometry(&shsurf->placement.geometry_listener, NULL);
+}
+
+static void
+placement_rebuild(struct desktop_shell *shell)
+{
+	struct weston_placement_map *map, *next;
+	struct weston_output *output;
+	struct weston_surface *surface;
+	struct shell_surface *shsurf;
+	struct workspace *ws = get_current_workspace(shell);
+	int panel_height;
+
+	wl_list_for_each_safe(map, next, &shell->placement.maps, link)
+		weston_placement_map_destroy(map);
+
+	wl_list_for_each(output, &shell->compositor->output_list, link) {
+		panel_height = get_output_panel_height(shell, output);
+		map = weston_placement_map_create(output->x,
+						  output->y + panel_height,
+						  output->width,
+						  output->height - panel_height,
+						  PLACEMENT_CELL_SIZE);
+		if (map)
+			wl_list_insert(shell->placement.maps.prev, &map->link);
+	}
+
+	shell->placement.generation++;
+	shell->placement.valid = true;
+
+	wl_list_for_each(surface, &ws->layer.surface_list, layer_link) {
+		shsurf = get_shell_surface(surface);
+		if (!shsurf)
+			continue;
+
+		weston_placement_footprint_init(&shsurf->placement.footprint);
+		shsurf->placement.generation = shell->placement.generation;
+		placement_update(shsurf);
+	}
+}
+
+static struct weston_placement_map *
+placement_find_map(struct desktop_shell *shell, struct weston_output *output)
+{
+	struct weston_placement_map *map;
+	int panel_height = get_output_panel_height(shell, output);
+
+	wl_list_for_each(map, &shell->placement.maps, link)
+		if (weston_placement_map_matches(map, output->x,
+						 output->y + panel_height,
+						 output->width,
+						 output->height - panel_height))
+			return map;
+
+	return NULL;
+}
+
+/* The maps only change for surfaces whose geometry went dirty since the
+ * last placement, so placing a window does not depend on the number of
+ * windows. Workspace switches and output or panel changes rebuild them.
+ */
+static struct weston_placement_map *
+placement_get_map(struct desktop_shell *shell, struct weston_output *output)
+{
+	struct shell_surface *shsurf, *next;
+	struct weston_placement_map *map;
+
+	if (!shell->placement.valid)
+		placement_rebuild(shell);
+
+	wl_list_for_each_safe(shsurf, next, &shell->placement.dirty_list,
+			      placement.dirty_link) {
+		placement_update(shsurf);
+
+		/* Stay on the list until the geometry is clean again,
+		 * otherwise further changes would go unnoticed. */
+		if (shsurf->surface->transform.dirty &&
+		    shsurf->placement.generation == shell->placement.generation)
+			continue;
+
+		wl_list_remove(&shsurf->placement.dirty_link);
+		wl_list_init(&shsurf->placement.dirty_link);
+	}
+
+	map = placement_find_map(shell, output);
+	if (map == NULL) {
+		placement_rebuild(shell);
+		map = placement_find_map(shell, output);
+	}
+
+	return map;
+}
+
 static void
 destroy_shell_surface(struct shell_surface *shsurf)
 {
@@ -2401,6 +2893,12 @@ destroy_shell_surface(struct shell_surface *shsurf)
 	wl_list_remove(&shsurf->surface_destroy_listener.link);
 	shsurf->surface->configure = NULL;
 	ping_timer_destroy(shsurf);
+
+	placement_forget(shsurf);
+	wl_list_remove(&shsurf->placement.geometry_listener.link);
+	wl_list_remove(&shsurf->placement.dirty_link);
+	if (shsurf->thumbnail.image)
+		pixman_image_unref(shsurf->thumbnail.image);
 	free(shsurf->title);
 
 	wl_list_remove(&shsurf->link);
@@ -2486,6 +2984,12 @@ create_shell_surface(void *shell, struct weston_surface *surface,
 
 	wl_list_init(&shsurf->workspace_transform.link);
 
+	wl_list_init(&shsurf->placement.dirty_link);
+	weston_placement_footprint_init(&shsurf->placement.footprint);
+	shsurf->placement.geometry_listener.notify = placement_handle_geometry;
+	wl_signal_add(&surface->geometry_signal,
+		      &shsurf->placement.geometry_listener);
+
 	shsurf->type = SHELL_SURFACE_NONE;
 	shsurf->next_type = SHELL_SURFACE_NONE;
 
@@ -2607,7 +3111,7 @@ configure_static_surface(struct weston_surface *es, struct weston_layer *layer,
 
 	if (wl_list_empty(&es->layer_link)) {
 		wl_list_insert(&layer->surface_list, &es->layer_link);
-		weston_compositor_schedule_repaint(es->compositor);
+		weston_surface_schedule_geometry_repaint(es);
 	}
 }
 
@@ -3048,10 +3552,10 @@ rotate_grab_motion(struct weston_pointer_grab *grab, uint32_t time)
 					    surface->geometry.y + dposy);
 	}
 
-	/* Repaint implies weston_surface_update_transform(), which
-	 * lazily applies the damage due to rotation update.
+	/* Applies the damage due to rotation update on the outputs
+	 * the surface was and is now on.
 	 */
-	weston_compositor_schedule_repaint(shsurf->surface->compositor);
+	weston_surface_schedule_geometry_repaint(shsurf->surface);
 }
 
 static void
@@ -3266,6 +3770,11 @@ lock(struct desktop_shell *shell)
 
 	shell->locked = true;
 
+	if (shell->workspaces.anim_to != NULL)
+		finish_workspace_change_animation(shell,
+						  shell->workspaces.anim_from,
+						  shell->workspaces.anim_to);
+
 	/* Hide all surfaces by removing the fullscreen, panel and
 	 * toplevel layers.  This way nothing else can show or receive
 	 * input events while we are locked. */
@@ -3306,6 +3815,19 @@ unlock(struct desktop_shell *shell)
 	shell->prepare_event_sent = true;
 }
 
+/* While the fade surface sits fully black nothing below it needs to be
+ * drawn, but while it fades the surfaces below must stay up to date. */
+static void
+shell_fade_set_opaque(struct weston_surface *surface, int opaque)
+{
+	pixman_region32_fini(&surface->opaque);
+	if (opaque)
+		pixman_region32_init_rect(&surface->opaque, 0, 0, 8192, 8192);
+	else
+		pixman_region32_init(&surface->opaque);
+	weston_surface_geometry_dirty(surface);
+}
+
 static void
 shell_fade_done(struct weston_surface_animation *animation, void *data)
 {
@@ -3319,6 +3841,7 @@ shell_fade_done(struct weston_surface_animation *animation, void *data)
 		shell->fade.surface = NULL;
 		break;
 	case FADE_OUT:
+		shell_fade_set_opaque(shell->fade.surface, 1);
 		lock(shell);
 		break;
 	}
@@ -3371,6 +3894,8 @@ shell_fade(struct desktop_shell *shell, enum fade_type type)
 		weston_surface_update_transform(shell->fade.surface);
 	}
 
+	shell_fade_set_opaque(shell->fade.surface, 0);
+
 	if (shell->fade.animation)
 		weston_fade_update(shell->fade.animation, tint);
 	else
@@ -3437,6 +3962,7 @@ shell_fade_init(struct desktop_shell *shell)
 	if (!shell->fade.surface)
 		return;
 
+	shell_fade_set_opaque(shell->fade.surface, 1);
 	weston_surface_update_transform(shell->fade.surface);
 	weston_surface_damage(shell->fade.surface);
 
@@ -3553,6 +4079,7 @@ weston_surface_set_initial_position (struct weston_surface *surface,
 	int range_x, range_y;
 	int dx, dy, x, y, panel_height;
 	struct weston_output *output, *target_output = NULL;
+	struct weston_placement_map *map;
 	struct weston_seat *seat;
 
 	/* As a heuristic place the new window on the same output as the
@@ -3581,6 +4108,15 @@ weston_surface_set_initial_position (struct weston_surface *surface,
 		return;
 	}
 
+	/* Put it where it covers the fewest windows, top left first */
+	map = placement_get_map(shell, target_output);
+	if (map) {
+		weston_placement_map_place(map, surface->geometry.width,
+					   surface->geometry.height, &x, &y);
+		weston_surface_set_position(surface, x, y);
+		return;
+	}
+
 	/* Valid range within output where the surface will still be onscreen.
 	 * If this is negative it means that the surface is bigger than
 	 * output.
@@ -3616,9 +4152,15 @@ map(struct desktop_shell *shell, struct weston_surface *surface,
 	struct weston_surface *parent;
 	struct weston_seat *seat;
 	struct workspace *ws;
+	struct freeze_stats stats = { 0 };
 	int panel_height = 0;
 	int32_t surf_x, surf_y;
 
+	/* Frozen on a hidden workspace, then unmapped: it is mapped on the
+	 * current one now. */
+	if (surface->freeze.active)
+		surface_tree_set_frozen(surface, false, &stats);
+
 	surface->geometry.width = width;
 	surface->geometry.height = height;
 	weston_surface_geometry_dirty(surface);
@@ -3666,6 +4208,7 @@ map(struct desktop_shell *shell, struct weston_surface *surface,
 	default:
 		ws = get_current_workspace(shell);
 		wl_list_insert(&ws->layer.surface_list, &surface->layer_link);
+		placement_track(shsurf);
 		break;
 	}
 
@@ -3759,11 +4302,18 @@ shell_surface_configure(struct weston_surface *es, int32_t sx, int32_t sy, int32
 
 	int type_changed = 0;
 
+	shsurf->thumbnail.stale = true;
+
 	if (!weston_surface_is_mapped(es) &&
 	    !wl_list_empty(&shsurf->popup.grab_link)) {
 		remove_popup_grab(shsurf);
 	}
 
+	/* Unmapping is no geometry change, so the footprint has to be
+	 * taken out here. */
+	if (!weston_surface_is_mapped(es))
+		placement_forget(shsurf);
+
 	if (width == 0)
 		return;
 
@@ -4180,13 +4730,360 @@ bind_input_panel(struct wl_client *client,
 	wl_resource_destroy(resource);
 }
 
+#define SWITCHER_THUMBNAIL_WIDTH	240
+#define SWITCHER_THUMBNAIL_HEIGHT	180
+#define SWITCHER_SPACING		24
+
+struct switcher_thumb {
+	struct switcher *switcher;
+	struct weston_surface *window;
+	struct weston_surface *surface;
+	struct wl_listener destroy_listener;
+	struct wl_list link;
+};
+
 struct switcher {
 	struct desktop_shell *shell;
 	struct weston_surface *current;
 	struct wl_listener listener;
 	struct weston_keyboard_grab grab;
+
+	/* Thumbnail overlay in its own layer. Without one (the renderer
+	 * can't read back surfaces) the other windows get dimmed. */
+	bool overlay;
+	struct weston_layer layer;
+	struct weston_output *output;
+	struct weston_surface *backdrop;
+	struct weston_surface *highlight;
+	struct wl_list thumbs;
 };
 
+static bool
+is_switcher_candidate(struct weston_surface *surface)
+{
+	switch (get_shell_surface_type(surface)) {
+	case SHELL_SURFACE_TOPLEVEL:
+	case SHELL_SURFACE_FULLSCREEN:
+	case SHELL_SURFACE_MAXIMIZED:
+		return true;
+	default:
+		return false;
+	}
+}
+
+/* Returns a downscaled copy of the window contents. It is kept until
+ * the client attaches a new buffer, so repeated alt-tabbing doesn't
+ * read back and scale windows that did not change. */
+static pixman_image_t *
+shell_surface_get_thumbnail(struct shell_surface *shsurf)
+{
+	struct weston_surface *surface = shsurf->surface;
+	struct weston_renderer *renderer = surface->compositor->renderer;
+	struct weston_buffer *buffer = surface->buffer_ref.buffer;
+	pixman_image_t *image, *thumbnail;
+	pixman_transform_t transform;
+	int32_t width, height, thumb_width, thumb_height;
+	double scale;
+	void *pixels;
+
+	if (shsurf->thumbnail.image && !shsurf->thumbnail.stale)
+		return shsurf->thumbnail.image;
+
+	/* Read the attached buffer at its own size */
+	if (buffer) {
+		width = buffer->width;
+		height = buffer->height;
+	} else {
+		width = surface->geometry.width * surface->buffer_scale;
+		height = surface->geometry.height * surface->buffer_scale;
+	}
+	if (width <= 0 || height <= 0)
+		return NULL;
+
+	pixels = malloc(width * height * 4);
+	if (!pixels)
+		return NULL;
+
+	if (renderer->read_surface_pixels(surface, PIXMAN_a8r8g8b8, pixels,
+					  0, 0, width, height) < 0) {
+		free(pixels);
+		return NULL;
+	}
+
+	scale = fmin((double) SWITCHER_THUMBNAIL_WIDTH / width,
+		     (double) SWITCHER_THUMBNAIL_HEIGHT / height);
+	if (scale > 1.0)
+		scale = 1.0;
+	thumb_width = fmax(width * scale, 1.0);
+	thumb_height = fmax(height * scale, 1.0);
+
+	image = pixman_image_create_bits(PIXMAN_a8r8g8b8, width, height,
+					 pixels, width * 4);
+	thumbnail = pixman_image_create_bits(PIXMAN_a8r8g8b8,
+					     thumb_width, thumb_height,
+					     NULL, 0);
+	if (!image || !thumbnail) {
+		if (image)
+			pixman_image_unref(image);
+		if (thumbnail)
+			pixman_image_unref(thumbnail);
+		free(pixels);
+		return NULL;
+	}
+
+	pixman_transform_init_scale(&transform,
+				    pixman_double_to_fixed(1.0 / scale),
+				    pixman_double_to_fixed(1.0 / scale));
+	pixman_image_set_transform(image, &transform);
+	pixman_image_set_filter(image, PIXMAN_FILTER_GOOD, NULL, 0);
+	pixman_image_composite32(PIXMAN_OP_SRC, image, NULL, thumbnail,
+				 0, 0, 0, 0, 0, 0, thumb_width, thumb_height);
+	pixman_image_unref(image);
+	free(pixels);
+
+	if (shsurf->thumbnail.image)
+		pixman_image_unref(shsurf->thumbnail.image);
+	shsurf->thumbnail.image = thumbnail;
+	shsurf->thumbnail.stale = false;
+
+	return thumbnail;
+}
+
+static struct weston_surface *
+switcher_create_overlay_surface(struct switcher *switcher)
+{
+	struct weston_surface *surface;
+
+	surface = weston_surface_create(switcher->shell->compositor);
+	if (surface == NULL)
+		return NULL;
+
+	/* The overlay never takes pointer focus */
+	pixman_region32_fini(&surface->input);
+	pixman_region32_init(&surface->input);
+	wl_list_insert(switcher->layer.surface_list.prev,
+		       &surface->layer_link);
+
+	return surface;
+}
+
+/* weston_surface_destroy() only unlinks surfaces that were given an
+ * output by a repaint, so take the overlay off the layer first. */
+static void
+switcher_destroy_overlay_surface(struct weston_surface *surface)
+{
+	wl_list_remove(&surface->layer_link);
+	wl_list_init(&surface->layer_link);
+	weston_surface_destroy(surface);
+}
+
+static void
+switcher_select(struct switcher *switcher, struct switcher_thumb *thumb)
+{
+	/* Only the highlight moves, repositioning it damages its old and
+	 * new place; the windows themselves are left untouched. */
+	switcher->current = thumb->window;
+	weston_surface_configure(switcher->highlight,
+				 thumb->surface->geometry.x - 6,
+				 thumb->surface->geometry.y - 6,
+				 thumb->surface->geometry.width + 12,
+				 thumb->surface->geometry.height + 12);
+	weston_compositor_schedule_repaint(switcher->shell->compositor);
+}
+
+static void
+switcher_layout(struct switcher *switcher)
+{
+	struct weston_output *output = switcher->output;
+	struct switcher_thumb *thumb;
+	int columns, rows, count, i;
+	int cell_width, cell_height, x0, y0;
+
+	count = wl_list_length(&switcher->thumbs);
+	if (count == 0) {
+		weston_surface_configure(switcher->backdrop, 0, 0, 0, 0);
+		weston_surface_configure(switcher->highlight, 0, 0, 0, 0);
+		return;
+	}
+
+	cell_width = SWITCHER_THUMBNAIL_WIDTH + SWITCHER_SPACING;
+	cell_height = SWITCHER_THUMBNAIL_HEIGHT + SWITCHER_SPACING;
+	columns = (output->width - SWITCHER_SPACING) / cell_width;
+	if (columns < 1)
+		columns = 1;
+	if (columns > count)
+		columns = count;
+	rows = (count + columns - 1) / columns;
+
+	x0 = output->x + (output->width - columns * cell_width -
+			  SWITCHER_SPACING) / 2;
+	y0 = output->y + (output->height - rows * cell_height -
+			  SWITCHER_SPACING) / 2;
+	weston_surface_configure(switcher->backdrop, x0, y0,
+				 columns * cell_width + SWITCHER_SPACING,
+				 rows * cell_height + SWITCHER_SPACING);
+
+	i = 0;
+	wl_list_for_each(thumb, &switcher->thumbs, link) {
+		struct weston_surface *surface = thumb->surface;
+
+		weston_surface_set_position(surface,
+			x0 + SWITCHER_SPACING + (i % columns) * cell_width +
+			(SWITCHER_THUMBNAIL_WIDTH - surface->geometry.width) / 2,
+			y0 + SWITCHER_SPACING + (i / columns) * cell_height +
+			(SWITCHER_THUMBNAIL_HEIGHT - surface->geometry.height) / 2);
+		if (thumb->window == switcher->current)
+			switcher_select(switcher, thumb);
+		i++;
+	}
+}
+
+static void
+switcher_thumb_destroy(struct switcher_thumb *thumb)
+{
+	wl_list_remove(&thumb->destroy_listener.link);
+	wl_list_remove(&thumb->link);
+	switcher_destroy_overlay_surface(thumb->surface);
+	free(thumb);
+}
+
+static void
+switcher_handle_window_destroy(struct wl_listener *listener, void *data)
+{
+	struct switcher_thumb *thumb =
+		container_of(listener, struct switcher_thumb,
+			     destroy_listener);
+	struct switcher *switcher = thumb->switcher;
+	struct switcher_thumb *next = NULL;
+
+	if (switcher->current == thumb->window) {
+		if (thumb->link.next != &switcher->thumbs)
+			next = container_of(thumb->link.next,
+					    struct switcher_thumb, link);
+		else if (thumb->link.prev != &switcher->thumbs)
+			next = container_of(switcher->thumbs.next,
+					    struct switcher_thumb, link);
+		switcher->current = next ? next->window : NULL;
+	}
+
+	switcher_thumb_destroy(thumb);
+	switcher_layout(switcher);
+}
+
+static int
+switcher_create_overlay(struct switcher *switcher)
+{
+	struct desktop_shell *shell = switcher->shell;
+	struct workspace *ws = get_current_workspace(shell);
+	struct weston_surface *surface;
+	struct switcher_thumb *thumb;
+	pixman_image_t *image;
+
+	if (!shell->compositor->renderer->read_surface_pixels ||
+	    !shell->compositor->renderer->surface_set_image)
+		return -1;
+
+	weston_layer_init(&switcher->layer,
+			  &shell->compositor->cursor_layer.link);
+	switcher->overlay = true;
+	switcher->output = get_default_output(shell->compositor);
+
+	/* Everything is inserted at the bottom of the layer: thumbnails
+	 * first, then the highlight and the backdrop below them. */
+	wl_list_for_each(surface, &ws->layer.surface_list, layer_link) {
+		if (!is_switcher_candidate(surface))
+			continue;
+
+		if (wl_list_empty(&switcher->thumbs) && surface->output)
+			switcher->output = surface->output;
+
+		thumb = calloc(1, sizeof *thumb);
+		if (!thumb)
+			return -1;
+		thumb->surface = switcher_create_overlay_surface(switcher);
+		if (!thumb->surface) {
+			free(thumb);
+			return -1;
+		}
+		thumb->switcher = switcher;
+		thumb->window = surface;
+		thumb->destroy_listener.notify =
+			switcher_handle_window_destroy;
+		wl_signal_add(&surface->destroy_signal,
+			      &thumb->destroy_listener);
+		wl_list_insert(switcher->thumbs.prev, &thumb->link);
+
+		image = shell_surface_get_thumbnail(get_shell_surface(surface));
+		if (image) {
+			weston_surface_set_image(thumb->surface, image);
+			weston_surface_configure(thumb->surface, 0, 0,
+						 pixman_image_get_width(image),
+						 pixman_image_get_height(image));
+		} else {
+			weston_surface_set_color(thumb->surface,
+						 0.5, 0.5, 0.5, 1.0);
+			weston_surface_configure(thumb->surface, 0, 0,
+						 SWITCHER_THUMBNAIL_WIDTH / 2,
+						 SWITCHER_THUMBNAIL_HEIGHT / 2);
+		}
+	}
+
+	switcher->highlight = switcher_create_overlay_surface(switcher);
+	switcher->backdrop = switcher_create_overlay_surface(switcher);
+	if (!switcher->backdrop || !switcher->highlight)
+		return -1;
+	weston_surface_set_color(switcher->backdrop, 0.0, 0.0, 0.0, 0.6);
+	weston_surface_set_color(switcher->highlight, 0.3, 0.5, 0.9, 0.8);
+
+	switcher_layout(switcher);
+
+	return 0;
+}
+
+static void
+switcher_destroy_overlay(struct switcher *switcher)
+{
+	struct switcher_thumb *thumb, *next;
+
+	wl_list_for_each_safe(thumb, next, &switcher->thumbs, link)
+		switcher_thumb_destroy(thumb);
+
+	if (switcher->backdrop)
+		switcher_destroy_overlay_surface(switcher->backdrop);
+	if (switcher->highlight)
+		switcher_destroy_overlay_surface(switcher->highlight);
+	switcher->backdrop = NULL;
+	switcher->highlight = NULL;
+
+	wl_list_remove(&switcher->layer.link);
+	switcher->overlay = false;
+	weston_compositor_schedule_repaint(switcher->shell->compositor);
+}
+
+static void
+switcher_overlay_next(struct switcher *switcher)
+{
+	struct switcher_thumb *thumb, *next = NULL;
+
+	if (wl_list_empty(&switcher->thumbs))
+		return;
+
+	wl_list_for_each(thumb, &switcher->thumbs, link) {
+		if (thumb->window != switcher->current)
+			continue;
+		if (thumb->link.next != &switcher->thumbs)
+			next = container_of(thumb->link.next,
+					    struct switcher_thumb, link);
+		break;
+	}
+
+	if (next == NULL)
+		next = container_of(switcher->thumbs.next,
+				    struct switcher_thumb, link);
+
+	switcher_select(switcher, next);
+}
+
 static void
 switcher_next(struct switcher *switcher)
 {
@@ -4195,11 +5092,13 @@ switcher_next(struct switcher *switcher)
 	struct shell_surface *shsurf;
 	struct workspace *ws = get_current_workspace(switcher->shell);
 
+	if (switcher->overlay) {
+		switcher_overlay_next(switcher);
+		return;
+	}
+
 	wl_list_for_each(surface, &ws->layer.surface_list, layer_link) {
-		switch (get_shell_surface_type(surface)) {
-		case SHELL_SURFACE_TOPLEVEL:
-		case SHELL_SURFACE_FULLSCREEN:
-		case SHELL_SURFACE_MAXIMIZED:
+		if (is_switcher_candidate(surface)) {
 			if (first == NULL)
 				first = surface;
 			if (prev == switcher->current)
@@ -4208,9 +5107,6 @@ switcher_next(struct switcher *switcher)
 			surface->alpha = 0.25;
 			weston_surface_geometry_dirty(surface);
 			weston_surface_damage(surface);
-			break;
-		default:
-			break;
 		}
 
 		if (is_black_surface(surface, NULL)) {
@@ -4253,9 +5149,13 @@ switcher_destroy(struct switcher *switcher)
 	struct weston_keyboard *keyboard = switcher->grab.keyboard;
 	struct workspace *ws = get_current_workspace(switcher->shell);
 
-	wl_list_for_each(surface, &ws->layer.surface_list, layer_link) {
-		surface->alpha = 1.0;
-		weston_surface_damage(surface);
+	if (switcher->overlay) {
+		switcher_destroy_overlay(switcher);
+	} else {
+		wl_list_for_each(surface, &ws->layer.surface_list, layer_link) {
+			surface->alpha = 1.0;
+			weston_surface_damage(surface);
+		}
 	}
 
 	if (switcher->current)
@@ -4312,14 +5212,21 @@ switcher_binding(struct weston_seat *seat, uint32_t time, uint32_t key,
 	struct desktop_shell *shell = data;
 	struct switcher *switcher;
 
-	switcher = malloc(sizeof *switcher);
+	switcher = calloc(1, sizeof *switcher);
+	if (!switcher)
+		return;
 	switcher->shell = shell;
 	switcher->current = NULL;
 	switcher->listener.notify = switcher_handle_surface_destroy;
 	wl_list_init(&switcher->listener.link);
+	wl_list_init(&switcher->thumbs);
 
 	restore_all_output_modes(shell->compositor);
 	lower_fullscreen_layer(switcher->shell);
+	if (switcher_create_overlay(switcher) < 0 && switcher->overlay) {
+		weston_log("switcher: overlay failed, dimming windows\n");
+		switcher_destroy_overlay(switcher);
+	}
 	switcher->grab.interface = &switcher_grab;
 	weston_keyboard_start_grab(seat->keyboard, &switcher->grab);
 	weston_keyboard_set_focus(seat->keyboard, NULL);
@@ -4543,6 +5450,26 @@ workspace_down_binding(struct weston_seat *seat, uint32_t time,
 	change_workspace(shell, new_index);
 }
 
+/* A vertical swipe with three or more fingers moves one workspace
+ * up or down, like the Super+Up and Super+Down bindings. */
+static void
+gesture_handler(struct wl_listener *listener, void *data)
+{
+	struct desktop_shell *shell =
+		container_of(listener, struct desktop_shell, gesture_listener);
+	struct weston_gesture_event *event = data;
+
+	if (event->type != WESTON_GESTURE_SWIPE ||
+	    event->phase != WESTON_GESTURE_END ||
+	    fabs(event->total_dy) <= fabs(event->total_dx))
+		return;
+
+	if (event->total_dy < 0)
+		workspace_down_binding(event->seat, event->time, 0, shell);
+	else
+		workspace_up_binding(event->seat, event->time, 0, shell);
+}
+
 static void
 workspace_f_binding(struct weston_seat *seat, uint32_t time,
 		    uint32_t key, void *data)
@@ -4597,6 +5524,7 @@ shell_destroy(struct wl_listener *listener, void *data)
 	struct desktop_shell *shell =
 		container_of(listener, struct desktop_shell, destroy_listener);
 	struct workspace **ws;
+	struct weston_placement_map *map, *next;
 
 	if (shell->child.client)
 		wl_client_destroy(shell->child.client);
@@ -4605,11 +5533,15 @@ shell_destroy(struct wl_listener *listener, void *data)
 	wl_list_remove(&shell->wake_listener.link);
 	wl_list_remove(&shell->show_input_panel_listener.link);
 	wl_list_remove(&shell->hide_input_panel_listener.link);
+	wl_list_remove(&shell->gesture_listener.link);
 
 	wl_array_for_each(ws, &shell->workspaces.array)
 		workspace_destroy(*ws);
 	wl_array_release(&shell->workspaces.array);
 
+	wl_list_for_each_safe(map, next, &shell->placement.maps, link)
+		weston_placement_map_destroy(map);
+
 	free(shell->screensaver.path);
 	free(shell);
 }
@@ -4720,6 +5652,8 @@ module_init(struct weston_compositor *ec,
 	wl_signal_add(&ec->hide_input_panel_signal, &shell->hide_input_panel_listener);
 	shell->update_input_panel_listener.notify = update_input_panels;
 	wl_signal_add(&ec->update_input_panel_signal, &shell->update_input_panel_listener);
+	shell->gesture_listener.notify = gesture_handler;
+	wl_signal_add(&ec->gesture_signal, &shell->gesture_listener);
 	ec->ping_handler = ping_handler;
 	ec->shell_interface.shell = shell;
 	ec->shell_interface.create_shell_surface = create_shell_surface;
@@ -4756,6 +5690,10 @@ module_init(struct weston_compositor *ec,
 	activate_workspace(shell, 0);
 
 	wl_list_init(&shell->workspaces.anim_sticky_list);
+	wl_list_init(&shell->placement.maps);
+	wl_list_init(&shell->placement.dirty_list);
+	wl_list_init(&shell->workspaces.anim_snapshot_list);
+	weston_layer_init(&shell->workspaces.anim_snapshot_layer, NULL);
 	wl_list_init(&shell->workspaces.animation.link);
 	shell->workspaces.animation.frame = animate_workspace_change_frame;
 
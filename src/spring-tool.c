@@ -40,6 +40,11 @@ weston_compositor_schedule_repaint(struct weston_compositor *compositor)
 {
 }
 
+WL_EXPORT void
+weston_surface_schedule_geometry_repaint(struct weston_surface *surface)
+{
+}
+
 int
 main(int argc, char *argv[])
 {
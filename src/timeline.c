@@ -0,0 +1,520 @@
+/*
+ * Copyright © 2013 Intel Corporation
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and
+ * its documentation for any purpose is hereby granted without fee, provided
+ * that the above copyright notice appear in all copies and that both that
+ * copyright notice and this permission notice appear in supporting
+ * documentation, and that the name of the copyright holders not be used in
+ * advertising or publicity pertaining to distribution of the software
+ * without specific, written prior permission.  The copyright holders make
+ * no representations about the suitability of this software for any
+ * purpose.  It is provided "as is" without express or implied warranty.
+ *
+ * THE COPYRIGHT HOLDERS DISCLAIM ALL WARRANTIES WITH REGARD TO THIS
+ * SOFTWARE, INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS, IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * SPECIAL, INDIRECT OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER
+ * RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF
+ * CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "compositor.h"
+#include "../shared/zalloc.h"
+
+/* A timeline animates a fixed set of properties on many surfaces from
+ * keyframes.  While it is being built keyframes are appended in any
+ * order; weston_timeline_start() sorts them into one contiguous array
+ * grouped by (target, property) and describes each group with a track.
+ * Before its first keyframe a track eases in from the surface's state
+ * at start, so a single keyframe is enough for a plain transition.
+ * A frame then walks the tracks once, writes the interpolated values
+ * into a flat array and only touches the surfaces whose values changed.
+ */
+
+struct timeline_keyframe {
+	uint32_t target;
+	uint32_t property;
+	uint32_t time;
+	uint32_t seq;
+	uint32_t easing;
+	float value;
+};
+
+struct timeline_track {
+	uint32_t target;
+	uint32_t property;
+	uint32_t first;
+	uint32_t count;
+	uint32_t cursor;
+	float base;		/* value before the first keyframe */
+};
+
+struct timeline_target {
+	struct weston_timeline *timeline;
+	struct weston_surface *surface;
+	struct weston_transform transform;
+	struct wl_listener destroy_listener;
+	uint32_t properties;	/* mask of animated properties */
+};
+
+struct weston_timeline {
+	struct weston_compositor *compositor;
+	struct weston_animation animation;
+	struct wl_array targets;	/* struct timeline_target * */
+	struct wl_array keyframes;	/* struct timeline_keyframe */
+	struct wl_array tracks;		/* struct timeline_track */
+	struct wl_array values;		/* float, per target and property */
+	struct wl_array dirty;		/* uint8_t, per target */
+	uint32_t num_targets;
+	uint32_t num_keyframes;
+	uint32_t num_tracks;
+	uint32_t duration;
+	uint32_t start;
+	uint32_t seq;
+	int running;
+	weston_timeline_done_func_t done;
+	void *data;
+};
+
+#define GEOMETRY_PROPERTIES					\
+	((1 << WESTON_TIMELINE_TRANSLATE_X) |			\
+	 (1 << WESTON_TIMELINE_TRANSLATE_Y) |			\
+	 (1 << WESTON_TIMELINE_SCALE) |				\
+	 (1 << WESTON_TIMELINE_ROTATION))
+
+static const float property_defaults[WESTON_TIMELINE_NUM_PROPERTIES] = {
+	[WESTON_TIMELINE_ALPHA] = 1.0f,
+	[WESTON_TIMELINE_TRANSLATE_X] = 0.0f,
+	[WESTON_TIMELINE_TRANSLATE_Y] = 0.0f,
+	[WESTON_TIMELINE_SCALE] = 1.0f,
+	[WESTON_TIMELINE_ROTATION] = 0.0f,
+};
+
+static inline float *
+timeline_values(struct weston_timeline *timeline, uint32_t target)
+{
+	float *values = timeline->values.data;
+
+	return &values[target * WESTON_TIMELINE_NUM_PROPERTIES];
+}
+
+static inline struct timeline_target *
+timeline_target(struct weston_timeline *timeline, uint32_t target)
+{
+	struct timeline_target **targets = timeline->targets.data;
+
+	return targets[target];
+}
+
+static void
+timeline_target_unlink(struct timeline_target *target)
+{
+	wl_list_remove(&target->destroy_listener.link);
+	wl_list_remove(&target->transform.link);
+	wl_list_init(&target->transform.link);
+	weston_surface_geometry_dirty(target->surface);
+	target->surface = NULL;
+}
+
+static void
+handle_target_surface_destroy(struct wl_listener *listener, void *data)
+{
+	struct timeline_target *target =
+		container_of(listener, struct timeline_target,
+			     destroy_listener);
+
+	timeline_target_unlink(target);
+}
+
+static int
+timeline_find_target(struct weston_timeline *timeline,
+		     struct weston_surface *surface)
+{
+	struct timeline_target *target, **p;
+	float *values;
+	uint32_t i;
+
+	for (i = 0; i < timeline->num_targets; i++)
+		if (timeline_target(timeline, i)->surface == surface)
+			return i;
+
+	target = zalloc(sizeof *target);
+	if (!target)
+		return -1;
+
+	/* The arrays are indexed in parallel, so undo the adds that
+	 * succeeded if a later one fails. */
+	p = wl_array_add(&timeline->targets, sizeof *p);
+	if (!p)
+		goto err_target;
+	values = wl_array_add(&timeline->values,
+			      sizeof property_defaults);
+	if (!values)
+		goto err_targets;
+	if (!wl_array_add(&timeline->dirty, 1))
+		goto err_values;
+
+	target->timeline = timeline;
+	target->surface = surface;
+	wl_list_init(&target->transform.link);
+	target->destroy_listener.notify = handle_target_surface_destroy;
+	wl_signal_add(&surface->destroy_signal, &target->destroy_listener);
+
+	memcpy(values, property_defaults, sizeof property_defaults);
+	values[WESTON_TIMELINE_ALPHA] = surface->alpha;
+	*p = target;
+
+	return timeline->num_targets++;
+
+err_values:
+	timeline->values.size -= sizeof property_defaults;
+err_targets:
+	timeline->targets.size -= sizeof *p;
+err_target:
+	free(target);
+	return -1;
+}
+
+WL_EXPORT struct weston_timeline *
+weston_timeline_create(struct weston_compositor *compositor)
+{
+	struct weston_timeline *timeline;
+
+	timeline = zalloc(sizeof *timeline);
+	if (!timeline)
+		return NULL;
+
+	timeline->compositor = compositor;
+	wl_list_init(&timeline->animation.link);
+	wl_array_init(&timeline->targets);
+	wl_array_init(&timeline->keyframes);
+	wl_array_init(&timeline->tracks);
+	wl_array_init(&timeline->values);
+	wl_array_init(&timeline->dirty);
+
+	return timeline;
+}
+
+WL_EXPORT void
+weston_timeline_destroy(struct weston_timeline *timeline)
+{
+	struct timeline_target *target;
+	struct weston_surface *surface;
+	uint32_t i;
+
+	wl_list_remove(&timeline->animation.link);
+
+	for (i = 0; i < timeline->num_targets; i++) {
+		target = timeline_target(timeline, i);
+		surface = target->surface;
+		if (surface) {
+			timeline_target_unlink(target);
+			weston_surface_schedule_geometry_repaint(surface);
+		}
+		free(target);
+	}
+
+	wl_array_release(&timeline->targets);
+	wl_array_release(&timeline->keyframes);
+	wl_array_release(&timeline->tracks);
+	wl_array_release(&timeline->values);
+	wl_array_release(&timeline->dirty);
+	free(timeline);
+}
+
+WL_EXPORT int
+weston_timeline_add_keyframe(struct weston_timeline *timeline,
+			     struct weston_surface *surface,
+			     enum weston_timeline_property property,
+			     uint32_t time, float value,
+			     enum weston_timeline_easing easing)
+{
+	struct timeline_keyframe *keyframe;
+	int target;
+
+	if (timeline->running || property >= WESTON_TIMELINE_NUM_PROPERTIES)
+		return -1;
+
+	target = timeline_find_target(timeline, surface);
+	if (target < 0)
+		return -1;
+
+	keyframe = wl_array_add(&timeline->keyframes, sizeof *keyframe);
+	if (!keyframe)
+		return -1;
+
+	keyframe->target = target;
+	keyframe->property = property;
+	keyframe->time = time;
+	keyframe->seq = timeline->seq++;
+	keyframe->easing = easing;
+	keyframe->value = value;
+	timeline->num_keyframes++;
+
+	timeline_target(timeline, target)->properties |= 1 << property;
+	if (time > timeline->duration)
+		timeline->duration = time;
+
+	return 0;
+}
+
+static int
+compare_keyframes(const void *a, const void *b)
+{
+	const struct timeline_keyframe *ka = a, *kb = b;
+
+	if (ka->target != kb->target)
+		return ka->target < kb->target ? -1 : 1;
+	if (ka->property != kb->property)
+		return ka->property < kb->property ? -1 : 1;
+	if (ka->time != kb->time)
+		return ka->time < kb->time ? -1 : 1;
+
+	return ka->seq < kb->seq ? -1 : 1;
+}
+
+static int
+timeline_build_tracks(struct weston_timeline *timeline)
+{
+	struct timeline_keyframe *keyframes = timeline->keyframes.data;
+	struct timeline_track *track = NULL;
+	struct timeline_target *target;
+	uint32_t i;
+
+	qsort(keyframes, timeline->num_keyframes, sizeof *keyframes,
+	      compare_keyframes);
+
+	timeline->tracks.size = 0;
+	timeline->num_tracks = 0;
+	for (i = 0; i < timeline->num_keyframes; i++) {
+		if (track && track->target == keyframes[i].target &&
+		    track->property == keyframes[i].property) {
+			track->count++;
+			continue;
+		}
+
+		track = wl_array_add(&timeline->tracks, sizeof *track);
+		if (!track)
+			return -1;
+		track->target = keyframes[i].target;
+		track->property = keyframes[i].property;
+		track->first = i;
+		track->count = 1;
+		track->cursor = 0;
+		target = timeline_target(timeline, track->target);
+		if (track->property == WESTON_TIMELINE_ALPHA &&
+		    target->surface)
+			track->base = target->surface->alpha;
+		else
+			track->base = property_defaults[track->property];
+		timeline->num_tracks++;
+	}
+
+	return 0;
+}
+
+static float
+ease(uint32_t easing, float t)
+{
+	switch (easing) {
+	case WESTON_TIMELINE_EASE_IN:
+		return t * t;
+	case WESTON_TIMELINE_EASE_OUT:
+		return t * (2.0f - t);
+	case WESTON_TIMELINE_EASE_IN_OUT:
+		return t * t * (3.0f - 2.0f * t);
+	case WESTON_TIMELINE_LINEAR:
+	default:
+		return t;
+	}
+}
+
+static float
+timeline_track_value(struct timeline_track *track,
+		     const struct timeline_keyframe *keyframes, uint32_t time)
+{
+	const struct timeline_keyframe *k = &keyframes[track->first];
+	const struct timeline_keyframe *a, *b;
+	float t;
+
+	if (time < k[0].time) {
+		t = (float) time / k[0].time;
+		return track->base +
+			(k[0].value - track->base) * ease(k[0].easing, t);
+	}
+
+	/* Time only moves backwards on a seek */
+	if (time < k[track->cursor].time)
+		track->cursor = 0;
+	while (track->cursor + 1 < track->count &&
+	       k[track->cursor + 1].time <= time)
+		track->cursor++;
+
+	a = &k[track->cursor];
+	if (time <= a->time || track->cursor + 1 == track->count)
+		return a->value;
+
+	b = a + 1;
+	t = (float) (time - a->time) / (b->time - a->time);
+
+	return a->value + (b->value - a->value) * ease(b->easing, t);
+}
+
+static void
+timeline_target_apply(struct timeline_target *target, const float *values)
+{
+	struct weston_surface *surface = target->surface;
+	struct weston_matrix *matrix = &target->transform.matrix;
+	float cx, cy, scale, angle;
+
+	if (target->properties & (1 << WESTON_TIMELINE_ALPHA)) {
+		surface->alpha = values[WESTON_TIMELINE_ALPHA];
+		if (surface->alpha < 0.0f)
+			surface->alpha = 0.0f;
+		else if (surface->alpha > 1.0f)
+			surface->alpha = 1.0f;
+	}
+
+	if (target->properties & GEOMETRY_PROPERTIES) {
+		cx = 0.5f * surface->geometry.width;
+		cy = 0.5f * surface->geometry.height;
+		scale = values[WESTON_TIMELINE_SCALE];
+		angle = values[WESTON_TIMELINE_ROTATION];
+
+		weston_matrix_init(matrix);
+		weston_matrix_translate(matrix, -cx, -cy, 0);
+		weston_matrix_scale(matrix, scale, scale, 1);
+		if (angle != 0.0f)
+			weston_matrix_rotate_xy(matrix, cosf(angle),
+						sinf(angle));
+		weston_matrix_translate(matrix,
+					cx + values[WESTON_TIMELINE_TRANSLATE_X],
+					cy + values[WESTON_TIMELINE_TRANSLATE_Y],
+					0);
+
+		if (wl_list_empty(&target->transform.link))
+			wl_list_insert(&surface->geometry.transformation_list,
+				       &target->transform.link);
+	}
+
+	weston_surface_geometry_dirty(surface);
+	weston_surface_schedule_geometry_repaint(surface);
+}
+
+static void
+timeline_evaluate(struct weston_timeline *timeline, uint32_t time, int force)
+{
+	const struct timeline_keyframe *keyframes = timeline->keyframes.data;
+	struct timeline_track *tracks = timeline->tracks.data;
+	struct timeline_target *target;
+	uint8_t *dirty = timeline->dirty.data;
+	float *values, v;
+	uint32_t i;
+
+	memset(dirty, force, timeline->num_targets);
+
+	for (i = 0; i < timeline->num_tracks; i++) {
+		v = timeline_track_value(&tracks[i], keyframes, time);
+		values = timeline_values(timeline, tracks[i].target);
+		if (values[tracks[i].property] != v) {
+			values[tracks[i].property] = v;
+			dirty[tracks[i].target] = 1;
+		}
+	}
+
+	for (i = 0; i < timeline->num_targets; i++) {
+		target = timeline_target(timeline, i);
+		if (dirty[i] && target->surface)
+			timeline_target_apply(target,
+					      timeline_values(timeline, i));
+	}
+}
+
+static void
+timeline_frame(struct weston_animation *animation,
+	       struct weston_output *output, uint32_t msecs)
+{
+	struct weston_timeline *timeline =
+		container_of(animation, struct weston_timeline, animation);
+	uint32_t time;
+
+	if (animation->frame_counter <= 1)
+		timeline->start = msecs;
+
+	time = msecs - timeline->start;
+	if (time > timeline->duration)
+		time = timeline->duration;
+
+	timeline_evaluate(timeline, time, 0);
+
+	if (time == timeline->duration) {
+		wl_list_remove(&animation->link);
+		wl_list_init(&animation->link);
+		timeline->running = 0;
+		if (timeline->done)
+			timeline->done(timeline, timeline->data);
+	}
+}
+
+/* Runs the timeline on the frame clock of output, or of the first
+ * target's output when NULL.  done is called once the last keyframe is
+ * reached; the surfaces keep their final state until the timeline is
+ * destroyed, which may be done from the callback. */
+WL_EXPORT int
+weston_timeline_start(struct weston_timeline *timeline,
+		      struct weston_output *output,
+		      weston_timeline_done_func_t done, void *data)
+{
+	struct weston_compositor *compositor = timeline->compositor;
+
+	if (timeline->running || timeline_build_tracks(timeline) < 0)
+		return -1;
+
+	if (!output && timeline->num_targets > 0 &&
+	    timeline_target(timeline, 0)->surface)
+		output = timeline_target(timeline, 0)->surface->output;
+	if (!output && !wl_list_empty(&compositor->output_list))
+		output = container_of(compositor->output_list.next,
+				      struct weston_output, link);
+
+	/* Apply the first keyframes right away, so the surfaces don't
+	 * show their untransformed state until the next frame. */
+	timeline_evaluate(timeline, 0, 1);
+
+	timeline->done = done;
+	timeline->data = data;
+	timeline->running = 1;
+	timeline->animation.frame = timeline_frame;
+	timeline->animation.frame_counter = 0;
+	wl_list_remove(&timeline->animation.link);
+	if (output)
+		wl_list_insert(&output->animation_list,
+			       &timeline->animation.link);
+	else
+		wl_list_init(&timeline->animation.link);
+
+	return 0;
+}
+
+WL_EXPORT void
+weston_timeline_seek(struct weston_timeline *timeline, uint32_t time)
+{
+	if (time > timeline->duration)
+		time = timeline->duration;
+
+	timeline_evaluate(timeline, time, 0);
+}
+
+WL_EXPORT uint32_t
+weston_timeline_get_duration(struct weston_timeline *timeline)
+{
+	return timeline->duration;
+}
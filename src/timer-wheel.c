@@ -0,0 +1,236 @@
+/*
+ * Copyright © 2013 Intel Corporation
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and
+ * its documentation for any purpose is hereby granted without fee, provided
+ * that the above copyright notice appear in all copies and that both that
+ * copyright notice and this permission notice appear in supporting
+ * documentation, and that the name of the copyright holders not be used in
+ * advertising or publicity pertaining to distribution of the software
+ * without specific, written prior permission.  The copyright holders make
+ * no representations about the suitability of this software for any
+ * purpose.  It is provided "as is" without express or implied warranty.
+ *
+ * THE COPYRIGHT HOLDERS DISCLAIM ALL WARRANTIES WITH REGARD TO THIS
+ * SOFTWARE, INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS, IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * SPECIAL, INDIRECT OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER
+ * RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF
+ * CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <stdlib.h>
+#include <sys/time.h>
+
+#include "timer-wheel.h"
+
+static uint32_t
+timer_wheel_get_time(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+
+	return tv.tv_sec * 1000 + tv.tv_usec / 1000;
+}
+
+static inline int
+tick_before_or_at(uint32_t a, uint32_t b)
+{
+	return (int32_t) (a - b) <= 0;
+}
+
+static void
+timer_wheel_arm(struct weston_timer_wheel *wheel, uint32_t time)
+{
+	struct weston_timer *timer;
+	uint32_t next = 0;
+	int32_t delay;
+	int i, found = 0;
+
+	if (wheel->source == NULL)
+		return;
+
+	if (wheel->count == 0) {
+		wl_event_source_timer_update(wheel->source, 0);
+		return;
+	}
+
+	/* Only a handful of timers are pending at any time, so
+	 * looking at all of them is cheaper than keeping them sorted. */
+	for (i = 0; i < WESTON_TIMER_WHEEL_SLOTS; i++) {
+		wl_list_for_each(timer, &wheel->slots[i], link) {
+			if (!found || tick_before_or_at(timer->expire, next)) {
+				next = timer->expire;
+				found = 1;
+			}
+		}
+	}
+
+	delay = (next - wheel->current) * wheel->tick_ms -
+		(time - wheel->current_time);
+	if (delay < 1)
+		delay = 1;
+
+	wl_event_source_timer_update(wheel->source, delay);
+}
+
+static int
+timer_wheel_handler(void *data)
+{
+	struct weston_timer_wheel *wheel = data;
+
+	weston_timer_wheel_expire(wheel, timer_wheel_get_time());
+
+	return 1;
+}
+
+WL_EXPORT struct weston_timer_wheel *
+weston_timer_wheel_create(struct wl_event_loop *loop, uint32_t tick_ms)
+{
+	struct weston_timer_wheel *wheel;
+	int i;
+
+	wheel = malloc(sizeof *wheel);
+	if (wheel == NULL)
+		return NULL;
+
+	for (i = 0; i < WESTON_TIMER_WHEEL_SLOTS; i++)
+		wl_list_init(&wheel->slots[i]);
+	wheel->tick_ms = tick_ms > 0 ? tick_ms : 1;
+	wheel->current = 0;
+	wheel->current_time = timer_wheel_get_time();
+	wheel->count = 0;
+	wheel->source = NULL;
+
+	if (loop) {
+		wheel->source = wl_event_loop_add_timer(loop,
+							timer_wheel_handler,
+							wheel);
+		if (wheel->source == NULL) {
+			free(wheel);
+			return NULL;
+		}
+	}
+
+	return wheel;
+}
+
+/* All timers must have been cancelled by their owners. */
+WL_EXPORT void
+weston_timer_wheel_destroy(struct weston_timer_wheel *wheel)
+{
+	if (wheel->source)
+		wl_event_source_remove(wheel->source);
+	free(wheel);
+}
+
+WL_EXPORT void
+weston_timer_init(struct weston_timer *timer, weston_timer_func_t func)
+{
+	wl_list_init(&timer->link);
+	timer->expire = 0;
+	timer->func = func;
+}
+
+WL_EXPORT int
+weston_timer_pending(struct weston_timer *timer)
+{
+	return !wl_list_empty(&timer->link);
+}
+
+WL_EXPORT void
+weston_timer_cancel(struct weston_timer_wheel *wheel,
+		    struct weston_timer *timer)
+{
+	if (!weston_timer_pending(timer))
+		return;
+
+	wl_list_remove(&timer->link);
+	wl_list_init(&timer->link);
+	wheel->count--;
+}
+
+WL_EXPORT void
+weston_timer_schedule(struct weston_timer_wheel *wheel,
+		      struct weston_timer *timer,
+		      uint32_t time, uint32_t timeout)
+{
+	uint32_t expire;
+	int32_t delta;
+
+	weston_timer_cancel(wheel, timer);
+
+	if (wheel->count == 0)
+		wheel->current_time = time;
+
+	/* Round up, a timer never fires early */
+	delta = time + timeout - wheel->current_time;
+	if (delta <= 0)
+		expire = wheel->current + 1;
+	else
+		expire = wheel->current +
+			((uint32_t) delta + wheel->tick_ms - 1) / wheel->tick_ms;
+
+	timer->expire = expire;
+	wl_list_insert(wheel->slots[expire % WESTON_TIMER_WHEEL_SLOTS].prev,
+		       &timer->link);
+	wheel->count++;
+
+	timer_wheel_arm(wheel, time);
+}
+
+/*
+ * Runs the callbacks of all timers due at the given time.  Due timers
+ * are moved to a private list first, so callbacks may schedule or
+ * cancel any timer, including ones that are about to fire.
+ */
+WL_EXPORT void
+weston_timer_wheel_expire(struct weston_timer_wheel *wheel, uint32_t time)
+{
+	struct weston_timer *timer, *next;
+	struct wl_list expired;
+	int32_t elapsed = time - wheel->current_time;
+	uint32_t now, tick, ticks;
+	struct wl_list *slot;
+
+	if (wheel->count == 0) {
+		wheel->current_time = time;
+		timer_wheel_arm(wheel, time);
+		return;
+	}
+
+	wl_list_init(&expired);
+
+	/* Time going backwards expires nothing */
+	ticks = elapsed > 0 ? (uint32_t) elapsed / wheel->tick_ms : 0;
+	now = wheel->current + ticks;
+	if (ticks > WESTON_TIMER_WHEEL_SLOTS)
+		ticks = WESTON_TIMER_WHEEL_SLOTS;
+
+	for (tick = 1; tick <= ticks; tick++) {
+		slot = &wheel->slots[(wheel->current + tick) %
+				     WESTON_TIMER_WHEEL_SLOTS];
+		wl_list_for_each_safe(timer, next, slot, link) {
+			if (!tick_before_or_at(timer->expire, now))
+				continue;
+			wl_list_remove(&timer->link);
+			wl_list_insert(expired.prev, &timer->link);
+		}
+	}
+	wheel->current_time += (now - wheel->current) * wheel->tick_ms;
+	wheel->current = now;
+
+	while (!wl_list_empty(&expired)) {
+		timer = wl_container_of(expired.next, timer, link);
+		wl_list_remove(&timer->link);
+		wl_list_init(&timer->link);
+		wheel->count--;
+		timer->func(timer, time);
+	}
+
+	timer_wheel_arm(wheel, time);
+}
@@ -0,0 +1,87 @@
+/*
+ * Copyright © 2013 Intel Corporation
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and
+ * its documentation for any purpose is hereby granted without fee, provided
+ * that the above copyright notice appear in all copies and that both that
+ * copyright notice and this permission notice appear in supporting
+ * documentation, and that the name of the copyright holders not be used in
+ * advertising or publicity pertaining to distribution of the software
+ * without specific, written prior permission.  The copyright holders make
+ * no representations about the suitability of this software for any
+ * purpose.  It is provided "as is" without express or implied warranty.
+ *
+ * THE COPYRIGHT HOLDERS DISCLAIM ALL WARRANTIES WITH REGARD TO THIS
+ * SOFTWARE, INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS, IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * SPECIAL, INDIRECT OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER
+ * RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF
+ * CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef _TIMER_WHEEL_H_
+#define _TIMER_WHEEL_H_
+
+#include <stdint.h>
+
+#include <wayland-server.h>
+
+#define WESTON_TIMER_WHEEL_SLOTS 64
+
+struct weston_timer;
+
+typedef void (*weston_timer_func_t)(struct weston_timer *timer,
+				    uint32_t time);
+
+/* A timer is embedded in its owner and may be rescheduled or
+ * cancelled at any time, also from its own callback. */
+struct weston_timer {
+	struct wl_list link;
+	uint32_t expire;	/* tick */
+	weston_timer_func_t func;
+};
+
+/*
+ * Hashed timer wheel for short input timeouts (tap, gesture and
+ * repeat timers).  Timers are rounded up to whole ticks and all of
+ * them share one wl_event_loop timer, which is only armed for the
+ * earliest pending timer.
+ *
+ * Ticks are counted rather than derived from the time, and times
+ * are only ever subtracted from each other, so both may wrap around.
+ */
+struct weston_timer_wheel {
+	struct wl_list slots[WESTON_TIMER_WHEEL_SLOTS];
+	uint32_t tick_ms;
+	uint32_t current;	/* last expired tick */
+	uint32_t current_time;	/* time at which current started, in ms */
+	int count;
+	struct wl_event_source *source;
+};
+
+struct weston_timer_wheel *
+weston_timer_wheel_create(struct wl_event_loop *loop, uint32_t tick_ms);
+
+void
+weston_timer_wheel_destroy(struct weston_timer_wheel *wheel);
+
+void
+weston_timer_init(struct weston_timer *timer, weston_timer_func_t func);
+
+void
+weston_timer_schedule(struct weston_timer_wheel *wheel,
+		      struct weston_timer *timer,
+		      uint32_t time, uint32_t timeout);
+
+void
+weston_timer_cancel(struct weston_timer_wheel *wheel,
+		    struct weston_timer *timer);
+
+int
+weston_timer_pending(struct weston_timer *timer);
+
+void
+weston_timer_wheel_expire(struct weston_timer_wheel *wheel, uint32_t time);
+
+#endif
@@ -0,0 +1,239 @@
+/*
+ * Copyright © 2013 Intel Corporation
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and
+ * its documentation for any purpose is hereby granted without fee, provided
+ * that the above copyright notice appear in all copies and that both that
+ * copyright notice and this permission notice appear in supporting
+ * documentation, and that the name of the copyright holders not be used in
+ * advertising or publicity pertaining to distribution of the software
+ * without specific, written prior permission.  The copyright holders make
+ * no representations about the suitability of this software for any
+ * purpose.  It is provided "as is" without express or implied warranty.
+ *
+ * THE COPYRIGHT HOLDERS DISCLAIM ALL WARRANTIES WITH REGARD TO THIS
+ * SOFTWARE, INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS, IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * SPECIAL, INDIRECT OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER
+ * RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF
+ * CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "window-placement.h"
+
+struct weston_placement_map *
+weston_placement_map_create(int32_t x, int32_t y,
+			    int32_t width, int32_t height, int32_t cell)
+{
+	struct weston_placement_map *map;
+
+	if (width <= 0 || height <= 0 || cell <= 0)
+		return NULL;
+
+	map = malloc(sizeof *map);
+	if (map == NULL)
+		return NULL;
+
+	map->x = x;
+	map->y = y;
+	map->width = width;
+	map->height = height;
+	map->cell = cell;
+	map->grid_width = (width + cell - 1) / cell;
+	map->grid_height = (height + cell - 1) / cell;
+	map->coverage = calloc(map->grid_width * map->grid_height,
+			       sizeof *map->coverage);
+	map->sums = malloc((map->grid_width + 1) * (map->grid_height + 1) *
+			   sizeof *map->sums);
+	wl_list_init(&map->link);
+
+	if (map->coverage == NULL || map->sums == NULL) {
+		weston_placement_map_destroy(map);
+		return NULL;
+	}
+
+	return map;
+}
+
+void
+weston_placement_map_destroy(struct weston_placement_map *map)
+{
+	wl_list_remove(&map->link);
+	free(map->coverage);
+	free(map->sums);
+	free(map);
+}
+
+int
+weston_placement_map_matches(struct weston_placement_map *map,
+			     int32_t x, int32_t y,
+			     int32_t width, int32_t height)
+{
+	return map->x == x && map->y == y &&
+		map->width == width && map->height == height;
+}
+
+void
+weston_placement_map_clear(struct weston_placement_map *map)
+{
+	memset(map->coverage, 0,
+	       map->grid_width * map->grid_height * sizeof *map->coverage);
+}
+
+/* Every cell the box touches counts as covered, so windows placed on
+ * cell boundaries next to it never overlap it. */
+static void
+placement_map_update(struct weston_placement_map *map,
+		     const pixman_box32_t *box, int delta)
+{
+	int32_t x1, y1, x2, y2, i, j;
+	uint16_t *row;
+
+	x1 = box->x1 - map->x;
+	y1 = box->y1 - map->y;
+	x2 = box->x2 - map->x;
+	y2 = box->y2 - map->y;
+
+	if (x1 < 0)
+		x1 = 0;
+	if (y1 < 0)
+		y1 = 0;
+	if (x2 > map->width)
+		x2 = map->width;
+	if (y2 > map->height)
+		y2 = map->height;
+	if (x1 >= x2 || y1 >= y2)
+		return;
+
+	x1 /= map->cell;
+	y1 /= map->cell;
+	x2 = (x2 + map->cell - 1) / map->cell;
+	y2 = (y2 + map->cell - 1) / map->cell;
+
+	for (j = y1; j < y2; j++) {
+		row = map->coverage + j * map->grid_width;
+		for (i = x1; i < x2; i++)
+			if (delta > 0 || row[i] > 0)
+				row[i] += delta;
+	}
+}
+
+void
+weston_placement_map_add(struct weston_placement_map *map,
+			 const pixman_box32_t *box)
+{
+	placement_map_update(map, box, 1);
+}
+
+void
+weston_placement_map_remove(struct weston_placement_map *map,
+			    const pixman_box32_t *box)
+{
+	placement_map_update(map, box, -1);
+}
+
+static void
+placement_map_sum(struct weston_placement_map *map)
+{
+	int32_t stride = map->grid_width + 1;
+	uint32_t *sum = map->sums;
+	uint16_t *row;
+	uint32_t acc;
+	int32_t i, j;
+
+	memset(sum, 0, stride * sizeof *sum);
+	for (j = 0; j < map->grid_height; j++) {
+		row = map->coverage + j * map->grid_width;
+		sum += stride;
+		sum[0] = 0;
+		acc = 0;
+		for (i = 0; i < map->grid_width; i++) {
+			acc += row[i];
+			sum[i + 1] = sum[i + 1 - stride] + acc;
+		}
+	}
+}
+
+/* Find the cell aligned position for a width x height window that
+ * overlaps the fewest windows, preferring top then left on ties, and
+ * return its cost in covered cells. Windows too big for the map are
+ * placed at its origin along that axis.
+ */
+uint32_t
+weston_placement_map_place(struct weston_placement_map *map,
+			   int32_t width, int32_t height,
+			   int32_t *x, int32_t *y)
+{
+	int32_t stride = map->grid_width + 1;
+	int32_t cw, ch, max_cx, max_cy, cx, cy, ex, ey;
+	uint32_t *top, *bottom, cost, best = UINT32_MAX;
+	int32_t best_cx = 0, best_cy = 0;
+
+	cw = (width + map->cell - 1) / map->cell;
+	ch = (height + map->cell - 1) / map->cell;
+	max_cx = width < map->width ? (map->width - width) / map->cell : 0;
+	max_cy = height < map->height ? (map->height - height) / map->cell : 0;
+
+	placement_map_sum(map);
+
+	for (cy = 0; cy <= max_cy && best > 0; cy++) {
+		ey = cy + ch;
+		if (ey > map->grid_height)
+			ey = map->grid_height;
+		top = map->sums + cy * stride;
+		bottom = map->sums + ey * stride;
+
+		for (cx = 0; cx <= max_cx; cx++) {
+			ex = cx + cw;
+			if (ex > map->grid_width)
+				ex = map->grid_width;
+
+			cost = bottom[ex] - bottom[cx] - top[ex] + top[cx];
+			if (cost < best) {
+				best = cost;
+				best_cx = cx;
+				best_cy = cy;
+				if (cost == 0)
+					break;
+			}
+		}
+	}
+
+	*x = map->x + best_cx * map->cell;
+	*y = map->y + best_cy * map->cell;
+
+	return best;
+}
+
+void
+weston_placement_footprint_init(struct weston_placement_footprint *footprint)
+{
+	footprint->accounted = 0;
+}
+
+/* Moves the footprint to box in all maps, or takes it out of them if
+ * box is NULL. */
+void
+weston_placement_footprint_update(struct wl_list *maps,
+				  struct weston_placement_footprint *footprint,
+				  const pixman_box32_t *box)
+{
+	struct weston_placement_map *map;
+
+	wl_list_for_each(map, maps, link) {
+		if (footprint->accounted)
+			weston_placement_map_remove(map, &footprint->box);
+		if (box)
+			weston_placement_map_add(map, box);
+	}
+
+	footprint->accounted = box != NULL;
+	if (box)
+		footprint->box = *box;
+}
@@ -0,0 +1,89 @@
+/*
+ * Copyright © 2013 Intel Corporation
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and
+ * its documentation for any purpose is hereby granted without fee, provided
+ * that the above copyright notice appear in all copies and that both that
+ * copyright notice and this permission notice appear in supporting
+ * documentation, and that the name of the copyright holders not be used in
+ * advertising or publicity pertaining to distribution of the software
+ * without specific, written prior permission.  The copyright holders make
+ * no representations about the suitability of this software for any
+ * purpose.  It is provided "as is" without express or implied warranty.
+ *
+ * THE COPYRIGHT HOLDERS DISCLAIM ALL WARRANTIES WITH REGARD TO THIS
+ * SOFTWARE, INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS, IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * SPECIAL, INDIRECT OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER
+ * RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF
+ * CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef _WINDOW_PLACEMENT_H_
+#define _WINDOW_PLACEMENT_H_
+
+#include <stdint.h>
+
+#include <pixman.h>
+#include <wayland-util.h>
+
+/*
+ * Free-space map of one output for placing new windows. The output is
+ * split into square cells, each counting the windows that cover it.
+ * Placing a window evaluates every cell-aligned position through a
+ * summed-area table of those counts, so the cost depends on the output
+ * size and not on the number of windows mapped.
+ */
+struct weston_placement_map {
+	struct wl_list link;
+	int32_t x, y, width, height;
+	int32_t cell;
+	int32_t grid_width, grid_height;
+	uint16_t *coverage;
+	uint32_t *sums;
+};
+
+struct weston_placement_map *
+weston_placement_map_create(int32_t x, int32_t y,
+			    int32_t width, int32_t height, int32_t cell);
+
+void
+weston_placement_map_destroy(struct weston_placement_map *map);
+
+int
+weston_placement_map_matches(struct weston_placement_map *map,
+			     int32_t x, int32_t y,
+			     int32_t width, int32_t height);
+
+void
+weston_placement_map_clear(struct weston_placement_map *map);
+
+void
+weston_placement_map_add(struct weston_placement_map *map,
+			 const pixman_box32_t *box);
+
+void
+weston_placement_map_remove(struct weston_placement_map *map,
+			    const pixman_box32_t *box);
+
+uint32_t
+weston_placement_map_place(struct weston_placement_map *map,
+			   int32_t width, int32_t height,
+			   int32_t *x, int32_t *y);
+
+/* The box a window covers in a list of maps, if it is in them */
+struct weston_placement_footprint {
+	pixman_box32_t box;
+	int accounted;
+};
+
+void
+weston_placement_footprint_init(struct weston_placement_footprint *footprint);
+
+void
+weston_placement_footprint_update(struct wl_list *maps,
+				  struct weston_placement_footprint *footprint,
+				  const pixman_box32_t *box);
+
+#endif
@@ -388,10 +388,12 @@ weston_output_init_zoom(struct weston_output *output)
 	output->zoom.type = ZOOM_FOCUS_POINTER;
 	weston_spring_init(&output->zoom.spring_z, 250.0, 0.0, 0.0);
 	output->zoom.spring_z.friction = 1000;
+	output->zoom.spring_z.solver = output->compositor->spring_solver;
 	output->zoom.animation_z.frame = weston_zoom_frame_z;
 	wl_list_init(&output->zoom.animation_z.link);
 	weston_spring_init(&output->zoom.spring_xy, 250.0, 0.0, 0.0);
 	output->zoom.spring_xy.friction = 1000;
+	output->zoom.spring_xy.solver = output->compositor->spring_solver;
 	output->zoom.animation_xy.frame = weston_zoom_frame_xy;
 	wl_list_init(&output->zoom.animation_xy.link);
 }
@@ -0,0 +1,235 @@
+/*
+ * Copyright © 2013 Intel Corporation
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and
+ * its documentation for any purpose is hereby granted without fee, provided
+ * that the above copyright notice appear in all copies and that both that
+ * copyright notice and this permission notice appear in supporting
+ * documentation, and that the name of the copyright holders not be used in
+ * advertising or publicity pertaining to distribution of the software
+ * without specific, written prior permission.  The copyright holders make
+ * no representations about the suitability of this software for any
+ * purpose.  It is provided "as is" without express or implied warranty.
+ *
+ * THE COPYRIGHT HOLDERS DISCLAIM ALL WARRANTIES WITH REGARD TO THIS
+ * SOFTWARE, INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS, IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * SPECIAL, INDIRECT OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER
+ * RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF
+ * CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <unistd.h>
+#include <signal.h>
+#include <time.h>
+#include <linux/input.h>
+
+#include "../src/compositor.h"
+
+#define NUM_BINDINGS	500
+#define NUM_EVENTS	4096
+
+static const uint32_t modifiers[] = {
+	MODIFIER_SUPER,
+	MODIFIER_SUPER | MODIFIER_SHIFT,
+	MODIFIER_CTRL | MODIFIER_ALT,
+	MODIFIER_SUPER | MODIFIER_ALT,
+	0,
+	MODIFIER_SHIFT,
+	MODIFIER_CTRL,
+	MODIFIER_ALT,
+};
+
+struct key_event {
+	uint32_t key;
+	uint32_t modifier;
+};
+
+static struct key_event events[NUM_EVENTS];
+static unsigned long handled;
+
+static struct timespec begin_time;
+
+static void
+reset_timer(void)
+{
+	clock_gettime(CLOCK_MONOTONIC, &begin_time);
+}
+
+static double
+read_timer(void)
+{
+	struct timespec t;
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return (double)(t.tv_sec - begin_time.tv_sec) +
+	       1e-9 * (t.tv_nsec - begin_time.tv_nsec);
+}
+
+/* bindings.c only needs these when a handler leaves the default grab
+ * in place, which never happens here. */
+WL_EXPORT void
+weston_keyboard_start_grab(struct weston_keyboard *keyboard,
+			   struct weston_keyboard_grab *grab)
+{
+	abort();
+}
+
+WL_EXPORT void
+weston_keyboard_end_grab(struct weston_keyboard *keyboard)
+{
+	abort();
+}
+
+static void
+count_handler(struct weston_seat *seat, uint32_t time, uint32_t key,
+	      void *data)
+{
+	handled++;
+}
+
+static int next_handler;
+
+static void
+order_handler(struct weston_seat *seat, uint32_t time, uint32_t key,
+	      void *data)
+{
+	int *index = data;
+
+	assert(*index == next_handler);
+	next_handler++;
+}
+
+/* Half the modifier combinations have bindings, so about half of the
+ * key presses go through to the client as they would normally. */
+static void
+add_bindings(struct weston_compositor *compositor)
+{
+	int i;
+
+	for (i = 0; i < NUM_BINDINGS; i++)
+		weston_compositor_add_key_binding(compositor,
+						  KEY_ESC + i / 4,
+						  modifiers[i % 4],
+						  count_handler, NULL);
+}
+
+static void
+generate_events(void)
+{
+	int i;
+
+	for (i = 0; i < NUM_EVENTS; i++) {
+		events[i].key = KEY_ESC + random() % (NUM_BINDINGS / 4);
+		events[i].modifier = modifiers[random() % 8];
+	}
+}
+
+/* Bindings for the same key and modifiers must run in the order they
+ * were added. */
+static void
+check_order(struct weston_compositor *compositor, struct weston_seat *seat)
+{
+	struct weston_binding *bindings[4];
+	int index[4];
+	int i;
+
+	for (i = 0; i < 4; i++) {
+		index[i] = i;
+		bindings[i] =
+			weston_compositor_add_key_binding(compositor, KEY_F12,
+							  MODIFIER_CTRL,
+							  order_handler,
+							  &index[i]);
+	}
+
+	seat->modifier_state = MODIFIER_CTRL;
+	weston_compositor_run_key_binding(compositor, seat, 0, KEY_F12,
+					  WL_KEYBOARD_KEY_STATE_PRESSED);
+	assert(next_handler == 4);
+
+	for (i = 0; i < 4; i++)
+		weston_binding_destroy(bindings[i]);
+
+	weston_compositor_run_key_binding(compositor, seat, 0, KEY_F12,
+					  WL_KEYBOARD_KEY_STATE_PRESSED);
+	assert(next_handler == 4);
+}
+
+static int running;
+static void
+stopme(int n)
+{
+	running = 0;
+}
+
+static void __attribute__((noinline))
+test_loop_speed(struct weston_compositor *compositor,
+		struct weston_seat *seat)
+{
+	unsigned long count = 0;
+	double t;
+	int i;
+
+	printf("Running 3 s test on weston_compositor_run_key_binding() "
+	       "with %d bindings...\n", NUM_BINDINGS);
+
+	handled = 0;
+	running = 1;
+	alarm(3);
+	reset_timer();
+	while (running) {
+		for (i = 0; i < NUM_EVENTS; i++) {
+			seat->modifier_state = events[i].modifier;
+			weston_compositor_run_key_binding(compositor, seat,
+				0, events[i].key,
+				WL_KEYBOARD_KEY_STATE_PRESSED);
+		}
+		count += NUM_EVENTS;
+	}
+	t = read_timer();
+
+	printf("%lu key events (%lu bound) in %f seconds, %.0f events/s, "
+	       "avg. %.1f ns/event.\n",
+	       count, handled, t, count / t, 1e9 * t / count);
+}
+
+int main(void)
+{
+	static struct weston_compositor compositor;
+	struct weston_keyboard_grab other_grab;
+	struct weston_keyboard keyboard;
+	struct weston_seat seat;
+	struct sigaction ding;
+
+	wl_list_init(&compositor.key_binding_list);
+	weston_binding_table_init(&compositor.binding_table);
+
+	memset(&keyboard, 0, sizeof keyboard);
+	memset(&seat, 0, sizeof seat);
+	keyboard.grab = &other_grab;
+	seat.keyboard = &keyboard;
+
+	ding.sa_handler = stopme;
+	sigemptyset(&ding.sa_mask);
+	ding.sa_flags = 0;
+	sigaction(SIGALRM, &ding, NULL);
+
+	srandom(13);
+	add_bindings(&compositor);
+	generate_events();
+
+	check_order(&compositor, &seat);
+	test_loop_speed(&compositor, &seat);
+
+	weston_binding_list_destroy_all(&compositor.key_binding_list);
+	weston_binding_table_release(&compositor.binding_table);
+
+	return 0;
+}
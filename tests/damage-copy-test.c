@@ -0,0 +1,300 @@
+/*
+ * Copyright © 2013 Intel Corporation
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and
+ * its documentation for any purpose is hereby granted without fee, provided
+ * that the above copyright notice appear in all copies and that both that
+ * copyright notice and this permission notice appear in supporting
+ * documentation, and that the name of the copyright holders not be used in
+ * advertising or publicity pertaining to distribution of the software
+ * without specific, written prior permission.  The copyright holders make
+ * no representations about the suitability of this software for any
+ * purpose.  It is provided "as is" without express or implied warranty.
+ *
+ * THE COPYRIGHT HOLDERS DISCLAIM ALL WARRANTIES WITH REGARD TO THIS
+ * SOFTWARE, INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS, IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * SPECIAL, INDIRECT OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER
+ * RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF
+ * CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Checks damage_copy_region() and compares the cost of a partial update
+ * at 1080p on the drm pixman path: compositing the damage of the last
+ * two frames straight into the framebuffer, as the dumb buffers used
+ * to be rendered, against compositing this frame's damage into a
+ * shadow image and copying from there.
+ *
+ * The framebuffer here is ordinary memory.  Dumb buffers are usually
+ * mapped write-combined, where reading back for blending costs far
+ * more, so the numbers are a lower bound for the gain.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <time.h>
+
+#include "../src/damage-copy.h"
+
+#define WIDTH 1920
+#define HEIGHT 1080
+
+static struct timespec begin_time;
+
+static void
+reset_timer(void)
+{
+	clock_gettime(CLOCK_MONOTONIC, &begin_time);
+}
+
+static double
+read_timer(void)
+{
+	struct timespec t;
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return (double)(t.tv_sec - begin_time.tv_sec) +
+	       1e-9 * (t.tv_nsec - begin_time.tv_nsec);
+}
+
+static volatile sig_atomic_t running;
+static void
+stopme(int n)
+{
+	running = 0;
+}
+
+static pixman_image_t *
+create_image(pixman_format_code_t format, int width, int height)
+{
+	pixman_image_t *image;
+	uint32_t *data;
+	int i, n;
+
+	image = pixman_image_create_bits(format, width, height, NULL, 0);
+	data = pixman_image_get_data(image);
+	n = pixman_image_get_stride(image) / 4 * height;
+	for (i = 0; i < n; i++)
+		data[i] = random();
+
+	return image;
+}
+
+static void
+random_damage(pixman_region32_t *damage, int count, int max_size)
+{
+	int i, x, y, w, h;
+
+	pixman_region32_clear(damage);
+	for (i = 0; i < count; i++) {
+		w = 1 + random() % max_size;
+		h = 1 + random() % max_size;
+		x = random() % (WIDTH - w);
+		y = random() % (HEIGHT - h);
+		pixman_region32_union_rect(damage, damage, x, y, w, h);
+	}
+}
+
+/* Damaged pixels must be copied, rows without damage left alone. */
+static int
+check_copy(pixman_image_t *dst, pixman_image_t *src,
+	   pixman_region32_t *damage)
+{
+	uint32_t *d = pixman_image_get_data(dst);
+	uint32_t *s = pixman_image_get_data(src);
+	int dst_stride = pixman_image_get_stride(dst) / 4;
+	int src_stride = pixman_image_get_stride(src) / 4;
+	pixman_box32_t *extents;
+	int x, y, failed = 0;
+
+	extents = pixman_region32_extents(damage);
+	for (y = 0; y < HEIGHT; y++)
+		for (x = 0; x < WIDTH; x++) {
+			if (pixman_region32_contains_point(damage, x, y,
+							   NULL)) {
+				if (d[y * dst_stride + x] !=
+				    s[y * src_stride + x])
+					failed++;
+			} else if (y < extents->y1 || y >= extents->y2) {
+				if (d[y * dst_stride + x] == 0xdeadbeef)
+					continue;
+				failed++;
+			}
+		}
+
+	return failed;
+}
+
+static int
+test_copy(void)
+{
+	pixman_image_t *src, *dst;
+	pixman_region32_t damage;
+	uint32_t *data;
+	int i, j, n, failed = 0;
+
+	printf("Checking damage_copy_region()...\n");
+
+	src = create_image(PIXMAN_x8r8g8b8, WIDTH, HEIGHT);
+	/* a stride other than the source's, like a dumb buffer pitch */
+	n = (WIDTH + 64) * HEIGHT;
+	data = malloc(n * 4);
+	dst = pixman_image_create_bits(PIXMAN_x8r8g8b8, WIDTH, HEIGHT,
+				       data, (WIDTH + 64) * 4);
+	pixman_region32_init(&damage);
+
+	for (i = 0; i < 20; i++) {
+		for (j = 0; j < n; j++)
+			data[j] = 0xdeadbeef;
+
+		if (i == 0)
+			pixman_region32_union_rect(&damage, &damage,
+						   0, 0, WIDTH, HEIGHT);
+		else
+			random_damage(&damage, i, 200);
+
+		damage_copy_region(dst, src, &damage);
+		failed += check_copy(dst, src, &damage);
+	}
+
+	printf("%d pixels wrong\n", failed);
+
+	pixman_region32_fini(&damage);
+	pixman_image_unref(src);
+	pixman_image_unref(dst);
+	free(data);
+
+	return failed;
+}
+
+struct scene {
+	const char *name;
+	int count;
+	int max_size;
+};
+
+static const struct scene scenes[] = {
+	{ "cursor sized", 1, 64 },
+	{ "text edits", 8, 48 },
+	{ "scattered", 64, 32 },
+	{ "window", 1, 800 },
+};
+
+static uint64_t
+region_area(pixman_region32_t *region)
+{
+	pixman_box32_t *rects;
+	uint64_t area = 0;
+	int i, n;
+
+	rects = pixman_region32_rectangles(region, &n);
+	for (i = 0; i < n; i++)
+		area += (uint64_t) (rects[i].x2 - rects[i].x1) *
+			(rects[i].y2 - rects[i].y1);
+
+	return area;
+}
+
+/* Returns ms per frame.  Blending straight into the framebuffer reads
+ * back every pixel it writes, *fb_read is set to that in kB per frame. */
+static double
+run_frames(pixman_image_t *fb, pixman_image_t *shadow,
+	   pixman_image_t *surface, const struct scene *scene,
+	   double *fb_read)
+{
+	pixman_region32_t damage, previous, total;
+	unsigned long frames = 0;
+	uint64_t read = 0;
+	double t;
+
+	pixman_region32_init(&damage);
+	pixman_region32_init(&previous);
+	pixman_region32_init(&total);
+
+	running = 1;
+	alarm(2);
+	reset_timer();
+	while (running) {
+		random_damage(&damage, scene->count, scene->max_size);
+		pixman_region32_union(&total, &damage, &previous);
+
+		if (shadow) {
+			pixman_image_set_clip_region32(shadow, &damage);
+			pixman_image_composite32(PIXMAN_OP_OVER, surface,
+						 NULL, shadow, 0, 0, 0, 0,
+						 0, 0, WIDTH, HEIGHT);
+			damage_copy_region(fb, shadow, &total);
+		} else {
+			pixman_image_set_clip_region32(fb, &total);
+			pixman_image_composite32(PIXMAN_OP_OVER, surface,
+						 NULL, fb, 0, 0, 0, 0,
+						 0, 0, WIDTH, HEIGHT);
+			read += region_area(&total) * 4;
+		}
+
+		pixman_region32_copy(&previous, &damage);
+		frames++;
+	}
+	t = read_timer();
+
+	pixman_region32_fini(&damage);
+	pixman_region32_fini(&previous);
+	pixman_region32_fini(&total);
+
+	if (fb_read)
+		*fb_read = read / 1024.0 / frames;
+
+	return 1e3 * t / frames;
+}
+
+static void
+test_speed(void)
+{
+	pixman_image_t *fb, *shadow, *surface;
+	double direct, copied, read;
+	unsigned i;
+
+	printf("\nPartial updates at %dx%d, ms per frame:\n",
+	       WIDTH, HEIGHT);
+
+	fb = create_image(PIXMAN_x8r8g8b8, WIDTH, HEIGHT);
+	shadow = create_image(PIXMAN_x8r8g8b8, WIDTH, HEIGHT);
+	surface = create_image(PIXMAN_a8r8g8b8, WIDTH, HEIGHT);
+
+	for (i = 0; i < sizeof scenes / sizeof scenes[0]; i++) {
+		direct = run_frames(fb, NULL, surface, &scenes[i], &read);
+		copied = run_frames(fb, shadow, surface, &scenes[i], NULL);
+		printf("%-14s direct %.3f, shadow and copy %.3f, "
+		       "%.0f kB less read back\n",
+		       scenes[i].name, direct, copied, read);
+	}
+
+	pixman_image_unref(fb);
+	pixman_image_unref(shadow);
+	pixman_image_unref(surface);
+}
+
+int main(void)
+{
+	struct sigaction ding;
+
+	ding.sa_handler = stopme;
+	sigemptyset(&ding.sa_mask);
+	ding.sa_flags = 0;
+	sigaction(SIGALRM, &ding, NULL);
+
+	srandom(13);
+
+	if (test_copy() != 0)
+		return 1;
+
+	test_speed();
+
+	return 0;
+}
@@ -0,0 +1,235 @@
+/*
+ * Copyright © 2013 Intel Corporation
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and
+ * its documentation for any purpose is hereby granted without fee, provided
+ * that the above copyright notice appear in all copies and that both that
+ * copyright notice and this permission notice appear in supporting
+ * documentation, and that the name of the copyright holders not be used in
+ * advertising or publicity pertaining to distribution of the software
+ * without specific, written prior permission.  The copyright holders make
+ * no representations about the suitability of this software for any
+ * purpose.  It is provided "as is" without express or implied warranty.
+ *
+ * THE COPYRIGHT HOLDERS DISCLAIM ALL WARRANTIES WITH REGARD TO THIS
+ * SOFTWARE, INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS, IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * SPECIAL, INDIRECT OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER
+ * RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF
+ * CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/* Surfaces with buffers gbm can import go on the overlay planes where
+ * they save the most compositing.  Runs on the simulated KMS device
+ * from kms-shim.c, which has two planes, with --use-sprites, see
+ * weston-tests-env. */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <assert.h>
+#include <sys/socket.h>
+#include <gbm.h>
+
+#include "../src/compositor.h"
+#include "kms-shim.h"
+
+#define WIDTH 800
+#define HEIGHT 600
+
+/* give the shell's fade-in time to go away */
+#define MAX_COMPOSITED_FRAMES 300
+
+struct test_surface {
+	int x, y, width, height;
+	float rate; /* commits per second */
+	struct kms_shim_buffer buffer;
+	struct weston_surface *surface;
+};
+
+/* Costs are area times rate: A and B are worth a plane each and C is
+ * not, until D stays composited on top of B and keeps B there too. */
+enum { A, B, C, D, NUM_SURFACES };
+
+struct planes_test {
+	struct weston_compositor *compositor;
+	struct weston_output *output;
+	struct weston_layer layer;
+	struct wl_client *client;
+	int fd;
+	struct test_surface surfaces[NUM_SURFACES];
+	struct wl_listener frame_listener;
+	int nframes;
+	int step;
+};
+
+static const struct test_surface layout[NUM_SURFACES] = {
+	[A] = { 50, 50, 200, 200, 60.0f },
+	[B] = { 400, 50, 300, 200, 30.0f },
+	[C] = { 50, 400, 100, 100, 10.0f },
+	[D] = { 500, 100, 50, 50, 1.0f },
+};
+
+static void
+add_surface(struct planes_test *test, int i)
+{
+	struct weston_compositor *compositor = test->compositor;
+	struct test_surface *ts = &test->surfaces[i];
+	struct wl_resource *resource;
+	struct weston_buffer *buffer;
+
+	*ts = layout[i];
+	ts->buffer.magic = KMS_SHIM_BUFFER_MAGIC;
+	ts->buffer.width = ts->width;
+	ts->buffer.height = ts->height;
+	ts->buffer.format = GBM_FORMAT_XRGB8888;
+
+	resource = wl_resource_create(test->client, &wl_buffer_interface,
+				      1, 0);
+	assert(resource);
+	wl_resource_set_implementation(resource, NULL, &ts->buffer, NULL);
+	buffer = weston_buffer_from_resource(resource);
+	assert(buffer);
+
+	ts->surface = weston_surface_create(compositor);
+	assert(ts->surface);
+	weston_buffer_reference(&ts->surface->buffer_ref, buffer);
+	weston_surface_configure(ts->surface,
+				 test->output->x + ts->x,
+				 test->output->y + ts->y,
+				 ts->width, ts->height);
+	wl_list_insert(&test->layer.surface_list,
+		       &ts->surface->layer_link);
+	weston_surface_damage(ts->surface);
+}
+
+static int
+on_sprite(struct planes_test *test, int i)
+{
+	struct weston_surface *surface = test->surfaces[i].surface;
+
+	return surface->plane != &test->compositor->primary_plane;
+}
+
+/* Pretend every surface just committed at its rate, then repaint */
+static void
+repaint_surfaces(void *data)
+{
+	struct planes_test *test = data;
+	uint32_t now = weston_compositor_get_time();
+	struct test_surface *ts;
+	int i;
+
+	for (i = 0; i < NUM_SURFACES; i++) {
+		ts = &test->surfaces[i];
+		if (!ts->surface)
+			continue;
+		ts->surface->stats.last_commit = now;
+		ts->surface->stats.commit_rate = ts->rate;
+		weston_surface_schedule_repaint(ts->surface);
+	}
+}
+
+static void
+finish_test(struct planes_test *test)
+{
+	struct weston_compositor *compositor = test->compositor;
+	int i;
+
+	wl_list_remove(&test->frame_listener.link);
+	for (i = 0; i < NUM_SURFACES; i++)
+		weston_surface_destroy(test->surfaces[i].surface);
+	wl_client_destroy(test->client);
+	close(test->fd);
+	free(test);
+
+	wl_display_terminate(compositor->wl_display);
+}
+
+static void
+frame_notify(struct wl_listener *listener, void *data)
+{
+	struct planes_test *test =
+		container_of(listener, struct planes_test, frame_listener);
+	struct weston_compositor *compositor = test->compositor;
+	struct wl_event_loop *loop =
+		wl_display_get_event_loop(compositor->wl_display);
+
+	test->nframes++;
+
+	if (test->step == 0 && !on_sprite(test, A)) {
+		assert(test->nframes < MAX_COMPOSITED_FRAMES);
+		wl_event_loop_add_idle(loop, repaint_surfaces, test);
+		return;
+	}
+
+	fprintf(stderr, "frame %d, step %d: A %d, B %d, C %d\n",
+		test->nframes, test->step, on_sprite(test, A),
+		on_sprite(test, B), on_sprite(test, C));
+
+	switch (test->step++) {
+	case 0:
+		assert(on_sprite(test, A));
+		assert(on_sprite(test, B));
+		assert(!on_sprite(test, C));
+		add_surface(test, D);
+		break;
+	case 1:
+		/* A and C save more than B with D on a plane as well */
+		assert(on_sprite(test, A));
+		assert(!on_sprite(test, B));
+		assert(on_sprite(test, C));
+		assert(!on_sprite(test, D));
+		finish_test(test);
+		return;
+	}
+
+	wl_event_loop_add_idle(loop, repaint_surfaces, test);
+}
+
+static void
+start_test(void *data)
+{
+	struct weston_compositor *compositor = data;
+	struct planes_test *test;
+	int sv[2], i;
+
+	assert(!wl_list_empty(&compositor->output_list));
+
+	test = calloc(1, sizeof *test);
+	assert(test);
+	test->compositor = compositor;
+	test->output = container_of(compositor->output_list.next,
+				    struct weston_output, link);
+	assert(test->output->current_mode->width == WIDTH);
+	assert(test->output->current_mode->height == HEIGHT);
+
+	/* a client of our own to own the buffers */
+	assert(socketpair(AF_UNIX, SOCK_STREAM, 0, sv) == 0);
+	test->client = wl_client_create(compositor->wl_display, sv[0]);
+	assert(test->client);
+	test->fd = sv[1];
+
+	weston_layer_init(&test->layer, &compositor->cursor_layer.link);
+	for (i = A; i < D; i++)
+		add_surface(test, i);
+
+	test->frame_listener.notify = frame_notify;
+	wl_signal_add(&test->output->frame_signal, &test->frame_listener);
+
+	repaint_surfaces(test);
+}
+
+WL_EXPORT int
+module_init(struct weston_compositor *compositor, int *argc, char *argv[])
+{
+	struct wl_event_loop *loop;
+
+	loop = wl_display_get_event_loop(compositor->wl_display);
+
+	wl_event_loop_add_idle(loop, start_test, compositor);
+
+	return 0;
+}
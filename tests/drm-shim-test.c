@@ -0,0 +1,130 @@
+/*
+ * Copyright © 2013 Intel Corporation
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and
+ * its documentation for any purpose is hereby granted without fee, provided
+ * that the above copyright notice appear in all copies and that both that
+ * copyright notice and this permission notice appear in supporting
+ * documentation, and that the name of the copyright holders not be used in
+ * advertising or publicity pertaining to distribution of the software
+ * without specific, written prior permission.  The copyright holders make
+ * no representations about the suitability of this software for any
+ * purpose.  It is provided "as is" without express or implied warranty.
+ *
+ * THE COPYRIGHT HOLDERS DISCLAIM ALL WARRANTIES WITH REGARD TO THIS
+ * SOFTWARE, INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS, IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * SPECIAL, INDIRECT OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER
+ * RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF
+ * CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/* Runs on the drm backend with the simulated KMS device from
+ * kms-shim.c, see weston-tests-env for its configuration. */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <assert.h>
+
+#include "../src/compositor.h"
+
+#define TEST_FRAMES 30
+
+struct frame_test {
+	struct weston_compositor *compositor;
+	struct weston_output *output;
+	struct wl_listener frame_listener;
+	uint32_t frame_times[TEST_FRAMES];
+	int nframes;
+};
+
+static void
+damage_output(void *data)
+{
+	struct frame_test *test = data;
+
+	weston_output_damage(test->output);
+}
+
+static void
+check_frame_times(struct frame_test *test)
+{
+	uint32_t period, delta;
+	int i;
+
+	/* refresh is in mHz, frame times are in ms */
+	period = 1000000 / test->output->current_mode->refresh;
+
+	for (i = 1; i < TEST_FRAMES; i++) {
+		delta = test->frame_times[i] - test->frame_times[i - 1];
+		fprintf(stderr, "frame %d: %u ms\n", i, delta);
+
+		/* never faster than the display refreshes */
+		assert(delta >= period - 1);
+	}
+}
+
+static void
+frame_notify(struct wl_listener *listener, void *data)
+{
+	struct frame_test *test =
+		container_of(listener, struct frame_test, frame_listener);
+	struct weston_compositor *compositor = test->compositor;
+	struct wl_event_loop *loop =
+		wl_display_get_event_loop(compositor->wl_display);
+
+	/* frame_time is the timestamp of the flip that ended the
+	 * previous frame */
+	test->frame_times[test->nframes++] = test->output->frame_time;
+
+	if (test->nframes < TEST_FRAMES) {
+		/* the repaint-needed flag is cleared after the frame
+		 * signal, so damage again once this repaint is done */
+		wl_event_loop_add_idle(loop, damage_output, test);
+		return;
+	}
+
+	wl_list_remove(&test->frame_listener.link);
+	check_frame_times(test);
+	free(test);
+
+	wl_display_terminate(compositor->wl_display);
+}
+
+static void
+start_test(void *data)
+{
+	struct weston_compositor *compositor = data;
+	struct frame_test *test;
+	struct weston_output *output;
+
+	assert(!wl_list_empty(&compositor->output_list));
+	output = container_of(compositor->output_list.next,
+			      struct weston_output, link);
+
+	/* WESTON_KMS_SHIM_MODE in weston-tests-env */
+	assert(output->current_mode->width == 800);
+	assert(output->current_mode->height == 600);
+
+	test = calloc(1, sizeof *test);
+	assert(test);
+	test->compositor = compositor;
+	test->output = output;
+	test->frame_listener.notify = frame_notify;
+	wl_signal_add(&output->frame_signal, &test->frame_listener);
+
+	weston_output_damage(output);
+}
+
+WL_EXPORT int
+module_init(struct weston_compositor *compositor, int *argc, char *argv[])
+{
+	struct wl_event_loop *loop;
+
+	loop = wl_display_get_event_loop(compositor->wl_display);
+
+	wl_event_loop_add_idle(loop, start_test, compositor);
+
+	return 0;
+}
@@ -0,0 +1,239 @@
+/*
+ * Copyright © 2013 Intel Corporation
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and
+ * its documentation for any purpose is hereby granted without fee, provided
+ * that the above copyright notice appear in all copies and that both that
+ * copyright notice and this permission notice appear in supporting
+ * documentation, and that the name of the copyright holders not be used in
+ * advertising or publicity pertaining to distribution of the software
+ * without specific, written prior permission.  The copyright holders make
+ * no representations about the suitability of this software for any
+ * purpose.  It is provided "as is" without express or implied warranty.
+ *
+ * THE COPYRIGHT HOLDERS DISCLAIM ALL WARRANTIES WITH REGARD TO THIS
+ * SOFTWARE, INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS, IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * SPECIAL, INDIRECT OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER
+ * RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF
+ * CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/* A fullscreen shm surface on the pixman drm backend is copied into
+ * the dumb buffers instead of composited.  Runs on the simulated KMS
+ * device from kms-shim.c, see weston-tests-env. */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <assert.h>
+#include <sys/socket.h>
+
+#include "../src/compositor.h"
+
+#define WIDTH 800
+#define HEIGHT 600
+#define BUFFER_ID 2
+
+/* give the shell's fade-in time to go away */
+#define MAX_COMPOSITED_FRAMES 300
+
+#define COLOR_BACKGROUND 0x204080
+#define COLOR_FIRST 0xff0000
+#define COLOR_SECOND 0x00ff00
+
+struct shm_scanout_test {
+	struct weston_compositor *compositor;
+	struct weston_output *output;
+	struct weston_layer layer;
+	struct weston_surface *surface;
+	struct wl_client *client;
+	int fd;
+	uint32_t *data;
+	uint32_t *pixels;
+	struct wl_listener frame_listener;
+	int nframes;
+	int step;
+};
+
+static void
+fill_rect(struct shm_scanout_test *test, int x, int y, int w, int h,
+	  uint32_t color)
+{
+	int i, j;
+
+	for (j = y; j < y + h; j++)
+		for (i = x; i < x + w; i++)
+			test->data[j * WIDTH + i] = color;
+}
+
+static void
+damage_rect(struct shm_scanout_test *test, int x, int y, int w, int h,
+	    uint32_t color)
+{
+	fill_rect(test, x, y, w, h, color);
+	pixman_region32_union_rect(&test->surface->damage,
+				   &test->surface->damage, x, y, w, h);
+}
+
+/* read_pixels() returns the image flipped, so only count colors */
+static int
+count_pixels(struct shm_scanout_test *test, uint32_t color)
+{
+	struct weston_compositor *compositor = test->compositor;
+	int i, count = 0;
+
+	assert(compositor->renderer->read_pixels(test->output,
+						 PIXMAN_x8r8g8b8,
+						 test->pixels, 0, 0,
+						 WIDTH, HEIGHT) == 0);
+
+	for (i = 0; i < WIDTH * HEIGHT; i++)
+		if ((test->pixels[i] & 0xffffff) == color)
+			count++;
+
+	return count;
+}
+
+static void
+repaint_surface(void *data)
+{
+	struct shm_scanout_test *test = data;
+
+	weston_surface_schedule_repaint(test->surface);
+}
+
+static void
+finish_test(struct shm_scanout_test *test)
+{
+	struct weston_compositor *compositor = test->compositor;
+
+	wl_list_remove(&test->frame_listener.link);
+	weston_surface_destroy(test->surface);
+	wl_client_destroy(test->client);
+	close(test->fd);
+	free(test->pixels);
+	free(test);
+
+	wl_display_terminate(compositor->wl_display);
+}
+
+static void
+frame_notify(struct wl_listener *listener, void *data)
+{
+	struct shm_scanout_test *test =
+		container_of(listener, struct shm_scanout_test,
+			     frame_listener);
+	struct weston_compositor *compositor = test->compositor;
+	struct wl_event_loop *loop =
+		wl_display_get_event_loop(compositor->wl_display);
+	int first, second;
+
+	test->nframes++;
+
+	if (test->surface->plane == &compositor->primary_plane) {
+		/* only the first frames may still be composited */
+		assert(test->step == 0);
+		assert(test->nframes < MAX_COMPOSITED_FRAMES);
+		wl_event_loop_add_idle(loop, repaint_surface, test);
+		return;
+	}
+
+	first = count_pixels(test, COLOR_FIRST);
+	second = count_pixels(test, COLOR_SECOND);
+	fprintf(stderr, "frame %d, step %d: %d first, %d second\n",
+		test->nframes, test->step, first, second);
+
+	switch (test->step++) {
+	case 0:
+		assert(count_pixels(test, COLOR_BACKGROUND) ==
+		       WIDTH * HEIGHT);
+		damage_rect(test, 100, 100, 50, 40, COLOR_FIRST);
+		break;
+	case 1:
+		/* this dumb buffer was last written before the surface
+		 * left the primary plane, so it needed a full copy */
+		assert(first == 50 * 40);
+		damage_rect(test, 400, 300, 20, 30, COLOR_SECOND);
+		break;
+	case 2:
+		/* only the new rectangle was damaged, the first one
+		 * comes from the previous frame's damage */
+		assert(first == 50 * 40);
+		assert(second == 20 * 30);
+		finish_test(test);
+		return;
+	}
+
+	wl_event_loop_add_idle(loop, repaint_surface, test);
+}
+
+static void
+start_test(void *data)
+{
+	struct weston_compositor *compositor = data;
+	struct shm_scanout_test *test;
+	struct wl_shm_buffer *shm_buffer;
+	struct weston_buffer *buffer;
+	int sv[2];
+
+	assert(!wl_list_empty(&compositor->output_list));
+
+	test = calloc(1, sizeof *test);
+	assert(test);
+	test->compositor = compositor;
+	test->output = container_of(compositor->output_list.next,
+				    struct weston_output, link);
+	assert(test->output->current_mode->width == WIDTH);
+	assert(test->output->current_mode->height == HEIGHT);
+
+	test->pixels = malloc(WIDTH * HEIGHT * 4);
+	assert(test->pixels);
+
+	/* a client of our own to own the buffer */
+	assert(socketpair(AF_UNIX, SOCK_STREAM, 0, sv) == 0);
+	test->client = wl_client_create(compositor->wl_display, sv[0]);
+	assert(test->client);
+	test->fd = sv[1];
+
+	shm_buffer = wl_shm_buffer_create(test->client, BUFFER_ID,
+					  WIDTH, HEIGHT, WIDTH * 4,
+					  WL_SHM_FORMAT_XRGB8888);
+	assert(shm_buffer);
+	test->data = wl_shm_buffer_get_data(shm_buffer);
+	fill_rect(test, 0, 0, WIDTH, HEIGHT, COLOR_BACKGROUND);
+
+	buffer = weston_buffer_from_resource(
+		wl_client_get_object(test->client, BUFFER_ID));
+	assert(buffer);
+
+	weston_layer_init(&test->layer, &compositor->cursor_layer.link);
+	test->surface = weston_surface_create(compositor);
+	assert(test->surface);
+	weston_buffer_reference(&test->surface->buffer_ref, buffer);
+	compositor->renderer->attach(test->surface, buffer);
+	weston_surface_configure(test->surface,
+				 test->output->x, test->output->y,
+				 WIDTH, HEIGHT);
+	wl_list_insert(&test->layer.surface_list,
+		       &test->surface->layer_link);
+
+	test->frame_listener.notify = frame_notify;
+	wl_signal_add(&test->output->frame_signal, &test->frame_listener);
+
+	weston_surface_damage(test->surface);
+}
+
+WL_EXPORT int
+module_init(struct weston_compositor *compositor, int *argc, char *argv[])
+{
+	struct wl_event_loop *loop;
+
+	loop = wl_display_get_event_loop(compositor->wl_display);
+
+	wl_event_loop_add_idle(loop, start_test, compositor);
+
+	return 0;
+}
@@ -0,0 +1,195 @@
+/*
+ * Copyright © 2013 Intel Corporation
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and
+ * its documentation for any purpose is hereby granted without fee, provided
+ * that the above copyright notice appear in all copies and that both that
+ * copyright notice and this permission notice appear in supporting
+ * documentation, and that the name of the copyright holders not be used in
+ * advertising or publicity pertaining to distribution of the software
+ * without specific, written prior permission.  The copyright holders make
+ * no representations about the suitability of this software for any
+ * purpose.  It is provided "as is" without express or implied warranty.
+ *
+ * THE COPYRIGHT HOLDERS DISCLAIM ALL WARRANTIES WITH REGARD TO THIS
+ * SOFTWARE, INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS, IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * SPECIAL, INDIRECT OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER
+ * RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF
+ * CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <unistd.h>
+#include <signal.h>
+#include <time.h>
+
+#include "../src/filter.h"
+
+#define NUM_EVENTS	4096
+#define EVENT_INTERVAL	8 /* ms */
+
+/* Same shape as the default touchpad profile, for a 1000 unit diagonal */
+#define CONSTANT_ACCEL_FACTOR	0.05
+#define MIN_ACCEL_FACTOR	0.16
+#define MAX_ACCEL_FACTOR	1.0
+
+struct motion_event {
+	double dx, dy;
+	uint32_t time;
+};
+
+static struct motion_event events[NUM_EVENTS];
+
+static struct timespec begin_time;
+
+static void
+reset_timer(void)
+{
+	clock_gettime(CLOCK_MONOTONIC, &begin_time);
+}
+
+static double
+read_timer(void)
+{
+	struct timespec t;
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return (double)(t.tv_sec - begin_time.tv_sec) +
+	       1e-9 * (t.tv_nsec - begin_time.tv_nsec);
+}
+
+static double
+profile(struct weston_motion_filter *filter, void *data,
+	double velocity, uint32_t time)
+{
+	double factor = velocity * CONSTANT_ACCEL_FACTOR;
+
+	if (factor > MAX_ACCEL_FACTOR)
+		factor = MAX_ACCEL_FACTOR;
+	else if (factor < MIN_ACCEL_FACTOR)
+		factor = MIN_ACCEL_FACTOR;
+
+	return factor;
+}
+
+/* Strokes that speed up and slow down while slowly changing direction,
+ * with an occasional pause. */
+static void
+generate_events(void)
+{
+	uint32_t time = 1000;
+	double speed, angle;
+	int i;
+
+	for (i = 0; i < NUM_EVENTS; i++) {
+		speed = 12.0 * (1.0 - cos(i * 0.05)) + (random() % 3);
+		angle = i * 0.01;
+		events[i].dx = rint(speed * cos(angle));
+		events[i].dy = rint(speed * sin(angle));
+
+		time += EVENT_INTERVAL;
+		if (i % 512 == 511)
+			time += 500;
+		events[i].time = time;
+	}
+}
+
+static void
+compare_filters(void)
+{
+	struct weston_motion_filter *reference, *table;
+	struct weston_motion_params a, b;
+	double err, errsup = 0.0, errsum = 0.0;
+	int i;
+
+	reference = create_pointer_accelator_filter(profile);
+	table = create_pointer_table_accelerator_filter(profile, NULL,
+			MAX_ACCEL_FACTOR / CONSTANT_ACCEL_FACTOR);
+
+	for (i = 0; i < NUM_EVENTS; i++) {
+		a.dx = b.dx = events[i].dx;
+		a.dy = b.dy = events[i].dy;
+		weston_filter_dispatch(reference, &a, NULL, events[i].time);
+		weston_filter_dispatch(table, &b, NULL, events[i].time);
+
+		err = hypot(a.dx - b.dx, a.dy - b.dy);
+		errsum += err;
+		if (err > errsup)
+			errsup = err;
+	}
+
+	printf("table vs. profile accelerator over %d events: "
+	       "max abs error %f, avg. %f device units.\n",
+	       NUM_EVENTS, errsup, errsum / NUM_EVENTS);
+
+	reference->interface->destroy(reference);
+	table->interface->destroy(table);
+}
+
+static int running;
+static void
+stopme(int n)
+{
+	running = 0;
+}
+
+static void __attribute__((noinline))
+test_loop_speed(const char *name, struct weston_motion_filter *filter)
+{
+	struct weston_motion_params motion;
+	unsigned long count = 0;
+	uint32_t base = 0;
+	double t;
+	int i;
+
+	printf("\nRunning 3 s test on weston_filter_dispatch() "
+	       "with %s...\n", name);
+
+	running = 1;
+	alarm(3);
+	reset_timer();
+	while (running) {
+		for (i = 0; i < NUM_EVENTS; i++) {
+			motion.dx = events[i].dx;
+			motion.dy = events[i].dy;
+			weston_filter_dispatch(filter, &motion, NULL,
+					       base + events[i].time);
+		}
+		base += events[NUM_EVENTS - 1].time;
+		count += NUM_EVENTS;
+	}
+	t = read_timer();
+
+	printf("%lu events in %f seconds, %.0f events/s, "
+	       "avg. %.1f ns/event.\n",
+	       count, t, count / t, 1e9 * t / count);
+
+	filter->interface->destroy(filter);
+}
+
+int main(void)
+{
+	struct sigaction ding;
+
+	ding.sa_handler = stopme;
+	sigemptyset(&ding.sa_mask);
+	ding.sa_flags = 0;
+	sigaction(SIGALRM, &ding, NULL);
+
+	srandom(13);
+	generate_events();
+
+	compare_filters();
+
+	test_loop_speed("profile accelerator",
+			create_pointer_accelator_filter(profile));
+	test_loop_speed("table accelerator",
+			create_pointer_table_accelerator_filter(profile, NULL,
+				MAX_ACCEL_FACTOR / CONSTANT_ACCEL_FACTOR));
+
+	return 0;
+}
@@ -0,0 +1,405 @@
+/*
+ * Copyright © 2013 Intel Corporation
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and
+ * its documentation for any purpose is hereby granted without fee, provided
+ * that the above copyright notice appear in all copies and that both that
+ * copyright notice and this permission notice appear in supporting
+ * documentation, and that the name of the copyright holders not be used in
+ * advertising or publicity pertaining to distribution of the software
+ * without specific, written prior permission.  The copyright holders make
+ * no representations about the suitability of this software for any
+ * purpose.  It is provided "as is" without express or implied warranty.
+ *
+ * THE COPYRIGHT HOLDERS DISCLAIM ALL WARRANTIES WITH REGARD TO THIS
+ * SOFTWARE, INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS, IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * SPECIAL, INDIRECT OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER
+ * RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF
+ * CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <linux/input.h>
+
+#include "weston-test-runner.h"
+
+#include "../src/evdev-gesture.h"
+#include "../src/timer-wheel.h"
+
+#define MOVE_THRESHOLD	50.0
+#define PINCH_THRESHOLD	100.0
+#define FRAME_INTERVAL	12 /* ms */
+
+#define MAX_EVENTS	128
+
+static struct weston_gesture_event events[MAX_EVENTS];
+static int num_events;
+
+static void
+record_event(struct evdev_gesture *gesture,
+	     struct weston_gesture_event *event, void *data)
+{
+	assert(num_events < MAX_EVENTS);
+	events[num_events++] = *event;
+}
+
+static void
+init_gesture(struct evdev_gesture *gesture)
+{
+	num_events = 0;
+	evdev_gesture_init(gesture, MOVE_THRESHOLD, PINCH_THRESHOLD,
+			   record_event, NULL);
+}
+
+static void
+finger(struct evdev_gesture *gesture, int slot, int x, int y)
+{
+	evdev_gesture_process_abs(gesture, ABS_MT_SLOT, slot);
+	if (!gesture->contacts[slot].active)
+		evdev_gesture_process_abs(gesture, ABS_MT_TRACKING_ID, slot);
+	evdev_gesture_process_abs(gesture, ABS_MT_POSITION_X, x);
+	evdev_gesture_process_abs(gesture, ABS_MT_POSITION_Y, y);
+}
+
+static void
+lift(struct evdev_gesture *gesture, int slot)
+{
+	evdev_gesture_process_abs(gesture, ABS_MT_SLOT, slot);
+	evdev_gesture_process_abs(gesture, ABS_MT_TRACKING_ID, -1);
+}
+
+static int
+count_events(enum weston_gesture_type type, enum weston_gesture_phase phase)
+{
+	int i, count = 0;
+
+	for (i = 0; i < num_events; i++)
+		if (events[i].type == type && events[i].phase == phase)
+			count++;
+
+	return count;
+}
+
+/* Moves all fingers by (dx, dy) per frame, starting at time 1000. The
+ * fingers are placed 300 units apart horizontally, plus spread per
+ * frame away from their centroid. */
+static uint32_t
+move_fingers(struct evdev_gesture *gesture, int fingers, int frames,
+	     int dx, int dy, int spread)
+{
+	uint32_t time = 1000;
+	int i, j, x;
+
+	for (i = 0; i <= frames; i++) {
+		for (j = 0; j < fingers; j++) {
+			x = 1000 + (j - (fingers - 1) / 2.0) *
+				(300 + 2 * spread * i);
+			finger(gesture, j, x + dx * i, 1000 + dy * i);
+		}
+		evdev_gesture_frame(gesture, time);
+		time += FRAME_INTERVAL;
+	}
+
+	return time;
+}
+
+static void
+lift_fingers(struct evdev_gesture *gesture, int fingers, uint32_t time)
+{
+	int j;
+
+	for (j = 0; j < fingers; j++)
+		lift(gesture, j);
+	evdev_gesture_frame(gesture, time);
+}
+
+TEST(two_finger_scroll)
+{
+	struct evdev_gesture gesture;
+	double sum_dy = 0.0;
+	uint32_t time;
+	int i;
+
+	init_gesture(&gesture);
+	time = move_fingers(&gesture, 2, 10, 0, 20, 0);
+
+	assert(num_events > 0);
+	assert(events[0].type == WESTON_GESTURE_SCROLL);
+	assert(events[0].phase == WESTON_GESTURE_BEGIN);
+	assert(events[0].fingers == 2);
+
+	/* Recognized on the first frame past the threshold, 3 frames
+	 * of 20 units for a threshold of 50 */
+	assert(events[0].time == 1000 + 3 * FRAME_INTERVAL);
+	assert(events[0].dy == 60.0);
+
+	for (i = 0; i < num_events; i++)
+		sum_dy += events[i].dy;
+	assert(sum_dy == 10 * 20);
+	assert(count_events(WESTON_GESTURE_SCROLL,
+			    WESTON_GESTURE_UPDATE) == 7);
+	assert(count_events(WESTON_GESTURE_PINCH, WESTON_GESTURE_BEGIN) == 0);
+
+	lift_fingers(&gesture, 2, time);
+	assert(events[num_events - 1].phase == WESTON_GESTURE_END);
+	assert(events[num_events - 1].total_dy == 10 * 20);
+	assert(fabs(events[num_events - 1].vy -
+		    20.0 / FRAME_INTERVAL) < 1e-6);
+	assert(events[num_events - 1].vx == 0.0);
+}
+
+TEST(two_finger_rest_is_no_gesture)
+{
+	struct evdev_gesture gesture;
+
+	init_gesture(&gesture);
+	move_fingers(&gesture, 2, 20, 1, -1, 0);
+	assert(num_events == 0);
+}
+
+TEST(symmetric_pinch)
+{
+	struct evdev_gesture gesture;
+	uint32_t time;
+	int i;
+
+	init_gesture(&gesture);
+	time = move_fingers(&gesture, 2, 10, 0, 0, 30);
+
+	assert(num_events > 0);
+	assert(events[0].type == WESTON_GESTURE_PINCH);
+	assert(events[0].phase == WESTON_GESTURE_BEGIN);
+	assert(events[0].time == 1000 + 4 * FRAME_INTERVAL);
+	assert(count_events(WESTON_GESTURE_SCROLL, WESTON_GESTURE_BEGIN) == 0);
+
+	for (i = 1; i < num_events; i++)
+		assert(events[i].scale > events[i - 1].scale);
+	assert(fabs(events[num_events - 1].scale - 900.0 / 300.0) < 1e-6);
+
+	lift_fingers(&gesture, 2, time);
+	assert(events[num_events - 1].type == WESTON_GESTURE_PINCH);
+	assert(events[num_events - 1].phase == WESTON_GESTURE_END);
+}
+
+TEST(one_sided_pinch)
+{
+	struct evdev_gesture gesture;
+	uint32_t time = 1000;
+	int i;
+
+	/* One finger stays put, the other one moves away from it. The
+	 * centroid moves as fast as the spread grows. */
+	init_gesture(&gesture);
+	for (i = 0; i <= 10; i++) {
+		finger(&gesture, 0, 1000, 1000);
+		finger(&gesture, 1, 1300 + 40 * i, 1000);
+		evdev_gesture_frame(&gesture, time);
+		time += FRAME_INTERVAL;
+	}
+
+	assert(num_events > 0);
+	assert(events[0].type == WESTON_GESTURE_PINCH);
+	assert(count_events(WESTON_GESTURE_SCROLL, WESTON_GESTURE_BEGIN) == 0);
+}
+
+TEST(three_finger_swipe)
+{
+	struct evdev_gesture gesture;
+	uint32_t time;
+	int n;
+
+	init_gesture(&gesture);
+	time = move_fingers(&gesture, 3, 8, 30, 0, 0);
+
+	assert(events[0].type == WESTON_GESTURE_SWIPE);
+	assert(events[0].phase == WESTON_GESTURE_BEGIN);
+	assert(events[0].fingers == 3);
+	assert(events[0].time == 1000 + 2 * FRAME_INTERVAL);
+
+	/* Lifting the fingers one at a time ends the swipe once and
+	 * doesn't turn into a scroll with the two fingers left. */
+	lift(&gesture, 0);
+	evdev_gesture_frame(&gesture, time);
+	n = num_events;
+	assert(events[n - 1].type == WESTON_GESTURE_SWIPE);
+	assert(events[n - 1].phase == WESTON_GESTURE_END);
+	assert(events[n - 1].total_dx == 8 * 30);
+	assert(fabs(events[n - 1].vx - 30.0 / FRAME_INTERVAL) < 1e-6);
+
+	finger(&gesture, 1, 2000, 2000);
+	finger(&gesture, 2, 2300, 2000);
+	evdev_gesture_frame(&gesture, time + FRAME_INTERVAL);
+	lift_fingers(&gesture, 3, time + 2 * FRAME_INTERVAL);
+	assert(num_events == n);
+	assert(count_events(WESTON_GESTURE_SCROLL, WESTON_GESTURE_BEGIN) == 0);
+}
+
+TEST(scroll_then_swipe)
+{
+	struct evdev_gesture gesture;
+	uint32_t time;
+	int i;
+
+	init_gesture(&gesture);
+	time = move_fingers(&gesture, 2, 5, 0, 20, 0);
+	assert(count_events(WESTON_GESTURE_SCROLL, WESTON_GESTURE_BEGIN) == 1);
+
+	/* A third finger ends the scroll and starts a new gesture */
+	for (i = 0; i < 5; i++) {
+		finger(&gesture, 0, 850 + 30 * i, 1100);
+		finger(&gesture, 1, 1150 + 30 * i, 1100);
+		finger(&gesture, 2, 1450 + 30 * i, 1100);
+		evdev_gesture_frame(&gesture, time);
+		time += FRAME_INTERVAL;
+	}
+
+	assert(count_events(WESTON_GESTURE_SCROLL, WESTON_GESTURE_END) == 1);
+	assert(count_events(WESTON_GESTURE_SWIPE, WESTON_GESTURE_BEGIN) == 1);
+}
+
+TEST(cancel)
+{
+	struct evdev_gesture gesture;
+	uint32_t time;
+
+	init_gesture(&gesture);
+	time = move_fingers(&gesture, 2, 5, 0, 20, 0);
+	evdev_gesture_cancel(&gesture, time);
+	assert(events[num_events - 1].phase == WESTON_GESTURE_CANCEL);
+
+	move_fingers(&gesture, 2, 5, 0, 20, 0);
+	assert(count_events(WESTON_GESTURE_SCROLL, WESTON_GESTURE_BEGIN) == 1);
+}
+
+static uint32_t fired[8];
+static int num_fired;
+static struct weston_timer_wheel *test_wheel;
+static struct weston_timer rearm_timer;
+
+static void
+timer_func(struct weston_timer *timer, uint32_t time)
+{
+	fired[num_fired++] = time;
+}
+
+static void
+rearm_func(struct weston_timer *timer, uint32_t time)
+{
+	fired[num_fired++] = time;
+	if (num_fired < 3)
+		weston_timer_schedule(test_wheel, timer, time, 10);
+}
+
+TEST(timer_wheel)
+{
+	struct weston_timer_wheel *wheel;
+	struct weston_timer a, b, c;
+	uint32_t t;
+
+	wheel = weston_timer_wheel_create(NULL, 4);
+	assert(wheel);
+	test_wheel = wheel;
+
+	weston_timer_init(&a, timer_func);
+	weston_timer_init(&b, timer_func);
+	weston_timer_init(&c, timer_func);
+
+	/* Never early, at most one tick late */
+	num_fired = 0;
+	weston_timer_schedule(wheel, &a, 1001, 100);
+	for (t = 1001; t < 1101; t++) {
+		weston_timer_wheel_expire(wheel, t);
+		assert(num_fired == 0);
+	}
+	for (; num_fired == 0; t++)
+		weston_timer_wheel_expire(wheel, t);
+	assert(fired[0] >= 1101 && fired[0] < 1101 + 4);
+	assert(!weston_timer_pending(&a));
+
+	/* Cancelled and rescheduled timers */
+	num_fired = 0;
+	weston_timer_schedule(wheel, &a, 2000, 20);
+	weston_timer_schedule(wheel, &b, 2000, 40);
+	weston_timer_schedule(wheel, &a, 2000, 60);
+	weston_timer_cancel(wheel, &b);
+	weston_timer_wheel_expire(wheel, 2050);
+	assert(num_fired == 0);
+	weston_timer_wheel_expire(wheel, 2060);
+	assert(num_fired == 1);
+	assert(wheel->count == 0);
+
+	/* Longer than one turn of the wheel, with a shorter timer
+	 * in the same slot */
+	num_fired = 0;
+	weston_timer_schedule(wheel, &c, 3000,
+			      WESTON_TIMER_WHEEL_SLOTS * 4 + 20);
+	weston_timer_schedule(wheel, &a, 3000, 20);
+	weston_timer_wheel_expire(wheel, 3020);
+	assert(num_fired == 1);
+	weston_timer_wheel_expire(wheel, 3000 + WESTON_TIMER_WHEEL_SLOTS * 4);
+	assert(num_fired == 1);
+	weston_timer_wheel_expire(wheel,
+				  3020 + WESTON_TIMER_WHEEL_SLOTS * 4);
+	assert(num_fired == 2);
+
+	/* Timers rescheduled from their callback */
+	num_fired = 0;
+	weston_timer_init(&rearm_timer, rearm_func);
+	weston_timer_schedule(wheel, &rearm_timer, 4000, 10);
+	for (t = 4000; t < 4100; t++)
+		weston_timer_wheel_expire(wheel, t);
+	assert(num_fired == 3);
+	assert(fired[1] - fired[0] >= 10);
+	assert(wheel->count == 0);
+
+	weston_timer_wheel_destroy(wheel);
+}
+
+TEST(timer_wheel_wrap)
+{
+	struct weston_timer_wheel *wheel;
+	struct weston_timer a, b;
+	uint32_t start = UINT32_MAX - 50, t;
+
+	/* The wheel lives across the 32-bit millisecond wrap */
+	wheel = weston_timer_wheel_create(NULL, 4);
+	assert(wheel);
+	test_wheel = wheel;
+
+	weston_timer_init(&a, timer_func);
+	weston_timer_init(&b, timer_func);
+
+	num_fired = 0;
+	weston_timer_schedule(wheel, &a, start, 20);
+	weston_timer_schedule(wheel, &b, start, 100);
+	for (t = start; t != start + 20; t++) {
+		weston_timer_wheel_expire(wheel, t);
+		assert(num_fired == 0);
+	}
+	weston_timer_wheel_expire(wheel, t);
+	assert(num_fired == 1);
+	assert(fired[0] == start + 20);
+
+	for (t++; t != start + 100; t++) {
+		weston_timer_wheel_expire(wheel, t);
+		assert(num_fired == 1);
+	}
+	weston_timer_wheel_expire(wheel, t);
+	assert(num_fired == 2);
+	assert(fired[1] == start + 100);
+	assert(wheel->count == 0);
+
+	/* Scheduled just after the wrap, while the wheel is idle */
+	num_fired = 0;
+	weston_timer_schedule(wheel, &a, 10, 30);
+	for (t = 10; num_fired == 0; t++)
+		weston_timer_wheel_expire(wheel, t);
+	assert(fired[0] >= 40 && fired[0] < 40 + 4);
+
+	weston_timer_wheel_destroy(wheel);
+}
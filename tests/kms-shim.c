@@ -0,0 +1,1851 @@
+/*
+ * Copyright © 2013 Intel Corporation
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and
+ * its documentation for any purpose is hereby granted without fee, provided
+ * that the above copyright notice appear in all copies and that both that
+ * copyright notice and this permission notice appear in supporting
+ * documentation, and that the name of the copyright holders not be used in
+ * advertising or publicity pertaining to distribution of the software
+ * without specific, written prior permission.  The copyright holders make
+ * no representations about the suitability of this software for any
+ * purpose.  It is provided "as is" without express or implied warranty.
+ *
+ * THE COPYRIGHT HOLDERS DISCLAIM ALL WARRANTIES WITH REGARD TO THIS
+ * SOFTWARE, INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS, IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * SPECIAL, INDIRECT OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER
+ * RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF
+ * CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * A simulated KMS device for running the drm backend without a GPU.
+ *
+ * Preload this into weston (LD_PRELOAD) and start it with the drm
+ * backend and --use-pixman.  The shim replaces the libdrm, libudev and
+ * gbm entry points the backend uses with a model of a device with a
+ * configurable number of outputs and overlay planes, serves the
+ * weston-launch protocol so no tty or root is needed, and backs dumb
+ * buffers with plain memory.  Page flips and vblank events complete
+ * on a simulated vblank clock per crtc.
+ *
+ * gbm only imports the buffers described in kms-shim.h, which stand
+ * in for buffers from a GPU driver, so with --use-sprites a test can
+ * put surfaces on the overlay planes.
+ *
+ * The model is configured through the environment:
+ *
+ *   WESTON_KMS_SHIM_OUTPUTS        number of connected outputs (1)
+ *   WESTON_KMS_SHIM_MODE           mode of every output (1024x768@60)
+ *   WESTON_KMS_SHIM_PLANES         number of overlay planes (2)
+ *   WESTON_KMS_SHIM_PLANE_FORMATS  fourccs the planes take (XR24,AR24)
+ *   WESTON_KMS_SHIM_FLIP_DELAY     extra page flip latency in ms (0)
+ *   WESTON_KMS_SHIM_STATS          file to write statistics to on exit,
+ *                                  stderr if unset
+ *
+ * The GL renderer and cursors are not simulated.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dlfcn.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+
+#include <xf86drm.h>
+#include <xf86drmMode.h>
+#include <drm_fourcc.h>
+#include <libudev.h>
+#include <gbm.h>
+#include <wayland-server.h>
+
+#include "../src/weston-launch.h"
+#include "kms-shim.h"
+
+#define SHIM_MAX_OUTPUTS 4
+#define SHIM_MAX_PLANES 8
+#define SHIM_MAX_FORMATS 8
+
+#define SHIM_DEVNODE "/dev/dri/card0"
+#define SHIM_SYSPATH "/sys/devices/platform/kms-shim/drm/card0"
+
+/* Object ids.  The backend uses crtc ids as bit positions, so they
+ * have to stay below 32. */
+#define SHIM_CRTC_ID(i) (1 + (i))
+#define SHIM_ENCODER_ID(i) (8 + (i))
+#define SHIM_CONNECTOR_ID(i) (16 + (i))
+#define SHIM_PLANE_ID(i) (32 + (i))
+#define SHIM_DPMS_PROP_ID 64
+#define SHIM_FIRST_FB_ID 128
+
+struct shim_fb {
+	uint32_t id;
+	uint32_t width, height;
+	uint32_t format;
+	struct shim_fb *next;
+};
+
+struct shim_bo {
+	uint32_t handle;
+	uint32_t pitch;
+	uint64_t size;
+	void *map;
+	struct shim_bo *next;
+};
+
+struct shim_gbm_device {
+	int fd;
+};
+
+struct shim_gbm_bo {
+	struct shim_gbm_device *device;
+	struct shim_bo *bo;
+	uint32_t width, height;
+	uint32_t format;
+	void *user_data;
+	void (*destroy_user_data)(struct gbm_bo *, void *);
+};
+
+struct shim_crtc {
+	uint32_t id;
+	drmModeModeInfo mode;
+	int mode_valid;
+	uint32_t fb_id;
+	uint32_t pending_fb_id;
+	int flip_pending;
+	uint64_t epoch;  /* usec, time of vblank 0 */
+	uint64_t period; /* usec */
+	uint64_t dpms;
+
+	struct {
+		uint32_t flips;
+		uint32_t busy;
+		uint64_t latency;	/* usec, summed */
+		uint64_t latency_max;	/* usec */
+		uint32_t skipped;	/* vblanks without a flip */
+		uint64_t last_flip;	/* vblank sequence */
+	} stats;
+};
+
+struct shim_plane {
+	uint32_t id;
+	uint32_t crtc_id;
+	uint32_t fb_id;
+	uint64_t enabled_since;
+
+	struct {
+		uint32_t updates;
+		uint32_t rejected;
+		uint64_t enabled;	/* usec */
+	} stats;
+};
+
+enum shim_event_type {
+	SHIM_EVENT_FLIP,
+	SHIM_EVENT_VBLANK
+};
+
+struct shim_event {
+	enum shim_event_type type;
+	uint64_t time;
+	uint64_t requested;
+	struct shim_crtc *crtc;
+	void *data;
+	struct shim_event *next;
+};
+
+static struct {
+	int active;
+	int fd;		/* our end of the device */
+	struct stat fd_stat;
+	pthread_t launcher_thread;
+	int launcher_sock;
+
+	int noutputs;
+	int nplanes;
+	int nformats;
+	uint32_t formats[SHIM_MAX_FORMATS];
+	int width, height, refresh;
+	uint64_t flip_delay;	/* usec */
+	const char *stats_path;
+
+	struct shim_crtc crtcs[SHIM_MAX_OUTPUTS];
+	struct shim_plane planes[SHIM_MAX_PLANES];
+	struct shim_fb *fbs;
+	struct shim_bo *bos;
+	struct shim_event *events;
+	struct shim_gbm_device gbm;
+	uint32_t next_fb_id;
+	uint32_t next_handle;
+	uint32_t rmfb_busy;
+	uint64_t start;
+} shim;
+
+static void *(*real_mmap)(void *, size_t, int, int, int, off_t);
+static int (*real_munmap)(void *, size_t);
+
+static uint64_t
+shim_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/* The launcher hands the compositor a duplicate of our device fd, so
+ * compare what the fds refer to.  All timerfds share one anonymous
+ * inode, but the compositor never passes its own timers to libdrm or
+ * mmap(). */
+static int
+shim_device(int fd)
+{
+	struct stat st;
+
+	if (!shim.active || fd < 0)
+		return 0;
+	if (fd == shim.fd)
+		return 1;
+	if (fstat(fd, &st) < 0)
+		return 0;
+
+	return st.st_dev == shim.fd_stat.st_dev &&
+		st.st_ino == shim.fd_stat.st_ino &&
+		st.st_rdev == shim.fd_stat.st_rdev;
+}
+
+static struct shim_crtc *
+shim_crtc_get(uint32_t id)
+{
+	int i;
+
+	for (i = 0; i < shim.noutputs; i++)
+		if (shim.crtcs[i].id == id)
+			return &shim.crtcs[i];
+
+	return NULL;
+}
+
+static struct shim_plane *
+shim_plane_get(uint32_t id)
+{
+	int i;
+
+	for (i = 0; i < shim.nplanes; i++)
+		if (shim.planes[i].id == id)
+			return &shim.planes[i];
+
+	return NULL;
+}
+
+static struct shim_fb *
+shim_fb_get(uint32_t id)
+{
+	struct shim_fb *fb;
+
+	for (fb = shim.fbs; fb; fb = fb->next)
+		if (fb->id == id)
+			return fb;
+
+	return NULL;
+}
+
+static struct shim_bo *
+shim_bo_get(uint32_t handle)
+{
+	struct shim_bo *bo;
+
+	for (bo = shim.bos; bo; bo = bo->next)
+		if (bo->handle == handle)
+			return bo;
+
+	return NULL;
+}
+
+static void
+shim_mode_init(drmModeModeInfo *mode, int width, int height, int refresh)
+{
+	memset(mode, 0, sizeof *mode);
+	mode->hdisplay = width;
+	mode->hsync_start = width + 16;
+	mode->hsync_end = width + 96;
+	mode->htotal = width + 160;
+	mode->vdisplay = height;
+	mode->vsync_start = height + 3;
+	mode->vsync_end = height + 7;
+	mode->vtotal = height + 30;
+	mode->clock = (uint64_t) mode->htotal * mode->vtotal * refresh / 1000;
+	mode->vrefresh = refresh;
+	mode->type = DRM_MODE_TYPE_DRIVER | DRM_MODE_TYPE_PREFERRED;
+	snprintf(mode->name, sizeof mode->name, "%dx%d", width, height);
+}
+
+static uint64_t
+shim_mode_period(const drmModeModeInfo *mode)
+{
+	return (uint64_t) mode->htotal * mode->vtotal * 1000 / mode->clock;
+}
+
+/* First vblank of the crtc at or after time t. */
+static uint64_t
+shim_crtc_next_vblank(struct shim_crtc *crtc, uint64_t t)
+{
+	uint64_t n;
+
+	if (t <= crtc->epoch)
+		return crtc->epoch;
+
+	n = (t - crtc->epoch + crtc->period - 1) / crtc->period;
+
+	return crtc->epoch + n * crtc->period;
+}
+
+static unsigned int
+shim_crtc_sequence(struct shim_crtc *crtc, uint64_t t)
+{
+	return (t - crtc->epoch) / crtc->period;
+}
+
+static void
+shim_arm_timer(void)
+{
+	struct itimerspec its;
+
+	memset(&its, 0, sizeof its);
+	if (shim.events) {
+		its.it_value.tv_sec = shim.events->time / 1000000;
+		its.it_value.tv_nsec = shim.events->time % 1000000 * 1000;
+	}
+
+	timerfd_settime(shim.fd, TFD_TIMER_ABSTIME, &its, NULL);
+}
+
+static void
+shim_queue_event(enum shim_event_type type, struct shim_crtc *crtc,
+		 uint64_t time, uint64_t requested, void *data)
+{
+	struct shim_event *event, **p;
+
+	event = calloc(1, sizeof *event);
+	if (!event)
+		return;
+
+	event->type = type;
+	event->crtc = crtc;
+	event->time = time;
+	event->requested = requested;
+	event->data = data;
+
+	for (p = &shim.events; *p && (*p)->time <= time; p = &(*p)->next)
+		;
+	event->next = *p;
+	*p = event;
+
+	shim_arm_timer();
+}
+
+static void
+shim_plane_set_fb(struct shim_plane *plane, uint32_t crtc_id, uint32_t fb_id)
+{
+	uint64_t now = shim_now();
+
+	if (plane->fb_id)
+		plane->stats.enabled += now - plane->enabled_since;
+	if (fb_id)
+		plane->enabled_since = now;
+
+	plane->crtc_id = crtc_id;
+	plane->fb_id = fb_id;
+}
+
+static void
+shim_write_stats(void)
+{
+	struct shim_crtc *crtc;
+	struct shim_plane *plane;
+	uint64_t now = shim_now(), enabled, lifetime;
+	FILE *fp = stderr;
+	int i;
+
+	if (shim.stats_path) {
+		fp = fopen(shim.stats_path, "w");
+		if (!fp)
+			return;
+	}
+
+	lifetime = now - shim.start;
+
+	fprintf(fp, "kms-shim: ran for %.3f s\n", lifetime / 1000000.0);
+	for (i = 0; i < shim.noutputs; i++) {
+		crtc = &shim.crtcs[i];
+		fprintf(fp, "crtc %u: %u flips, %u skipped vblanks, "
+			"%u busy, flip latency avg %.3f ms max %.3f ms\n",
+			crtc->id, crtc->stats.flips, crtc->stats.skipped,
+			crtc->stats.busy,
+			crtc->stats.flips ?
+			crtc->stats.latency / 1000.0 / crtc->stats.flips : 0.0,
+			crtc->stats.latency_max / 1000.0);
+	}
+
+	for (i = 0; i < shim.nplanes; i++) {
+		plane = &shim.planes[i];
+		enabled = plane->stats.enabled;
+		if (plane->fb_id)
+			enabled += now - plane->enabled_since;
+		fprintf(fp, "plane %u: %u updates, %u rejected, "
+			"in use %.1f%%\n",
+			plane->id, plane->stats.updates, plane->stats.rejected,
+			lifetime ? enabled * 100.0 / lifetime : 0.0);
+	}
+
+	if (shim.rmfb_busy)
+		fprintf(fp, "%u framebuffers removed while scanned out\n",
+			shim.rmfb_busy);
+
+	if (fp != stderr)
+		fclose(fp);
+}
+
+/* weston-launch protocol, see src/launcher-util.c */
+static void *
+shim_launcher_thread(void *data)
+{
+	char buffer[4096];
+	struct weston_launcher_open *message = (void *) buffer;
+	union {
+		struct cmsghdr cmsg;
+		char control[CMSG_SPACE(sizeof(int))];
+	} u;
+	struct cmsghdr *cmsg;
+	struct msghdr msg;
+	struct iovec iov;
+	ssize_t len;
+	int ret, fd;
+
+	while (1) {
+		len = recv(shim.launcher_sock, buffer, sizeof buffer - 1, 0);
+		if (len < 0 && errno == EINTR)
+			continue;
+		if (len < (ssize_t) sizeof *message)
+			break;
+		buffer[len] = '\0';
+
+		if (message->header.opcode != WESTON_LAUNCHER_OPEN)
+			continue;
+
+		if (!strcmp(message->path, SHIM_DEVNODE))
+			fd = shim.fd;
+		else
+			fd = open(message->path, message->flags);
+		ret = fd < 0 ? -1 : 0;
+
+		memset(&msg, 0, sizeof msg);
+		iov.iov_base = &ret;
+		iov.iov_len = sizeof ret;
+		msg.msg_iov = &iov;
+		msg.msg_iovlen = 1;
+		if (fd >= 0) {
+			msg.msg_control = u.control;
+			msg.msg_controllen = sizeof u.control;
+			cmsg = CMSG_FIRSTHDR(&msg);
+			cmsg->cmsg_level = SOL_SOCKET;
+			cmsg->cmsg_type = SCM_RIGHTS;
+			cmsg->cmsg_len = CMSG_LEN(sizeof fd);
+			memcpy(CMSG_DATA(cmsg), &fd, sizeof fd);
+		}
+
+		do {
+			len = sendmsg(shim.launcher_sock, &msg, 0);
+		} while (len < 0 && errno == EINTR);
+
+		if (fd >= 0 && fd != shim.fd)
+			close(fd);
+	}
+
+	close(shim.launcher_sock);
+
+	return NULL;
+}
+
+static int
+shim_getenv_int(const char *name, int def, int min, int max)
+{
+	const char *s = getenv(name);
+	char *end;
+	long v;
+
+	if (!s)
+		return def;
+
+	v = strtol(s, &end, 10);
+	if (*end != '\0' || v < min || v > max) {
+		fprintf(stderr, "kms-shim: bad %s=%s\n", name, s);
+		return def;
+	}
+
+	return v;
+}
+
+static void
+shim_parse_formats(const char *s)
+{
+	shim.nformats = 0;
+	while (s && strlen(s) >= 4 && shim.nformats < SHIM_MAX_FORMATS) {
+		shim.formats[shim.nformats++] =
+			fourcc_code(s[0], s[1], s[2], s[3]);
+		s += 4;
+		if (*s != ',')
+			break;
+		s++;
+	}
+}
+
+static void __attribute__((constructor))
+shim_init(void)
+{
+	const char *s;
+	char str[16];
+	int sv[2], i;
+
+	/* Only simulate the device for the compositor itself, not for
+	 * the clients and helpers it spawns. */
+	if (strcmp(program_invocation_short_name, "weston") &&
+	    strcmp(program_invocation_short_name, "lt-weston"))
+		return;
+
+	unsetenv("LD_PRELOAD");
+
+	real_mmap = dlsym(RTLD_NEXT, "mmap");
+	real_munmap = dlsym(RTLD_NEXT, "munmap");
+
+	shim.noutputs = shim_getenv_int("WESTON_KMS_SHIM_OUTPUTS",
+					1, 1, SHIM_MAX_OUTPUTS);
+	shim.nplanes = shim_getenv_int("WESTON_KMS_SHIM_PLANES",
+				       2, 0, SHIM_MAX_PLANES);
+	shim.flip_delay = shim_getenv_int("WESTON_KMS_SHIM_FLIP_DELAY",
+					  0, 0, 1000) * 1000;
+	shim.stats_path = getenv("WESTON_KMS_SHIM_STATS");
+
+	s = getenv("WESTON_KMS_SHIM_PLANE_FORMATS");
+	shim_parse_formats(s ? s : "XR24,AR24");
+
+	shim.width = 1024;
+	shim.height = 768;
+	shim.refresh = 60;
+	s = getenv("WESTON_KMS_SHIM_MODE");
+	if (s && (sscanf(s, "%dx%d@%d", &shim.width, &shim.height,
+			 &shim.refresh) != 3 ||
+		  shim.width <= 0 || shim.height <= 0 || shim.refresh <= 0)) {
+		fprintf(stderr, "kms-shim: bad WESTON_KMS_SHIM_MODE=%s\n", s);
+		shim.width = 1024;
+		shim.height = 768;
+		shim.refresh = 60;
+	}
+
+	for (i = 0; i < shim.noutputs; i++) {
+		shim.crtcs[i].id = SHIM_CRTC_ID(i);
+		shim.crtcs[i].dpms = DRM_MODE_DPMS_ON;
+	}
+	for (i = 0; i < shim.nplanes; i++)
+		shim.planes[i].id = SHIM_PLANE_ID(i);
+	shim.next_fb_id = SHIM_FIRST_FB_ID;
+	shim.next_handle = 1;
+
+	shim.fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+	if (shim.fd < 0 || fstat(shim.fd, &shim.fd_stat) < 0) {
+		fprintf(stderr, "kms-shim: timerfd_create failed: %m\n");
+		return;
+	}
+
+	if (socketpair(AF_LOCAL, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, sv) < 0) {
+		fprintf(stderr, "kms-shim: socketpair failed: %m\n");
+		close(shim.fd);
+		return;
+	}
+
+	shim.launcher_sock = sv[0];
+	if (pthread_create(&shim.launcher_thread, NULL,
+			   shim_launcher_thread, NULL) != 0) {
+		fprintf(stderr, "kms-shim: failed to start launcher\n");
+		close(sv[0]);
+		close(sv[1]);
+		close(shim.fd);
+		return;
+	}
+	pthread_detach(shim.launcher_thread);
+
+	snprintf(str, sizeof str, "%d", sv[1]);
+	setenv("WESTON_LAUNCHER_SOCK", str, 1);
+
+	shim.start = shim_now();
+	shim.active = 1;
+}
+
+static void __attribute__((destructor))
+shim_fini(void)
+{
+	if (shim.active)
+		shim_write_stats();
+}
+
+/* libdrm */
+
+WL_EXPORT int
+drmGetCap(int fd, uint64_t capability, uint64_t *value)
+{
+	if (!shim_device(fd)) {
+		errno = EBADF;
+		return -EBADF;
+	}
+
+	switch (capability) {
+	case DRM_CAP_DUMB_BUFFER:
+	case DRM_CAP_TIMESTAMP_MONOTONIC:
+		*value = 1;
+		return 0;
+	default:
+		errno = EINVAL;
+		return -EINVAL;
+	}
+}
+
+WL_EXPORT int
+drmSetMaster(int fd)
+{
+	return 0;
+}
+
+WL_EXPORT int
+drmDropMaster(int fd)
+{
+	return 0;
+}
+
+WL_EXPORT int
+drmGetMagic(int fd, drm_magic_t *magic)
+{
+	*magic = 1;
+
+	return 0;
+}
+
+WL_EXPORT int
+drmAuthMagic(int fd, drm_magic_t magic)
+{
+	return 0;
+}
+
+WL_EXPORT int
+drmPrimeHandleToFD(int fd, uint32_t handle, uint32_t flags, int *prime_fd)
+{
+	errno = ENOSYS;
+
+	return -ENOSYS;
+}
+
+WL_EXPORT int
+drmIoctl(int fd, unsigned long request, void *arg)
+{
+	struct drm_mode_create_dumb *create = arg;
+	struct drm_mode_map_dumb *map = arg;
+	struct drm_mode_destroy_dumb *destroy = arg;
+	struct shim_bo *bo, **p;
+
+	if (!shim_device(fd)) {
+		errno = EBADF;
+		return -1;
+	}
+
+	switch (request) {
+	case DRM_IOCTL_MODE_CREATE_DUMB:
+		bo = calloc(1, sizeof *bo);
+		if (!bo) {
+			errno = ENOMEM;
+			return -1;
+		}
+		bo->pitch = (create->width * ((create->bpp + 7) / 8) + 63) &
+			~63;
+		bo->size = (uint64_t) bo->pitch * create->height;
+		bo->map = real_mmap(NULL, bo->size, PROT_READ | PROT_WRITE,
+				    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (bo->map == MAP_FAILED) {
+			free(bo);
+			errno = ENOMEM;
+			return -1;
+		}
+		bo->handle = shim.next_handle++;
+		bo->next = shim.bos;
+		shim.bos = bo;
+
+		create->handle = bo->handle;
+		create->pitch = bo->pitch;
+		create->size = bo->size;
+		return 0;
+
+	case DRM_IOCTL_MODE_MAP_DUMB:
+		if (!shim_bo_get(map->handle)) {
+			errno = ENOENT;
+			return -1;
+		}
+		map->offset = (uint64_t) map->handle << 12;
+		return 0;
+
+	case DRM_IOCTL_MODE_DESTROY_DUMB:
+		for (p = &shim.bos; *p; p = &(*p)->next) {
+			bo = *p;
+			if (bo->handle != destroy->handle)
+				continue;
+			*p = bo->next;
+			real_munmap(bo->map, bo->size);
+			free(bo);
+			return 0;
+		}
+		errno = ENOENT;
+		return -1;
+
+	default:
+		errno = EINVAL;
+		return -1;
+	}
+}
+
+WL_EXPORT void *
+mmap(void *addr, size_t length, int prot, int flags, int fd, off_t offset)
+{
+	struct shim_bo *bo;
+
+	if (shim_device(fd)) {
+		bo = shim_bo_get(offset >> 12);
+		if (!bo || length > bo->size) {
+			errno = EINVAL;
+			return MAP_FAILED;
+		}
+
+		return bo->map;
+	}
+
+	if (!real_mmap)
+		real_mmap = dlsym(RTLD_NEXT, "mmap");
+
+	return real_mmap(addr, length, prot, flags, fd, offset);
+}
+
+WL_EXPORT void *
+mmap64(void *addr, size_t length, int prot, int flags, int fd, off64_t offset)
+{
+	return mmap(addr, length, prot, flags, fd, offset);
+}
+
+WL_EXPORT int
+munmap(void *addr, size_t length)
+{
+	struct shim_bo *bo;
+
+	/* dumb buffer memory goes away with the buffer */
+	for (bo = shim.bos; bo; bo = bo->next)
+		if (bo->map == addr)
+			return 0;
+
+	if (!real_munmap)
+		real_munmap = dlsym(RTLD_NEXT, "munmap");
+
+	return real_munmap(addr, length);
+}
+
+WL_EXPORT drmModeResPtr
+drmModeGetResources(int fd)
+{
+	drmModeResPtr res;
+	int i;
+
+	if (!shim_device(fd))
+		return NULL;
+
+	res = calloc(1, sizeof *res);
+	if (!res)
+		return NULL;
+
+	res->count_crtcs = shim.noutputs;
+	res->count_encoders = shim.noutputs;
+	res->count_connectors = shim.noutputs;
+	res->crtcs = calloc(shim.noutputs, sizeof *res->crtcs);
+	res->encoders = calloc(shim.noutputs, sizeof *res->encoders);
+	res->connectors = calloc(shim.noutputs, sizeof *res->connectors);
+	if (!res->crtcs || !res->encoders || !res->connectors) {
+		drmModeFreeResources(res);
+		return NULL;
+	}
+
+	for (i = 0; i < shim.noutputs; i++) {
+		res->crtcs[i] = SHIM_CRTC_ID(i);
+		res->encoders[i] = SHIM_ENCODER_ID(i);
+		res->connectors[i] = SHIM_CONNECTOR_ID(i);
+	}
+	res->min_width = 1;
+	res->min_height = 1;
+	res->max_width = 8192;
+	res->max_height = 8192;
+
+	return res;
+}
+
+WL_EXPORT void
+drmModeFreeResources(drmModeResPtr res)
+{
+	if (!res)
+		return;
+
+	free(res->fbs);
+	free(res->crtcs);
+	free(res->encoders);
+	free(res->connectors);
+	free(res);
+}
+
+WL_EXPORT drmModeConnectorPtr
+drmModeGetConnector(int fd, uint32_t connector_id)
+{
+	drmModeConnectorPtr connector;
+	int i = connector_id - SHIM_CONNECTOR_ID(0);
+
+	if (!shim_device(fd) || i < 0 || i >= shim.noutputs) {
+		errno = ENOENT;
+		return NULL;
+	}
+
+	connector = calloc(1, sizeof *connector);
+	if (!connector)
+		return NULL;
+
+	connector->connector_id = connector_id;
+	connector->connector_type = DRM_MODE_CONNECTOR_HDMIA;
+	connector->connector_type_id = i + 1;
+	connector->connection = DRM_MODE_CONNECTED;
+	connector->subpixel = DRM_MODE_SUBPIXEL_UNKNOWN;
+	connector->mmWidth = shim.width * 254 / 960;
+	connector->mmHeight = shim.height * 254 / 960;
+	connector->encoder_id = 0;
+
+	connector->count_modes = 1;
+	connector->modes = calloc(1, sizeof *connector->modes);
+	connector->count_props = 1;
+	connector->props = calloc(1, sizeof *connector->props);
+	connector->prop_values = calloc(1, sizeof *connector->prop_values);
+	connector->count_encoders = 1;
+	connector->encoders = calloc(1, sizeof *connector->encoders);
+	if (!connector->modes || !connector->props ||
+	    !connector->prop_values || !connector->encoders) {
+		drmModeFreeConnector(connector);
+		return NULL;
+	}
+
+	shim_mode_init(&connector->modes[0],
+		       shim.width, shim.height, shim.refresh);
+	connector->props[0] = SHIM_DPMS_PROP_ID;
+	connector->prop_values[0] = shim.crtcs[i].dpms;
+	connector->encoders[0] = SHIM_ENCODER_ID(i);
+
+	return connector;
+}
+
+WL_EXPORT void
+drmModeFreeConnector(drmModeConnectorPtr connector)
+{
+	if (!connector)
+		return;
+
+	free(connector->modes);
+	free(connector->props);
+	free(connector->prop_values);
+	free(connector->encoders);
+	free(connector);
+}
+
+WL_EXPORT drmModeEncoderPtr
+drmModeGetEncoder(int fd, uint32_t encoder_id)
+{
+	drmModeEncoderPtr encoder;
+	int i = encoder_id - SHIM_ENCODER_ID(0);
+
+	if (!shim_device(fd) || i < 0 || i >= shim.noutputs) {
+		errno = ENOENT;
+		return NULL;
+	}
+
+	encoder = calloc(1, sizeof *encoder);
+	if (!encoder)
+		return NULL;
+
+	encoder->encoder_id = encoder_id;
+	encoder->encoder_type = DRM_MODE_ENCODER_TMDS;
+	encoder->crtc_id = 0;
+	encoder->possible_crtcs = 1 << i;
+
+	return encoder;
+}
+
+WL_EXPORT void
+drmModeFreeEncoder(drmModeEncoderPtr encoder)
+{
+	free(encoder);
+}
+
+WL_EXPORT drmModeCrtcPtr
+drmModeGetCrtc(int fd, uint32_t crtc_id)
+{
+	struct shim_crtc *crtc;
+	drmModeCrtcPtr r;
+
+	crtc = shim_crtc_get(crtc_id);
+	if (!shim_device(fd) || !crtc) {
+		errno = ENOENT;
+		return NULL;
+	}
+
+	r = calloc(1, sizeof *r);
+	if (!r)
+		return NULL;
+
+	r->crtc_id = crtc->id;
+	r->buffer_id = crtc->fb_id;
+	r->mode_valid = crtc->mode_valid;
+	if (crtc->mode_valid) {
+		r->mode = crtc->mode;
+		r->width = crtc->mode.hdisplay;
+		r->height = crtc->mode.vdisplay;
+	}
+	r->gamma_size = 256;
+
+	return r;
+}
+
+WL_EXPORT void
+drmModeFreeCrtc(drmModeCrtcPtr crtc)
+{
+	free(crtc);
+}
+
+WL_EXPORT int
+drmModeSetCrtc(int fd, uint32_t crtc_id, uint32_t buffer_id,
+	       uint32_t x, uint32_t y, uint32_t *connectors, int count,
+	       drmModeModeInfoPtr mode)
+{
+	struct shim_crtc *crtc;
+
+	crtc = shim_crtc_get(crtc_id);
+	if (!shim_device(fd) || !crtc) {
+		errno = ENOENT;
+		return -ENOENT;
+	}
+
+	if (!buffer_id || !mode) {
+		crtc->fb_id = 0;
+		crtc->mode_valid = 0;
+		return 0;
+	}
+
+	if (!shim_fb_get(buffer_id)) {
+		errno = ENOENT;
+		return -ENOENT;
+	}
+
+	if (!crtc->mode_valid ||
+	    memcmp(&crtc->mode, mode, sizeof *mode) != 0) {
+		crtc->mode = *mode;
+		crtc->mode_valid = 1;
+		crtc->period = shim_mode_period(mode);
+		crtc->epoch = shim_now();
+		crtc->stats.last_flip = 0;
+	}
+	crtc->fb_id = buffer_id;
+
+	return 0;
+}
+
+WL_EXPORT int
+drmModeCrtcSetGamma(int fd, uint32_t crtc_id, uint32_t size,
+		    uint16_t *red, uint16_t *green, uint16_t *blue)
+{
+	if (!shim_device(fd) || !shim_crtc_get(crtc_id) || size != 256) {
+		errno = EINVAL;
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
+WL_EXPORT int
+drmModeSetCursor(int fd, uint32_t crtc_id, uint32_t bo_handle,
+		 uint32_t width, uint32_t height)
+{
+	if (!shim_device(fd) || !shim_crtc_get(crtc_id)) {
+		errno = ENOENT;
+		return -ENOENT;
+	}
+
+	/* no cursor planes */
+	errno = ENXIO;
+	return bo_handle ? -ENXIO : 0;
+}
+
+WL_EXPORT int
+drmModeMoveCursor(int fd, uint32_t crtc_id, int x, int y)
+{
+	errno = ENXIO;
+
+	return -ENXIO;
+}
+
+static int
+shim_add_fb(uint32_t width, uint32_t height, uint32_t format,
+	    uint32_t handle, uint32_t *buf_id)
+{
+	struct shim_fb *fb;
+
+	if (!shim_bo_get(handle)) {
+		errno = ENOENT;
+		return -ENOENT;
+	}
+
+	fb = calloc(1, sizeof *fb);
+	if (!fb) {
+		errno = ENOMEM;
+		return -ENOMEM;
+	}
+
+	fb->id = shim.next_fb_id++;
+	fb->width = width;
+	fb->height = height;
+	fb->format = format;
+	fb->next = shim.fbs;
+	shim.fbs = fb;
+	*buf_id = fb->id;
+
+	return 0;
+}
+
+WL_EXPORT int
+drmModeAddFB(int fd, uint32_t width, uint32_t height, uint8_t depth,
+	     uint8_t bpp, uint32_t pitch, uint32_t bo_handle, uint32_t *buf_id)
+{
+	uint32_t format;
+
+	if (!shim_device(fd)) {
+		errno = EBADF;
+		return -EBADF;
+	}
+
+	if (bpp == 32 && depth == 24)
+		format = DRM_FORMAT_XRGB8888;
+	else if (bpp == 32 && depth == 32)
+		format = DRM_FORMAT_ARGB8888;
+	else if (bpp == 16 && depth == 16)
+		format = DRM_FORMAT_RGB565;
+	else {
+		errno = EINVAL;
+		return -EINVAL;
+	}
+
+	return shim_add_fb(width, height, format, bo_handle, buf_id);
+}
+
+WL_EXPORT int
+drmModeAddFB2(int fd, uint32_t width, uint32_t height, uint32_t pixel_format,
+	      uint32_t bo_handles[4], uint32_t pitches[4], uint32_t offsets[4],
+	      uint32_t *buf_id, uint32_t flags)
+{
+	if (!shim_device(fd)) {
+		errno = EBADF;
+		return -EBADF;
+	}
+
+	return shim_add_fb(width, height, pixel_format, bo_handles[0], buf_id);
+}
+
+WL_EXPORT int
+drmModeRmFB(int fd, uint32_t buffer_id)
+{
+	struct shim_fb *fb, **p;
+	int i;
+
+	if (!shim_device(fd)) {
+		errno = EBADF;
+		return -EBADF;
+	}
+
+	for (p = &shim.fbs; *p; p = &(*p)->next) {
+		fb = *p;
+		if (fb->id != buffer_id)
+			continue;
+
+		/* The kernel would turn off the crtc or plane here;
+		 * the backend should never get into that situation. */
+		for (i = 0; i < shim.noutputs; i++)
+			if (shim.crtcs[i].fb_id == buffer_id ||
+			    (shim.crtcs[i].flip_pending &&
+			     shim.crtcs[i].pending_fb_id == buffer_id))
+				shim.rmfb_busy++;
+		for (i = 0; i < shim.nplanes; i++)
+			if (shim.planes[i].fb_id == buffer_id) {
+				shim.rmfb_busy++;
+				shim_plane_set_fb(&shim.planes[i], 0, 0);
+			}
+
+		*p = fb->next;
+		free(fb);
+		return 0;
+	}
+
+	errno = ENOENT;
+	return -ENOENT;
+}
+
+WL_EXPORT int
+drmModePageFlip(int fd, uint32_t crtc_id, uint32_t fb_id,
+		uint32_t flags, void *user_data)
+{
+	struct shim_crtc *crtc;
+	uint64_t now;
+
+	crtc = shim_crtc_get(crtc_id);
+	if (!shim_device(fd) || !crtc || !shim_fb_get(fb_id)) {
+		errno = ENOENT;
+		return -ENOENT;
+	}
+
+	if (!crtc->mode_valid) {
+		errno = EINVAL;
+		return -EINVAL;
+	}
+
+	if (crtc->flip_pending) {
+		crtc->stats.busy++;
+		errno = EBUSY;
+		return -EBUSY;
+	}
+
+	now = shim_now();
+	crtc->flip_pending = 1;
+	crtc->pending_fb_id = fb_id;
+	shim_queue_event(SHIM_EVENT_FLIP, crtc,
+			 shim_crtc_next_vblank(crtc, now + shim.flip_delay),
+			 now, (flags & DRM_MODE_PAGE_FLIP_EVENT) ?
+			 user_data : NULL);
+
+	return 0;
+}
+
+WL_EXPORT drmModePlaneResPtr
+drmModeGetPlaneResources(int fd)
+{
+	drmModePlaneResPtr res;
+	int i;
+
+	if (!shim_device(fd)) {
+		errno = EBADF;
+		return NULL;
+	}
+
+	res = calloc(1, sizeof *res);
+	if (!res)
+		return NULL;
+
+	res->count_planes = shim.nplanes;
+	res->planes = calloc(shim.nplanes ? shim.nplanes : 1,
+			     sizeof *res->planes);
+	if (!res->planes) {
+		free(res);
+		return NULL;
+	}
+
+	for (i = 0; i < shim.nplanes; i++)
+		res->planes[i] = shim.planes[i].id;
+
+	return res;
+}
+
+WL_EXPORT void
+drmModeFreePlaneResources(drmModePlaneResPtr res)
+{
+	if (!res)
+		return;
+
+	free(res->planes);
+	free(res);
+}
+
+WL_EXPORT drmModePlanePtr
+drmModeGetPlane(int fd, uint32_t plane_id)
+{
+	struct shim_plane *plane;
+	drmModePlanePtr r;
+
+	plane = shim_plane_get(plane_id);
+	if (!shim_device(fd) || !plane) {
+		errno = ENOENT;
+		return NULL;
+	}
+
+	r = calloc(1, sizeof *r);
+	if (!r)
+		return NULL;
+
+	r->count_formats = shim.nformats;
+	r->formats = calloc(shim.nformats ? shim.nformats : 1,
+			    sizeof *r->formats);
+	if (!r->formats) {
+		free(r);
+		return NULL;
+	}
+	memcpy(r->formats, shim.formats, shim.nformats * sizeof *r->formats);
+
+	r->plane_id = plane->id;
+	r->crtc_id = plane->crtc_id;
+	r->fb_id = plane->fb_id;
+	r->possible_crtcs = (1 << shim.noutputs) - 1;
+	r->gamma_size = 0;
+
+	return r;
+}
+
+WL_EXPORT void
+drmModeFreePlane(drmModePlanePtr plane)
+{
+	if (!plane)
+		return;
+
+	free(plane->formats);
+	free(plane);
+}
+
+WL_EXPORT int
+drmModeSetPlane(int fd, uint32_t plane_id, uint32_t crtc_id,
+		uint32_t fb_id, uint32_t flags,
+		int32_t crtc_x, int32_t crtc_y,
+		uint32_t crtc_w, uint32_t crtc_h,
+		uint32_t src_x, uint32_t src_y,
+		uint32_t src_w, uint32_t src_h)
+{
+	struct shim_plane *plane;
+	struct shim_fb *fb;
+	int i;
+
+	plane = shim_plane_get(plane_id);
+	if (!shim_device(fd) || !plane) {
+		errno = ENOENT;
+		return -ENOENT;
+	}
+
+	if (!fb_id) {
+		shim_plane_set_fb(plane, 0, 0);
+		return 0;
+	}
+
+	fb = shim_fb_get(fb_id);
+	if (!fb || !shim_crtc_get(crtc_id)) {
+		plane->stats.rejected++;
+		errno = ENOENT;
+		return -ENOENT;
+	}
+
+	for (i = 0; i < shim.nformats; i++)
+		if (shim.formats[i] == fb->format)
+			break;
+
+	/* src coordinates are 16.16 fixed point */
+	if (i == shim.nformats ||
+	    (src_x >> 16) + (src_w >> 16) > fb->width ||
+	    (src_y >> 16) + (src_h >> 16) > fb->height) {
+		plane->stats.rejected++;
+		errno = EINVAL;
+		return -EINVAL;
+	}
+
+	plane->stats.updates++;
+	shim_plane_set_fb(plane, crtc_id, fb_id);
+
+	return 0;
+}
+
+WL_EXPORT drmModePropertyPtr
+drmModeGetProperty(int fd, uint32_t property_id)
+{
+	drmModePropertyPtr prop;
+
+	if (!shim_device(fd) || property_id != SHIM_DPMS_PROP_ID) {
+		errno = ENOENT;
+		return NULL;
+	}
+
+	prop = calloc(1, sizeof *prop);
+	if (!prop)
+		return NULL;
+
+	prop->prop_id = property_id;
+	prop->flags = DRM_MODE_PROP_ENUM;
+	strcpy(prop->name, "DPMS");
+
+	return prop;
+}
+
+WL_EXPORT void
+drmModeFreeProperty(drmModePropertyPtr prop)
+{
+	if (!prop)
+		return;
+
+	free(prop->values);
+	free(prop->enums);
+	free(prop->blob_ids);
+	free(prop);
+}
+
+WL_EXPORT drmModePropertyBlobPtr
+drmModeGetPropertyBlob(int fd, uint32_t blob_id)
+{
+	errno = ENOENT;
+
+	return NULL;
+}
+
+WL_EXPORT void
+drmModeFreePropertyBlob(drmModePropertyBlobPtr blob)
+{
+	free(blob);
+}
+
+WL_EXPORT int
+drmModeConnectorSetProperty(int fd, uint32_t connector_id,
+			    uint32_t property_id, uint64_t value)
+{
+	int i = connector_id - SHIM_CONNECTOR_ID(0);
+
+	if (!shim_device(fd) || i < 0 || i >= shim.noutputs ||
+	    property_id != SHIM_DPMS_PROP_ID) {
+		errno = ENOENT;
+		return -ENOENT;
+	}
+
+	shim.crtcs[i].dpms = value;
+
+	return 0;
+}
+
+WL_EXPORT int
+drmWaitVBlank(int fd, drmVBlankPtr vbl)
+{
+	struct shim_crtc *crtc;
+	uint64_t now, target;
+	unsigned int sequence;
+	int pipe = 0;
+
+	if (!shim_device(fd)) {
+		errno = EBADF;
+		return -EBADF;
+	}
+
+	if (vbl->request.type & DRM_VBLANK_SECONDARY)
+		pipe = 1;
+	else if (vbl->request.type & DRM_VBLANK_HIGH_CRTC_MASK)
+		pipe = (vbl->request.type & DRM_VBLANK_HIGH_CRTC_MASK) >>
+			DRM_VBLANK_HIGH_CRTC_SHIFT;
+
+	if (pipe >= shim.noutputs || !shim.crtcs[pipe].mode_valid) {
+		errno = EINVAL;
+		return -EINVAL;
+	}
+	crtc = &shim.crtcs[pipe];
+
+	now = shim_now();
+	sequence = vbl->request.sequence;
+	if (vbl->request.type & DRM_VBLANK_RELATIVE)
+		sequence += shim_crtc_sequence(crtc, now);
+
+	target = crtc->epoch + (uint64_t) sequence * crtc->period;
+	if (target < now && (vbl->request.type & DRM_VBLANK_NEXTONMISS))
+		target = shim_crtc_next_vblank(crtc, now);
+
+	if (vbl->request.type & DRM_VBLANK_EVENT) {
+		shim_queue_event(SHIM_EVENT_VBLANK, crtc,
+				 target < now ? now : target, now,
+				 (void *) vbl->request.signal);
+		vbl->reply.sequence = shim_crtc_sequence(crtc, target);
+		return 0;
+	}
+
+	if (target > now)
+		usleep(target - now);
+	else
+		target = crtc->epoch +
+			shim_crtc_sequence(crtc, now) * crtc->period;
+
+	vbl->reply.sequence = shim_crtc_sequence(crtc, target);
+	vbl->reply.tval_sec = target / 1000000;
+	vbl->reply.tval_usec = target % 1000000;
+
+	return 0;
+}
+
+WL_EXPORT int
+drmHandleEvent(int fd, drmEventContextPtr context)
+{
+	struct shim_event *event;
+	struct shim_crtc *crtc;
+	unsigned int sequence, sec, usec;
+	uint64_t expirations, latency;
+
+	if (!shim_device(fd)) {
+		errno = EBADF;
+		return -1;
+	}
+
+	if (read(shim.fd, &expirations, sizeof expirations) < 0 &&
+	    errno != EAGAIN)
+		return -1;
+
+	while (shim.events && shim.events->time <= shim_now()) {
+		event = shim.events;
+		shim.events = event->next;
+		crtc = event->crtc;
+
+		sequence = shim_crtc_sequence(crtc, event->time);
+		sec = event->time / 1000000;
+		usec = event->time % 1000000;
+
+		switch (event->type) {
+		case SHIM_EVENT_FLIP:
+			crtc->fb_id = crtc->pending_fb_id;
+			crtc->flip_pending = 0;
+
+			latency = event->time - event->requested;
+			crtc->stats.flips++;
+			crtc->stats.latency += latency;
+			if (latency > crtc->stats.latency_max)
+				crtc->stats.latency_max = latency;
+			if (crtc->stats.last_flip &&
+			    sequence > crtc->stats.last_flip + 1)
+				crtc->stats.skipped +=
+					sequence - crtc->stats.last_flip - 1;
+			crtc->stats.last_flip = sequence;
+
+			if (event->data && context->page_flip_handler)
+				context->page_flip_handler(fd, sequence,
+							   sec, usec,
+							   event->data);
+			break;
+		case SHIM_EVENT_VBLANK:
+			if (context->vblank_handler)
+				context->vblank_handler(fd, sequence,
+							sec, usec,
+							event->data);
+			break;
+		}
+
+		free(event);
+	}
+
+	shim_arm_timer();
+
+	return 0;
+}
+
+/* gbm, importing kms-shim.h buffers only */
+
+WL_EXPORT struct gbm_device *
+gbm_create_device(int fd)
+{
+	if (!shim_device(fd)) {
+		errno = ENODEV;
+		return NULL;
+	}
+
+	shim.gbm.fd = fd;
+
+	return (struct gbm_device *) &shim.gbm;
+}
+
+WL_EXPORT void
+gbm_device_destroy(struct gbm_device *gbm)
+{
+}
+
+WL_EXPORT int
+gbm_device_get_fd(struct gbm_device *gbm)
+{
+	return ((struct shim_gbm_device *) gbm)->fd;
+}
+
+WL_EXPORT struct gbm_bo *
+gbm_bo_import(struct gbm_device *gbm, uint32_t type,
+	      void *buffer, uint32_t usage)
+{
+	struct wl_resource *resource = buffer;
+	struct kms_shim_buffer *shim_buffer;
+	struct shim_gbm_bo *gbo;
+	struct shim_bo *bo;
+
+	/* shm buffers can't be imported on real hardware either */
+	if (type != GBM_BO_IMPORT_WL_BUFFER || wl_shm_buffer_get(resource))
+		return NULL;
+
+	shim_buffer = wl_resource_get_user_data(resource);
+	if (!shim_buffer || shim_buffer->magic != KMS_SHIM_BUFFER_MAGIC)
+		return NULL;
+
+	gbo = calloc(1, sizeof *gbo);
+	bo = calloc(1, sizeof *bo);
+	if (!gbo || !bo) {
+		free(gbo);
+		free(bo);
+		return NULL;
+	}
+
+	/* no memory behind it, nothing reads scanout buffers */
+	bo->handle = shim.next_handle++;
+	bo->pitch = (shim_buffer->width * 4 + 63) & ~63;
+	bo->size = (uint64_t) bo->pitch * shim_buffer->height;
+	bo->next = shim.bos;
+	shim.bos = bo;
+
+	gbo->device = (struct shim_gbm_device *) gbm;
+	gbo->bo = bo;
+	gbo->width = shim_buffer->width;
+	gbo->height = shim_buffer->height;
+	gbo->format = shim_buffer->format;
+
+	return (struct gbm_bo *) gbo;
+}
+
+WL_EXPORT uint32_t
+gbm_bo_get_width(struct gbm_bo *bo)
+{
+	return ((struct shim_gbm_bo *) bo)->width;
+}
+
+WL_EXPORT uint32_t
+gbm_bo_get_height(struct gbm_bo *bo)
+{
+	return ((struct shim_gbm_bo *) bo)->height;
+}
+
+WL_EXPORT uint32_t
+gbm_bo_get_stride(struct gbm_bo *bo)
+{
+	return ((struct shim_gbm_bo *) bo)->bo->pitch;
+}
+
+WL_EXPORT uint32_t
+gbm_bo_get_format(struct gbm_bo *bo)
+{
+	return ((struct shim_gbm_bo *) bo)->format;
+}
+
+WL_EXPORT union gbm_bo_handle
+gbm_bo_get_handle(struct gbm_bo *bo)
+{
+	union gbm_bo_handle handle;
+
+	handle.u64 = ((struct shim_gbm_bo *) bo)->bo->handle;
+
+	return handle;
+}
+
+WL_EXPORT struct gbm_device *
+gbm_bo_get_device(struct gbm_bo *bo)
+{
+	return (struct gbm_device *) ((struct shim_gbm_bo *) bo)->device;
+}
+
+WL_EXPORT void
+gbm_bo_set_user_data(struct gbm_bo *bo, void *data,
+		     void (*destroy_user_data)(struct gbm_bo *, void *))
+{
+	struct shim_gbm_bo *gbo = (struct shim_gbm_bo *) bo;
+
+	gbo->user_data = data;
+	gbo->destroy_user_data = destroy_user_data;
+}
+
+WL_EXPORT void *
+gbm_bo_get_user_data(struct gbm_bo *bo)
+{
+	return ((struct shim_gbm_bo *) bo)->user_data;
+}
+
+WL_EXPORT void
+gbm_bo_destroy(struct gbm_bo *bo)
+{
+	struct shim_gbm_bo *gbo = (struct shim_gbm_bo *) bo;
+	struct shim_bo **p;
+
+	if (gbo->destroy_user_data)
+		gbo->destroy_user_data(bo, gbo->user_data);
+
+	for (p = &shim.bos; *p; p = &(*p)->next) {
+		if (*p != gbo->bo)
+			continue;
+		*p = gbo->bo->next;
+		break;
+	}
+
+	free(gbo->bo);
+	free(gbo);
+}
+
+/* libudev, just enough to find the simulated card */
+
+struct udev {
+	int refcount;
+};
+
+struct udev_list_entry {
+	const char *name;
+	struct udev_list_entry *next;
+};
+
+struct udev_enumerate {
+	int match_drm;
+	struct udev_list_entry card;
+	struct udev_list_entry *list;
+};
+
+struct udev_device {
+	int refcount;
+};
+
+struct udev_monitor {
+	int fd;
+};
+
+static struct udev_device shim_udev_card = { 1 };
+
+WL_EXPORT struct udev *
+udev_new(void)
+{
+	struct udev *udev;
+
+	udev = calloc(1, sizeof *udev);
+	if (udev)
+		udev->refcount = 1;
+
+	return udev;
+}
+
+WL_EXPORT struct udev *
+udev_ref(struct udev *udev)
+{
+	udev->refcount++;
+
+	return udev;
+}
+
+WL_EXPORT struct udev *
+udev_unref(struct udev *udev)
+{
+	if (udev && --udev->refcount == 0)
+		free(udev);
+
+	return NULL;
+}
+
+WL_EXPORT struct udev_enumerate *
+udev_enumerate_new(struct udev *udev)
+{
+	return calloc(1, sizeof(struct udev_enumerate));
+}
+
+WL_EXPORT struct udev_enumerate *
+udev_enumerate_unref(struct udev_enumerate *e)
+{
+	free(e);
+
+	return NULL;
+}
+
+WL_EXPORT int
+udev_enumerate_add_match_subsystem(struct udev_enumerate *e,
+				   const char *subsystem)
+{
+	if (!strcmp(subsystem, "drm"))
+		e->match_drm = 1;
+
+	return 0;
+}
+
+WL_EXPORT int
+udev_enumerate_add_match_sysname(struct udev_enumerate *e,
+				 const char *sysname)
+{
+	return 0;
+}
+
+WL_EXPORT int
+udev_enumerate_scan_devices(struct udev_enumerate *e)
+{
+	/* no input devices, only the card */
+	if (e->match_drm && shim.active) {
+		e->card.name = SHIM_SYSPATH;
+		e->list = &e->card;
+	}
+
+	return 0;
+}
+
+WL_EXPORT struct udev_list_entry *
+udev_enumerate_get_list_entry(struct udev_enumerate *e)
+{
+	return e->list;
+}
+
+WL_EXPORT struct udev_list_entry *
+udev_list_entry_get_next(struct udev_list_entry *entry)
+{
+	return entry->next;
+}
+
+WL_EXPORT const char *
+udev_list_entry_get_name(struct udev_list_entry *entry)
+{
+	return entry->name;
+}
+
+WL_EXPORT struct udev_device *
+udev_device_new_from_syspath(struct udev *udev, const char *syspath)
+{
+	if (strcmp(syspath, SHIM_SYSPATH))
+		return NULL;
+
+	shim_udev_card.refcount++;
+
+	return &shim_udev_card;
+}
+
+WL_EXPORT struct udev_device *
+udev_device_unref(struct udev_device *device)
+{
+	if (device)
+		device->refcount--;
+
+	return NULL;
+}
+
+WL_EXPORT const char *
+udev_device_get_syspath(struct udev_device *device)
+{
+	return SHIM_SYSPATH;
+}
+
+WL_EXPORT const char *
+udev_device_get_sysname(struct udev_device *device)
+{
+	return "card0";
+}
+
+WL_EXPORT const char *
+udev_device_get_sysnum(struct udev_device *device)
+{
+	return "0";
+}
+
+WL_EXPORT const char *
+udev_device_get_devnode(struct udev_device *device)
+{
+	return SHIM_DEVNODE;
+}
+
+WL_EXPORT const char *
+udev_device_get_action(struct udev_device *device)
+{
+	return NULL;
+}
+
+WL_EXPORT const char *
+udev_device_get_property_value(struct udev_device *device, const char *key)
+{
+	return NULL;
+}
+
+WL_EXPORT const char *
+udev_device_get_sysattr_value(struct udev_device *device, const char *sysattr)
+{
+	return NULL;
+}
+
+WL_EXPORT struct udev_device *
+udev_device_get_parent_with_subsystem_devtype(struct udev_device *device,
+					      const char *subsystem,
+					      const char *devtype)
+{
+	return NULL;
+}
+
+WL_EXPORT struct udev_monitor *
+udev_monitor_new_from_netlink(struct udev *udev, const char *name)
+{
+	struct udev_monitor *monitor;
+
+	monitor = calloc(1, sizeof *monitor);
+	if (!monitor)
+		return NULL;
+
+	/* never readable, there are no hotplug events */
+	monitor->fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+	if (monitor->fd < 0) {
+		free(monitor);
+		return NULL;
+	}
+
+	return monitor;
+}
+
+WL_EXPORT struct udev_monitor *
+udev_monitor_unref(struct udev_monitor *monitor)
+{
+	if (monitor) {
+		close(monitor->fd);
+		free(monitor);
+	}
+
+	return NULL;
+}
+
+WL_EXPORT int
+udev_monitor_filter_add_match_subsystem_devtype(struct udev_monitor *monitor,
+						const char *subsystem,
+						const char *devtype)
+{
+	return 0;
+}
+
+WL_EXPORT int
+udev_monitor_enable_receiving(struct udev_monitor *monitor)
+{
+	return 0;
+}
+
+WL_EXPORT int
+udev_monitor_get_fd(struct udev_monitor *monitor)
+{
+	return monitor->fd;
+}
+
+WL_EXPORT struct udev_device *
+udev_monitor_receive_device(struct udev_monitor *monitor)
+{
+	return NULL;
+}
@@ -22,6 +22,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <math.h>
 #include <unistd.h>
 #include <signal.h>
@@ -177,6 +178,97 @@ randomize_matrix(struct weston_matrix *m)
 #else
 		m->d[i] = frand();
 #endif
+	m->type = WESTON_MATRIX_TRANSFORM_OTHER;
+}
+
+/* Build a matrix with exactly the given type bits through the helpers */
+static void
+random_typed_matrix(struct weston_matrix *m, unsigned int type)
+{
+	double angle;
+
+	if (type & WESTON_MATRIX_TRANSFORM_OTHER) {
+		randomize_matrix(m);
+		return;
+	}
+
+	weston_matrix_init(m);
+	if (type & WESTON_MATRIX_TRANSFORM_SCALE)
+		weston_matrix_scale(m, 0.1 + 4.0 * fabs(frand()),
+				    0.1 + 4.0 * fabs(frand()),
+				    0.1 + 4.0 * fabs(frand()));
+	if (type & WESTON_MATRIX_TRANSFORM_ROTATE) {
+		angle = M_PI * frand();
+		weston_matrix_rotate_xy(m, cos(angle), sin(angle));
+	}
+	if (type & WESTON_MATRIX_TRANSFORM_TRANSLATE)
+		weston_matrix_translate(m, 1000.0 * frand(), 1000.0 * frand(),
+					10.0 * frand());
+}
+
+/* Plain scalar versions of the matrix operations, as references for
+ * the SIMD and matrix type specific code paths. */
+static void
+ref_multiply(struct weston_matrix *m, const struct weston_matrix *n)
+{
+	struct weston_matrix tmp;
+	unsigned i, j;
+
+	for (i = 0; i < 16; i++) {
+		tmp.d[i] = 0;
+		for (j = 0; j < 4; j++)
+			tmp.d[i] += m->d[(i / 4) * 4 + j] * n->d[i % 4 + j * 4];
+	}
+	tmp.type = m->type | n->type;
+	*m = tmp;
+}
+
+static void
+ref_transform(const struct weston_matrix *m, struct weston_vector *v)
+{
+	struct weston_vector t;
+	unsigned i, j;
+
+	for (i = 0; i < 4; i++) {
+		t.f[i] = 0;
+		for (j = 0; j < 4; j++)
+			t.f[i] += v->f[j] * m->d[i + j * 4];
+	}
+	*v = t;
+}
+
+static int
+ref_invert(struct weston_matrix *inverse, const struct weston_matrix *m)
+{
+	struct inverse_matrix q;
+	unsigned i;
+
+	if (matrix_invert(q.LU, q.perm, m) != 0)
+		return -1;
+
+	weston_matrix_init(inverse);
+	for (i = 0; i < 4; ++i)
+		inverse_transform(q.LU, q.perm, &inverse->d[i * 4]);
+	inverse->type = m->type;
+
+	return 0;
+}
+
+/* Largest difference relative to the largest element of the reference */
+static double
+matrix_error(const float *a, const float *ref, unsigned n)
+{
+	double err = 0.0, mag = 1.0;
+	unsigned i;
+
+	for (i = 0; i < n; i++) {
+		if (fabs(ref[i]) > mag)
+			mag = fabs(ref[i]);
+		if (fabs(a[i] - ref[i]) > err)
+			err = fabs(a[i] - ref[i]);
+	}
+
+	return err / mag;
 }
 
 /* Take a matrix, compute inverse, multiply together
@@ -238,7 +330,7 @@ test(void)
 	return TEST_FAIL;
 }
 
-static int running;
+static volatile sig_atomic_t running;
 static void
 stopme(int n)
 {
@@ -265,6 +357,217 @@ test_loop_precision(void)
 	       counts[TEST_FAIL]);
 }
 
+static const unsigned int test_types[] = {
+	0,
+	WESTON_MATRIX_TRANSFORM_TRANSLATE,
+	WESTON_MATRIX_TRANSFORM_SCALE,
+	WESTON_MATRIX_TRANSFORM_TRANSLATE | WESTON_MATRIX_TRANSFORM_SCALE,
+	WESTON_MATRIX_TRANSFORM_ROTATE,
+	WESTON_MATRIX_TRANSFORM_TRANSLATE | WESTON_MATRIX_TRANSFORM_SCALE |
+		WESTON_MATRIX_TRANSFORM_ROTATE,
+	WESTON_MATRIX_TRANSFORM_OTHER,
+};
+
+#define NUM_TEST_TYPES (sizeof test_types / sizeof test_types[0])
+
+static const char *
+type_name(unsigned int type)
+{
+	static char buf[8];
+
+	if (type & WESTON_MATRIX_TRANSFORM_OTHER)
+		return "other";
+
+	snprintf(buf, sizeof buf, "%s%s%s",
+		 type & WESTON_MATRIX_TRANSFORM_TRANSLATE ? "T" : "",
+		 type & WESTON_MATRIX_TRANSFORM_SCALE ? "S" : "",
+		 type & WESTON_MATRIX_TRANSFORM_ROTATE ? "R" : "");
+
+	return type ? buf : "identity";
+}
+
+/* Compare multiply, transform and invert against the scalar reference
+ * for every pair of matrix types.  Returns the number of failures. */
+static int
+test_fast_paths(void)
+{
+	struct weston_matrix a, b, r, ref;
+	struct weston_vector v, w;
+	unsigned i, j, k, l;
+	int failed = 0;
+
+	printf("\nComparing matrix operations against the reference...\n");
+
+	for (i = 0; i < NUM_TEST_TYPES; i++)
+	for (j = 0; j < NUM_TEST_TYPES; j++)
+	for (k = 0; k < 1000; k++) {
+		random_typed_matrix(&a, test_types[i]);
+		random_typed_matrix(&b, test_types[j]);
+
+		r = a;
+		ref = a;
+		weston_matrix_multiply(&r, &b);
+		ref_multiply(&ref, &b);
+		if (r.type != ref.type ||
+		    matrix_error(r.d, ref.d, 16) > 1e-6) {
+			printf("multiply %s * %s failed\n",
+			       type_name(test_types[j]),
+			       type_name(test_types[i]));
+			failed++;
+		}
+
+		for (l = 0; l < 4; l++)
+			v.f[l] = 100.0 * frand();
+		v.f[3] = 1.0;
+		w = v;
+		weston_matrix_transform(&a, &v);
+		ref_transform(&a, &w);
+		if (matrix_error(v.f, w.f, 4) > 1e-6) {
+			printf("transform %s failed\n",
+			       type_name(test_types[i]));
+			failed++;
+		}
+
+		if (weston_matrix_invert(&r, &a) != ref_invert(&ref, &a)) {
+			printf("invert %s disagrees on invertibility\n",
+			       type_name(test_types[i]));
+			failed++;
+		} else if (matrix_error(r.d, ref.d, 16) > 1e-5 &&
+			   !(test_types[i] & WESTON_MATRIX_TRANSFORM_OTHER)) {
+			printf("invert %s failed\n",
+			       type_name(test_types[i]));
+			failed++;
+		}
+	}
+
+	printf("%d failures.\n", failed);
+
+	return failed;
+}
+
+/* A matrix filled in through d[] like weston-calibrator does, marked
+ * as WESTON_MATRIX_TRANSFORM_OTHER, must not take the fast paths meant
+ * for matrices built by the helpers.  Returns the number of failures. */
+static int
+test_hand_built(void)
+{
+	static const float clicked[3][2] = {
+		{ 102.0, 77.0 }, { 713.0, 95.0 }, { 388.0, 534.0 }
+	};
+	struct weston_matrix m, r, ref;
+	struct weston_vector v, w;
+	unsigned i;
+	int failed = 0;
+
+	printf("\nChecking a hand-built matrix...\n");
+
+	memset(&m, 0, sizeof m);
+	for (i = 0; i < 3; i++) {
+		m.d[i] = clicked[i][0];
+		m.d[i + 4] = clicked[i][1];
+		m.d[i + 8] = 1;
+	}
+	m.d[15] = 1;
+	m.type = WESTON_MATRIX_TRANSFORM_OTHER;
+
+	if (weston_matrix_invert(&r, &m) != 0 || ref_invert(&ref, &m) != 0 ||
+	    matrix_error(r.d, ref.d, 16) > 1e-6) {
+		printf("invert of a hand-built matrix failed\n");
+		failed++;
+	}
+
+	/* translating must not turn it into a translate-only matrix */
+	r = m;
+	ref = m;
+	weston_matrix_translate(&r, 10.0, 20.0, 0.0);
+	ref_multiply(&ref, &(struct weston_matrix) {
+		.d = { 1, 0, 0, 0,  0, 1, 0, 0,  0, 0, 1, 0,  10, 20, 0, 1 },
+		.type = WESTON_MATRIX_TRANSFORM_TRANSLATE });
+	v.f[0] = 0.25;
+	v.f[1] = 0.5;
+	v.f[2] = 0.25;
+	v.f[3] = 1.0;
+	w = v;
+	weston_matrix_transform(&r, &v);
+	ref_transform(&ref, &w);
+	if (matrix_error(r.d, ref.d, 16) > 1e-6 ||
+	    matrix_error(v.f, w.f, 4) > 1e-6) {
+		printf("transform of a hand-built matrix failed\n");
+		failed++;
+	}
+
+	printf("%d failures.\n", failed);
+
+	return failed;
+}
+
+static void __attribute__((noinline))
+test_loop_speed_types(void)
+{
+	struct weston_matrix m, n, r;
+	struct weston_vector v = { { 0.5, 0.5, 0.5, 1.0 } };
+	unsigned long count;
+	unsigned i;
+	double t;
+
+	printf("\nRunning 1 s tests per matrix type, ns/iter:\n");
+	printf("%10s %10s %10s %10s %10s\n", "type",
+	       "multiply", "reference", "transform", "invert");
+
+	for (i = 0; i < NUM_TEST_TYPES; i++) {
+		random_typed_matrix(&m, test_types[i]);
+		random_typed_matrix(&n, test_types[i]);
+		printf("%10s", type_name(test_types[i]));
+
+		count = 0;
+		running = 1;
+		alarm(1);
+		reset_timer();
+		while (running) {
+			r = m;
+			weston_matrix_multiply(&r, &n);
+			count++;
+		}
+		t = read_timer();
+		printf(" %10.1f", 1e9 * t / count);
+
+		count = 0;
+		running = 1;
+		alarm(1);
+		reset_timer();
+		while (running) {
+			r = m;
+			ref_multiply(&r, &n);
+			count++;
+		}
+		t = read_timer();
+		printf(" %10.1f", 1e9 * t / count);
+
+		count = 0;
+		running = 1;
+		alarm(1);
+		reset_timer();
+		while (running) {
+			weston_matrix_transform(&m, &v);
+			v.f[3] = 1.0;
+			count++;
+		}
+		t = read_timer();
+		printf(" %10.1f", 1e9 * t / count);
+
+		count = 0;
+		running = 1;
+		alarm(1);
+		reset_timer();
+		while (running) {
+			weston_matrix_invert(&r, &m);
+			count++;
+		}
+		t = read_timer();
+		printf(" %10.1f\n", 1e9 * t / count);
+	}
+}
+
 static void __attribute__((noinline))
 test_loop_speed_matrixvector(void)
 {
@@ -409,11 +712,18 @@ int main(void)
 	print_matrix(&M);
 	printf("max abs error: %g, original determinant %g\n", errsup, det);
 
+	if (test_fast_paths() != 0)
+		return 1;
+
+	if (test_hand_built() != 0)
+		return 1;
+
 	test_loop_precision();
 	test_loop_speed_matrixvector();
 	test_loop_speed_inversetransform();
 	test_loop_speed_invert();
 	test_loop_speed_invert_explicit();
+	test_loop_speed_types();
 
 	return 0;
 }
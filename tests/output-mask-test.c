@@ -0,0 +1,135 @@
+/*
+ * Copyright © 2013 Intel Corporation
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and
+ * its documentation for any purpose is hereby granted without fee, provided
+ * that the above copyright notice appear in all copies and that both that
+ * copyright notice and this permission notice appear in supporting
+ * documentation, and that the name of the copyright holders not be used in
+ * advertising or publicity pertaining to distribution of the software
+ * without specific, written prior permission.  The copyright holders make
+ * no representations about the suitability of this software for any
+ * purpose.  It is provided "as is" without express or implied warranty.
+ *
+ * THE COPYRIGHT HOLDERS DISCLAIM ALL WARRANTIES WITH REGARD TO THIS
+ * SOFTWARE, INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS, IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * SPECIAL, INDIRECT OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER
+ * RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF
+ * CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <assert.h>
+
+#include "weston-test-runner.h"
+
+#include "../src/compositor.h"
+
+TEST(inline_mask)
+{
+	struct weston_output_mask mask;
+
+	weston_output_mask_init(&mask);
+	assert(weston_output_mask_is_empty(&mask));
+	assert(weston_output_mask_first_clear(&mask) == 0);
+
+	assert(weston_output_mask_set(&mask, 0) == 0);
+	assert(weston_output_mask_set(&mask, 63) == 0);
+	assert(mask.bits == NULL);
+
+	assert(weston_output_mask_test(&mask, 0));
+	assert(weston_output_mask_test(&mask, 63));
+	assert(!weston_output_mask_test(&mask, 1));
+	assert(!weston_output_mask_test(&mask, 1000));
+	assert(weston_output_mask_first_clear(&mask) == 1);
+
+	weston_output_mask_unset(&mask, 0);
+	assert(weston_output_mask_is_single(&mask, 63));
+	assert(!weston_output_mask_is_single(&mask, 0));
+
+	weston_output_mask_release(&mask);
+}
+
+TEST(mask_grows)
+{
+	struct weston_output_mask mask;
+	int id, n;
+
+	weston_output_mask_init(&mask);
+	for (id = 0; id < 200; id += 3)
+		assert(weston_output_mask_set(&mask, id) == 0);
+	assert(mask.bits != NULL);
+
+	n = 0;
+	weston_output_mask_for_each(id, &mask) {
+		assert(id % 3 == 0);
+		n++;
+	}
+	assert(n == 67);
+	assert(weston_output_mask_next(&mask, 199) == -1);
+	assert(weston_output_mask_next(&mask, 190) == 192);
+
+	weston_output_mask_clear(&mask);
+	assert(weston_output_mask_is_empty(&mask));
+	assert(weston_output_mask_set(&mask, 130) == 0);
+	assert(weston_output_mask_is_single(&mask, 130));
+
+	weston_output_mask_release(&mask);
+	assert(mask.bits == NULL);
+}
+
+TEST(mask_or_copy_equal)
+{
+	struct weston_output_mask a, b;
+
+	weston_output_mask_init(&a);
+	weston_output_mask_init(&b);
+
+	weston_output_mask_set(&a, 5);
+	weston_output_mask_set(&b, 100);
+	weston_output_mask_unset(&b, 100);
+
+	/* b has heap words but no bits beyond the inline ones */
+	assert(weston_output_mask_equal(&b, &a) == 0);
+	weston_output_mask_set(&b, 5);
+	assert(weston_output_mask_equal(&a, &b));
+	assert(weston_output_mask_equal(&b, &a));
+
+	weston_output_mask_set(&b, 99);
+	assert(weston_output_mask_or(&a, &b) == 0);
+	assert(weston_output_mask_test(&a, 5));
+	assert(weston_output_mask_test(&a, 99));
+	assert(weston_output_mask_equal(&a, &b));
+
+	weston_output_mask_unset(&b, 99);
+	assert(weston_output_mask_copy(&a, &b) == 0);
+	assert(!weston_output_mask_test(&a, 99));
+	assert(weston_output_mask_equal(&a, &b));
+
+	weston_output_mask_release(&a);
+	weston_output_mask_release(&b);
+}
+
+TEST(output_ids)
+{
+	struct weston_output_mask pool;
+	uint32_t id;
+	int i;
+
+	/* Allocation as done by weston_output_init() */
+	weston_output_mask_init(&pool);
+	for (i = 0; i < 100; i++) {
+		id = weston_output_mask_first_clear(&pool);
+		assert(id == (uint32_t) i);
+		weston_output_mask_set(&pool, id);
+	}
+
+	weston_output_mask_unset(&pool, 40);
+	weston_output_mask_unset(&pool, 70);
+	assert(weston_output_mask_first_clear(&pool) == 40);
+
+	weston_output_mask_release(&pool);
+}
@@ -0,0 +1,195 @@
+/*
+ * Copyright © 2013 Intel Corporation
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and
+ * its documentation for any purpose is hereby granted without fee, provided
+ * that the above copyright notice appear in all copies and that both that
+ * copyright notice and this permission notice appear in supporting
+ * documentation, and that the name of the copyright holders not be used in
+ * advertising or publicity pertaining to distribution of the software
+ * without specific, written prior permission.  The copyright holders make
+ * no representations about the suitability of this software for any
+ * purpose.  It is provided "as is" without express or implied warranty.
+ *
+ * THE COPYRIGHT HOLDERS DISCLAIM ALL WARRANTIES WITH REGARD TO THIS
+ * SOFTWARE, INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS, IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * SPECIAL, INDIRECT OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER
+ * RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF
+ * CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <time.h>
+
+#include "../src/window-placement.h"
+
+#define OUTPUT_WIDTH	1920
+#define OUTPUT_HEIGHT	1080
+#define CELL_SIZE	32
+#define MAX_WINDOWS	500
+
+static int32_t widths[MAX_WINDOWS], heights[MAX_WINDOWS];
+static pixman_box32_t boxes[MAX_WINDOWS];
+static unsigned char coverage[OUTPUT_WIDTH * OUTPUT_HEIGHT];
+
+static struct timespec begin_time;
+
+static void
+reset_timer(void)
+{
+	clock_gettime(CLOCK_MONOTONIC, &begin_time);
+}
+
+static double
+read_timer(void)
+{
+	struct timespec t;
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return (double)(t.tv_sec - begin_time.tv_sec) +
+	       1e-9 * (t.tv_nsec - begin_time.tv_nsec);
+}
+
+static void
+generate_windows(void)
+{
+	int i;
+
+	for (i = 0; i < MAX_WINDOWS; i++) {
+		widths[i] = 200 + random() % 600;
+		heights[i] = 150 + random() % 450;
+	}
+}
+
+/* What shell.c did before: anywhere the window stays on screen */
+static void
+place_random(int n)
+{
+	int i;
+
+	for (i = 0; i < n; i++) {
+		boxes[i].x1 = random() % (OUTPUT_WIDTH - widths[i]);
+		boxes[i].y1 = random() % (OUTPUT_HEIGHT - heights[i]);
+		boxes[i].x2 = boxes[i].x1 + widths[i];
+		boxes[i].y2 = boxes[i].y1 + heights[i];
+	}
+}
+
+static void
+place_map(struct weston_placement_map *map, int n)
+{
+	int i;
+
+	weston_placement_map_clear(map);
+	for (i = 0; i < n; i++) {
+		weston_placement_map_place(map, widths[i], heights[i],
+					   &boxes[i].x1, &boxes[i].y1);
+		boxes[i].x2 = boxes[i].x1 + widths[i];
+		boxes[i].y2 = boxes[i].y1 + heights[i];
+		weston_placement_map_add(map, &boxes[i]);
+	}
+}
+
+/* Fraction of the window area hidden under other windows, which is
+ * what the compositor ends up painting for nothing. */
+static double
+overlap(int n)
+{
+	unsigned long area = 0, visible = 0;
+	int32_t x, y;
+	int i;
+
+	memset(coverage, 0, sizeof coverage);
+	for (i = 0; i < n; i++) {
+		area += (boxes[i].x2 - boxes[i].x1) *
+			(boxes[i].y2 - boxes[i].y1);
+		for (y = boxes[i].y1; y < boxes[i].y2; y++)
+			for (x = boxes[i].x1; x < boxes[i].x2; x++)
+				coverage[y * OUTPUT_WIDTH + x] = 1;
+	}
+
+	for (i = 0; i < OUTPUT_WIDTH * OUTPUT_HEIGHT; i++)
+		visible += coverage[i];
+
+	return 1.0 - (double) visible / area;
+}
+
+static void
+compare_placement(struct weston_placement_map *map)
+{
+	static const int counts[] = { 4, 8, 16, 50 };
+	unsigned int i;
+
+	printf("hidden window area, %dx%d output:\n",
+	       OUTPUT_WIDTH, OUTPUT_HEIGHT);
+	for (i = 0; i < sizeof counts / sizeof counts[0]; i++) {
+		place_random(counts[i]);
+		printf("%4d windows: random %5.1f%%", counts[i],
+		       100.0 * overlap(counts[i]));
+		place_map(map, counts[i]);
+		printf(", map %5.1f%%\n", 100.0 * overlap(counts[i]));
+	}
+}
+
+static volatile sig_atomic_t running;
+static void
+stopme(int n)
+{
+	running = 0;
+}
+
+static void __attribute__((noinline))
+test_loop_speed(struct weston_placement_map *map, int n)
+{
+	unsigned long count = 0;
+	double t;
+
+	printf("\nRunning 3 s test placing %d windows...\n", n);
+
+	running = 1;
+	alarm(3);
+	reset_timer();
+	while (running) {
+		place_map(map, n);
+		count += n;
+	}
+	t = read_timer();
+
+	printf("%lu placements in %f seconds, avg. %.2f us/placement.\n",
+	       count, t, 1e6 * t / count);
+}
+
+int main(void)
+{
+	struct weston_placement_map *map;
+	struct sigaction ding;
+
+	ding.sa_handler = stopme;
+	sigemptyset(&ding.sa_mask);
+	ding.sa_flags = 0;
+	sigaction(SIGALRM, &ding, NULL);
+
+	map = weston_placement_map_create(0, 0, OUTPUT_WIDTH, OUTPUT_HEIGHT,
+					  CELL_SIZE);
+	if (!map)
+		return 1;
+
+	srandom(13);
+	generate_windows();
+
+	compare_placement(map);
+
+	test_loop_speed(map, 10);
+	test_loop_speed(map, 100);
+	test_loop_speed(map, MAX_WINDOWS);
+
+	weston_placement_map_destroy(map);
+
+	return 0;
+}
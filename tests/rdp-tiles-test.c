@@ -0,0 +1,261 @@
+/*
+ * Copyright © 2013 Intel Corporation
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and
+ * its documentation for any purpose is hereby granted without fee, provided
+ * that the above copyright notice appear in all copies and that both that
+ * copyright notice and this permission notice appear in supporting
+ * documentation, and that the name of the copyright holders not be used in
+ * advertising or publicity pertaining to distribution of the software
+ * without specific, written prior permission.  The copyright holders make
+ * no representations about the suitability of this software for any
+ * purpose.  It is provided "as is" without express or implied warranty.
+ *
+ * THE COPYRIGHT HOLDERS DISCLAIM ALL WARRANTIES WITH REGARD TO THIS
+ * SOFTWARE, INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS, IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * SPECIAL, INDIRECT OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER
+ * RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF
+ * CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * Checks rdp_tiles_filter_damage() and counts the bytes it saves the
+ * RDP backend at 1080p, for clients that redraw more than they change:
+ * a blinking cursor, a terminal redrawing its cursor line and a clock
+ * redrawn every frame but ticking once a second.  A video-like scene
+ * where every damaged pixel changes shows the cost of hashing.
+ *
+ * The raw path sends each damaged rectangle, NSCodec encodes the
+ * extents of the damage, so both are counted as the bytes handed to
+ * the encoder.  How well NSCodec compresses them isn't measured.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#include "../src/rdp-tiles.h"
+
+#define WIDTH 1920
+#define HEIGHT 1080
+#define FPS 60
+#define FRAMES (10 * FPS)
+
+static double
+now(void)
+{
+	struct timespec t;
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec + 1e-9 * t.tv_nsec;
+}
+
+static void
+fill(pixman_image_t *image, int x, int y, int w, int h, uint32_t color)
+{
+	uint32_t *data = pixman_image_get_data(image);
+	int stride = pixman_image_get_stride(image) / 4;
+	int i, j;
+
+	for (i = y; i < y + h; i++)
+		for (j = x; j < x + w; j++)
+			data[i * stride + j] = color;
+}
+
+static void
+fill_random(pixman_image_t *image, int x, int y, int w, int h)
+{
+	uint32_t *data = pixman_image_get_data(image);
+	int stride = pixman_image_get_stride(image) / 4;
+	int i, j;
+
+	for (i = y; i < y + h; i++)
+		for (j = x; j < x + w; j++)
+			data[i * stride + j] = random();
+}
+
+/* Each scene draws frame n and sets the damage its client would post */
+struct scene {
+	const char *name;
+	void (*draw)(pixman_image_t *image, int n, pixman_region32_t *damage);
+};
+
+static void
+draw_cursor(pixman_image_t *image, int n, pixman_region32_t *damage)
+{
+	/* blinks every half second, the cell is damaged every frame */
+	fill(image, 400, 300, 8, 16, (n / 30) % 2 ? 0xffffffff : 0xff000000);
+	pixman_region32_init_rect(damage, 400, 300, 8, 16);
+}
+
+static void
+draw_cursor_line(pixman_image_t *image, int n, pixman_region32_t *damage)
+{
+	draw_cursor(image, n, damage);
+	pixman_region32_fini(damage);
+	pixman_region32_init_rect(damage, 80, 300, 640, 16);
+}
+
+static void
+draw_clock(pixman_image_t *image, int n, pixman_region32_t *damage)
+{
+	static const int hand[12][2] = {
+		{ 0, -1 }, { 1, -2 }, { 2, -1 }, { 1, 0 }, { 2, 1 }, { 1, 2 },
+		{ 0, 1 }, { -1, 2 }, { -2, 1 }, { -1, 0 }, { -2, -1 },
+		{ -1, -2 }
+	};
+	int x = 1720, y = 40, size = 160, i, dx, dy;
+
+	/* whole window redrawn every frame, the hand moves every second */
+	fill(image, x, y, size, size, 0xffe0e0e0);
+	dx = hand[(n / FPS) % 12][0];
+	dy = hand[(n / FPS) % 12][1];
+	for (i = 0; i < 30; i++)
+		fill(image, x + size / 2 + dx * i, y + size / 2 + dy * i,
+		     2, 2, 0xff000000);
+	pixman_region32_init_rect(damage, x, y, size, size);
+}
+
+static void
+draw_video(pixman_image_t *image, int n, pixman_region32_t *damage)
+{
+	fill_random(image, 320, 240, 640, 360);
+	pixman_region32_init_rect(damage, 320, 240, 640, 360);
+}
+
+static const struct scene scenes[] = {
+	{ "blinking cursor", draw_cursor },
+	{ "cursor line", draw_cursor_line },
+	{ "clock", draw_clock },
+	{ "video", draw_video },
+};
+
+static uint64_t
+region_area(pixman_region32_t *region)
+{
+	pixman_box32_t *rects;
+	uint64_t area = 0;
+	int i, n;
+
+	rects = pixman_region32_rectangles(region, &n);
+	for (i = 0; i < n; i++)
+		area += (uint64_t) (rects[i].x2 - rects[i].x1) *
+			(rects[i].y2 - rects[i].y1);
+
+	return area;
+}
+
+static uint64_t
+extents_area(pixman_region32_t *region)
+{
+	pixman_box32_t *extents = pixman_region32_extents(region);
+
+	if (!pixman_region32_not_empty(region))
+		return 0;
+
+	return (uint64_t) (extents->x2 - extents->x1) *
+		(extents->y2 - extents->y1);
+}
+
+/* Every damaged pixel that differs from the last frame must pass. */
+static int
+check_changed(pixman_image_t *image, pixman_image_t *last,
+	      pixman_region32_t *damage, pixman_region32_t *changed)
+{
+	uint32_t *d = pixman_image_get_data(image);
+	uint32_t *l = pixman_image_get_data(last);
+	int stride = pixman_image_get_stride(image) / 4;
+	pixman_box32_t *rects;
+	int i, n, x, y, failed = 0;
+
+	rects = pixman_region32_rectangles(damage, &n);
+	for (i = 0; i < n; i++)
+		for (y = rects[i].y1; y < rects[i].y2; y++)
+			for (x = rects[i].x1; x < rects[i].x2; x++) {
+				if (d[y * stride + x] == l[y * stride + x])
+					continue;
+				if (!pixman_region32_contains_point(changed,
+								    x, y,
+								    NULL))
+					failed++;
+			}
+
+	return failed;
+}
+
+static int
+run_scene(const struct scene *scene)
+{
+	pixman_image_t *image, *last;
+	pixman_region32_t damage, changed;
+	struct rdp_tiles tiles = { 0 };
+	uint64_t raw = 0, raw_sent = 0, nsc = 0, nsc_sent = 0;
+	double t, filter = 0;
+	int n, failed = 0;
+
+	image = pixman_image_create_bits(PIXMAN_x8r8g8b8, WIDTH, HEIGHT,
+					 NULL, 0);
+	last = pixman_image_create_bits(PIXMAN_x8r8g8b8, WIDTH, HEIGHT,
+					NULL, 0);
+	fill_random(image, 0, 0, WIDTH, HEIGHT);
+	if (rdp_tiles_reset(&tiles, image) < 0) {
+		printf("no memory for tile hashes\n");
+		return 1;
+	}
+	pixman_region32_init(&changed);
+
+	for (n = 0; n < FRAMES; n++) {
+		memcpy(pixman_image_get_data(last),
+		       pixman_image_get_data(image),
+		       pixman_image_get_stride(image) * HEIGHT);
+		scene->draw(image, n, &damage);
+
+		t = now();
+		rdp_tiles_filter_damage(&tiles, image, &damage, &changed);
+		filter += now() - t;
+
+		failed += check_changed(image, last, &damage, &changed);
+
+		raw += region_area(&damage) * 4;
+		raw_sent += region_area(&changed) * 4;
+		nsc += extents_area(&damage) * 4;
+		nsc_sent += extents_area(&changed) * 4;
+		pixman_region32_fini(&damage);
+	}
+
+	/* kB per second of frames */
+	printf("%-16s raw %7.1f -> %7.1f, NSCodec %7.1f -> %7.1f, "
+	       "filter %.3f ms per frame\n", scene->name,
+	       raw / 1024.0 / 10, raw_sent / 1024.0 / 10,
+	       nsc / 1024.0 / 10, nsc_sent / 1024.0 / 10,
+	       1e3 * filter / FRAMES);
+	if (failed)
+		printf("%s: %d changed pixels filtered out\n",
+		       scene->name, failed);
+
+	pixman_region32_fini(&changed);
+	rdp_tiles_release(&tiles);
+	pixman_image_unref(image);
+	pixman_image_unref(last);
+
+	return failed;
+}
+
+int main(void)
+{
+	unsigned i;
+	int failed = 0;
+
+	srandom(13);
+
+	printf("%d frames at %dx%d, kB/s handed to the encoder "
+	       "before -> after filtering:\n", FRAMES, WIDTH, HEIGHT);
+	for (i = 0; i < sizeof scenes / sizeof scenes[0]; i++)
+		failed += run_scene(&scenes[i]);
+
+	return failed ? 1 : 0;
+}
@@ -0,0 +1,280 @@
+/*
+ * Copyright © 2013 Intel Corporation
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and
+ * its documentation for any purpose is hereby granted without fee, provided
+ * that the above copyright notice appear in all copies and that both that
+ * copyright notice and this permission notice appear in supporting
+ * documentation, and that the name of the copyright holders not be used in
+ * advertising or publicity pertaining to distribution of the software
+ * without specific, written prior permission.  The copyright holders make
+ * no representations about the suitability of this software for any
+ * purpose.  It is provided "as is" without express or implied warranty.
+ *
+ * THE COPYRIGHT HOLDERS DISCLAIM ALL WARRANTIES WITH REGARD TO THIS
+ * SOFTWARE, INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS, IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * SPECIAL, INDIRECT OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER
+ * RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF
+ * CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <assert.h>
+#include <math.h>
+
+#include "weston-test-runner.h"
+
+#include "../src/compositor.h"
+
+/* animation.c calls into the compositor core from its surface
+ * animations; the springs themselves only need these to link. */
+WL_EXPORT void
+weston_surface_geometry_dirty(struct weston_surface *surface)
+{
+}
+
+WL_EXPORT int
+weston_log(const char *fmt, ...)
+{
+	return 0;
+}
+
+WL_EXPORT void
+weston_compositor_schedule_repaint(struct weston_compositor *compositor)
+{
+}
+
+WL_EXPORT void
+weston_surface_schedule_geometry_repaint(struct weston_surface *surface)
+{
+}
+
+#define START_TIME	1000
+#define NUM_STEPS	250
+
+struct spring_params {
+	double k, friction;
+	double current, previous, target;
+	double min, max;
+	uint32_t clip;
+};
+
+/* The parameters used by weston_zoom_run(), weston_fade_run(), the
+ * default surface animation, weston_slide_run() and an underdamped
+ * spring that overshoots its target. */
+static const struct spring_params overshoot_params[] = {
+	{ 300.0, 1400.0, 0.5, 0.485, 1.0, 0.0, 1.0, WESTON_SPRING_OVERSHOOT },
+	{ 200.0, 1400.0, 0.0, -0.03, 1.0, 0.0, 1.0, WESTON_SPRING_OVERSHOOT },
+	{ 200.0, 700.0, 0.0, 0.0, 1.0, 0.0, 1.0, WESTON_SPRING_OVERSHOOT },
+	{ 400.0, 600.0, 0.0, 0.0, 1.0, 0.0, 1.0, WESTON_SPRING_OVERSHOOT },
+	{ 300.0, 100.0, 0.0, 0.0, 1.0, 0.0, 1.0, WESTON_SPRING_OVERSHOOT },
+};
+
+static void
+init_spring(struct weston_spring *spring, const struct spring_params *p,
+	    uint32_t solver)
+{
+	weston_spring_init(spring, p->k, p->current, p->target);
+	spring->friction = p->friction;
+	spring->previous = p->previous;
+	spring->min = p->min;
+	spring->max = p->max;
+	spring->clip = p->clip;
+	spring->solver = solver;
+	spring->timestamp = START_TIME;
+}
+
+/* Run both solvers side by side and return the largest difference.
+ * The step solver only advances while more than 4 ms are left, so it
+ * is sampled 1 ms after each 4 ms boundary. */
+static double
+compare_solvers(const struct spring_params *p)
+{
+	struct weston_spring step, analytic;
+	double d, max_diff = 0.0;
+	uint32_t time;
+	int i;
+
+	init_spring(&step, p, WESTON_SPRING_SOLVER_STEP);
+	init_spring(&analytic, p, WESTON_SPRING_SOLVER_ANALYTIC);
+
+	for (i = 1; i <= NUM_STEPS; i++) {
+		time = START_TIME + i * 4;
+		weston_spring_update(&step, time + 1);
+		weston_spring_update(&analytic, time);
+
+		if (p->clip != WESTON_SPRING_OVERSHOOT) {
+			assert(analytic.current <= p->max);
+			assert(analytic.current >= p->min);
+		}
+
+		d = fabs(step.current - analytic.current);
+		if (d > max_diff)
+			max_diff = d;
+	}
+
+	return max_diff;
+}
+
+TEST(overshoot_matches_step)
+{
+	unsigned int i;
+
+	for (i = 0; i < ARRAY_LENGTH(overshoot_params); i++)
+		assert(compare_solvers(&overshoot_params[i]) < 1e-9);
+}
+
+TEST(clamp_matches_step)
+{
+	struct spring_params p = {
+		300.0, 100.0, 0.0, 0.0, 1.0, 0.0, 1.0, WESTON_SPRING_CLAMP
+	};
+
+	/* Target on the bound: both stop dead on the first crossing */
+	assert(compare_solvers(&p) < 1e-9);
+
+	/* Target inside: the analytic solver clamps at the exact crossing
+	 * instead of the next 4 ms boundary. */
+	p.target = 0.7;
+	p.max = 0.8;
+	assert(compare_solvers(&p) < 0.01);
+
+	p.current = p.previous = 0.8;
+	p.target = 0.0;
+	assert(compare_solvers(&p) < 1e-9);
+}
+
+TEST(bounce_matches_step)
+{
+	struct spring_params p = {
+		400.0, 600.0, 0.0, 0.0, 1.0, 0.0, 1.0, WESTON_SPRING_BOUNCE
+	};
+
+	/* weston_slide_run() */
+	assert(compare_solvers(&p) < 1e-9);
+
+	p.friction = 100.0;
+	assert(compare_solvers(&p) < 1e-9);
+
+	p.target = 0.7;
+	p.max = 0.8;
+	assert(compare_solvers(&p) < 0.02);
+}
+
+TEST(clamp_pins_to_bound)
+{
+	struct spring_params p = {
+		300.0, 100.0, 0.0, 0.0, 1.5, 0.0, 1.0, WESTON_SPRING_CLAMP
+	};
+	struct weston_spring spring;
+	uint32_t time;
+
+	init_spring(&spring, &p, WESTON_SPRING_SOLVER_ANALYTIC);
+	for (time = START_TIME; time < START_TIME + 1000; time += 16)
+		weston_spring_update(&spring, time);
+
+	assert(spring.current == 1.0);
+	assert(spring.previous == 1.0);
+
+	/* Moving the target back inside releases it */
+	spring.target = 0.5;
+	weston_spring_update(&spring, time + 16);
+	assert(spring.current < 1.0);
+}
+
+TEST(frame_rate_independent)
+{
+	const struct spring_params *p = &overshoot_params[4];
+	struct weston_spring fast, slow, step;
+	uint32_t time;
+
+	init_spring(&fast, p, WESTON_SPRING_SOLVER_ANALYTIC);
+	init_spring(&slow, p, WESTON_SPRING_SOLVER_ANALYTIC);
+	init_spring(&step, p, WESTON_SPRING_SOLVER_STEP);
+
+	for (time = START_TIME + 1; time <= START_TIME + 1000; time++) {
+		weston_spring_update(&fast, time);
+		if ((time - START_TIME) % 17 != 0)
+			continue;
+
+		weston_spring_update(&slow, time);
+		weston_spring_update(&step, time);
+		assert(fabs(fast.current - slow.current) < 1e-9);
+		assert(fabs(fast.current - step.current) < 0.05);
+	}
+}
+
+/* A clipped spring that was not updated for a while lands where one
+ * updated every frame does. */
+TEST(clipped_stall_matches_frames)
+{
+	struct spring_params p = {
+		400.0, 100.0, 0.0, 0.0, 0.7, 0.0, 0.8, WESTON_SPRING_BOUNCE
+	};
+	struct weston_spring frames, stalled;
+	uint32_t time;
+	int i;
+
+	for (i = 0; i < 2; i++) {
+		if (i == 1)
+			p.clip = WESTON_SPRING_CLAMP;
+
+		init_spring(&frames, &p, WESTON_SPRING_SOLVER_ANALYTIC);
+		init_spring(&stalled, &p, WESTON_SPRING_SOLVER_ANALYTIC);
+
+		for (time = START_TIME + 16; time <= START_TIME + 992;
+		     time += 16)
+			weston_spring_update(&frames, time);
+		weston_spring_update(&stalled, START_TIME + 992);
+		assert(fabs(frames.current - stalled.current) < 1e-6);
+	}
+}
+
+TEST(retarget_matches_step)
+{
+	const struct spring_params *p = &overshoot_params[1];
+	struct weston_spring step, analytic;
+	uint32_t time;
+	int i;
+
+	init_spring(&step, p, WESTON_SPRING_SOLVER_STEP);
+	init_spring(&analytic, p, WESTON_SPRING_SOLVER_ANALYTIC);
+
+	for (i = 1; i <= NUM_STEPS; i++) {
+		/* weston_fade_update() a quarter of the way in */
+		if (i == NUM_STEPS / 4) {
+			step.target = 0.25;
+			analytic.target = 0.25;
+		}
+
+		time = START_TIME + i * 4;
+		weston_spring_update(&step, time + 1);
+		weston_spring_update(&analytic, time);
+		assert(fabs(step.current - analytic.current) < 1e-9);
+	}
+
+	assert(weston_spring_done(&analytic) == weston_spring_done(&step));
+}
+
+TEST(stiff_spring_falls_back_to_step)
+{
+	/* A negative root has no continuous interpolation */
+	struct spring_params p = {
+		300.0, 10500.0, 0.0, 0.0, 1.0, 0.0, 1.0,
+		WESTON_SPRING_OVERSHOOT
+	};
+	struct weston_spring step, analytic;
+	uint32_t time;
+
+	init_spring(&step, &p, WESTON_SPRING_SOLVER_STEP);
+	init_spring(&analytic, &p, WESTON_SPRING_SOLVER_ANALYTIC);
+
+	for (time = START_TIME; time < START_TIME + 1000; time += 16) {
+		weston_spring_update(&step, time);
+		weston_spring_update(&analytic, time);
+		assert(step.current == analytic.current);
+	}
+}
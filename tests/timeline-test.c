@@ -0,0 +1,262 @@
+/*
+ * Copyright © 2013 Intel Corporation
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and
+ * its documentation for any purpose is hereby granted without fee, provided
+ * that the above copyright notice appear in all copies and that both that
+ * copyright notice and this permission notice appear in supporting
+ * documentation, and that the name of the copyright holders not be used in
+ * advertising or publicity pertaining to distribution of the software
+ * without specific, written prior permission.  The copyright holders make
+ * no representations about the suitability of this software for any
+ * purpose.  It is provided "as is" without express or implied warranty.
+ *
+ * THE COPYRIGHT HOLDERS DISCLAIM ALL WARRANTIES WITH REGARD TO THIS
+ * SOFTWARE, INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS, IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * SPECIAL, INDIRECT OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER
+ * RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF
+ * CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <assert.h>
+#include <string.h>
+#include <math.h>
+
+#include "weston-test-runner.h"
+
+#include "../src/compositor.h"
+
+static int geometry_dirty_count;
+
+WL_EXPORT void
+weston_surface_geometry_dirty(struct weston_surface *surface)
+{
+	geometry_dirty_count++;
+}
+
+WL_EXPORT void
+weston_surface_schedule_geometry_repaint(struct weston_surface *surface)
+{
+}
+
+static struct weston_compositor compositor;
+static struct weston_output output;
+
+static void
+init_compositor(void)
+{
+	memset(&compositor, 0, sizeof compositor);
+	memset(&output, 0, sizeof output);
+	wl_list_init(&compositor.output_list);
+	wl_list_init(&output.animation_list);
+	wl_list_insert(&compositor.output_list, &output.link);
+	geometry_dirty_count = 0;
+}
+
+static void
+init_surface(struct weston_surface *surface)
+{
+	memset(surface, 0, sizeof *surface);
+	wl_signal_init(&surface->destroy_signal);
+	wl_list_init(&surface->geometry.transformation_list);
+	surface->geometry.width = 100;
+	surface->geometry.height = 50;
+	surface->alpha = 1.0;
+}
+
+static void
+run_frame(uint32_t msecs)
+{
+	struct weston_animation *animation, *next;
+
+	wl_list_for_each_safe(animation, next, &output.animation_list, link) {
+		animation->frame_counter++;
+		animation->frame(animation, &output, msecs);
+	}
+}
+
+static struct weston_transform *
+surface_transform(struct weston_surface *surface)
+{
+	if (wl_list_empty(&surface->geometry.transformation_list))
+		return NULL;
+
+	return container_of(surface->geometry.transformation_list.next,
+			    struct weston_transform, link);
+}
+
+static int done_count;
+
+static void
+count_done(struct weston_timeline *timeline, void *data)
+{
+	done_count++;
+}
+
+TEST(crossfade)
+{
+	struct weston_surface a, b;
+	struct weston_timeline *timeline;
+
+	init_compositor();
+	init_surface(&a);
+	init_surface(&b);
+	b.alpha = 0.0;
+	done_count = 0;
+
+	timeline = weston_timeline_create(&compositor);
+	assert(timeline);
+
+	/* Added out of order on purpose */
+	assert(weston_timeline_add_keyframe(timeline, &b, WESTON_TIMELINE_ALPHA,
+					    200, 1.0, WESTON_TIMELINE_LINEAR) == 0);
+	assert(weston_timeline_add_keyframe(timeline, &a, WESTON_TIMELINE_ALPHA,
+					    200, 0.0, WESTON_TIMELINE_LINEAR) == 0);
+	assert(weston_timeline_add_keyframe(timeline, &a, WESTON_TIMELINE_ALPHA,
+					    0, 1.0, WESTON_TIMELINE_LINEAR) == 0);
+	assert(weston_timeline_add_keyframe(timeline, &b, WESTON_TIMELINE_ALPHA,
+					    100, 0.0, WESTON_TIMELINE_LINEAR) == 0);
+	assert(weston_timeline_get_duration(timeline) == 200);
+
+	assert(weston_timeline_start(timeline, NULL, count_done, NULL) == 0);
+	assert(!wl_list_empty(&output.animation_list));
+
+	/* The start state is applied right away; b stays hidden until
+	 * its first keyframe at 100 ms */
+	assert(a.alpha == 1.0);
+	assert(b.alpha == 0.0);
+
+	/* Alpha only: no transform is inserted */
+	assert(surface_transform(&a) == NULL);
+
+	run_frame(5000);
+	run_frame(5050);
+	assert(fabs(a.alpha - 0.75) < 1e-6);
+	assert(b.alpha == 0.0);
+
+	run_frame(5150);
+	assert(fabs(a.alpha - 0.25) < 1e-6);
+	assert(fabs(b.alpha - 0.5) < 1e-6);
+	assert(done_count == 0);
+
+	run_frame(5300);
+	assert(a.alpha == 0.0);
+	assert(b.alpha == 1.0);
+	assert(done_count == 1);
+	assert(wl_list_empty(&output.animation_list));
+
+	/* Keyframes cannot be added while running, but can once done */
+	assert(weston_timeline_add_keyframe(timeline, &a, WESTON_TIMELINE_ALPHA,
+					    300, 1.0, WESTON_TIMELINE_LINEAR) == 0);
+
+	weston_timeline_destroy(timeline);
+}
+
+TEST(seek_and_easing)
+{
+	struct weston_surface s;
+	struct weston_timeline *timeline;
+
+	init_compositor();
+	init_surface(&s);
+
+	timeline = weston_timeline_create(&compositor);
+	weston_timeline_add_keyframe(timeline, &s, WESTON_TIMELINE_ALPHA,
+				     0, 0.0, WESTON_TIMELINE_LINEAR);
+	weston_timeline_add_keyframe(timeline, &s, WESTON_TIMELINE_ALPHA,
+				     100, 1.0, WESTON_TIMELINE_EASE_IN);
+	weston_timeline_add_keyframe(timeline, &s, WESTON_TIMELINE_ALPHA,
+				     200, 0.0, WESTON_TIMELINE_EASE_IN_OUT);
+	weston_timeline_start(timeline, NULL, NULL, NULL);
+
+	weston_timeline_seek(timeline, 50);
+	assert(fabs(s.alpha - 0.25) < 1e-6);
+	weston_timeline_seek(timeline, 150);
+	assert(fabs(s.alpha - 0.5) < 1e-6);
+	weston_timeline_seek(timeline, 175);
+	assert(fabs(s.alpha - (1.0 - 0.84375)) < 1e-6);
+
+	/* Backwards */
+	weston_timeline_seek(timeline, 10);
+	assert(fabs(s.alpha - 0.01) < 1e-6);
+	assert(weston_timeline_add_keyframe(timeline, &s,
+					    WESTON_TIMELINE_ALPHA, 300, 1.0,
+					    WESTON_TIMELINE_LINEAR) < 0);
+
+	weston_timeline_destroy(timeline);
+}
+
+TEST(zoom_transform)
+{
+	struct weston_surface s;
+	struct weston_timeline *timeline;
+	struct weston_transform *transform;
+	struct weston_vector v = { { 0.0f, 0.0f, 0.0f, 1.0f } };
+
+	init_compositor();
+	init_surface(&s);
+
+	timeline = weston_timeline_create(&compositor);
+	weston_timeline_add_keyframe(timeline, &s, WESTON_TIMELINE_SCALE,
+				     0, 0.5, WESTON_TIMELINE_LINEAR);
+	weston_timeline_add_keyframe(timeline, &s, WESTON_TIMELINE_SCALE,
+				     100, 1.0, WESTON_TIMELINE_LINEAR);
+	weston_timeline_add_keyframe(timeline, &s,
+				     WESTON_TIMELINE_TRANSLATE_X,
+				     100, 10.0, WESTON_TIMELINE_LINEAR);
+	weston_timeline_start(timeline, NULL, NULL, NULL);
+
+	/* Scaled around the center, the origin moves to 1/4 */
+	transform = surface_transform(&s);
+	assert(transform);
+	weston_matrix_transform(&transform->matrix, &v);
+	assert(fabs(v.f[0] - 25.0f) < 1e-4);
+	assert(fabs(v.f[1] - 12.5f) < 1e-4);
+
+	weston_timeline_seek(timeline, 100);
+	v.f[0] = v.f[1] = 0.0f;
+	v.f[2] = 0.0f;
+	v.f[3] = 1.0f;
+	weston_matrix_transform(&transform->matrix, &v);
+	assert(fabs(v.f[0] - 10.0f) < 1e-4);
+	assert(fabs(v.f[1]) < 1e-4);
+
+	/* Nothing changes past the end: no geometry update either */
+	geometry_dirty_count = 0;
+	weston_timeline_seek(timeline, 150);
+	assert(geometry_dirty_count == 0);
+
+	weston_timeline_destroy(timeline);
+	assert(wl_list_empty(&s.geometry.transformation_list));
+}
+
+TEST(surface_destroyed)
+{
+	struct weston_surface a, b;
+	struct weston_timeline *timeline;
+
+	init_compositor();
+	init_surface(&a);
+	init_surface(&b);
+
+	timeline = weston_timeline_create(&compositor);
+	weston_timeline_add_keyframe(timeline, &a, WESTON_TIMELINE_SCALE,
+				     100, 2.0, WESTON_TIMELINE_LINEAR);
+	weston_timeline_add_keyframe(timeline, &b, WESTON_TIMELINE_ALPHA,
+				     100, 0.0, WESTON_TIMELINE_LINEAR);
+	weston_timeline_start(timeline, NULL, NULL, NULL);
+	assert(surface_transform(&a));
+
+	wl_signal_emit(&a.destroy_signal, &a);
+	assert(wl_list_empty(&a.geometry.transformation_list));
+
+	run_frame(0);
+	run_frame(50);
+	assert(fabs(b.alpha - 0.5) < 1e-6);
+
+	weston_timeline_destroy(timeline);
+}
@@ -0,0 +1,189 @@
+/*
+ * Copyright © 2013 Intel Corporation
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and
+ * its documentation for any purpose is hereby granted without fee, provided
+ * that the above copyright notice appear in all copies and that both that
+ * copyright notice and this permission notice appear in supporting
+ * documentation, and that the name of the copyright holders not be used in
+ * advertising or publicity pertaining to distribution of the software
+ * without specific, written prior permission.  The copyright holders make
+ * no representations about the suitability of this software for any
+ * purpose.  It is provided "as is" without express or implied warranty.
+ *
+ * THE COPYRIGHT HOLDERS DISCLAIM ALL WARRANTIES WITH REGARD TO THIS
+ * SOFTWARE, INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS, IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * SPECIAL, INDIRECT OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER
+ * RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF
+ * CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <assert.h>
+
+#include "weston-test-runner.h"
+
+#include "../src/window-placement.h"
+
+static pixman_box32_t
+place(struct weston_placement_map *map, int32_t width, int32_t height,
+      uint32_t *cost)
+{
+	pixman_box32_t box;
+	uint32_t c;
+
+	c = weston_placement_map_place(map, width, height, &box.x1, &box.y1);
+	if (cost)
+		*cost = c;
+	box.x2 = box.x1 + width;
+	box.y2 = box.y1 + height;
+	weston_placement_map_add(map, &box);
+
+	return box;
+}
+
+TEST(place_without_overlap)
+{
+	struct weston_placement_map *map;
+	pixman_box32_t a, b, c;
+	uint32_t cost;
+
+	map = weston_placement_map_create(100, 50, 1000, 600, 20);
+	assert(map);
+
+	a = place(map, 500, 300, &cost);
+	assert(cost == 0);
+	assert(a.x1 == 100 && a.y1 == 50);
+
+	/* Next to the first one, on the next cell boundary */
+	b = place(map, 490, 300, &cost);
+	assert(cost == 0);
+	assert(b.x1 == 600 && b.y1 == 50);
+
+	c = place(map, 300, 290, &cost);
+	assert(cost == 0);
+	assert(c.x1 == 100 && c.y1 == 350);
+
+	weston_placement_map_destroy(map);
+}
+
+TEST(place_least_overlap)
+{
+	struct weston_placement_map *map;
+	pixman_box32_t box = { 0, 0, 1000, 600 };
+	pixman_box32_t a;
+	uint32_t cost;
+	int32_t x, y;
+
+	map = weston_placement_map_create(0, 0, 1000, 600, 10);
+	assert(map);
+
+	/* Full screen window plus a second layer on the left half */
+	weston_placement_map_add(map, &box);
+	box.x2 = 500;
+	weston_placement_map_add(map, &box);
+
+	a = place(map, 400, 400, &cost);
+	assert(a.x1 == 500 && a.y1 == 0);
+	assert(cost == 40 * 40);
+
+	/* Removing windows frees their space again */
+	weston_placement_map_remove(map, &a);
+	weston_placement_map_remove(map, &box);
+	box.x2 = 1000;
+	weston_placement_map_remove(map, &box);
+	cost = weston_placement_map_place(map, 1000, 600, &x, &y);
+	assert(cost == 0 && x == 0 && y == 0);
+
+	weston_placement_map_destroy(map);
+}
+
+TEST(place_oversized)
+{
+	struct weston_placement_map *map;
+	pixman_box32_t box = { -100, -100, 50, 50 };
+	int32_t x, y;
+
+	map = weston_placement_map_create(0, 0, 640, 480, 32);
+	assert(map);
+
+	/* Boxes are clipped to the map */
+	weston_placement_map_add(map, &box);
+
+	weston_placement_map_place(map, 2000, 100, &x, &y);
+	assert(x == 0 && y == 64);
+	weston_placement_map_place(map, 100, 2000, &x, &y);
+	assert(x == 64 && y == 0);
+
+	weston_placement_map_destroy(map);
+}
+
+TEST(place_deterministic)
+{
+	struct weston_placement_map *a, *b;
+	pixman_box32_t box_a, box_b;
+	uint32_t seed = 1;
+	int32_t w, h;
+	int i;
+
+	a = weston_placement_map_create(0, 0, 1920, 1080, 32);
+	b = weston_placement_map_create(0, 0, 1920, 1080, 32);
+	assert(a && b);
+
+	for (i = 0; i < 300; i++) {
+		seed = seed * 1103515245 + 12345;
+		w = 100 + (seed >> 16) % 700;
+		h = 100 + (seed >> 8) % 500;
+
+		box_a = place(a, w, h, NULL);
+		box_b = place(b, w, h, NULL);
+		assert(box_a.x1 == box_b.x1 && box_a.y1 == box_b.y1);
+		assert(box_a.x1 >= 0 && box_a.x2 <= 1920);
+		assert(box_a.y1 >= 0 && box_a.y2 <= 1080);
+	}
+
+	weston_placement_map_destroy(a);
+	weston_placement_map_destroy(b);
+}
+
+TEST(footprint_unmap_remap)
+{
+	struct weston_placement_map *map;
+	struct weston_placement_footprint footprint;
+	struct wl_list maps;
+	pixman_box32_t box = { 0, 0, 500, 600 };
+	uint32_t cost;
+	int32_t x, y;
+	int i;
+
+	map = weston_placement_map_create(0, 0, 1000, 600, 10);
+	assert(map);
+	wl_list_init(&maps);
+	wl_list_insert(&maps, &map->link);
+	weston_placement_footprint_init(&footprint);
+
+	/* A window hidden and shown again covers its box only once */
+	weston_placement_footprint_update(&maps, &footprint, &box);
+	for (i = 0; i < 3; i++) {
+		weston_placement_footprint_update(&maps, &footprint, NULL);
+		cost = weston_placement_map_place(map, 1000, 600, &x, &y);
+		assert(cost == 0);
+
+		weston_placement_footprint_update(&maps, &footprint, &box);
+	}
+	cost = weston_placement_map_place(map, 1000, 600, &x, &y);
+	assert(cost == 50 * 60);
+
+	/* Moving it leaves nothing behind */
+	box.x1 = 500;
+	box.x2 = 1000;
+	weston_placement_footprint_update(&maps, &footprint, &box);
+	cost = weston_placement_map_place(map, 500, 600, &x, &y);
+	assert(cost == 0 && x == 0);
+
+	weston_placement_footprint_update(&maps, &footprint, NULL);
+	weston_placement_map_destroy(map);
+}
@@ -0,0 +1,168 @@
+/*
+ * Copyright © 2013 Intel Corporation
+ *
+ * Permission to use, copy, modify, distribute, and sell this software and
+ * its documentation for any purpose is hereby granted without fee, provided
+ * that the above copyright notice appear in all copies and that both that
+ * copyright notice and this permission notice appear in supporting
+ * documentation, and that the name of the copyright holders not be used in
+ * advertising or publicity pertaining to distribution of the software
+ * without specific, written prior permission.  The copyright holders make
+ * no representations about the suitability of this software for any
+ * purpose.  It is provided "as is" without express or implied warranty.
+ *
+ * THE COPYRIGHT HOLDERS DISCLAIM ALL WARRANTIES WITH REGARD TO THIS
+ * SOFTWARE, INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS, IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * SPECIAL, INDIRECT OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER
+ * RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF
+ * CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+
+#include <string.h>
+#include <unistd.h>
+
+#include "weston-test-client-helper.h"
+#include "workspaces-client-protocol.h"
+
+struct workspace_state {
+	uint32_t current;
+	uint32_t count;
+};
+
+static void
+workspace_manager_handle_state(void *data,
+			       struct workspace_manager *workspace_manager,
+			       uint32_t current, uint32_t count)
+{
+	struct workspace_state *state = data;
+
+	state->current = current;
+	state->count = count;
+}
+
+static const struct workspace_manager_listener workspace_manager_listener = {
+	workspace_manager_handle_state
+};
+
+static void
+shell_surface_handle_ping(void *data, struct wl_shell_surface *shell_surface,
+			  uint32_t serial)
+{
+	wl_shell_surface_pong(shell_surface, serial);
+}
+
+static void
+shell_surface_handle_configure(void *data,
+			       struct wl_shell_surface *shell_surface,
+			       uint32_t edges, int32_t width, int32_t height)
+{
+}
+
+static void
+shell_surface_handle_popup_done(void *data,
+				struct wl_shell_surface *shell_surface)
+{
+}
+
+static const struct wl_shell_surface_listener shell_surface_listener = {
+	shell_surface_handle_ping,
+	shell_surface_handle_configure,
+	shell_surface_handle_popup_done
+};
+
+static void *
+bind_global(struct client *client, const char *interface,
+	    const struct wl_interface *wl_interface)
+{
+	struct global *g;
+
+	wl_list_for_each(g, &client->global_list, link)
+		if (strcmp(g->interface, interface) == 0)
+			return wl_registry_bind(client->wl_registry, g->name,
+						wl_interface, 1);
+
+	assert(0 && "global not found");
+	return NULL;
+}
+
+/* A frozen surface holds back its frame callbacks, so give up after a
+ * second rather than hang. */
+static int
+frame_callback_wait_timeout(struct client *client, int *done)
+{
+	int i;
+
+	for (i = 0; i < 200 && !*done; i++) {
+		client_roundtrip(client);
+		if (!*done)
+			usleep(5000);
+	}
+
+	return *done;
+}
+
+static void
+commit_buffer(struct wl_surface *surface, struct wl_buffer *buffer,
+	      int *done)
+{
+	wl_surface_attach(surface, buffer, 0, 0);
+	wl_surface_damage(surface, 0, 0, 64, 64);
+	frame_callback_set(surface, done);
+	wl_surface_commit(surface);
+}
+
+TEST(remap_after_hidden_workspace)
+{
+	struct client *client;
+	struct workspace_manager *workspace_manager;
+	struct workspace_state state = { 0, 0 };
+	struct wl_shell *shell;
+	struct wl_shell_surface *shell_surface;
+	struct wl_surface *surface;
+	struct wl_buffer *buffer;
+	void *pixels;
+	int done;
+
+	client = client_create(100, 100, 100, 100);
+	assert(client);
+
+	workspace_manager = bind_global(client, "workspace_manager",
+					&workspace_manager_interface);
+	workspace_manager_add_listener(workspace_manager,
+				       &workspace_manager_listener, &state);
+	shell = bind_global(client, "wl_shell", &wl_shell_interface);
+	client_roundtrip(client);
+	assert(state.count >= 2);
+
+	surface = wl_compositor_create_surface(client->wl_compositor);
+	shell_surface = wl_shell_get_shell_surface(shell, surface);
+	wl_shell_surface_add_listener(shell_surface, &shell_surface_listener,
+				      NULL);
+	wl_shell_surface_set_toplevel(shell_surface);
+
+	buffer = create_shm_buffer(client, 64, 64, &pixels);
+	memset(pixels, 0xff, 64 * 64 * 4);
+	commit_buffer(surface, buffer, &done);
+	assert(frame_callback_wait_timeout(client, &done));
+
+	/* Hidden on the other workspace, the surface is frozen */
+	workspace_manager_move_surface(workspace_manager, surface,
+				       state.current + 1);
+	client_roundtrip(client);
+
+	/* Unmapped there and mapped again on the current workspace, it
+	 * has to be thawed to be shown. */
+	wl_surface_attach(surface, NULL, 0, 0);
+	wl_surface_commit(surface);
+	client_roundtrip(client);
+
+	commit_buffer(surface, buffer, &done);
+	assert(frame_callback_wait_timeout(client, &done));
+
+	wl_shell_surface_destroy(shell_surface);
+	wl_surface_destroy(surface);
+	wl_buffer_destroy(buffer);
+}